@@ -25,7 +25,10 @@ A/I Database Routines
 
 """
 
+import binascii
+import os
 import Queue
+import re
 from sqlite3 import dbapi2 as sqlite
 import threading
 
@@ -35,19 +38,42 @@ class DB:
     """
 
 
-    def __init__(self, db, commit=False):
+    def __init__(self, db, commit=False, readers=1):
         """
-        Here we initialize the queue the DB thread will run, the DB
-        thread itself (as well as daemonize it, and start it)
+        Here we initialize the queue the DB threads will run, the DB
+        threads themselves (as well as daemonize them, and start them):
+        a pool of readers, each with its own connection, and if commit is
+        set a single writer so changes stay serialized.
         """
-        self._requests = Queue.Queue()
-        self._runner = DBthread(db, self._requests, commit)
-        self._runner.setDaemon(True)
-        self._runner.start()
+        self._dBfile = db
+        self._requests = DBqueue(commit)
+        # concurrent readers only pay off when they don't block each other
+        # or the writer, so switch the database to write-ahead logging
+        if readers > 1:
+            enableWAL(db)
+        self._runners = list()
+        for i in range(max(readers, 1)):
+            self._runners.append(DBthread(db, self._requests.getReads(),
+                                          False))
+        if commit:
+            self._runners.append(DBthread(db, self._requests.getWrites(),
+                                          True))
+        for runner in self._runners:
+            runner.setDaemon(True)
+            runner.start()
+        self._index = CriteriaIndex(db, self._requests)
 
     def getQueue(self):
         return self._requests
 
+    def getCriteriaIndex(self):
+        """
+        Returns the CriteriaIndex of this database, building it on first use
+        and rebuilding it if the database file changed since it was built
+        """
+        self._index.refresh()
+        return self._index
+
     def verifyDBStructure(self):
         """
         Ensures reasonable DB schema and columns or else raises a SystemExit
@@ -79,18 +105,51 @@ class DB:
             len(columns) < 3:
             raise SystemExit(_("Error:\tDatabase columns appear malformed"))
 
+class DBqueue(object):
+    """
+    Class to hand DBrequests to the DB threads: requests which need to
+    commit go to the writer, all others to the pool of readers
+    """
+
+
+    def __init__(self, commit):
+        """
+        Create the reader queue, and the writer queue if the DB is
+        committable (otherwise committable requests go to the readers, which
+        will refuse them)
+        """
+        self._reads = Queue.Queue()
+        if commit:
+            self._writes = Queue.Queue()
+        else:
+            self._writes = self._reads
+
+    def getReads(self):
+        return self._reads
+
+    def getWrites(self):
+        return self._writes
+
+    def put(self, request):
+        """ Queue a DBrequest for the appropriate DB thread """
+        if request is not None and request.needsCommit():
+            self._writes.put(request)
+        else:
+            self._reads.put(request)
+
 class DBrequest(object):
     """
     Class to hold SQL queries and their responses
     """
 
 
-    def __init__(self, query, commit=False):
+    def __init__(self, query, commit=False, params=()):
         """
-        Set the private SQL query and create the event to flag when
-        the query has returned.
+        Set the private SQL query, the values to bind to its parameters and
+        create the event to flag when the query has returned.
         """
         self._sql = str(query)
+        self._params = tuple(params)
         self._e = threading.Event()
         self._ans = None
         self._committable = commit
@@ -105,6 +164,10 @@ class DBrequest(object):
         """ Use getSql() to access the SQL query string. """
         return(self._sql)
 
+    def getParams(self):
+        """ Use getParams() to access the values bound to the query. """
+        return(self._params)
+
     def setResponse(self, resp):
         """
         Use setResponse() to set the DB response and update the event flag.
@@ -178,6 +241,9 @@ class DBthread(threading.Thread):
                                        isolation_level="IMMEDIATE")
         else:
             self._con = sqlite.connect(self._dBfile)
+            # readers never change the database (SQLite versions without
+            # this pragma silently ignore it)
+            self._con.execute("PRAGMA query_only = ON")
         # allow access by both index and column name
         self._con.row_factory = sqlite.Row
         self._cursor = self._con.cursor()
@@ -190,7 +256,8 @@ class DBthread(threading.Thread):
                 # query and commit it
                 if request.needsCommit() and self._committable:
                     try:
-                        self._cursor.execute(request.getSql())
+                        self._cursor.execute(request.getSql(),
+                                             request.getParams())
                         self._con.commit()
                     except Exception, e:
                         # save error string for caller to trigger
@@ -203,7 +270,8 @@ class DBthread(threading.Thread):
                 # the query does not need to commit
                 elif not request.needsCommit():
                     try:
-                        self._cursor.execute(request.getSql())
+                        self._cursor.execute(request.getSql(),
+                                             request.getParams())
                     except Exception, e:
                         # save error string for caller to trigger
                         request.setResponse(_("Database failure with SQL: %s") %
@@ -223,6 +291,184 @@ class DBthread(threading.Thread):
                     # ensure we do not continue processing this request
                     continue
                 request.setResponse(self._cursor.fetchall())
+
+class CriteriaIndex(object):
+    """
+    Class holding the criteria columns of the manifests table in memory, so
+    a client's criteria can be resolved without a query per criterion.
+    The index is rebuilt whenever the database file (or its write-ahead log)
+    changes on disk, which covers publish_manifest, delete-manifest and
+    set_criteria run from other processes.
+    """
+
+    def __init__(self, db, queue):
+        """
+        Keep track of the DB filename and the request queue to load the
+        index through; the index itself is built by refresh()
+        """
+        self._dBfile = db
+        self._requests = queue
+        self._lock = threading.Lock()
+        self._stamp = None
+        self._generation = 0
+        # (columns, rows) where columns is a list of used criteria columns
+        # in table order and rows a list of (name, values) tuples with values
+        # in column order (mac values as upper case hex strings)
+        self._snapshot = ([], [])
+
+    def _getStamp(self):
+        """
+        Returns a tuple identifying the current contents of the database
+        files
+        """
+        stamp = list()
+        for path in (self._dBfile, self._dBfile + "-wal"):
+            try:
+                st = os.stat(path)
+            except OSError:
+                stamp.append(None)
+                continue
+            stamp.append((st.st_ino, st.st_size, st.st_mtime))
+        return tuple(stamp)
+
+    def refresh(self):
+        """
+        Rebuild the index if the database changed since it was last built
+        """
+        stamp = self._getStamp()
+        if stamp == self._stamp:
+            return
+        self._lock.acquire()
+        try:
+            # another thread may have rebuilt it while we waited
+            if stamp == self._stamp:
+                return
+            self._build()
+            # the stamp is taken before loading the rows, so a change made
+            # while loading triggers another rebuild on the next lookup
+            self._stamp = stamp
+            self._generation += 1
+        finally:
+            self._lock.release()
+
+    def getGeneration(self):
+        """
+        Returns a number which changes every time the index is rebuilt, for
+        callers caching anything derived from the database
+        """
+        return self._generation
+
+    def _build(self):
+        """
+        Load the used criteria columns of every manifest instance
+        """
+        columns = list(getCriteria(self._requests, onlyUsed=True,
+                                   strip=False))
+
+        queryStr = "SELECT name"
+        for col in columns:
+            if col.endswith('mac'):
+                # keep NULL distinguishable from an empty HEX() string
+                queryStr += (", CASE WHEN " + col + " IS NULL THEN NULL " +
+                             "ELSE HEX(" + col + ") END")
+            else:
+                queryStr += ", " + col
+        queryStr += " FROM manifests"
+        query = DBrequest(queryStr)
+        self._requests.put(query)
+        query.waitAns()
+        response = query.getResponse()
+        if response is None:
+            raise RuntimeError(_("Unable to load the criteria index"))
+
+        rows = list()
+        for row in response:
+            rows.append((row[0],
+                         tuple([row[i] for i in range(1, len(columns) + 1)])))
+        self._snapshot = (columns, rows)
+
+    def _compile(self, columns, criteria):
+        """
+        Turn the client's criteria into one predicate per column, in column
+        order. Returns None if a criteria is missing or malformed (which
+        is what made the SQL based lookup fail and serve the default).
+        """
+        preds = list()
+        for crit in columns:
+            if crit.startswith("MIN") or crit.startswith("MAX"):
+                key = crit[3:]
+            else:
+                key = crit
+            try:
+                value = sanitizeSQL(criteria[key])
+            except KeyError:
+                print _("Missing criteria: %s;returning 0 - oft default.xml") \
+                      % crit
+                return None
+
+            if crit.endswith("mac") and key != crit:
+                # the SQL lookup compared HEX() strings, where a NULL
+                # column compares as an empty string
+                if not re.match("^([0-9a-fA-F]{2})*$", value):
+                    print _("Bad criteria: %s;returning 0 - oft " +
+                            "default.xml") % crit
+                    return None
+                value = value.upper()
+                if crit.startswith("MIN"):
+                    preds.append(lambda col, v=value: (col or "") <= v)
+                else:
+                    preds.append(lambda col, v=value: (col or "") >= v)
+            elif key != crit:
+                try:
+                    value = long(value)
+                except ValueError:
+                    try:
+                        value = float(value)
+                    except ValueError:
+                        print _("Bad criteria: %s;returning 0 - oft " +
+                                "default.xml") % crit
+                        return None
+                if crit.startswith("MIN"):
+                    preds.append(lambda col, v=value: col is not None and
+                                 _sqlNumCmp(col, v) <= 0)
+                else:
+                    preds.append(lambda col, v=value: col is not None and
+                                 _sqlNumCmp(col, v) >= 0)
+            else:
+                # a double quote would have ended the SQL string literal
+                if '"' in value:
+                    print _("Bad criteria: %s;returning 0 - oft " +
+                            "default.xml") % crit
+                    return None
+                # single values are stored in lower case
+                value = value.lower()
+                preds.append(lambda col, v=value: col is not None and
+                             col == v)
+        return preds
+
+    def match(self, criteria):
+        """
+        Returns the names of the manifest instances matching criteria. Each
+        criteria narrows down the candidates as long as at least one
+        candidate matches it; if none does, only the candidates which do
+        not specify that criteria are kept. Returns None if the criteria
+        can not be resolved.
+        """
+        (columns, rows) = self._snapshot
+        preds = self._compile(columns, criteria)
+        if preds is None:
+            return None
+
+        candidates = rows
+        for (i, pred) in enumerate(preds):
+            matched = [row for row in candidates if pred(row[1][i])]
+            if not matched:
+                # criteria reduced effective set to zero (fall back to the
+                # rows with a NULL criteria instead)
+                matched = [row for row in candidates if row[1][i] is None]
+            candidates = matched
+        return [row[0] for row in candidates]
+
 #
 # Functions below here
 #
@@ -233,6 +479,8 @@ def sanitizeSQL(s):
     unintended results if unexpectedly embedded in an SQL query.
     This shouldn't be expected to make a SQL injection attack somehow
     return valid data, but it should cause it to not be a threat to the DB.
+    (Queries now bind their values as parameters; this is kept so client
+    criteria are normalized the way manifest lookups always did.)
     """
     s = s.replace('%', '')
     s = s.replace('*', '')
@@ -245,10 +493,48 @@ def sanitizeSQL(s):
     # format
     return str(s)
 
+def enableWAL(db):
+    """
+    Switch the database db to write-ahead logging, so readers do not block
+    each other or a writer. Returns True if the database is in WAL mode;
+    older SQLite versions, or a database we can't write, stay as they are.
+    """
+    try:
+        con = sqlite.connect(db)
+        try:
+            mode = con.execute("PRAGMA journal_mode = WAL").fetchone()[0]
+        finally:
+            con.close()
+    except sqlite.Error:
+        return False
+    return str(mode).lower() == "wal"
+
+def rangeValue(crit, value):
+    """
+    Returns value formatted to be bound to the MIN/MAX column of the range
+    criteria crit: MAC addresses (hex digits) are stored as blobs, numbers
+    as integers
+    """
+    if crit.endswith("mac"):
+        return sqlite.Binary(binascii.unhexlify(str(value)))
+    try:
+        return long(value)
+    except ValueError:
+        return str(value).upper()
+
+def _sqlNumCmp(col, value):
+    """
+    Compare a stored column value to a number the way SQLite does, where
+    any number sorts before any text or blob.
+    """
+    if isinstance(col, (int, long, float)):
+        return cmp(col, value)
+    return 1
+
 def numInstances(manifest, queue):
     """ Run to return the number of instances for manifest in the DB """
     query = DBrequest('SELECT COUNT(instance) FROM manifests WHERE ' +
-                      'name = "' + manifest + '"')
+                      'name = ?', params=(manifest,))
     queue.put(query)
     query.waitAns()
     return(query.getResponse()[0][0])
@@ -265,16 +551,13 @@ def getManNames(queue):
     Use to create a generator which provides the names of manifests
     in the DB
     """
-    # Whether the DBrequest should be in or out of the for loop depends on if
-    # doing one large SQL query and iterating the responses (but holding the
-    # response in memory) is better than requesting row by row, and
-    # doing more DB transactions in less memory
-    for i in range(numManifests(queue)):
-        query = DBrequest('SELECT DISTINCT(name) FROM manifests LIMIT 1 ' +
-                          'OFFSET %s' % i)
-        queue.put(query)
-        query.waitAns()
-        yield(query.getResponse()[0][0])
+    # one query for all names; asking row by row with LIMIT/OFFSET costs
+    # a DB round trip and a rescan of the table per manifest
+    query = DBrequest('SELECT DISTINCT(name) FROM manifests')
+    queue.put(query)
+    query.waitAns()
+    for row in query.getResponse():
+        yield(row[0])
     return
 
 def findManifestsByCriteria(queue, criteria):
@@ -286,14 +569,14 @@ def findManifestsByCriteria(queue, criteria):
     # warning if there's a massive number of criteria this may pass the SQL
     # query length for the database in use
     for crit in criteria:
-        queryStr += crit[0] + ' = "' + crit[1l] + '" AND '
+        queryStr += crit[0] + ' = ? AND '
     else:
-        # cut off extraneous '" AND '
+        # cut off extraneous ' AND '
         queryStr = queryStr[:-5]
-    query = DBrequest(queryStr)
+    query = DBrequest(queryStr, params=[crit[1] for crit in criteria])
     queue.put(query)
     query.waitAns()
-    return(query.respnse())
+    return(query.getResponse())
 
 def getSpecificCriteria(queue, criteria, criteria2=None,
                         provideManNameAndInstance=False,
@@ -330,11 +613,13 @@ def getSpecificCriteria(queue, criteria, criteria2=None,
             queryStr += (criteria + " FROM manifests WHERE " + criteria +
                          " IS NOT NULL")
 
+    params = list()
     if excludeManifests is not None:
         for manifest in excludeManifests:
-            queryStr += " AND name IS NOT '" + manifest + "'"
+            queryStr += " AND name IS NOT ?"
+            params.append(manifest)
 
-    query = DBrequest(queryStr)
+    query = DBrequest(queryStr, params=params)
     queue.put(query)
     query.waitAns()
     return(query.getResponse())
@@ -441,9 +726,8 @@ def getManifestCriteria(name, instance, queue, humanOutput=False,
             queryStr = queryStr[:-2]
         else:
             raise AssertionError(_("Database contains no criteria!"))
-    queryStr += ' FROM manifests WHERE name = "' + name + \
-                '" AND instance = "' + str(instance) + '"'
-    query = DBrequest(queryStr)
+    queryStr += ' FROM manifests WHERE name = ? AND instance = ?'
+    query = DBrequest(queryStr, params=(name, instance))
     queue.put(query)
     query.waitAns()
     return query.getResponse()[0]
@@ -458,71 +742,15 @@ def findManifest(criteria, db):
     if len(criteria) == 0:
         return 0
 
-    curCount = 0
-    queryStr = "SELECT name FROM manifests WHERE "
-    for crit in getCriteria(db.getQueue(), strip=False):
-        prevCount = curCount
-        queryStr1 = queryStr
-        try:
-            if crit.startswith("MIN"):
-                if crit.endswith("mac"):
-                    # setup a clause like HEX(MINmac) <= HEX(x'F00')
-                    queryStr1 += "HEX(" + crit + ") <= HEX(x'" + \
-                                 sanitizeSQL(
-                                 criteria[crit.replace('MIN', '',1)]) + "')"
-                else:
-                    # setup a clause like crit <= value
-                    queryStr1 += crit + " " + "<= " + \
-                                 sanitizeSQL(criteria[crit.replace('MIN', '',1)])
-            elif crit.startswith("MAX"):
-                if crit.endswith("mac"):
-                    # setup a clause like HEX(MINmac) >= HEX(x'F000')
-                    queryStr1 += "HEX(" + crit + ") >= HEX(x'" + \
-                                 sanitizeSQL(
-                                 criteria[crit.replace('MAX', '',1)]) + "')"
-                else:
-                    # setup a clause like crit <= value
-                    queryStr1 += crit + " " + ">= " + \
-                                 sanitizeSQL(criteria[crit.replace('MAX', '',1)])
-            else:
-                # store single values in lower case
-                # setup a clause like crit = lower(value)
-                queryStr1 += crit + " " + '= LOWER("' + \
-                             sanitizeSQL(criteria[crit]) + '")'
-        except KeyError:
-            print _("Missing criteria: %s;returning 0 - oft default.xml") % crit
-            return 0
-        query = DBrequest(queryStr1)
-        db.getQueue().put(query)
-        query.waitAns()
-
-        try:
-            curCount = len(query.getResponse())
-        except Exception:
-            # we'll not get a response if we were provided a criteria which
-            # isn't in the DB (we'll generate a DB error); shouldn't happen
-            # unless getCriteria() is really confused
-            print _("Bad criteria: %s;returning 0 - oft default.xml") % crit
-            return 0
-
-        if len(query.getResponse()) >= 1:
-            queryStr = queryStr1 + " AND "
-        else:
-            # criteria reduced effective set to zero (add a NULL criteria
-            # instead)
-            queryStr += crit + " IS NULL AND "
-    else:
-        # remove extraneous " AND "
-        queryStr = queryStr[:-5]
-    query = DBrequest(queryStr)
-    db.getQueue().put(query)
-    query.waitAns()
+    names = db.getCriteriaIndex().match(criteria)
+    if names is None:
+        return 0
 
     # see if we got one, more or zero manifests back
-    if len(query.getResponse()) == 1:
-        return query.getResponse()[0]['name']
-    elif len(query.getResponse()) > 1:
-        return len(query.getResponse())
+    if len(names) == 1:
+        return names[0]
+    elif len(names) > 1:
+        return len(names)
     # got zero manifests back
     else:
         return 0
@@ -73,8 +73,8 @@ def delete_manifest_from_DB(DB, manifest_instance, dataLoc):
     # if we do not have an instance remove the entire manifest
     if instance is None:
         # remove manifest from database
-        query = AIdb.DBrequest("DELETE FROM manifests WHERE name = '%s'" %
-                               AIdb.sanitizeSQL(man_name), commit=True)
+        query = AIdb.DBrequest("DELETE FROM manifests WHERE name = ?",
+                               commit=True, params=(man_name,))
         DB.getQueue().put(query)
         query.waitAns()
         # run getResponse to handle and errors
@@ -98,9 +98,8 @@ def delete_manifest_from_DB(DB, manifest_instance, dataLoc):
                               AIdb.numInstances(man_name, DB.getQueue()))))
 
         # remove instance from database
-        query = "DELETE FROM manifests WHERE name = '%s' AND instance = '%i'" %\
-                (man_name, instance)
-        query = AIdb.DBrequest(query, commit=True)
+        query = "DELETE FROM manifests WHERE name = ? AND instance = ?"
+        query = AIdb.DBrequest(query, commit=True, params=(man_name, instance))
         DB.getQueue().put(query)
         query.waitAns()
         # run getResponse to handle and errors
@@ -115,10 +114,10 @@ def delete_manifest_from_DB(DB, manifest_instance, dataLoc):
         for num in range(instance, AIdb.numInstances(man_name,
                                                      DB.getQueue())+1):
             # now decrement the instance number
-            query = "UPDATE manifests SET instance = '%i' WHERE name = '%s' " %\
-                   (num-1, AIdb.sanitizeSQL(man_name))
-            query += "AND instance = '%i'" % num
-            query = AIdb.DBrequest(query, commit=True)
+            query = "UPDATE manifests SET instance = ? WHERE name = ? " + \
+                    "AND instance = ?"
+            query = AIdb.DBrequest(query, commit=True,
+                                   params=(num - 1, man_name, num))
             DB.getQueue().put(query)
             query.waitAns()
             # run getResponse to handle and errors
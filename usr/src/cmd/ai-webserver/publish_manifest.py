@@ -464,25 +464,26 @@ def insert_SQL(files):
     Args: None
     Returns: None
     """
-    query = "INSERT INTO manifests VALUES("
+    # the values to insert, in column order
+    values = list()
 
-    # add the manifest name to the query string
-    query += "'" + AIdb.sanitizeSQL(files.manifest_name) + "',"
+    # add the manifest name to the values
+    values.append(files.manifest_name)
     # check to see if manifest name is alreay in database (affects instance
     # number)
-    if AIdb.sanitizeSQL(files.manifest_name) in \
+    if files.manifest_name in \
         AIdb.getManNames(files.database.getQueue()):
             # database already has this manifest name get the number of
             # instances
-        instance = AIdb.numInstances(AIdb.sanitizeSQL(files.manifest_name),
+        instance = AIdb.numInstances(files.manifest_name,
                                      files.database.getQueue())
 
     # this a new manifest
     else:
         instance = 0
 
-    # actually add the instance to the query string
-    query += str(instance) + ","
+    # actually add the instance to the values
+    values.append(instance)
 
     # we need to fill in the criteria or NULLs for each criteria the database
     # supports (so iterate over each criteria)
@@ -494,46 +495,44 @@ def insert_SQL(files):
             continue
 
         # get the values from the manifest
-        values = files.criteria[crit.replace('MAX', '', 1)]
+        crit_values = files.criteria[crit.replace('MAX', '', 1)]
 
         # If the critera manifest didn't specify this criteria, fill in NULLs
-        if values is None:
+        if crit_values is None:
             # use the criteria name to determine if this is a range
             if crit.startswith('MAX'):
-                query += "NULL,NULL,"
+                values.extend([None, None])
             # this is a single value
             else:
-                query += "NULL,"
+                values.append(None)
 
         # this is a single criteria (not a range)
-        elif isinstance(values, basestring):
+        elif isinstance(crit_values, basestring):
             # translate "unbounded" to a database NULL
-            if values == "unbounded":
-                query += "NULL,"
+            if crit_values == "unbounded":
+                values.append(None)
             else:
                 # use lower case for text strings
-                query += "'" + AIdb.sanitizeSQL(str(values).lower()) + "',"
+                values.append(str(crit_values).lower())
 
         # else values is a range
         else:
-            for value in values:
+            for value in crit_values:
                 # translate "unbounded" to a database NULL
                 if value == "unbounded":
-                    query += "NULL,"
-                # we need to deal with mac addresses specially being
-                # hexadecimal
+                    values.append(None)
+                # mac addresses are hexadecimal, stored as blobs (use an
+                # upper case string for hex values)
                 elif crit.endswith("mac"):
-                    # need to insert with hex operand x'<val>'
-                    # use an upper case string for hex values
-                    query += "x'" + AIdb.sanitizeSQL(str(value).upper())+"',"
+                    values.append(AIdb.rangeValue(crit, str(value).upper()))
                 else:
-                    query += AIdb.sanitizeSQL(str(value).upper()) + ","
+                    values.append(AIdb.rangeValue(crit, value))
 
-    # strip trailing comma and close parentheses
-    query = query[:-1] + ")"
+    query = "INSERT INTO manifests VALUES(" + \
+            ",".join(["?"] * len(values)) + ")"
 
     # update the database
-    query = AIdb.DBrequest(query, commit=True)
+    query = AIdb.DBrequest(query, commit=True, params=values)
     files.database.getQueue().put(query)
     query.waitAns()
     # in case there's an error call the response function (which will print the
@@ -101,7 +101,7 @@ def check_published_manifest(service_dir, db, manifest_name):
     """
 
     # Check if manifest exists in the service's criteria DB.
-    if AIdb.sanitizeSQL(manifest_name) not in AIdb.getManNames(db.getQueue()):
+    if manifest_name not in AIdb.getManNames(db.getQueue()):
         print(_("Error: install service does not contain the specified "
                 "manifest: %s") % manifest_name)
         return False
@@ -123,20 +123,14 @@ def format_value(crit, value):
     Args: crit - the criteria name.
           value - the value to format.
     Returns:
-          Formatted value for (used by set_criteria()) to use in
-          a string to query the install service's DB.
+          Formatted value for (used by set_criteria()) to bind to
+          a parameter of the query to the install service's DB.
     """
     # For the value "unbounded", we store this as "NULL" in the DB.
     if value == "unbounded":
-        return "NULL"
+        return None
     else:
-        formatted_val = "'" + AIdb.sanitizeSQL(str(value).upper()) + "'"
-
-        # If its the "mac" criteria, must add a special hex operand
-        if crit == "mac":
-            return "x" + formatted_val
-
-        return formatted_val
+        return AIdb.rangeValue(crit, value)
 
 def set_criteria(criteria, manifest_name, db, append=False):
     """
@@ -148,8 +142,18 @@ def set_criteria(criteria, manifest_name, db, append=False):
     set for the manifest, and use only the criteria specified.
     """
 
-    # Build a list of criteria nvpairs to update
+    # Build a list of criteria nvpairs to update, and the values to bind to
+    # their parameters
     nvpairs = list()
+    params = list()
+
+    def add_nvpair(column, value):
+        """ Set column to value, or to NULL if value is None """
+        if value is None:
+            nvpairs.append(column + "=NULL")
+        else:
+            nvpairs.append(column + "=?")
+            params.append(value)
 
     # we need to fill in the criteria or NULLs for each criteria the database
     # supports (so iterate over each criteria)
@@ -177,26 +181,24 @@ def set_criteria(criteria, manifest_name, db, append=False):
         elif isinstance(values, basestring):
             # translate "unbounded" to a database NULL
             if values == "unbounded":
-                nvstr = crit + "=NULL"
+                add_nvpair(crit, None)
             else:
                 # use lower case for text strings
-                nvstr = crit + "='" + AIdb.sanitizeSQL(str(values).lower()) \
-                        + "'"
-            nvpairs.append(nvstr)
+                add_nvpair(crit, str(values).lower())
 
         # Else the values are a list this is a range criteria
         else:
             # Set the MIN column for this range criteria
-            nvpairs.append("MIN" + crit + "=" + format_value(crit, values[0]))
+            add_nvpair("MIN" + crit, format_value(crit, values[0]))
 
             # Set the MAX column for this range criteria
-            nvpairs.append("MAX" + crit + "=" + format_value(crit, values[1]))
+            add_nvpair("MAX" + crit, format_value(crit, values[1]))
 
-    query = "UPDATE manifests SET " + ",".join(nvpairs) + \
-            " WHERE name='" + manifest_name + "'"
+    query = "UPDATE manifests SET " + ",".join(nvpairs) + " WHERE name=?"
+    params.append(manifest_name)
 
     # update the DB
-    query = AIdb.DBrequest(query, commit=True)
+    query = AIdb.DBrequest(query, commit=True, params=params)
     db.getQueue().put(query)
     query.waitAns()
     # in case there's an error call the response function (which
@@ -0,0 +1,467 @@
+#!/usr/bin/python2.7
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+
+'''
+Load generator for the AI webserver.
+
+Populates a scratch AI service with a number of manifests, starts the
+webserver on the loopback interface and has a number of concurrent simulated
+AI clients boot against it the way ai_get_manifest does: fetch the criteria
+list from manifest.xml, then POST the client's criteria to get its manifest.
+Latency percentiles and the request rate are reported once all clients are
+done. Nothing leaves the local host.
+
+This is not a unit test (and so is not named test_*); run it by hand, with
+the same PYTHONPATH as the tests (see usr/src/tools/tests/README):
+
+    bench_webserver.py -n 1000 -c 50 -r 20
+
+By default the webserver.py next to this directory is used; use -w to point
+at another one (e.g. the one in the proto area).
+'''
+
+import errno
+import gettext
+import httplib
+import os
+import random
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib
+from optparse import OptionParser
+from sqlite3 import dbapi2 as sqlite
+
+gettext.install("ai-test")
+
+# the schema of a fresh AI.db (see the AI.db target of ../Makefile)
+SCHEMA = 'CREATE TABLE manifests (name TEXT, instance INTEGER, arch TEXT, ' \
+         'MINmac INTEGER, MAXmac INTEGER, MINipv4 INTEGER, MAXipv4 INTEGER, ' \
+         'cpu TEXT, platform TEXT, MINnetwork INTEGER, MAXnetwork INTEGER, ' \
+         'MINmem INTEGER, MAXmem INTEGER)'
+
+# criteria a manifest can be selected by, see ManifestSet
+KINDS = ["arch", "mac", "ipv4", "mem"]
+
+# architectures used by "arch" manifests; every other client is an i86pc so
+# it never matches one of them by accident
+ARCH_VALUES = ["sun4u", "sun4v"]
+
+# the blocks each manifest's range is carved out of
+MAC_BASE = 0x080020000000
+MAC_BLOCK = 0x100
+IPV4_BASE = (10 << 24)
+IPV4_BLOCK = 0x100
+MEM_BASE = 1024
+MEM_BLOCK = 64
+
+# Where the values of clients matching no range are taken from. Each MIN and
+# MAX column narrows the candidates down on its own, so such a client must
+# satisfy no bound at all (or it is left with just the manifests of that
+# kind): below every block for numbers, above every block for MACs, where a
+# NULL MINmac compares as the lowest address.
+MAC_UNMATCHED = 0x0A0000000000
+IPV4_UNMATCHED = (9 << 24)
+MEM_UNMATCHED = 256
+
+MANIFEST = '''<ai_criteria_manifest>
+    <ai_embedded_manifest>
+        <ai_manifest name="%s">
+            <ai_pkg_repo_default_publisher>
+                <main url="http://pkg.opensolaris.org/release"
+                    publisher="opensolaris.org"/>
+            </ai_pkg_repo_default_publisher>
+            <ai_install_packages>
+                <pkg name="entire"/>
+                <pkg name="SUNWcsd"/>
+                <pkg name="SUNWcs"/>
+                <pkg name="babel_install"/>
+            </ai_install_packages>
+        </ai_manifest>
+    </ai_embedded_manifest>
+</ai_criteria_manifest>
+'''
+
+
+def parse_options():
+    '''Parse and validate options'''
+    parser = OptionParser(usage=_("usage: %prog [options]"))
+    parser.add_option("-n", "--manifests", dest="manifests", default=100,
+                      type="int", help=_("number of manifests to publish"))
+    parser.add_option("-m", "--mix", dest="mix",
+                      default="arch=1,mac=1,ipv4=1,mem=1",
+                      help=_("relative weights of the criteria manifests are "
+                             "selected by, as kind=weight,... with kinds "
+                             "arch, mac, ipv4 and mem"))
+    parser.add_option("-c", "--clients", dest="clients", default=10,
+                      type="int", help=_("number of concurrent clients"))
+    parser.add_option("-r", "--requests", dest="requests", default=10,
+                      type="int", help=_("number of boots per client"))
+    parser.add_option("-u", "--unmatched", dest="unmatched", default=0.1,
+                      type="float", help=_("fraction of the boots matching "
+                                           "no manifest (served default.xml)"))
+    parser.add_option("-t", "--threads", dest="threads", default=10,
+                      type="int", help=_("number of webserver threads"))
+    parser.add_option("-p", "--port", dest="port", default=0, type="int",
+                      help=_("port to run the webserver on (default: any "
+                             "free port)"))
+    parser.add_option("-w", "--webserver", dest="webserver",
+                      default=os.path.join(os.path.dirname(
+                          os.path.abspath(__file__)), "..", "webserver.py"),
+                      help=_("webserver program to benchmark"))
+    parser.add_option("-s", "--seed", dest="seed", default=None, type="int",
+                      help=_("random seed, to replay the same run"))
+    parser.add_option("-k", "--keep", dest="keep", default=False,
+                      action="store_true",
+                      help=_("keep the scratch service directory"))
+
+    (options, args) = parser.parse_args()
+    if args or options.manifests < 1 or options.clients < 1 or \
+        options.requests < 1 or not 0 <= options.unmatched <= 1:
+        parser.print_help()
+        sys.exit(1)
+    try:
+        options.mix = parse_mix(options.mix)
+    except ValueError, err:
+        parser.error(str(err))
+    return options
+
+
+def parse_mix(mix):
+    '''
+    Parse a kind=weight,... criteria mix into a list of (kind, weight),
+    raising ValueError if it is malformed
+    '''
+    weights = []
+    for item in mix.split(","):
+        try:
+            (kind, weight) = item.split("=", 1)
+            weight = float(weight)
+        except ValueError:
+            raise ValueError(_("malformed criteria mix entry: %s") % item)
+        if kind not in KINDS or weight < 0:
+            raise ValueError(_("unknown criteria mix entry: %s") % item)
+        if weight:
+            weights.append((kind, weight))
+    if not weights:
+        raise ValueError(_("criteria mix has no weight"))
+    return weights
+
+
+def percentile(samples, pct):
+    '''Returns the pct percentile of a sorted list of samples'''
+    if not samples:
+        return 0.0
+    return samples[min(len(samples) - 1, int(len(samples) * pct / 100.0))]
+
+
+class ManifestSet(object):
+    '''
+    The manifests of the scratch service. Each manifest is selected by one
+    kind of criteria with a value or range no other manifest uses, so every
+    client either matches exactly one manifest or none:
+
+        arch - arch and platform ("bench<n>")
+        mac  - a MINmac/MAXmac block of MAC_BLOCK addresses
+        ipv4 - a MINipv4/MAXipv4 block of IPV4_BLOCK addresses
+        mem  - a MINmem/MAXmem block of MEM_BLOCK megabytes
+    '''
+
+    def __init__(self, count, mix, rand):
+        self.rand = rand
+        self.manifests = []
+        total = sum([weight for (kind, weight) in mix])
+        for i in range(count):
+            pick = rand.uniform(0, total)
+            for (kind, weight) in mix:
+                pick -= weight
+                if pick <= 0:
+                    break
+            self.manifests.append(("bench%d.xml" % i, kind, i))
+
+    def populate(self, data_loc):
+        '''Create the AI.db and AI_data of a service in data_loc'''
+        ai_data = os.path.join(data_loc, "AI_data")
+        os.mkdir(ai_data)
+        for name in ["default.xml"] + \
+            [name for (name, kind, i) in self.manifests]:
+            manifest_file = open(os.path.join(ai_data, name), "w")
+            manifest_file.write(MANIFEST % name)
+            manifest_file.close()
+
+        con = sqlite.connect(os.path.join(data_loc, "AI.db"))
+        con.execute(SCHEMA)
+        for (name, kind, i) in self.manifests:
+            row = {"name": name, "instance": 0}
+            if kind == "arch":
+                row["arch"] = ARCH_VALUES[i % len(ARCH_VALUES)]
+                row["platform"] = "bench%d" % i
+            elif kind == "mac":
+                row["MINmac"] = sqlite.Binary(self.mac(i, 0).decode("hex"))
+                row["MAXmac"] = sqlite.Binary(
+                    self.mac(i, MAC_BLOCK - 1).decode("hex"))
+            elif kind == "ipv4":
+                # stored as the digits publish_manifest stores them as
+                row["MINipv4"] = long(self.ipv4(i, 0))
+                row["MAXipv4"] = long(self.ipv4(i, IPV4_BLOCK - 1))
+            else:
+                row["MINmem"] = MEM_BASE + i * MEM_BLOCK
+                row["MAXmem"] = MEM_BASE + (i + 1) * MEM_BLOCK - 1
+            con.execute("INSERT INTO manifests (" + ", ".join(row.keys()) +
+                        ") VALUES (" + ", ".join(["?"] * len(row)) + ")",
+                        row.values())
+        con.commit()
+        con.close()
+
+    @staticmethod
+    def mac(i, offset):
+        '''MAC address offset in the block of manifest i, as hex digits'''
+        return "%012X" % (MAC_BASE + i * MAC_BLOCK + offset)
+
+    @staticmethod
+    def ipv4_digits(addr):
+        '''IPv4 address addr as the 12 digits clients send'''
+        return "%03d%03d%03d%03d" % (addr >> 24, (addr >> 16) & 0xff,
+                                     (addr >> 8) & 0xff, addr & 0xff)
+
+    @classmethod
+    def ipv4(cls, i, offset):
+        '''IPv4 address offset in the block of manifest i, as digits'''
+        return cls.ipv4_digits(IPV4_BASE + i * IPV4_BLOCK + offset)
+
+    def client(self, unmatched):
+        '''
+        Returns the criteria of a random client and the name of the
+        manifest it should be served
+        '''
+        rand = self.rand
+        # criteria matching no manifest
+        criteria = {"arch": "i86pc",
+                    "platform": "i86pc",
+                    "cpu": "i386",
+                    "mac": "%012X" % (MAC_UNMATCHED +
+                                      rand.randint(0, 0xffffff)),
+                    "ipv4": self.ipv4_digits(IPV4_UNMATCHED +
+                                             rand.randint(0, 0xffff)),
+                    "network": "009000000000",
+                    "mem": str(rand.randint(MEM_UNMATCHED, MEM_BASE - 1))}
+        if rand.random() < unmatched:
+            return (criteria, "default.xml")
+
+        (name, kind, i) = rand.choice(self.manifests)
+        if kind == "arch":
+            criteria["arch"] = ARCH_VALUES[i % len(ARCH_VALUES)]
+            criteria["platform"] = "bench%d" % i
+        elif kind == "mac":
+            criteria["mac"] = self.mac(i, rand.randint(0, MAC_BLOCK - 1))
+        elif kind == "ipv4":
+            criteria["ipv4"] = self.ipv4(i, rand.randint(0, IPV4_BLOCK - 1))
+        else:
+            criteria["mem"] = str(MEM_BASE + i * MEM_BLOCK +
+                                  rand.randint(0, MEM_BLOCK - 1))
+        return (criteria, name)
+
+
+class Client(threading.Thread):
+    '''
+    A simulated AI client booting a number of times, each boot as a new
+    machine. Like ai_get_manifest, every request uses a connection of its
+    own.
+    '''
+
+    def __init__(self, address, boots):
+        threading.Thread.__init__(self)
+        self.address = address
+        self.boots = boots
+        # latencies of the criteria list and manifest requests
+        self.list_times = []
+        self.manifest_times = []
+        self.wrong = 0
+        self.errors = []
+
+    def request(self, method, body=None):
+        '''Returns the status, headers and data of a manifest.xml request'''
+        conn = httplib.HTTPConnection(self.address)
+        try:
+            if body is None:
+                conn.request(method, "/manifest.xml")
+            else:
+                conn.request(method, "/manifest.xml", body,
+                             {"Content-Type":
+                              "application/x-www-form-urlencoded"})
+            resp = conn.getresponse()
+            return (resp.status, resp.getheader("Content-Disposition", ""),
+                    resp.read())
+        finally:
+            conn.close()
+
+    def run(self):
+        for (criteria, expected) in self.boots:
+            try:
+                start = time.time()
+                (status, disposition, data) = self.request("GET")
+                self.list_times.append(time.time() - start)
+                if status != httplib.OK or "CriteriaList" not in data:
+                    self.errors.append(_("criteria list: HTTP %d") % status)
+                    continue
+
+                post_data = ";".join(["%s=%s" % item for item in
+                                      sorted(criteria.items())])
+                start = time.time()
+                (status, disposition, data) = self.request("POST",
+                    urllib.urlencode({"postData": post_data}))
+                self.manifest_times.append(time.time() - start)
+                if status != httplib.OK:
+                    self.errors.append(_("manifest: HTTP %d") % status)
+                elif ('filename="%s"' % expected) not in disposition:
+                    self.wrong += 1
+            except (socket.error, httplib.HTTPException), err:
+                self.errors.append(str(err))
+
+
+def free_port():
+    '''Returns a loopback port nothing listens on'''
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(("127.0.0.1", 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+def start_server(webserver, data_loc, port, threads):
+    '''
+    Start the webserver on the loopback interface and wait until it serves
+    the criteria list. Returns the server process.
+    '''
+    log = open(os.path.join(data_loc, "webserver.log"), "w")
+    proc = subprocess.Popen([sys.executable, webserver, "-l", "127.0.0.1",
+                             "-p", str(port), "-t", str(threads), data_loc],
+                            stdout=log, stderr=subprocess.STDOUT)
+    log.close()
+    deadline = time.time() + 30
+    while time.time() < deadline:
+        if proc.poll() is not None:
+            raise SystemExit(_("Error:\twebserver exited (%d), see %s") %
+                             (proc.returncode,
+                              os.path.join(data_loc, "webserver.log")))
+        try:
+            conn = httplib.HTTPConnection("127.0.0.1:%d" % port)
+            conn.request("GET", "/manifest.xml")
+            if conn.getresponse().status == httplib.OK:
+                conn.close()
+                return proc
+            conn.close()
+        except (socket.error, httplib.HTTPException):
+            pass
+        time.sleep(0.1)
+    stop_server(proc)
+    raise SystemExit(_("Error:\twebserver did not come up on port %d") % port)
+
+
+def stop_server(proc):
+    '''Stop the webserver'''
+    try:
+        proc.terminate()
+    except OSError, err:
+        if err.errno != errno.ESRCH:
+            raise
+    proc.wait()
+
+
+def report(label, samples):
+    '''Print latency percentiles of samples'''
+    samples.sort()
+    print _("%-10s %8d requests  p50 %8.2f ms  p99 %8.2f ms  "
+            "max %8.2f ms") % (label, len(samples),
+                               percentile(samples, 50) * 1000,
+                               percentile(samples, 99) * 1000,
+                               (samples and samples[-1] or 0) * 1000)
+
+
+def main():
+    '''Run the benchmark'''
+    options = parse_options()
+    rand = random.Random(options.seed)
+    manifests = ManifestSet(options.manifests, options.mix, rand)
+
+    data_loc = tempfile.mkdtemp(prefix="ai-bench.")
+    try:
+        manifests.populate(data_loc)
+        boots = [[manifests.client(options.unmatched)
+                  for j in range(options.requests)]
+                 for i in range(options.clients)]
+
+        port = options.port or free_port()
+        proc = start_server(options.webserver, data_loc, port,
+                            options.threads)
+        try:
+            clients = [Client("127.0.0.1:%d" % port, boots[i])
+                       for i in range(options.clients)]
+            start = time.time()
+            for client in clients:
+                client.start()
+            for client in clients:
+                client.join()
+            elapsed = time.time() - start
+        finally:
+            stop_server(proc)
+    finally:
+        if options.keep:
+            print _("service directory: %s") % data_loc
+        else:
+            shutil.rmtree(data_loc, ignore_errors=True)
+
+    list_times = []
+    manifest_times = []
+    errors = []
+    wrong = 0
+    for client in clients:
+        list_times.extend(client.list_times)
+        manifest_times.extend(client.manifest_times)
+        errors.extend(client.errors)
+        wrong += client.wrong
+
+    print _("%d manifests, %d clients x %d boots, %d server threads") % \
+        (options.manifests, options.clients, options.requests,
+         options.threads)
+    report(_("criteria"), list_times)
+    report(_("manifest"), manifest_times)
+    report(_("all"), list_times + manifest_times)
+    print _("%.1f requests/sec, %.1f boots/sec over %.2f s") % \
+        ((len(list_times) + len(manifest_times)) / elapsed,
+         len(manifest_times) / elapsed, elapsed)
+    if wrong or errors:
+        print _("%d wrong manifests served, %d failed requests") % \
+            (wrong, len(errors))
+        for err in sorted(set(errors)):
+            print "    " + err
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -30,7 +30,12 @@ must be rebuilt for these tests to pick up any changes in the tested code.
 '''
 
 import gettext
+import os
+import shutil
+import tempfile
+import time
 import unittest
+from sqlite3 import dbapi2 as sqlite
 import osol_install.auto_install.AI_database as AIdb
 
 gettext.install("ai-test")
@@ -55,9 +60,11 @@ class MockQuery(object):
     '''Class for mock query '''
     def __init__(self):
         self.query = None
+        self.params = None
 
-    def __call__(self, query, commit=False):
+    def __call__(self, query, commit=False, params=()):
         self.query = query
+        self.params = tuple(params)
         return self
 
     def waitAns(self):
@@ -116,8 +123,9 @@ class getSpecificCriteria(unittest.TestCase):
         queue = self.files.database.getQueue()
         AIdb.getSpecificCriteria(queue, criteria, excludeManifests=["suexml"])
         expect_query = "SELECT arch FROM manifests WHERE arch IS NOT NULL " + \
-                       "AND name IS NOT 'suexml'"
+                       "AND name IS NOT ?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("suexml",), self.mockquery.params)
 
     def test_MINipv4(self):
         '''Verify single MIN query string '''
@@ -248,5 +256,92 @@ class formatValue(unittest.TestCase):
         self.assertEqual(fmt, self.cpu)
 
 
+class findManifest(unittest.TestCase):
+    '''Tests for findManifest and the criteria index'''
+
+    def setUp(self):
+        '''unit test set up'''
+        self.tmpdir = tempfile.mkdtemp()
+        self.db_file = os.path.join(self.tmpdir, 'AI.db')
+        self.execute('CREATE TABLE manifests (name TEXT, instance INTEGER, '
+                     'arch TEXT, MINmac INTEGER, MAXmac INTEGER, '
+                     'MINipv4 INTEGER, MAXipv4 INTEGER, cpu TEXT, '
+                     'platform TEXT, MINnetwork INTEGER, MAXnetwork INTEGER, '
+                     'MINmem INTEGER, MAXmem INTEGER)')
+        self.insert("sparc", arch="'sun4v'")
+        self.insert("bigmem", MINmem="4096")
+        self.insert("macs", MINmac="x'080027000000'", MAXmac="x'0800270000FF'")
+        self.insert("x86", arch="'i86pc'", MINmem="1024", MAXmem="4095")
+        self.database = AIdb.DB(self.db_file)
+        self.client = {'arch': 'i86pc', 'mac': '080027000100',
+                       'mem': '2048'}
+
+    def tearDown(self):
+        '''unit test tear down'''
+        shutil.rmtree(self.tmpdir)
+
+    def execute(self, sql):
+        '''run sql against the test database'''
+        con = sqlite.connect(self.db_file)
+        con.execute(sql)
+        con.commit()
+        con.close()
+
+    def insert(self, name, **crit):
+        '''add a manifest with the given criteria (SQL literals)'''
+        cols = ['name', 'instance'] + crit.keys()
+        vals = ["'" + name + "'", '0'] + crit.values()
+        self.execute('INSERT INTO manifests (' + ', '.join(cols) +
+                     ') VALUES (' + ', '.join(vals) + ')')
+
+    def test_single_value(self):
+        '''Verify a single value criteria selects a manifest'''
+        self.client['arch'] = 'SUN4V'
+        self.client['mem'] = '512'
+        self.assertEquals(AIdb.findManifest(self.client, self.database),
+                          'sparc')
+
+    def test_range(self):
+        '''Verify MIN/MAX ranges, including an unbounded MAX'''
+        self.assertEquals(AIdb.findManifest(self.client, self.database),
+                          'x86')
+        self.client['arch'] = 'sun4u'
+        self.client['mem'] = '8192'
+        self.assertEquals(AIdb.findManifest(self.client, self.database),
+                          'bigmem')
+
+    def test_mac_range(self):
+        '''Verify MAC address ranges compare as hex'''
+        self.client['arch'] = 'sun4u'
+        self.client['mac'] = '0800270000aB'
+        self.assertEquals(AIdb.findManifest(self.client, self.database),
+                          'macs')
+
+    def test_null_fallback(self):
+        '''Verify unmatched criteria fall back to unspecified criteria'''
+        self.client['arch'] = 'sun4u'
+        self.client['mem'] = '512'
+        self.client['mac'] = '000000000000'
+        self.assertEquals(AIdb.findManifest(self.client, self.database), 0)
+
+    def test_multiple(self):
+        '''Verify the number of matches is returned if not unique'''
+        self.insert("x86too", arch="'i86pc'", MINmem="1024",
+                    MAXmem="4095")
+        # a changed database is picked up without a restart
+        os.utime(self.db_file, (time.time() + 5, time.time() + 5))
+        self.assertEquals(AIdb.findManifest(self.client, self.database), 2)
+
+    def test_bad_criteria(self):
+        '''Verify missing or malformed criteria give no manifest'''
+        del self.client['mem']
+        self.assertEquals(AIdb.findManifest(self.client, self.database), 0)
+        self.client['mem'] = 'lots'
+        self.assertEquals(AIdb.findManifest(self.client, self.database), 0)
+        self.client['mem'] = '2048'
+        self.client['mac'] = '0800270'
+        self.assertEquals(AIdb.findManifest(self.client, self.database), 0)
+
+
 if __name__ == '__main__':
     unittest.main()
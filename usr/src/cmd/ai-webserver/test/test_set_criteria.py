@@ -58,9 +58,11 @@ class MockQuery(object):
     '''Class for mock query '''
     def __init__(self):
         self.query = None
+        self.params = None
 
-    def __call__(self, query, commit=False):
+    def __call__(self, query, commit=False, params=()):
         self.query = query
+        self.params = tuple(params)
         return self
 
     def waitAns(self):
@@ -139,10 +141,11 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("ipv4")
         criteria.setdefault("mac")
         set_criteria.set_criteria(criteria, "myxml", self.files.database)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINmem=NULL," + \
-                       "MAXmem='4096',MINipv4=NULL,MAXipv4=NULL,MINmac=NULL," +\
-                       "MAXmac=NULL WHERE name='myxml'"
+        expect_query = "UPDATE manifests SET arch=?,MINmem=NULL," + \
+                       "MAXmem=?,MINipv4=NULL,MAXipv4=NULL,MINmac=NULL," +\
+                       "MAXmac=NULL WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", 4096, "myxml"), self.mockquery.params)
 
     def test_unbounded_max(self):
         '''Ensure set_criteria max query constructed properly '''
@@ -150,10 +153,11 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("ipv4")
         criteria.setdefault("mac")
         set_criteria.set_criteria(criteria, "myxml", self.files.database)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINmem='1024'," + \
+        expect_query = "UPDATE manifests SET arch=?,MINmem=?," + \
                        "MAXmem=NULL,MINipv4=NULL,MAXipv4=NULL,MINmac=NULL," + \
-                       "MAXmac=NULL WHERE name='myxml'"
+                       "MAXmac=NULL WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", 1024, "myxml"), self.mockquery.params)
 
     def test_range(self):
         '''Ensure set_criteria max query constructed properly '''
@@ -161,11 +165,13 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("mac")
         criteria.setdefault("mem")
         set_criteria.set_criteria(criteria, "myxml", self.files.database)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINmem=NULL," + \
-                       "MAXmem=NULL,MINipv4='10.0.30.100'," + \
-                       "MAXipv4='10.0.50.400',MINmac=NULL,MAXmac=NULL " + \
-                       "WHERE name='myxml'"
+        expect_query = "UPDATE manifests SET arch=?,MINmem=NULL," + \
+                       "MAXmem=NULL,MINipv4=?," + \
+                       "MAXipv4=?,MINmac=NULL,MAXmac=NULL " + \
+                       "WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", "10.0.30.100", "10.0.50.400", "myxml"),
+                          self.mockquery.params)
 
     def test_append_unbounded_min(self):
         '''Ensure set_criteria append min query constructed properly '''
@@ -174,9 +180,10 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("mac")
         set_criteria.set_criteria(criteria, "myxml", self.files.database,
                                   append=True)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINmem=NULL," \
-                       "MAXmem='4096' WHERE name='myxml'"
+        expect_query = "UPDATE manifests SET arch=?,MINmem=NULL," \
+                       "MAXmem=? WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", 4096, "myxml"), self.mockquery.params)
 
     def test_append_unbounded_max(self):
         '''Ensure set_criteria append max query constructed properly '''
@@ -185,9 +192,10 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("mac")
         set_criteria.set_criteria(criteria, "myxml", self.files.database,
                                   append=True)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINmem='2048'," \
-                       "MAXmem=NULL WHERE name='myxml'"
+        expect_query = "UPDATE manifests SET arch=?,MINmem=?," \
+                       "MAXmem=NULL WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", 2048, "myxml"), self.mockquery.params)
 
     def test_append_range(self):
         '''Ensure set_criteria append range query constructed properly '''
@@ -196,9 +204,11 @@ class SetCriteria(unittest.TestCase):
         criteria.setdefault("mac")
         set_criteria.set_criteria(criteria, "myxml", self.files.database,
                                   append=True)
-        expect_query = "UPDATE manifests SET arch='i86pc',MINipv4=" + \
-                       "'10.0.10.10',MAXipv4='10.0.10.300' WHERE name='myxml'"
+        expect_query = "UPDATE manifests SET arch=?,MINipv4=" + \
+                       "?,MAXipv4=? WHERE name=?"
         self.assertEquals(expect_query, self.mockquery.query)
+        self.assertEquals(("i86pc", "10.0.10.10", "10.0.10.300", "myxml"),
+                          self.mockquery.params)
 
 class CheckPublishedManifest(unittest.TestCase):
     '''Tests for check_published_manifest'''
@@ -32,6 +32,8 @@ import os
 import sys
 import re
 import gettext
+import hashlib
+import threading
 from optparse import OptionParser
 
 import cherrypy
@@ -75,18 +77,151 @@ def parse_options():
 
     return (options, args[0])
 
+class ManifestCache(object):
+    """
+    Class caching what manifest.xml serves: the manifest found for a set of
+    criteria, the contents of the manifests and the criteria list. All of it
+    is dropped when the criteria index is rebuilt, i.e. a manifest was
+    published or deleted or had its criteria changed; manifest contents are
+    also reloaded if the file changed.
+    """
+
+    # upper bound on the number of cached lookups (one per distinct client)
+    MAX_LOOKUPS = 4096
+
+    def __init__(self, db, data_loc):
+        self._db = db
+        self._dataDir = os.path.join(data_loc, "AI_data")
+        self._lock = threading.Lock()
+        self._generation = None
+        self._lookups = dict()
+        self._files = dict()
+        self._criteriaXML = None
+
+    def _sync(self):
+        """
+        Drop everything derived from the database if it changed (called
+        with the lock held). Returns the current generation.
+        """
+        generation = self._db.getCriteriaIndex().getGeneration()
+        if generation != self._generation:
+            self._lookups.clear()
+            self._files.clear()
+            self._criteriaXML = None
+            self._generation = generation
+        return generation
+
+    def findManifest(self, criteria):
+        """
+        Cached AIdb.findManifest(), keyed by the client's criteria
+        """
+        key = tuple(sorted(criteria.items()))
+        self._lock.acquire()
+        try:
+            generation = self._sync()
+            if key in self._lookups:
+                return self._lookups[key]
+        finally:
+            self._lock.release()
+
+        manifest = AIdb.findManifest(criteria, self._db)
+
+        self._lock.acquire()
+        try:
+            # don't cache a result computed against a database since changed
+            if generation == self._generation:
+                if len(self._lookups) >= self.MAX_LOOKUPS:
+                    self._lookups.clear()
+                self._lookups[key] = manifest
+        finally:
+            self._lock.release()
+        return manifest
+
+    def getManifest(self, name):
+        """
+        Returns the contents of the manifest name and its entity tag. Raises
+        OSError or IOError if it can't be read.
+        """
+        path = os.path.abspath(os.path.join(self._dataDir, name))
+        st = os.stat(path)
+        stamp = (st.st_ino, st.st_size, st.st_mtime)
+
+        self._lock.acquire()
+        try:
+            self._sync()
+            entry = self._files.get(name)
+        finally:
+            self._lock.release()
+        if entry is not None and entry[0] == stamp:
+            return entry[1], entry[2]
+
+        manifest_file = open(path, "rb")
+        try:
+            data = manifest_file.read()
+        finally:
+            manifest_file.close()
+        entry = (stamp, data, '"%s"' % hashlib.md5(data).hexdigest())
+
+        self._lock.acquire()
+        try:
+            self._files[name] = entry
+        finally:
+            self._lock.release()
+        return entry[1], entry[2]
+
+    def getCriteriaList(self):
+        """
+        Returns the CriteriaList XML document telling AI clients what
+        criteria to send
+        """
+        self._lock.acquire()
+        try:
+            self._sync()
+            if self._criteriaXML is not None:
+                return self._criteriaXML
+        finally:
+            self._lock.release()
+
+        # <CriteriaList>
+        #       <Version Number="0.5">
+        #       <Criteria Name="MEM">
+        #       <Criteria Name="arch">
+        # ...
+        # </CriteriaList>
+        XML = lxml.etree.Element("CriteriaList")
+        version_value = lxml.etree.Element("Version")
+        version_value.attrib["Number"] = "0.5"
+        XML.append(version_value)
+        for crit in AIdb.getCriteria(self._db.getQueue(), strip=True):
+            tag = lxml.etree.Element("Criteria")
+            tag.attrib["Name"] = crit
+            XML.append(tag)
+        criteriaXML = lxml.etree.tostring(XML, pretty_print=True)
+
+        self._lock.acquire()
+        try:
+            self._criteriaXML = criteriaXML
+        finally:
+            self._lock.release()
+        return criteriaXML
+
 class staticPages:
     """
     Class containing the HTML for the static pages
     """
 
-    def __init__(self, data_loc):
+    def __init__(self, data_loc, threads=1):
         self.base_dir = data_loc
         if os.path.exists(os.path.join(self.base_dir, 'AI.db')):
-            self.AISQL = AIdb.DB(os.path.join(self.base_dir, 'AI.db'))
+            # give each server thread a DB connection of its own
+            self.AISQL = AIdb.DB(os.path.join(self.base_dir, 'AI.db'),
+                                 readers=threads)
         else:
             raise SystemExit(_("Error:\tNo AI.db database"))
         self.AISQL.verifyDBStructure()
+        # build the criteria index now rather than on the first client
+        self.AISQL.getCriteriaIndex()
+        self.cache = ManifestCache(self.AISQL, self.base_dir)
 
     @cherrypy.expose
     def index(self):
@@ -238,7 +373,7 @@ class staticPages:
                     criteria[key] = value
                 except (ValueError, NameError, TypeError, KeyError):
                     criteria = {}
-            manifest = AIdb.findManifest(criteria, self.AISQL)
+            manifest = self.cache.findManifest(criteria)
             # check if findManifest() returned a number and one larger than 0
             # (means we got multiple manifests back -- an error)
             if str(manifest).isdigit() and manifest > 0:
@@ -263,32 +398,32 @@ class staticPages:
             # else findManifest() returned the name of the manifest to serve
             # (or it is now set to default.xml)
             try:
-                return serve_file(os.path.abspath(
-                        os.path.join(self.base_dir, os.path.join("AI_data",
-                        manifest))), "application/x-download", "attachment")
-            except OSError:
+                (data, etag) = self.cache.getManifest(manifest)
+            except (OSError, IOError):
                 raise cherrypy.NotFound("/manifests/" + str(manifest))
 
+            # a client which already has this manifest needn't download it
+            # again; only a GET or HEAD may be answered with 304 (RFC 2616)
+            cherrypy.response.headers['ETag'] = etag
+            if_none_match = cherrypy.request.headers.get('If-None-Match')
+            if cherrypy.request.method in ('GET', 'HEAD') and \
+                if_none_match is not None and \
+                (if_none_match.strip() == '*' or
+                 etag in [tag.strip() for tag in if_none_match.split(',')]):
+                cherrypy.response.status = 304
+                return ""
+
+            cherrypy.response.headers['Content-Type'] = \
+                "application/x-download"
+            cherrypy.response.headers['Content-Disposition'] = \
+                'attachment; filename="%s"' % os.path.basename(manifest)
+            return data
+
         # this URI is not being requested using a POST method
         # return criteria list for AI-client to know what needs querried
         else:
-            # <CriteriaList>
-            #       <Version Number="0.5">
-            #       <Criteria Name="MEM">
-            #       <Criteria Name="arch">
-            # ...
-            # </CriteriaList>
-
             cherrypy.response.headers['Content-Type'] = "text/xml"
-            XML = lxml.etree.Element("CriteriaList")
-            version_value = lxml.etree.Element("Version")
-            version_value.attrib["Number"] = "0.5"
-            XML.append(version_value)
-            for crit in AIdb.getCriteria(self.AISQL.getQueue(), strip=True):
-                tag = lxml.etree.Element("Criteria")
-                tag.attrib["Name"] = crit
-                XML.append(tag)
-            return lxml.etree.tostring(XML, pretty_print=True)
+            return self.cache.getCriteriaList()
 
 class Manifests:
     """
@@ -347,7 +482,7 @@ if __name__ == '__main__':
     gettext.install("ai", "/usr/lib/locale")
     (OPTIONS, DATA_LOC) = parse_options()
     CONF = { "/": { } }
-    ROOT = cherrypy.tree.mount(staticPages(DATA_LOC))
+    ROOT = cherrypy.tree.mount(staticPages(DATA_LOC, OPTIONS.thread))
     cherrypy.tree.mount(Manifests(DATA_LOC), script_name="/manifests",
                         config=CONF)
     cherrypy.tree.mount(AIFiles(DATA_LOC), script_name="/ai-files",
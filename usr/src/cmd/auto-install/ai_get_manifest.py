@@ -31,11 +31,15 @@
 import sys
 import time
 
+import ctypes
 import getopt
 import httplib
+import os
 import re
 import socket
-from subprocess import Popen, PIPE
+import struct
+import tempfile
+import threading
 import traceback
 
 #
@@ -123,419 +127,482 @@ class AILog:
 #
 AIGM_LOG = AILog("AISC")
 
+# timeout in seconds for blocking operations on connection to AI service
+AI_SERVICE_TIMEOUT = 5
 
-def ai_exec_cmd(cmd):
-    """     Description: Executes provided command using subprocess.Popen()
-                         method and captures its stdout & stderr.
-                         stderr is captured for debugging purposes
+# size of chunks the manifest is streamed in
+AI_HTTP_CHUNK_SIZE = 65536
 
-            Parameters:
-                      	cmd - Command to be executed
 
-            Returns:
-                captured stdout from 'cmd'
-                return code - 0..success, -1..failure
-    """
+#
+# Constants used by the native client probe. They mirror definitions from
+# <sys/systeminfo.h>, <sys/ioccom.h>, <sys/sockio.h>, <net/if.h> and
+# <libdlpi.h>.
+#
+SI_ARCHITECTURE = 6
+SI_PLATFORM = 513
+SYS_NMLN = 257
 
-    AIGM_LOG.post(AILog.AI_DBGLVL_INFO, "cmd:" + cmd)
+IOCPARM_MASK = 0xff
+IOC_OUT = 0x40000000
+IOC_INOUT = 0xc0000000
 
-    try:
-        cmd_popen = Popen(cmd, shell=True, stdout=PIPE)
-        (cmd_stdout, cmd_stderr) = cmd_popen.communicate()
+# size of 'struct ifreq' - interface name followed by 16 bytes union
+IFNAMSIZ = 16
+IFREQ_SIZE = 32
 
-    except OSError:
-        AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "Popen() raised OSError exception")
+IFF_UP = 0x1
+IFF_LOOPBACK = 0x8
 
-        return None, -1
+DLPI_SUCCESS = 10000
+DL_CURR_PHYS_ADDR = 0x2
+DLPI_PHYSADDR_MAX = 64
 
-    except ValueError:
-        AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "Popen() raised ValueError exception")
+# length of Ethernet MAC address in bytes
+ETHERADDRL = 6
 
-        return None, -1
 
-    # capture output of stderr for debugging purposes
-    if cmd_stderr is not None:
-        AIGM_LOG.post(AILog.AI_DBGLVL_WARN,
-                      " stderr: %s", cmd_stderr)
+def ai_ioc(direction, group, num, size):
+    """ Description: Builds ioctl(2) request code the same way
+                     _IOR() and _IOWR() macros from <sys/ioccom.h> do
+    """
 
-    # check if child process terminated successfully
-    if cmd_popen.returncode != 0:
-        AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "Command failed: ret=%d", cmd_popen.returncode)
+    return direction | ((size & IOCPARM_MASK) << 16) | \
+        (ord(group) << 8) | num
 
-        return None, -1
+SIOCGIFADDR = ai_ioc(IOC_INOUT, 'i', 13, IFREQ_SIZE)
+SIOCGIFFLAGS = ai_ioc(IOC_INOUT, 'i', 17, IFREQ_SIZE)
+SIOCGIFCONF = ai_ioc(IOC_INOUT, 'i', 20, 8)
+SIOCGIFNETMASK = ai_ioc(IOC_INOUT, 'i', 21, IFREQ_SIZE)
+SIOCGIFNUM = ai_ioc(IOC_OUT, 'i', 87, 4)
 
-    return cmd_stdout, 0
 
+class AIIfConf(ctypes.Structure):
+    """ Class: AIIfConf - 'struct ifconf' passed to SIOCGIFCONF
+    """
 
-class AICriteria:
-    """ Class: AICriteria - base class for holding/manipulating AI criteria
+    _fields_ = [("ifc_len", ctypes.c_int),
+                ("ifc_buf", ctypes.c_void_p)]
+
+
+class AIClientProbe:
+    """ Class: AIClientProbe - collects all information about the client
+        in one pass from system calls and kernel interfaces, without
+        running any external command. It is done only once and results
+        are cached in class variables.
     """
 
-    def __init__(self, criteria=None):
-        self.criteria = criteria
+    client_info = None
 
-    def get(self):
-        """ return criteria value
+    def __init__(self):
+        self.libc = None
+        self.sock = None
+
+    def sysinfo(self, command):
+        """ Description: Obtains string from sysinfo(2)
+
+            Returns:
+                requested string, None if it couldn't be obtained
         """
 
-        return self.criteria
+        buf = ctypes.create_string_buffer(SYS_NMLN)
+        ret = self.libc.sysinfo(command, buf, ctypes.c_long(SYS_NMLN))
 
+        if ret < 0 or ret > SYS_NMLN or buf.value == "":
+            return None
 
-    def is_known(self):
-        """ check if information requried by criteria is available
+        return buf.value
+
+    def ioctl_ifreq(self, request, ifname):
+        """ Description: Issues ioctl(2) with 'struct ifreq' filled in
+                         with interface name
+
+            Returns:
+                'struct ifreq' returned by kernel as string,
+                None if ioctl(2) failed
         """
 
-        return self.criteria is not None
+        ifreq = ctypes.create_string_buffer(ifname[:IFNAMSIZ - 1],
+                                            IFREQ_SIZE)
+        if self.libc.ioctl(self.sock.fileno(), ctypes.c_uint(request),
+                           ifreq) < 0:
+            return None
 
-class AICriteriaHostname(AICriteria):
-    """ Class: AICriteriaHostname - class for obtaining/manipulating 'hostname'
-        criteria
-    """
+        return ifreq.raw
 
-    def __init__(self):
-        AICriteria.__init__(self, socket.gethostname())
+    def get_mem_size(self):
+        """ Description: Obtains physical memory size in MB
+        """
 
-class AICriteriaArch(AICriteria):
-    """ Class: AICriteriaArch class - class for obtaining/manipulating
-        'architecture' criteria
-    """
+        try:
+            mem_size = long(os.sysconf('SC_PHYS_PAGES')) * \
+                os.sysconf('SC_PAGESIZE') / (1024 * 1024)
 
-    client_arch = None
-    def __init__(self):
-        if AICriteriaArch.client_arch:
-            AICriteria.__init__(self, AICriteriaArch.client_arch)
-            return
+        except (ValueError, OSError):
+            return None
 
-        cmd = "/usr/bin/uname -m"
-        client_arch, ret = ai_exec_cmd(cmd)
-	
-        if ret != 0 or client_arch == "":
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain machine architecture")
-            AICriteriaArch.client_arch = None
-        else:
-            AICriteriaArch.client_arch = client_arch.strip()
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Physical memory size: %ld MB", mem_size)
 
-        AICriteria.__init__(self, AICriteriaArch.client_arch)
+        if mem_size <= 0:
+            return None
 
-class AICriteriaPlatform(AICriteria):
-    """ Class: AICriteriaPlatform class - class for obtaining/manipulating
-        'platform' criteria
-    """
+        return repr(mem_size).rstrip('L')
 
-    client_platform = None
-    def __init__(self):
-        if AICriteriaPlatform.client_platform:
-            AICriteria.__init__(self,
-                                 AICriteriaPlatform.client_platform)
-            return
+    def get_up_ifaces(self):
+        """ Description: Lists IPv4 interfaces, which are UP - omit
+                         loopback interfaces.
 
-        cmd = "/usr/bin/uname -i"
-        AICriteriaPlatform.client_platform, ret = ai_exec_cmd(cmd)
-	
-        if ret != 0 or AICriteriaPlatform.client_platform == "":
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain machine platform")
-        else:
-            AICriteriaPlatform.client_platform = \
-                AICriteriaPlatform.client_platform.strip()
+            Returns:
+                list of interface names, logical ones included
+        """
 
-        AICriteria.__init__(self, AICriteriaPlatform.client_platform)
+        ifnum = ctypes.c_int(0)
+        if self.libc.ioctl(self.sock.fileno(), ctypes.c_uint(SIOCGIFNUM),
+                           ctypes.byref(ifnum)) < 0 or ifnum.value <= 0:
+            return []
 
-class AICriteriaCPU(AICriteria):
-    """ Class: AICriteriaCPU - class for obtaining/manipulating
-        'processor type' criteria
-    """
+        buf = ctypes.create_string_buffer(ifnum.value * IFREQ_SIZE)
+        ifconf = AIIfConf(len(buf.raw),
+                          ctypes.cast(buf, ctypes.c_void_p))
 
-    client_cpu = None
-    def __init__(self):
-        if AICriteriaCPU.client_cpu:
-            AICriteria.__init__(self, AICriteriaCPU.client_cpu)
-            return
+        if self.libc.ioctl(self.sock.fileno(), ctypes.c_uint(SIOCGIFCONF),
+                           ctypes.byref(ifconf)) < 0:
+            return []
 
-        cmd = "/usr/bin/uname -p"
-        AICriteriaCPU.client_cpu, ret = ai_exec_cmd(cmd)
-	
-        if ret != 0 or AICriteriaCPU.client_cpu == "":
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain processor type")
-        else:
-            AICriteriaCPU.client_cpu = \
-                AICriteriaCPU.client_cpu.strip()
+        ifnames = []
+        for off in range(0, ifconf.ifc_len, IFREQ_SIZE):
+            ifname = buf.raw[off:off + IFNAMSIZ].split('\0', 1)[0]
 
-        AICriteria.__init__(self, AICriteriaCPU.client_cpu)
+            ifreq = self.ioctl_ifreq(SIOCGIFFLAGS, ifname)
+            if ifreq is None:
+                continue
 
-class AICriteriaMemSize(AICriteria):
-    """ Class: AICriteriaMemSize class - class for obtaining/manipulating
-        'physical memory size' criteria, value is in MB
-    """
+            ifflags = struct.unpack("=h", ifreq[IFNAMSIZ:IFNAMSIZ + 2])[0]
+            if ifflags & IFF_UP and not ifflags & IFF_LOOPBACK:
+                ifnames.append(ifname)
 
-    client_mem_size = None
-    client_mem_size_initialized = False
+        return ifnames
 
-    def __init__(self):
-        if AICriteriaMemSize.client_mem_size_initialized:
-            AICriteria.__init__(self,
-                                 AICriteriaMemSize.client_mem_size)
+    def get_network_iface(self):
+        """ Description: Searches for the first IPv4 interface, which is
+                         UP - omit loopback interfaces.
+
+            Returns:
+                name of physical interface, None if there is none
+        """
+
+        ifnames = self.get_up_ifaces()
+        if not ifnames:
+            return None
+
+        # logical interface - use underlying physical one
+        return ifnames[0].split(':')[0]
+
+    def get_ipv4_addr(self, request, ifname):
+        """ Description: Obtains IPv4 address or netmask of interface
+
+            Returns:
+                address as long, None if it couldn't be obtained
+        """
+
+        ifreq = self.ioctl_ifreq(request, ifname)
+        if ifreq is None:
+            return None
+
+        # sin_addr follows sin_family and sin_port in 'struct sockaddr_in'
+        return long(struct.unpack("!I",
+                                  ifreq[IFNAMSIZ + 4:IFNAMSIZ + 8])[0])
+
+    def get_mac(self, ifname):
+        """ Description: Obtains MAC address of interface from DLPI
+
+            Returns:
+                MAC address as string of 12 hexadecimal digits,
+                None if it couldn't be obtained
+        """
+
+        libdlpi = ctypes.CDLL("libdlpi.so.1")
+        dlpi_handle = ctypes.c_void_p()
+
+        if libdlpi.dlpi_open(ifname, ctypes.byref(dlpi_handle),
+                             0) != DLPI_SUCCESS:
+            return None
+
+        physaddr = ctypes.create_string_buffer(DLPI_PHYSADDR_MAX)
+        physaddr_len = ctypes.c_size_t(DLPI_PHYSADDR_MAX)
+
+        ret = libdlpi.dlpi_get_physaddr(dlpi_handle, DL_CURR_PHYS_ADDR,
+                                        physaddr, ctypes.byref(physaddr_len))
+        libdlpi.dlpi_close(dlpi_handle)
+
+        if ret != DLPI_SUCCESS or physaddr_len.value != ETHERADDRL:
+            return None
+
+        #
+        # This makes sure that the criteria are passed to the server
+        # in the format which server can understand - without ':'
+        # and padded with '0's.
+        #
+        return "".join(["%02x" % ord(byte)
+                        for byte in physaddr.raw[:ETHERADDRL]])
+
+    def probe_network(self, info):
+        """ Description: Obtains MAC address, IP address and network
+                         address of the first valid network interface
+        """
+
+        ifname = self.get_network_iface()
+        if ifname is None:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't obtain name of valid network interface")
             return
-		
-        AICriteriaMemSize.client_mem_size_initialized = True
-        cmd = "/usr/sbin/prtconf -vp | /usr/bin/grep '^Memory size: '"
-        client_mem_info, ret = ai_exec_cmd(cmd)
 
-        if ret != 0 or client_mem_info == "":
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Network interface obtained: %s", ifname)
+
+        try:
+            info['mac'] = self.get_mac(ifname)
+
+        except OSError:
+            info['mac'] = None
+
+        if info['mac'] is None:
             AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain memory size")
-            AICriteriaMemSize.client_mem_size = None
-            AICriteria.__init__(self)
+                          "Couldn't obtain client MAC address")
+        else:
+            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "Client MAC address: %s", info['mac'])
+
+        ip_long = self.get_ipv4_addr(SIOCGIFADDR, ifname)
+        if ip_long is None:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't obtain IP address")
             return
 
-        (client_mem_size, client_mem_unit) = client_mem_info.split()[2:]
-        client_mem_size = long(client_mem_size)
-	
+        info['ipv4'] = "%03ld%03ld%03ld%03ld" % \
+            (ip_long >> 24, ip_long >> 16 & 0xff,
+             ip_long >> 8 & 0xff, ip_long & 0xff)
+
         AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "prtconf(1M) reported: %ld %s", client_mem_size,
-                      client_mem_unit)
+                      "Client IP address: %s", info['ipv4'])
 
-        if client_mem_size == 0 or client_mem_unit == "":
+        client_netmask = self.get_ipv4_addr(SIOCGIFNETMASK, ifname)
+        if client_netmask is None:
             AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain memory size")
-            AICriteriaMemSize.client_mem_size = None
-            AICriteria.__init__(self)
+                          "Couldn't obtain network address")
             return
 
-        if client_mem_unit == "Kilobytes":
-            client_mem_size /= 1024
-        elif client_mem_unit == "Gigabytes":
-            client_mem_size *= 1024
-        elif client_mem_unit == "Terabytes":
-            client_mem_size *= 1024 * 1024
-        elif client_mem_unit != "Megabytes":
-            AIGM_LOG.post(AILog.AI_DBGLVL_WARN,
-                          "Unknown mem size units %s", client_mem_unit)
-            client_mem_size = 0
+        client_network_long = ip_long & client_netmask
 
-        AICriteriaMemSize.client_mem_size = \
-            repr(client_mem_size).rstrip('L')
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Mask: %08lX, IP: %08lX, Network: %08lX",
+                      client_netmask, ip_long, client_network_long)
 
-        AICriteria.__init__(self, AICriteriaMemSize.client_mem_size)
+        info['network'] = "%03ld%03ld%03ld%03ld" % \
+            (client_network_long >> 24,
+             client_network_long >> 16 & 0xff,
+             client_network_long >> 8 & 0xff,
+             client_network_long & 0xff)
 
-class AICriteriaNetworkInterface(AICriteria):
-    """ Class: AICriteriaNetworkInterface class - class for
-        obtaining/manipulating information about network interface -
-        this criteria is currently private and not exposed to the server
-    """
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Client net: %s", info['network'])
 
-    network_iface = None
-    ifconfig_iface_info = None
-    network_iface_initialized = False
+    def probe(self):
+        """ Description: Collects all client information
 
-    def __init__(self):
-        AICriteria.__init__(self)
+            Returns:
+                dictionary of client criteria, value is None
+                if criteria couldn't be obtained
+        """
 
-        # initialize class variables only once
-        if AICriteriaNetworkInterface.network_iface_initialized:
-            return
+        info = dict.fromkeys(['hostname', 'arch', 'platform', 'cpu',
+                              'mem', 'mac', 'ipv4', 'network'])
 
-        AICriteriaNetworkInterface.network_iface_initialized = True
-        #
-        # Obtain network interface name, which will be queried in next
-        # step in order to obtain required network parameters
-        #
-        # Search for the first interface, which is UP - omit loopback
-        # interfaces. Then use ifconfig for query the information about
-        # that interface and store the result.
-        #
-        cmd = "/usr/sbin/ifconfig -au | /usr/bin/grep '[0-9]:' " \
-            "| /usr/bin/grep -v 'LOOPBACK'"
-        AICriteriaNetworkInterface.network_iface, ret = ai_exec_cmd(cmd)
+        info['hostname'] = socket.gethostname()
 
-        if ret != 0:
+        # machine hardware name, as reported by 'uname -m'
+        info['arch'] = os.uname()[4]
+        if info['arch'] == "":
             AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain name of valid network interface")
-            AICriteriaNetworkInterface.network_iface = None
-        else:
-            AICriteriaNetworkInterface.network_iface = \
-                AICriteriaNetworkInterface.network_iface.split(':')[0]
+                          "Couldn't obtain machine architecture")
+            info['arch'] = None
 
-            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "Network interface obtained: %s",
-                          AICriteriaNetworkInterface.network_iface)
+        info['mem'] = self.get_mem_size()
+        if info['mem'] is None:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't obtain memory size")
 
-            #
-            # Collect all available information about network interface
-            #
-            cmd = "/usr/sbin/ifconfig %s" % \
-                AICriteriaNetworkInterface.network_iface
+        try:
+            self.libc = ctypes.CDLL("libc.so.1", use_errno=True)
 
-            AICriteriaNetworkInterface.ifconfig_iface_info, ret = \
-                ai_exec_cmd(cmd)
+        except OSError:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't load libc, client probe incomplete")
+            return info
 
-            if ret != 0 or \
-               AICriteriaNetworkInterface.ifconfig_iface_info == "":
-                AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                              "Couldn't obtain information about "
-                              "network interface %s",
-                              AICriteriaNetworkInterface.network_iface)
-				
-                AICriteriaNetworkInterface.ifconfig_iface_info = None
+        info['platform'] = self.sysinfo(SI_PLATFORM)
+        if info['platform'] is None:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't obtain machine platform")
 
-class AICriteriaMAC(AICriteriaNetworkInterface):
-    """ Class: AICriteriaMAC - class for obtaining/manipulating
-        information about client MAC address
+        info['cpu'] = self.sysinfo(SI_ARCHITECTURE)
+        if info['cpu'] is None:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't obtain processor type")
+
+        try:
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+        except socket.error:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't open socket for network interface "
+                          "queries")
+            return info
+
+        try:
+            self.probe_network(info)
+
+        finally:
+            self.sock.close()
+
+        return info
+
+
+def ai_probe_client():
+    """ Description: Collects information about the client. All criteria
+                     are obtained at once during the first call, following
+                     calls return cached values.
+
+        Returns:
+            dictionary of client criteria
     """
 
-    client_mac = None
-    client_mac_initialized = False
-		
-    def __init__(self):
-        AICriteriaNetworkInterface.__init__(self)
+    if AIClientProbe.client_info is None:
+        AIClientProbe.client_info = AIClientProbe().probe()
 
-        # initialize class variables only once
-        if AICriteriaMAC.client_mac_initialized:
-            AICriteria.__init__(self, AICriteriaMAC.client_mac)
-            return
+    return AIClientProbe.client_info
 
-        AICriteriaMAC.client_mac_initialized = True
 
-        if AICriteriaNetworkInterface.ifconfig_iface_info is None:
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain MAC address")
-        else:
-            AICriteriaMAC.client_mac = AICriteriaNetworkInterface. \
-                ifconfig_iface_info.split("ether", 1)
+def ai_get_ipv4_addrs():
+    """ Description: Obtains IPv4 address of every physical interface,
+                     which is UP - omit loopback interfaces.
 
-            if len(AICriteriaMAC.client_mac) < 2:
-                AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                              "Couldn't obtain client MAC address")
-                AICriteriaMAC.client_mac = None
-            else:
-                AICriteriaMAC.client_mac = AICriteriaMAC.\
-                    client_mac[1].strip().split()[0].strip()
-
-                #
-                # remove ':' and pad with '0's
-                #
-                # This step makes sure that the criteria are
-                # passed to the server in the format which
-                # server can understand. This is just an interim
-                # solution.
-                #
-                # For longer term, all criteria should be
-                # passed to the server in native format letting
-                # the server side control the process of
-                # conversion.
-                #
-
-                client_mac_parts = \
-                    AICriteriaMAC.client_mac.split(":")
-
-                AICriteriaMAC.client_mac = "%s%s%s%s%s%s" % \
-                    (client_mac_parts[0].zfill(2),
-                     client_mac_parts[1].zfill(2),
-                     client_mac_parts[2].zfill(2),
-                     client_mac_parts[3].zfill(2),
-                     client_mac_parts[4].zfill(2),
-                     client_mac_parts[5].zfill(2))
-
-                AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                              "Client MAC address: %s",
-                              AICriteriaMAC.client_mac)
-
-        AICriteria.__init__(self, AICriteriaMAC.client_mac)
-
-
-class AICriteriaIP(AICriteriaNetworkInterface):
-    """ Class: AICriteriaIP class - class for obtaining/manipulating
-        information about client IP address
+        Returns:
+            list of addresses in dotted notation, empty list if they
+            couldn't be obtained
     """
 
-    client_ip = None
-    client_ip_string = None
-    client_ip_initialized = False
+    probe = AIClientProbe()
+    try:
+        probe.libc = ctypes.CDLL("libc.so.1", use_errno=True)
+        probe.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 
-    def __init__(self):
-        AICriteriaNetworkInterface.__init__(self)
+    except (OSError, socket.error):
+        return []
 
-        # initialize class variables only once
-        if AICriteriaIP.client_ip_initialized:
-            AICriteria.__init__(self, AICriteriaIP.client_ip_string)
-            return
+    ifaces = []
+    addrs = []
+    try:
+        for ifname in probe.get_up_ifaces():
+            # logical interfaces share physical one with its address
+            if ifname.split(':')[0] in ifaces:
+                continue
 
-        AICriteriaIP.client_ip_initialized = True
-        if AICriteriaNetworkInterface.ifconfig_iface_info == None:
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain IP address")
-        else:
-            AICriteriaIP.client_ip = AICriteriaNetworkInterface. \
-                ifconfig_iface_info.split("inet", 1)[1].strip().\
-                split()[0].strip()
+            ip_long = probe.get_ipv4_addr(SIOCGIFADDR, ifname)
+            if ip_long is not None:
+                ifaces.append(ifname.split(':')[0])
+                addrs.append(socket.inet_ntoa(struct.pack("!I", ip_long)))
 
-            # remove '.'
-            ip_split = AICriteriaIP.client_ip.split('.')
-            AICriteriaIP.client_ip_string = "%03d%03d%03d%03d" % \
-                (int(ip_split[0]), int(ip_split[1]),
-                 int(ip_split[2]), int(ip_split[3]))
+    finally:
+        probe.sock.close()
 
-            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "Client IP address: %s",
-                          AICriteriaIP.client_ip_string)
+    return addrs
 
-        AICriteria.__init__(self, AICriteriaIP.client_ip_string)
 
-class AICriteriaNetwork(AICriteriaIP):
-    """ Class: AICriteriaNetwork class - class for obtaining/manipulating
-        information about client network address
+class AICriteria:
+    """ Class: AICriteria - base class for holding/manipulating AI criteria
     """
 
-    client_net = None
-    client_net_initialized = False
+    def __init__(self, criteria=None):
+        self.criteria = criteria
+
+    def get(self):
+        """ return criteria value
+        """
+
+        return self.criteria
+
+
+    def is_known(self):
+        """ check if information requried by criteria is available
+        """
+
+        return self.criteria is not None
+
+class AICriteriaHostname(AICriteria):
+    """ Class: AICriteriaHostname - class for obtaining/manipulating 'hostname'
+        criteria
+    """
 
     def __init__(self):
-        AICriteriaIP.__init__(self)
+        AICriteria.__init__(self, ai_probe_client()['hostname'])
 
-        # initialize class variables only once
-        if AICriteriaNetwork.client_net_initialized:
-            AICriteria.__init__(self, AICriteriaNetwork.client_net)
-            return
+class AICriteriaArch(AICriteria):
+    """ Class: AICriteriaArch class - class for obtaining/manipulating
+        'architecture' criteria
+    """
 
-        AICriteriaNetwork.client_net_initialized = True
-			
-        if AICriteriaNetworkInterface.ifconfig_iface_info == None or \
-            AICriteriaIP.client_ip == None:
-            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain network address")
-        else:
-            # extract network mask
-            client_netmask = \
-                long(AICriteriaNetworkInterface.ifconfig_iface_info.
-                    split("netmask", 1)[1].strip().split()[0].strip(), 16)
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['arch'])
+
+class AICriteriaPlatform(AICriteria):
+    """ Class: AICriteriaPlatform class - class for obtaining/manipulating
+        'platform' criteria
+    """
 
-            # Translate IP address in string format to long
-            ip_part = AICriteriaIP.client_ip.split('.')
-            ip_long = long(ip_part[0]) << 24 | long(ip_part[1]) << \
-                16 | long(ip_part[2]) << 8 | long(ip_part[3])
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['platform'])
 
-            client_network_long = ip_long & client_netmask
-	
-            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "Mask: %08lX, IP: %08lX, Network: %08lX",
-                          client_netmask, ip_long, client_network_long)
+class AICriteriaCPU(AICriteria):
+    """ Class: AICriteriaCPU - class for obtaining/manipulating
+        'processor type' criteria
+    """
 
-            AICriteriaNetwork.client_net = \
-                "%03ld%03ld%03ld%03ld" % \
-                (client_network_long >> 24,
-                 client_network_long >> 16 & 0xff,
-                 client_network_long >> 8 & 0xff,
-                 client_network_long & 0xff)
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['cpu'])
 
-            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "Client net: %s", AICriteriaNetwork.client_net)
+class AICriteriaMemSize(AICriteria):
+    """ Class: AICriteriaMemSize class - class for obtaining/manipulating
+        'physical memory size' criteria, value is in MB
+    """
+
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['mem'])
+
+class AICriteriaMAC(AICriteria):
+    """ Class: AICriteriaMAC - class for obtaining/manipulating
+        information about client MAC address
+    """
+
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['mac'])
+
+class AICriteriaIP(AICriteria):
+    """ Class: AICriteriaIP class - class for obtaining/manipulating
+        information about client IP address
+    """
+
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['ipv4'])
+
+class AICriteriaNetwork(AICriteria):
+    """ Class: AICriteriaNetwork class - class for obtaining/manipulating
+        information about client network address
+    """
 
-        AICriteria.__init__(self, AICriteriaNetwork.client_net)
+    def __init__(self):
+        AICriteria.__init__(self, ai_probe_client()['network'])
 
 #
 # dictionary defining list of supported criteria and relationship
@@ -545,9 +612,9 @@ class AICriteriaNetwork(AICriteriaIP):
 # It also contains short informative description of the criteria
 #
 # Use following steps if support for new criteria is required:
-# [1] Define name of criteria (like 'MEM'), create new class
-#     which inherits AICriteria and implements method for
-#     obtaining the criteria.
+# [1] Define name of criteria (like 'MEM'), teach AIClientProbe
+#     how to obtain the criteria and create new class which
+#     inherits AICriteria and picks its value from ai_probe_client().
 # [2] Add name of criteria, class and short description in following
 #     dictionary
 # [3] Test ;-)
@@ -575,32 +642,33 @@ def usage():
 
 
 #~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-def ai_get_http_file(address, file_path, method, * nv_pairs):
+def ai_get_http_file(http_conn, file_path, method, nv_pairs=None,
+                     fh_out=None):
     """		Description: Downloads file from url using HTTP protocol
 
 		Parameters:
-		    address - address of webserver to connect
+		    http_conn - connection to webserver, it is kept open,
+		                so that it can be reused for next request
 		    file_path - path to file
 		    method - 'POST' or 'GET'
 		    nv_pairs - dictionary containing name-value pairs to be sent
 		               to the server using 'POST' method
+		    fh_out - if provided, file is streamed to it instead of
+		             being returned
 
 		Returns:
-		    file
+		    file, None if it was streamed to fh_out
 		    return code: >= 100 - HTTP Response status code
 		                 -1 - Connection to web server failed
 	"""
 
-    # try to connect to the provided web server
-    http_conn = httplib.HTTPConnection(address)
-
     # turn on debug mode in order to track HTTP connection
     # http_conn.set_debuglevel(1)
     try:
         if (method == "POST"):
             post_data = "postData="
-            for key in nv_pairs[0].keys():
-                post_data += "%s=%s;" % (key, nv_pairs[0][key])
+            for key in nv_pairs.keys():
+                post_data += "%s=%s;" % (key, nv_pairs[key])
 
             # remove trailing ';' and replace all ';' with "%3B",
             # so that the data is correctly passed to AI web server
@@ -616,22 +684,199 @@ def ai_get_http_file(address, file_path, method, * nv_pairs):
         else:
             http_conn.request("GET", file_path)
 
+        http_response = http_conn.getresponse()
+        http_status = http_response.status
+
+        #
+        # Response body is always read completely, otherwise the
+        # connection couldn't be used for next request
+        #
+        if fh_out is None or http_status != httplib.OK:
+            return http_response.read(), http_status
+
+        while True:
+            chunk = http_response.read(AI_HTTP_CHUNK_SIZE)
+            if not chunk:
+                break
+            fh_out.write(chunk)
+
     except httplib.InvalidURL:
         AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "%s is not valid URL", address)
+                      "%s:%d is not valid URL", http_conn.host,
+                      http_conn.port)
         return None, -1
 
-    except StandardError:
+    except (httplib.HTTPException, StandardError):
         AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "Connection to %s refused", address)
+                      "Connection to %s:%d failed", http_conn.host,
+                      http_conn.port)
         return None, -1
 
-    http_response = http_conn.getresponse()
-    url_content = http_response.read()
-    http_status = http_response.status
-    http_conn.close()
+    return None, http_status
+
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class AIServiceRace:
+    """ Class: AIServiceRace - collects results of AI services queried
+        concurrently. Services are preferred in the order they are
+        listed, so the first listed one which provides valid manifest
+        wins, even if services listed after it answer sooner.
+    """
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.results = {}
+
+    def finished(self, query, ret):
+        """ Description: Records result of AI service query
+        """
+
+        self.cond.acquire()
+        self.results[query] = ret
+        self.cond.notify()
+        self.cond.release()
 
-    return url_content, http_status
+    def wait(self, queries):
+        """ Description: Waits until valid manifest is obtained from
+                         service which is not preceded by any service
+                         still being queried, or all AI services fail
+
+            Parameters:
+                queries - AIServiceQuery list, in order of preference
+
+            Returns:
+                AIServiceQuery which obtained manifest, None if none
+        """
+
+        winner = None
+
+        self.cond.acquire()
+        for query in queries:
+            while not self.results.has_key(query):
+                self.cond.wait()
+            if self.results[query] == httplib.OK:
+                winner = query
+                break
+        self.cond.release()
+
+        return winner
+
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class AIServiceQuery(threading.Thread):
+    """ Class: AIServiceQuery - obtains manifest from one AI service.
+        Both requests of the handshake are sent over one persistent
+        HTTP/1.1 connection and the manifest is streamed to file.
+        The file is opened by the caller, so that it can be removed
+        at any time without the query creating it again.
+    """
+
+    def __init__(self, race, ai_service, ai_criteria_known, manifest_path,
+                 fh_manifest):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.race = race
+        self.ai_service = ai_service
+        self.ai_criteria_known = ai_criteria_known
+        self.manifest_path = manifest_path
+        self.fh_manifest = fh_manifest
+
+    def run(self):
+        ret = -1
+        try:
+            ret = self.query()
+        finally:
+            self.fh_manifest.close()
+            self.race.finished(self, ret)
+
+    def query(self):
+        """ Description: Follows the handshake with AI service
+
+            Returns:
+                return code: >= 100 - HTTP Response status code
+                             -1 - Connection to web server failed
+        """
+
+        ai_service = self.ai_service
+
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Asking for criteria list:")
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      " HTTP GET %s/manifest.xml", ai_service)
+
+        try:
+            http_conn = httplib.HTTPConnection(ai_service,
+                                               timeout=AI_SERVICE_TIMEOUT)
+        except httplib.InvalidURL:
+            AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "%s is not valid URL", ai_service)
+            return -1
+
+        try:
+            xml_criteria, ret = ai_get_http_file(http_conn,
+                                                 "/manifest.xml", "GET")
+
+            if ret != httplib.OK:
+                AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
+                              "Couldn't obtain criteria list from %s, "
+                              "ret=%d", ai_service, ret)
+                return ret
+
+            #
+            # Extract list of required criteria from XML file provided
+            # format of XML file is not validated, information is being
+            # extracted in simple way. This is just interim solution
+            # todo: Switch to DC XML validator - bug 12494
+            #
+            # The format of file for November is following (it might
+            # become more complex and will be docummented in design spec):
+            #
+            # <CriteriaList>
+            #	<Version Number="0.5">
+            # 	<Criteria Name="MEM">
+            #	<Criteria Name="arch">
+            # ...
+            # </CriteriaList>
+            #
+            criteria_required, ret = \
+                ai_get_requested_criteria_list(xml_criteria)
+
+            # Fill in dictionary with criteria name-value pairs
+            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "List of criteria to be sent:")
+
+            ai_crit_response = {}
+            for cr_key in criteria_required:
+                if self.ai_criteria_known.has_key(cr_key) \
+                    and self.ai_criteria_known[cr_key] != None:
+                    ai_crit_response[cr_key] = \
+                        self.ai_criteria_known[cr_key]
+                    AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                                  " %s=%s", cr_key,
+                                  ai_crit_response[cr_key])
+
+            # Send back filled in list of criteria to server
+            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "Sending list of criteria, asking for manifest:")
+            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                          " HTTP POST %s %s", ai_crit_response, ai_service)
+
+            ret = ai_get_http_file(http_conn, "/manifest.xml", "POST",
+                                   ai_crit_response, self.fh_manifest)[1]
+
+        finally:
+            http_conn.close()
+
+        if ret == httplib.OK:
+            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "%s AI service provided valid manifest",
+                          ai_service)
+        else:
+            AIGM_LOG.post(AILog.AI_DBGLVL_WARN,
+                          "%s AI service didn't provide valid manifest, " \
+                          "ret=%d", ai_service, ret)
+
+        return ret
 
 
 #~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -659,6 +904,23 @@ def ai_get_requested_criteria_list(xml_file):
     return crit_required, 0
 
 
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def ai_remove_manifests(ai_queries, ai_winner):
+    """		Description: Removes temporary manifest files of AI service
+		             queries, except the one of the winner. Queries
+		             still in progress keep writing to unlinked file.
+    """
+
+    for ai_query in ai_queries:
+        if ai_query is ai_winner:
+            continue
+
+        try:
+            os.unlink(ai_query.manifest_path)
+        except OSError:
+            pass
+
+
 #~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def parse_cli(cli_opts_args):
     """ main application
@@ -700,7 +962,12 @@ def parse_cli(cli_opts_args):
 
     ai_criteria_known = {}
 
-    # Obtain all available information about client
+    #
+    # Obtain all available information about client in one pass,
+    # before any of AI services is contacted
+    #
+    ai_probe_client()
+
     for key in AI_CRITERIA_SUPPORTED.keys():
         ai_crit = AI_CRITERIA_SUPPORTED[key][0]()
         if ai_crit.is_known():
@@ -727,23 +994,28 @@ def parse_cli(cli_opts_args):
         return 0
 
     #
-    # Go through the list of services.
-    # Contact each of them and try to obtain valid manifest by
-    # following handshake using HTTP protocol:
+    # Contact all services concurrently and try to obtain valid
+    # manifest from each of them by following handshake using HTTP
+    # protocol:
     # [1] Ask for list of criteria server is interested in
     #     GET <service>/manifest. xml
     # [2] Return criteria as a list of name,value pairs
     #     POST "postData=cr_name1=cr_value1;cr_name2=cr_value2"
     #     <service>/manifest.xml
-    # [3] If valid manifest is not returned, continue with next
-    #     service
+    # [3] Valid manifest of the first service in the list which
+    #     provides one is used, services which are still being
+    #     queried at that time are abandoned. As all of them are
+    #     queried at once, service which fails doesn't delay those
+    #     listed after it
+    #
+    # Each service streams manifest to its own temporary file next
+    # to the manifest file, the one which wins is renamed to it.
     #
 
     AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
                   "Starting to contact AI services provided by %s",
                   service_list)
 
-    ai_manifest_obtained = False
     try:
         service_list_fh = open(service_list, 'r')
     except IOError:
@@ -751,85 +1023,42 @@ def parse_cli(cli_opts_args):
                       "Couldn't open %s file", service_list)
         return 2
 
-    for ai_service in service_list_fh.readlines():
-        ai_service = ai_service.strip()
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "AI service: %s", ai_service)
+    ai_services = [ai_service.strip() for ai_service in
+                   service_list_fh.readlines() if ai_service.strip()]
+    service_list_fh.close()
 
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "Asking for criteria list:")
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      " HTTP GET %s/manifest.xml", ai_service)
+    race = AIServiceRace()
+    ai_queries = []
+    manifest_dir = os.path.dirname(manifest_file) or "."
 
-        xml_criteria, ret = ai_get_http_file(ai_service,
-                                             "/manifest.xml", "GET")
+    for ai_service in ai_services:
+        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "AI service: %s", ai_service)
 
-        if ret != httplib.OK:
+        try:
+            (fd, manifest_path) = tempfile.mkstemp(prefix=".ai_manifest.",
+                                                   dir=manifest_dir)
+            fh_manifest = os.fdopen(fd, 'wb')
+        except (IOError, OSError):
             AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Couldn't obtain criteria list from %s, ret=%d",
-                          ai_service, ret)
-            continue
+                          "Couldn't open %s for saving obtained manifest",
+                          manifest_file)
+            for ai_query in ai_queries:
+                ai_query.fh_manifest.close()
+            ai_remove_manifests(ai_queries, None)
+            return 2
 
-        #
-        # Extract list of required criteria from XML file provided
-        # format of XML file is not validated, information is being
-        # extracted in simple way. This is just interim solution
-        # todo: Switch to DC XML validator - bug 12494
-        #
-        # The format of file for November is following (it might become
-        # more complex and will be docummented in design spec):
-        #
-        # <CriteriaList>
-        #	<Version Number="0.5">
-        # 	<Criteria Name="MEM">
-        #	<Criteria Name="arch">
-        # ...
-        # </CriteriaList>
-        #
-        criteria_required, ret = \
-            ai_get_requested_criteria_list(xml_criteria)
+        ai_queries.append(AIServiceQuery(race, ai_service,
+                                         ai_criteria_known, manifest_path,
+                                         fh_manifest))
 
-        # Fill in dictionary with criteria name-value pairs
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "List of criteria to be sent:")
-
-        ai_crit_response = {}
-        for i in range(len(criteria_required)):
-            cr_key = criteria_required[i]
-            if ai_criteria_known.has_key(cr_key) \
-                and ai_criteria_known[cr_key] != None:
-                ai_crit_response[cr_key] = ai_criteria_known[cr_key]
-                AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                              " %s=%s", cr_key, ai_crit_response[cr_key])
-
-        # Send back filled in list of criteria to server
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "Sending list of criteria, asking for manifest:")
-        AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                      " HTTP POST %s %s", ai_crit_response, ai_service)
+    for ai_query in ai_queries:
+        ai_query.start()
 
-        ai_manifest, ret = ai_get_http_file(ai_service,
-                                            "/manifest.xml", "POST",
-                                            ai_crit_response)
+    ai_winner = race.wait(ai_queries)
+    ai_remove_manifests(ai_queries, ai_winner)
 
-        #
-        # If valid manifest was provided, it is not necessary
-        # to connect next AI service,
-        #
-        if ret == httplib.OK:
-            AIGM_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "%s AI service provided valid manifest",
-                          ai_service)
-            ai_manifest_obtained = True
-            break
-        else:
-            AIGM_LOG.post(AILog.AI_DBGLVL_WARN,
-                          "%s AI service didn't provide valid manifest, " \
-                          "ret=%d", ai_service, ret)
-
-    service_list_fh.close()
-
-    if not ai_manifest_obtained:
+    if ai_winner is None:
         AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
                       "None of contacted AI services provided valid manifest")
         return 2
@@ -839,16 +1068,15 @@ def parse_cli(cli_opts_args):
                   "Saving manifest to %s", manifest_file)
 
     try:
-        fh_manifest = open(manifest_file, 'w')
-    except IOError:
+        os.chmod(ai_winner.manifest_path, 0644)
+        os.rename(ai_winner.manifest_path, manifest_file)
+    except OSError:
         AIGM_LOG.post(AILog.AI_DBGLVL_ERR,
-                      "Couldn't open %s for saving obtained manifest",
+                      "Couldn't save obtained manifest to %s",
                       manifest_file)
+        ai_remove_manifests(ai_queries, None)
         return 2
 
-    fh_manifest.write(ai_manifest)
-    fh_manifest.close()
-
     return 0
 
 
@@ -31,20 +31,441 @@ import sys
 
 import getopt
 import os
-import re
-import signal
-from subprocess import Popen, PIPE
+import select
+import socket
+import struct
+import time
 import traceback
-from osol_install.auto_install.ai_get_manifest import AILog
+from osol_install.auto_install.ai_get_manifest import AILog, \
+    ai_get_ipv4_addrs
 
 #
 # AI service discovery logging service
 #
 AISD_LOG = AILog("AISD")
 
+#
+# Services discovered are cached here for the rest of the boot, so that
+# they don't have to be looked up again if service discovery is restarted
+#
+AISD_CACHE_FILE = "/var/run/ai_sd_cache"
+
+# multicast DNS group and port (RFC 6762)
+MDNS_ADDRESS = ("224.0.0.251", 5353)
+
+# DNS record types and class used for service discovery (RFC 6763)
+DNS_TYPE_A = 1
+DNS_TYPE_PTR = 12
+DNS_TYPE_TXT = 16
+DNS_TYPE_SRV = 33
+DNS_CLASS_IN = 1
+
+# QR bit of DNS message header - set in responses
+DNS_FLAG_QR = 0x8000
+
+# size of the largest DNS message accepted
+DNS_MSG_MAX = 9000
+
+# initial interval of query retransmission, it doubles with each one
+MDNS_RETRANSMIT_INTERVAL = 1.0
+
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def dns_name_pack(labels):
+    """ Description: Encodes domain name given as list of labels
+    """
+
+    name = ""
+    for label in labels:
+        name += chr(len(label)) + label
+
+    return name + "\0"
+
+
+def dns_name_unpack(msg, offset):
+    """ Description: Decodes (possibly compressed) domain name
+
+        Returns:
+            list of labels, offset of data following the name
+    """
+
+    labels = []
+    end = None
+    jumps = 0
+
+    while True:
+        length = ord(msg[offset])
+
+        # compression pointer
+        if length & 0xc0 == 0xc0:
+            if end is None:
+                end = offset + 2
+
+            jumps += 1
+            if jumps > len(msg):
+                raise ValueError("DNS name compression loop")
+
+            offset = struct.unpack("!H", msg[offset:offset + 2])[0] & 0x3fff
+            continue
+
+        offset += 1
+        if length == 0:
+            break
+
+        labels.append(msg[offset:offset + length])
+        offset += length
+
+    if end is None:
+        end = offset
+
+    return labels, end
+
+
+def dns_query_pack(questions):
+    """ Description: Encodes DNS query
+
+        Parameters:
+            questions - list of (labels, type) tuples
+    """
+
+    msg = struct.pack("!HHHHHH", 0, 0, len(questions), 0, 0, 0)
+    for labels, qtype in questions:
+        msg += dns_name_pack(labels) + struct.pack("!HH", qtype,
+                                                   DNS_CLASS_IN)
+
+    return msg
+
+
+def dns_response_unpack(msg):
+    """ Description: Decodes resource records of DNS response.
+                     Only records needed for service discovery
+                     are decoded, others are skipped.
+
+        Returns:
+            list of (labels, type, data) tuples, data is
+                list of labels for PTR records,
+                list of strings for TXT records,
+                (port, target labels) for SRV records,
+                address string for A records
+    """
+
+    (flags, qdcount, ancount, nscount, arcount) = \
+        struct.unpack("!2xHHHHH", msg[:12])
+
+    if not flags & DNS_FLAG_QR:
+        return []
+
+    offset = 12
+    for i in range(qdcount):
+        offset = dns_name_unpack(msg, offset)[1] + 4
+
+    records = []
+    for i in range(ancount + nscount + arcount):
+        labels, offset = dns_name_unpack(msg, offset)
+        (rtype, rdlength) = struct.unpack("!H6xH", msg[offset:offset + 10])
+        offset += 10
+        rdata_end = offset + rdlength
+
+        if rdata_end > len(msg):
+            raise ValueError("DNS record truncated")
+
+        if rtype == DNS_TYPE_PTR:
+            records.append((labels, rtype,
+                            dns_name_unpack(msg, offset)[0]))
+
+        elif rtype == DNS_TYPE_TXT:
+            strings = []
+            pos = offset
+            while pos < rdata_end:
+                length = ord(msg[pos])
+                strings.append(msg[pos + 1:pos + 1 + length])
+                pos += 1 + length
+            records.append((labels, rtype, strings))
+
+        elif rtype == DNS_TYPE_SRV:
+            port = struct.unpack("!4xH", msg[offset:offset + 6])[0]
+            records.append((labels, rtype,
+                            (port, dns_name_unpack(msg, offset + 6)[0])))
+
+        elif rtype == DNS_TYPE_A and rdlength == 4:
+            records.append((labels, rtype,
+                            socket.inet_ntoa(msg[offset:rdata_end])))
+
+        offset = rdata_end
+
+    return records
+
 
 #~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+class AIServiceResolver:
+    """ Class: AIServiceResolver - looks up instances of given service
+        type using multicast DNS. One query browses for all instances
+        at once, all answers which arrive before deadline are collected.
+        Services found are cached for the rest of the boot.
+    """
+
+    def __init__(self, svc_type, domain="local", address=MDNS_ADDRESS,
+                 cache_file=AISD_CACHE_FILE):
+        """ Metod:    __init__
+
+		    Parameters:
+		        svc_type - service type, like '_OSInstall._tcp'
+			domain - .local for multicast DNS
+			address - where queries are sent, (address, port)
+			cache_file - file caching services found,
+			             None..no caching
+
+	"""
+        self.svc_type = svc_type
+        self.domain = domain
+        self.address = address
+        self.cache_file = cache_file
+
+        # labels of service type, instance names are prepended to them
+        self.type_labels = [label.lower() for label in
+                            (svc_type + "." + domain).split('.') if label]
+
+        # TXT records of service instances found, by instance name
+        self.svc_txt_recs = {}
+
+        # set when the browse was carried out until its deadline
+        self.browse_complete = False
+
+        self._cache_load()
+
+        # TXT records already recorded in cache file
+        self.svc_txt_recs_cached = self.svc_txt_recs.copy()
+
+    def _cache_key(self):
+        """ Returns:
+		        service type the cache entries are recorded for
+	"""
+        return ".".join(self.type_labels)
+
+    def _cache_load(self):
+        """ Description: Loads services found during this boot
+	"""
+        if self.cache_file is None:
+            return
+
+        try:
+            fh_cache = open(self.cache_file, 'r')
+        except IOError:
+            return
+
+        for line in fh_cache.readlines():
+            entry = line.rstrip('\n').split('\t')
+            if len(entry) == 3 and entry[0] == self._cache_key():
+                self.svc_txt_recs[entry[1]] = entry[2]
+
+        fh_cache.close()
+
+    def _cache_store(self):
+        """ Description: Records services found for the rest of the boot
+	"""
+        new_txt_recs = [(name, txt_rec) for name, txt_rec in
+                        self.svc_txt_recs.items()
+                        if self.svc_txt_recs_cached.get(name) != txt_rec]
+
+        if self.cache_file is None or not new_txt_recs:
+            return
+
+        try:
+            fh_cache = open(self.cache_file, 'a')
+        except IOError:
+            AISD_LOG.post(AILog.AI_DBGLVL_WARN,
+                          "Couldn't open %s for caching services found",
+                          self.cache_file)
+            return
+
+        for name, txt_rec in new_txt_recs:
+            fh_cache.write("%s\t%s\t%s\n" % (self._cache_key(), name,
+                                             txt_rec))
+            self.svc_txt_recs_cached[name] = txt_rec
+        fh_cache.close()
+
+    def _instance_name(self, labels):
+        """ Returns:
+		        name of service instance if labels name instance
+			of our service type, None otherwise
+	"""
+        if len(labels) != len(self.type_labels) + 1 or \
+            [label.lower() for label in labels[1:]] != self.type_labels:
+            return None
+
+        return labels[0]
+
+    def _process_response(self, msg):
+        """ Description: Picks up instances and their TXT records
+		                 from multicast DNS response
+
+		    Returns:
+		        list of instances whose TXT record is still missing
+	"""
+        try:
+            records = dns_response_unpack(msg)
+        except (ValueError, IndexError, struct.error):
+            AISD_LOG.post(AILog.AI_DBGLVL_WARN,
+                          "Malformed multicast DNS response ignored")
+            return []
+
+        instances = []
+        for labels, rtype, data in records:
+            if rtype == DNS_TYPE_PTR and \
+                [label.lower() for label in labels] == self.type_labels:
+                name = self._instance_name(data)
+                if name is not None:
+                    instances.append(name)
+
+            elif rtype == DNS_TYPE_TXT:
+                name = self._instance_name(labels)
+                if name is None:
+                    continue
+
+                #
+                # verify TXT record - following format is expected:
+                #
+                # aiwebserver=<address>:<port>
+                #
+                for txt in data:
+                    if txt.startswith("aiwebserver="):
+                        AISD_LOG.post(AILog.AI_DBGLVL_INFO,
+                                      " %s TXT: %s", name, txt)
+                        self.svc_txt_recs[name] = txt
+                        break
+
+        return [name for name in instances
+                if not self.svc_txt_recs.has_key(name)]
+
+    def _send(self, sock, msg, ifaddrs):
+        """ Description: Sends query to multicast DNS address, once
+		                 on each of given interfaces
+
+		    Parameters:
+		        sock - socket to send query from
+			msg - query to be sent
+			ifaddrs - IPv4 addresses of interfaces, the query
+			          is sent on default interface if empty
+	"""
+        if not ifaddrs:
+            sock.sendto(msg, self.address)
+            return
+
+        for ifaddr in ifaddrs:
+            try:
+                sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF,
+                                socket.inet_aton(ifaddr))
+                sock.sendto(msg, self.address)
+            except socket.error, err:
+                AISD_LOG.post(AILog.AI_DBGLVL_WARN,
+                              "Multicast DNS query on %s failed: %s",
+                              ifaddr, err)
+
+    def browse(self, timeout, wanted=None):
+        """ Description: Sends query for all instances of service type
+		                 and collects answers until timeout expires
+		                 or wanted instance is found
+
+		    Parameters:
+		        timeout - max time to wait for answers
+			wanted - name of service instance which ends
+			         the browse early when found
+	"""
+        try:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL,
+                            struct.pack("B", 255))
+            sock.bind(("", 0))
+        except socket.error, err:
+            AISD_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Couldn't open socket for multicast DNS: %s", err)
+            return
+
+        query = dns_query_pack([(self.type_labels, DNS_TYPE_PTR)])
+        txt_asked = []
+
+        #
+        # multicast datagram leaves on one interface only, so the query
+        # is sent on each of them to reach services on every network
+        #
+        ifaddrs = []
+        if 224 <= ord(socket.inet_aton(self.address[0])[0]) <= 239:
+            ifaddrs = ai_get_ipv4_addrs()
+            AISD_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "Interfaces queried: %s",
+                          ", ".join(ifaddrs) or "default")
+
+        AISD_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "Browsing for %s at %s:%d", self._cache_key(),
+                      self.address[0], self.address[1])
+
+        now = time.time()
+        deadline = now + timeout
+        retransmit = now
+        interval = MDNS_RETRANSMIT_INTERVAL
+
+        try:
+            while now < deadline:
+                #
+                # the query is repeated with increasing interval,
+                # since any multicast datagram can be lost
+                #
+                if now >= retransmit:
+                    self._send(sock, query, ifaddrs)
+                    retransmit = now + interval
+                    interval *= 2
+
+                ready = select.select([sock], [], [],
+                                      min(deadline, retransmit) - now)[0]
+                if ready:
+                    msg = sock.recvfrom(DNS_MSG_MAX)[0]
+                    missing = [name for name in self._process_response(msg)
+                               if name not in txt_asked]
+
+                    #
+                    # responders usually include TXT records along with
+                    # the answer, ask explicitly for those which didn't
+                    #
+                    if missing:
+                        txt_asked.extend(missing)
+                        self._send(sock, dns_query_pack(
+                            [([name] + self.type_labels, DNS_TYPE_TXT)
+                             for name in missing]), ifaddrs)
+
+                    if wanted is not None and \
+                        self.svc_txt_recs.has_key(wanted):
+                        break
+
+                now = time.time()
+            else:
+                self.browse_complete = True
+
+        except socket.error, err:
+            AISD_LOG.post(AILog.AI_DBGLVL_ERR,
+                          "Multicast DNS query failed: %s", err)
+
+        sock.close()
+        self._cache_store()
+
+    def lookup(self, name, timeout):
+        """ Description: Looks up service instance. Multicast DNS is
+		                 queried only if the instance isn't known yet
+		                 and no browse has been completed so far.
+
+		    Returns:
+		        TXT record of the instance, None if not found
+	"""
+        if not self.svc_txt_recs.has_key(name) and \
+            not self.browse_complete:
+            self.browse(timeout, name)
+        else:
+            AISD_LOG.post(AILog.AI_DBGLVL_INFO,
+                          "Result of previous look up used for %s", name)
+
+        return self.svc_txt_recs.get(name)
+
+
 class AIService:
     """ Class: AIService - base class for holding/manipulating AI service
     """
@@ -68,42 +489,10 @@ class AIService:
         self.timeout = timeout
         self.domain = domain
         self.found = False
-        self.svc_info = self.svc_txt_rec = None
-
-        #
-        # ID of process running dns-sd(1M) command. It will be used by
-        # os.kill() to terminate the process.
-        #
-
-        self.pid = -1
-
-        #
-        # Flag which indicates that timer expired for running dns-sd(1M)
-        #
-
-        self.timeout_expired = False
+        self.svc_txt_rec = None
 
         return
 	
-    def _svc_lookup_timeout_handler(self, signum, frame):
-        """     Description:
-		    Handles raising of SIGALRM signal - kill the process
-		    with ID saved in SD_PID by sending SIGTERM signal
-
-		    Parameters:
-		        signum - number of signal
-			frame - current stack frame
-
-		    Returns:
-        """
-
-        if self.pid >= 0:
-            os.kill(self.pid, signal.SIGTERM)
-
-        # set the flag and disable the alarm
-        self.timeout_expired = True
-        signal.alarm(0)
-
     def get_found(self):
         """    Returns:
 		        True..service found, False..service not found
@@ -120,181 +509,81 @@ class AIService:
 		"""
         return self.svc_txt_rec
 
-    def lookup(self):
+    def lookup(self, resolver):
         """ Metod:    lookup
 
 		    Description:
 		        Tries to look up service instance
 
+		    Parameters:
+		        resolver - AIServiceResolver for service type
+
 		    Returns:
 		        0..service found, -1..service not found
 
 	"""
 
-        #
-        # discard the information we obtained so far
-        # and start new look up process
-        #
-        self.svc_info = self.svc_txt_rec = None
-        self.found = False
-
-        # dns-sd(1M) is used for look up the service
-        cmd = "/usr/bin/dns-sd -L %s %s %s" % (self.name,
-                                               self.__class__.type,
-                                               self.domain)
-
-        AISD_LOG.post(AILog.AI_DBGLVL_INFO, "cmd: %s", cmd)
-
-        cmd_args = cmd.split()
-
-        #
-        # spawn new process which will take care of looking up
-        # the service. If the service is not found within specified
-        # time, raise the SIGALRM signal and kill the process
-        #
-        try:
-            cmd_popen = Popen(cmd_args, stdout=PIPE, stderr=PIPE)
-
-        except OSError:
-            AISD_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Popen() raised OSError exception")
+        self.svc_txt_rec = resolver.lookup(self.name, self.timeout)
+        self.found = self.svc_txt_rec is not None
 
+        if not self.found:
             return -1
 
-        except ValueError:
-            AISD_LOG.post(AILog.AI_DBGLVL_ERR,
-                          "Popen() raised ValueError exception")
-
-            return -1
-
-        #
-        # save ID of new process - os.kill() will use it later
-        # to terminate the process
-        #
-        self.pid = cmd_popen.pid
         AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                      "dns-sd pid: %d", self.pid)
-	
-        signal.signal(signal.SIGALRM, self._svc_lookup_timeout_handler)
+                      "Valid service found:\n svc: %s\n TXT: %s",
+                      self.name, self.svc_txt_rec)
 
-        # activate timeout
-        self.timeout_expired = False
-        signal.alarm(self.timeout)
+        return 0
 
-        #
-        # Save file descriptors for stdout, stderr
-        # from dns-sd for later purposes
-        #
-        cmd_stdout_fd = cmd_popen.stdout
-        cmd_stderr = None
-
-        svc_info = svc_txt_rec = None
-        svc_info_found = svc_txt_rec_found = False
-
-        #
-        # process output from dns-sd(1M) until either service
-        # is found or timeout expires
-        #
-        while cmd_popen.poll() is None and not self.timeout_expired:
-            try:
-                # read main service info - wait for the line
-                # containing service name
-                line = cmd_stdout_fd.readline().strip()
-
-                # search for exact match of given service name
-                svc = line.split()
-                if len(svc) > 1 and re.search("^%s." % self.name,
-                                              svc[1].strip()):
-
-                    AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                                  " Svc: %s", line)
-
-                    svc_info_found = True
-                    svc_info = line
-                    svc_txt_rec_found = False
-                    continue
-
-                #
-                # read and verify TXT records -
-                # following format is expected:
-                #
-                # aiwebserver=<address>:<port>
-                #
-                if re.search(r"^aiwebserver=", line):
-                    AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                                  " TXT: %s", line)
-                    svc_txt_rec = line
-                    svc_txt_rec_found = True
-                else:
-                    svc_info_found = \
-                        svc_txt_rec_found = False
+	
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def ai_service_addresses(resolver, preferred):
+    """         Description: Lists addresses of all AI service instances
+                             found, in order in which they should be
+                             tried. Preferred instances go first, in
+                             given order, the rest sorted by name.
 
-                #
-                # Abort look up process, if service was found
-                #
+		    Parameters:
+		        resolver - AIServiceResolver the look up was
+			           carried out with
+			preferred - names of preferred service instances
 
-                if svc_info_found and svc_txt_rec_found:
-                    AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                                  " %s service found", self.name)
-                    break
-
-            #
-            # IOError exception is raised when the process
-            # is terminated during I/O operation. This will
-            # happen if service can't be found, since in this case
-            # we would be waiting in cmd_stdout_fd.readline()
-            #
-            except IOError:
-                # wait for process to finish
-                cmd_stderr = cmd_popen.communicate()[1]
-
-                if self.timeout_expired:
-                    AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                                  "Timeout expired, dns-sd (pid=%d)" \
-                                  " terminated", self.pid)
-
-                else:
-                    AISD_LOG.post(AILog.AI_DBGLVL_WARN,
-                                  "IOError raised for unknown reason")
-
-        # disable alarm
-        signal.alarm(0)
+		    Returns:
+		        list of 'address:port' strings
+    """
+    txt_recs = resolver.svc_txt_recs
+    names = [name for name in preferred if txt_recs.has_key(name)]
+    names.extend(sorted([name for name in txt_recs.keys()
+                         if name not in names]))
 
+    addresses = []
+    for name in names:
         #
-        # if the process didn't finish yet, it is either
-        # still running or in the phase of finishing its job.
+        # parse information captured from TXT record in order
+        # to obtain source of service (address and port)
+        # extract value from 'aiwebserver' name-value pair
         #
-        if cmd_popen.poll() is None:
-            # If process is running, terminate it
-            if not self.timeout_expired:
-                AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                              "dns-sd (pid=%d) is running, will be " \
-                              "terminated", self.pid)
-
-                os.kill(self.pid, signal.SIGTERM)
-
-        if cmd_popen.poll() is not None:
-            AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "dns-sd return code: %d", cmd_popen.returncode)
-
-        # capture output of stderr for debugging purposes
-        if cmd_stderr:
+        try:
+            svc_address = txt_recs[name].strip().split('aiwebserver=', 1)[1]
+            svc_address = svc_address.split(',')[0]
+            (svc_address, svc_port) = svc_address.split(':')
+        except (IndexError, ValueError):
             AISD_LOG.post(AILog.AI_DBGLVL_WARN,
-                          " stderr: %s", cmd_stderr)
+                          "Ignoring %s, invalid TXT record: %s",
+                          name, txt_recs[name])
+            continue
 
-        if svc_info_found and svc_txt_rec_found:
-            AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                          "Valid service found:\n svc: %s\n TXT: %s",
-                          svc_info, svc_txt_rec)
+        AISD_LOG.post(AILog.AI_DBGLVL_INFO,
+                      "%s can be reached at: %s:%s", name,
+                      svc_address, svc_port)
 
-            self.found = True
-            self.svc_info = svc_info
-            self.svc_txt_rec = svc_txt_rec
-            return 0
+        svc_address = "%s:%s" % (svc_address, svc_port)
+        if svc_address not in addresses:
+            addresses.append(svc_address)
+
+    return addresses
 
-        return -1
 
-	
 #~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def usage():
     """         Description: Print usage message and exit
@@ -366,6 +655,13 @@ def parse_cli(cli_opts_args):
     # add default service
     service_list.append(AIService('_default', service_lookup_timeout))
 
+    #
+    # All instances of service type are looked up at once, so the
+    # default service doesn't need additional look up, if the named
+    # one is not found
+    #
+    resolver = AIServiceResolver(AIService.type)
+
     # Go through the list of services and try to look up them
     for i in range(len(service_list)):
         svc_instance = "%s.%s.%s" % (service_list[i].name,
@@ -375,7 +671,7 @@ def parse_cli(cli_opts_args):
                       "Service to look up: %s", svc_instance)
 
         # look up the service
-        ret = service_list[i].lookup()
+        ret = service_list[i].lookup(resolver)
         if ret == 0:
             svc_found_index = i
             break
@@ -386,18 +682,17 @@ def parse_cli(cli_opts_args):
         return 2
 
     #
-    # parse information captured from dns-sd in order
-    # to obtain source of service (address and port)
-    # extract value from 'aiwebserver' name-value pair
+    # Other instances seen during the look up are listed too, after
+    # the one found, so that the manifest can still be obtained if
+    # it is not available. Services are tried in the order listed.
     #
-    svc_address = service_list[svc_found_index].get_txt_rec()
-    svc_address = svc_address.strip().split('aiwebserver=', 1)[1]
-    svc_address = svc_address.split(',')[0]
-    (svc_address, svc_port) = svc_address.split(':')
+    preferred = [service.name for service in service_list[svc_found_index:]]
+    svc_addresses = ai_service_addresses(resolver, preferred)
 
-    AISD_LOG.post(AILog.AI_DBGLVL_INFO,
-                  "%s can be reached at: %s:%s", svc_instance,
-                  svc_address, svc_port)
+    if not svc_addresses:
+        AISD_LOG.post(AILog.AI_DBGLVL_ERR,
+                      "No valid AI service found")
+        return 2
 
     # write the information to the given location
     AISD_LOG.post(AILog.AI_DBGLVL_INFO,
@@ -410,7 +705,8 @@ def parse_cli(cli_opts_args):
                       "Couldn't open %s for saving service list", service_file)
         return 2
 
-    fh_svc_list.write("%s:%s\n" % (svc_address, svc_port))
+    for svc_address in svc_addresses:
+        fh_svc_list.write("%s\n" % svc_address)
     fh_svc_list.close()
 
     return 0
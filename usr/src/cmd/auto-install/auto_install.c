@@ -1801,6 +1801,32 @@ main(int argc, char **argv)
 			nvlist_free(ls_init_attr);
 			exit(AI_EXIT_FAILURE);
 		}
+
+		/*
+		 * Debug messages are numerous, don't let them slow down
+		 * the installation by writing each of them synchronously
+		 */
+		if (nvlist_add_boolean_value(ls_init_attr, LS_ATTR_ASYNC,
+		    B_TRUE) != 0) {
+			(void) fprintf(stderr,
+			    "Setting LS_ATTR_ASYNC failed\n");
+
+			nvlist_free(ls_init_attr);
+			exit(AI_EXIT_FAILURE);
+		}
+
+		/*
+		 * Record trace spans, they are saved next to the install
+		 * log on the target
+		 */
+		if (nvlist_add_boolean_value(ls_init_attr, LS_ATTR_TRACE,
+		    B_TRUE) != 0) {
+			(void) fprintf(stderr,
+			    "Setting LS_ATTR_TRACE failed\n");
+
+			nvlist_free(ls_init_attr);
+			exit(AI_EXIT_FAILURE);
+		}
 	}
 
 	if (ls_init(ls_init_attr) != LS_E_SUCCESS) {
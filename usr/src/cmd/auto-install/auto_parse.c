@@ -309,8 +309,10 @@ ai_setup_manifest_image()
 void
 ai_teardown_manifest_state()
 {
-	if (manifest_serv_obj != NULL)
+	if (manifest_serv_obj != NULL) {
 		(void) ai_destroy_manifestserv(manifest_serv_obj);
+		manifest_serv_obj = NULL;
+	}
 }
 
 char **
@@ -24,16 +24,15 @@
  */
 
 #include <Python.h>
+#include <sys/time.h>
 #include "auto_install.h"
+#include "pysession.h"
 
 #define	AI_PARSE_MANIFEST_SCRIPT "osol_install.auto_install.ai_parse_manifest"
 #define	AI_CREATE_MANIFESTSERV "ai_create_manifestserv"
 #define	AI_SETUP_MANIFESTSERV "ai_setup_manifestserv"
 #define	AI_LOOKUP_MANIFEST_VALUES "ai_lookup_manifest_values"
 
-static PyThreadState * mainThreadState = NULL;
-static char *empty_argv[1] = { "" };
-
 /*
  * The C interface to ai_create_manifestserv (python module).
  * This function takes a manifest file and hands it off to
@@ -45,81 +44,58 @@ static char *empty_argv[1] = { "" };
  *
  * ai_destroy_manifestserv() must be called after all the
  * processing has been done to destroy the ManifestServ object
- *
- * This function can only be invoked from a single threaded
- * context.
  */
 PyObject *
 ai_create_manifestserv(char *filename)
 {
 	PyObject	*pFunc;
-	PyObject	*pName;
 	PyObject	*pArgs;
-	PyThreadState	*myThreadState;
-	PyObject	*pModule = NULL;
+	ps_state_t	pyState;
 	PyObject	*rv = NULL;
 	PyObject	*pRet = NULL;
 
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
-
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
-	}
-
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
-
-	if ((pName = PyString_FromString(AI_PARSE_MANIFEST_SCRIPT)) != NULL) {
-		pModule = PyImport_Import(pName);
-		Py_DECREF(pName);
+	if (!ps_session_init()) {
+		auto_debug_print(AUTO_DBGLVL_ERR, "Call failed: %s\n",
+		    AI_CREATE_MANIFESTSERV);
+		return (NULL);
 	}
-	if (pModule != NULL) {
-		/* Load the ai_parse_manifest module */
-		pFunc = PyObject_GetAttrString(pModule, AI_CREATE_MANIFESTSERV);
-		/* pFunc is a new reference */
-		if (pFunc && PyCallable_Check(pFunc)) {
 
-			pArgs = PyTuple_New(1);
-			PyTuple_SetItem(pArgs, 0,
-			    PyString_FromString(filename));
+	pyState = ps_session_enter();
 
-			/* Call the ai_parse_manifest */
-			pRet = PyObject_CallObject(pFunc, pArgs);
-			Py_DECREF(pArgs);
-			if ((pRet != NULL) && (!PyErr_Occurred())) {
-				/*
-				 * A reference is getting stolen here.
-				 * We intentionally don't do a DECREF
-				 * so that future calls using this object
-				 * have a valid ManifestServ object to work
-				 * with.
-				 */
-				if (pRet != Py_None)
-					rv = pRet;
-			} else {
-				PyErr_Print();
-				auto_debug_print(AUTO_DBGLVL_ERR,
-				    "Call failed: %s\n",
-				    AI_CREATE_MANIFESTSERV);
-			}
+	/* Load the ai_parse_manifest module */
+	pFunc = ps_get_function(AI_PARSE_MANIFEST_SCRIPT,
+	    AI_CREATE_MANIFESTSERV);
+	/* pFunc is a borrowed reference owned by the session */
+	if (pFunc != NULL) {
+		pArgs = PyTuple_New(1);
+		PyTuple_SetItem(pArgs, 0, PyString_FromString(filename));
+
+		/* Call the ai_parse_manifest */
+		pRet = PyObject_CallObject(pFunc, pArgs);
+		Py_DECREF(pArgs);
+		if ((pRet != NULL) && (!PyErr_Occurred())) {
+			/*
+			 * A reference is getting stolen here.
+			 * We intentionally don't do a DECREF
+			 * so that future calls using this object
+			 * have a valid ManifestServ object to work
+			 * with.
+			 */
+			if (pRet != Py_None)
+				rv = pRet;
 		} else {
-			auto_debug_print(AUTO_DBGLVL_ERR, "Python function "
-			    "does not appear callable: %s\n",
+			PyErr_Print();
+			auto_debug_print(AUTO_DBGLVL_ERR,
+			    "Call failed: %s\n",
 			    AI_CREATE_MANIFESTSERV);
 		}
+	} else {
+		PyErr_Print();
+		auto_debug_print(AUTO_DBGLVL_ERR, "Python function "
+		    "does not appear callable: %s\n",
+		    AI_CREATE_MANIFESTSERV);
 	}
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+	ps_session_exit(pyState);
 	return (rv);
 }
 
@@ -128,58 +104,42 @@ ai_create_manifestserv(char *filename)
  * Sets up and validates the data of a ManifestServ object.
  * Must be called after ai_create_manifestserv has set up a
  * ManifestServ object in memory.
- *
- * This function can only be invoked from a single threaded
- * context.
  */
 int
 ai_setup_manifestserv(PyObject *server_obj)
 {
 	PyObject	*pFunc;
-	PyObject	*pName;
 	PyObject	*pArgs;
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject	*pRet;
-	PyObject	*pModule = NULL;
 	int		rval = AUTO_INSTALL_SUCCESS;
 
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
-
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
+	if (!ps_session_init()) {
+		auto_debug_print(AUTO_DBGLVL_ERR, "Call failed: %s\n",
+		    AI_SETUP_MANIFESTSERV);
+		return (AUTO_INSTALL_FAILURE);
 	}
 
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
+	pyState = ps_session_enter();
 
-	if ((pName = PyString_FromString(AI_PARSE_MANIFEST_SCRIPT)) != NULL) {
-		pModule = PyImport_Import(pName);
-		Py_DECREF(pName);
-	}
-	if (pModule != NULL) {
-		/* Load the ai_parse_manifest module */
-		pFunc = PyObject_GetAttrString(pModule, AI_SETUP_MANIFESTSERV);
-		/* pFunc is a new reference */
-		if (pFunc && PyCallable_Check(pFunc)) {
-			pArgs = PyTuple_New(1);
-			Py_INCREF(server_obj);
-			PyTuple_SetItem(pArgs, 0, server_obj);
+	/* Load the ai_parse_manifest module */
+	pFunc = ps_get_function(AI_PARSE_MANIFEST_SCRIPT,
+	    AI_SETUP_MANIFESTSERV);
+	/* pFunc is a borrowed reference owned by the session */
+	if (pFunc != NULL) {
+		pArgs = PyTuple_New(1);
+		Py_INCREF(server_obj);
+		PyTuple_SetItem(pArgs, 0, server_obj);
 
-			/* Call the ai_parse_manifest */
-			pRet = PyObject_CallObject(pFunc, pArgs);
+		/* Call the ai_parse_manifest */
+		pRet = PyObject_CallObject(pFunc, pArgs);
+		Py_DECREF(pArgs);
+		if (pRet != NULL) {
 			rval = PyInt_AS_LONG(pRet);
 			Py_DECREF(pRet);
-			Py_DECREF(pArgs);
 		} else {
-			auto_debug_print(AUTO_DBGLVL_ERR, "Python function "
-			    "does not appear callable: %s\n",
+			PyErr_Print();
+			auto_debug_print(AUTO_DBGLVL_ERR, "Call failed: %s\n",
 			    AI_SETUP_MANIFESTSERV);
 			rval = AUTO_INSTALL_FAILURE;
 		}
@@ -189,11 +149,7 @@ ai_setup_manifestserv(PyObject *server_obj)
 		    AI_SETUP_MANIFESTSERV);
 		rval = AUTO_INSTALL_FAILURE;
 	}
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+	ps_session_exit(pyState);
 	return (rval);
 }
 
@@ -208,54 +164,24 @@ char **
 ai_lookup_manifest_values(PyObject *server_obj, char *path, int *len)
 {
 	PyObject	*pFunc;
-	PyObject	*pName;
 	PyObject 	*pArgs;
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject 	*item;
 	char		**rv;
-	PyObject	*pModule = NULL;
-
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
 
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
-	}
-
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
-
-	pName = PyString_FromString(AI_PARSE_MANIFEST_SCRIPT);
-	assert(pName != NULL);
-	if (pName == NULL) {
-		PyErr_Print();
+	if (!ps_session_init()) {
 		auto_debug_print(AUTO_DBGLVL_INFO, "Call failed: %s\n",
 		    AI_LOOKUP_MANIFEST_VALUES);
-		Py_Finalize();
 		return (NULL);
 	}
 
-	pModule = PyImport_Import(pName);
-	assert(pModule != NULL);
-	if (pModule == NULL) {
-		Py_DECREF(pName);
-		PyErr_Print();
-		auto_debug_print(AUTO_DBGLVL_INFO, "Call failed: %s\n",
-		    AI_LOOKUP_MANIFEST_VALUES);
-		Py_Finalize();
-		return (NULL);
-	}
+	pyState = ps_session_enter();
 
 	/* Load the ai_parse_manifest module */
-	pFunc = PyObject_GetAttrString(pModule, AI_LOOKUP_MANIFEST_VALUES);
-	/* pFunc is a new reference */
-	if (pFunc && PyCallable_Check(pFunc)) {
+	pFunc = ps_get_function(AI_PARSE_MANIFEST_SCRIPT,
+	    AI_LOOKUP_MANIFEST_VALUES);
+	/* pFunc is a borrowed reference owned by the session */
+	if (pFunc != NULL) {
 		PyObject *pRet = NULL;
 
 
@@ -295,24 +221,18 @@ ai_lookup_manifest_values(PyObject *server_obj, char *path, int *len)
 				rv = NULL;
 			Py_DECREF(pRet);
 		} else {
-			Py_DECREF(pFunc);
-			Py_DECREF(pModule);
 			PyErr_Print();
 			auto_debug_print(AUTO_DBGLVL_INFO, "Call failed: %s\n",
 			    AI_LOOKUP_MANIFEST_VALUES);
 			rv = NULL;
 		}
 	} else {
-		assert(!PyErr_Occurred());
-		if (PyErr_Occurred())
-			PyErr_Print();
+		PyErr_Print();
+		auto_debug_print(AUTO_DBGLVL_INFO, "Call failed: %s\n",
+		    AI_LOOKUP_MANIFEST_VALUES);
 		rv = NULL;
 	}
-	Py_XDECREF(pFunc);
-	Py_DECREF(pModule);
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+	ps_session_exit(pyState);
 	return (rv);
 }
 
@@ -342,6 +262,24 @@ ai_free_manifest_value_list(char **value_list)
 void
 ai_destroy_manifestserv(PyObject *server_obj)
 {
-	if (Py_IsInitialized())
-		Py_Finalize();
+	ps_state_t	pyState;
+	ps_stats_t	stats;
+
+	if (server_obj == NULL || !ps_session_init())
+		return;
+
+	/*
+	 * The interpreter itself stays up for the rest of the process,
+	 * it is shared with the other install libraries.
+	 */
+	pyState = ps_session_enter();
+	Py_DECREF(server_obj);
+	ps_session_exit(pyState);
+
+	ps_session_stats(&stats);
+	auto_debug_print(AUTO_DBGLVL_INFO, "Python session: %llu calls, "
+	    "%llu ms in the interpreter, %llu imports, %llu cache hits\n",
+	    (u_longlong_t)stats.pst_crossings,
+	    (u_longlong_t)(stats.pst_boundary_ns / (NANOSEC / MILLISEC)),
+	    (u_longlong_t)stats.pst_imports, (u_longlong_t)stats.pst_hits);
 }
@@ -0,0 +1,246 @@
+#!/usr/bin/python2.7
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+
+'''
+Stand-in multicast DNS responder for testing AI service discovery.
+
+It answers queries for instances of the AI service type the way mdnsd
+does for services published with dns-sd(1M) -R, but on a plain UDP socket,
+so that ai_sd's resolver can be exercised on the loopback interface
+without any multicast routing or mdnsd running:
+
+    mdns_responder.py -p 5354 _default=10.0.0.1:8081
+
+Only PTR, TXT, SRV and A records are served and responses always go back
+by unicast to the address the query came from.
+'''
+
+import getopt
+import select
+import socket
+import struct
+import sys
+import threading
+
+DNS_TYPE_A = 1
+DNS_TYPE_PTR = 12
+DNS_TYPE_TXT = 16
+DNS_TYPE_SRV = 33
+DNS_TYPE_ANY = 255
+DNS_CLASS_IN = 1
+
+# response, authoritative answer
+DNS_FLAGS_RESPONSE = 0x8400
+
+# TTL of records served
+RECORD_TTL = 120
+
+
+def name_pack(labels):
+    '''Encode domain name given as list of labels, without compression'''
+    return "".join([chr(len(label)) + label for label in labels]) + "\0"
+
+
+def name_unpack(msg, offset):
+    '''Decode domain name, return list of labels and offset following it'''
+    labels = []
+    end = None
+    while True:
+        length = ord(msg[offset])
+        if length & 0xc0 == 0xc0:
+            if end is None:
+                end = offset + 2
+            offset = struct.unpack("!H", msg[offset:offset + 2])[0] & 0x3fff
+            continue
+        offset += 1
+        if length == 0:
+            break
+        labels.append(msg[offset:offset + length])
+        offset += length
+    if end is None:
+        end = offset
+    return labels, end
+
+
+def record_pack(labels, rtype, rdata):
+    '''Encode resource record'''
+    return name_pack(labels) + struct.pack("!HHIH", rtype, DNS_CLASS_IN,
+                                           RECORD_TTL, len(rdata)) + rdata
+
+
+class MDNSResponder(threading.Thread):
+    '''Serves AI service instances until stopped.
+
+    services - dictionary mapping instance name to (address, port) of
+               the AI webserver, published in 'aiwebserver' TXT record
+    address - (address, port) to listen on, port 0 picks a free one
+    additionals - if False, only records asked for are returned, so that
+                  clients have to ask for TXT records explicitly
+    '''
+
+    def __init__(self, services, svc_type="_OSInstall._tcp", domain="local",
+                 address=("127.0.0.1", 0), additionals=True):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.services = services
+        self.type_labels = [label.lower() for label in
+                            (svc_type + "." + domain).split(".") if label]
+        self.additionals = additionals
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(address)
+        self.address = self.sock.getsockname()
+        self.stopped = False
+
+        # questions received so far, as (labels, type) tuples
+        self.questions = []
+
+    def instance_records(self, name, rtypes):
+        '''Records of service instance of given types'''
+        (host, port) = self.services[name]
+        labels = [name] + self.type_labels
+        target = ["host-" + host.replace(".", "-"), self.type_labels[-1]]
+        records = []
+        if DNS_TYPE_TXT in rtypes:
+            txt = "aiwebserver=%s:%d" % (host, port)
+            records.append(record_pack(labels, DNS_TYPE_TXT,
+                                       chr(len(txt)) + txt))
+        if DNS_TYPE_SRV in rtypes:
+            records.append(record_pack(labels, DNS_TYPE_SRV,
+                                       struct.pack("!HHH", 0, 0, port) +
+                                       name_pack(target)))
+            try:
+                records.append(record_pack(target, DNS_TYPE_A,
+                                           socket.inet_aton(host)))
+            except socket.error:
+                pass
+        return records
+
+    def respond(self, query):
+        '''Build response to query, None if there is nothing to answer'''
+        (qid, flags, qdcount) = struct.unpack("!HHH", query[:6])
+        if flags & 0x8000:
+            return None
+
+        offset = 12
+        questions = ""
+        answers = []
+        additionals = []
+        for i in range(qdcount):
+            labels, end = name_unpack(query, offset)
+            qtype = struct.unpack("!H", query[end:end + 2])[0]
+            questions += query[offset:end] + query[end:end + 4]
+            offset = end + 4
+            self.questions.append((labels, qtype))
+
+            labels = [label.lower() for label in labels]
+            if labels == self.type_labels and \
+                qtype in (DNS_TYPE_PTR, DNS_TYPE_ANY):
+                for name in self.services:
+                    answers.append(record_pack(self.type_labels,
+                                               DNS_TYPE_PTR,
+                                               name_pack([name] +
+                                                   self.type_labels)))
+                    if self.additionals:
+                        additionals.extend(self.instance_records(name,
+                            (DNS_TYPE_TXT, DNS_TYPE_SRV)))
+                continue
+
+            for name in self.services:
+                if labels != [name.lower()] + self.type_labels:
+                    continue
+                if qtype == DNS_TYPE_ANY:
+                    answers.extend(self.instance_records(name,
+                        (DNS_TYPE_TXT, DNS_TYPE_SRV)))
+                else:
+                    answers.extend(self.instance_records(name, (qtype,)))
+
+        if not answers:
+            return None
+
+        # questions are repeated, as required for legacy unicast responses
+        return struct.pack("!HHHHHH", qid, DNS_FLAGS_RESPONSE, qdcount,
+                           len(answers), 0, len(additionals)) + \
+            questions + "".join(answers) + "".join(additionals)
+
+    def run(self):
+        while not self.stopped:
+            if not select.select([self.sock], [], [], 0.1)[0]:
+                continue
+            (query, peer) = self.sock.recvfrom(9000)
+            try:
+                response = self.respond(query)
+            except (IndexError, struct.error):
+                continue
+            if response is not None:
+                self.sock.sendto(response, peer)
+
+    def stop(self):
+        '''Stop serving and wait for the responder to finish'''
+        self.stopped = True
+        self.join()
+        self.sock.close()
+
+
+def main():
+    '''Serve instances given on command line until interrupted'''
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "a:p:s:")
+    except getopt.GetoptError:
+        args = []
+    if not args:
+        print >> sys.stderr, "Usage: mdns_responder.py [-a address] " \
+            "[-p port] [-s service_type] name=address:port ..."
+        return 1
+
+    address = "127.0.0.1"
+    port = 5353
+    svc_type = "_OSInstall._tcp"
+    for option, argument in opts:
+        if option == "-a":
+            address = argument
+        elif option == "-p":
+            port = int(argument)
+        elif option == "-s":
+            svc_type = argument
+
+    services = {}
+    for arg in args:
+        (name, server) = arg.split("=", 1)
+        (host, svc_port) = server.rsplit(":", 1)
+        services[name] = (host, int(svc_port))
+
+    responder = MDNSResponder(services, svc_type, address=(address, port))
+    print "Serving %s at %s:%d" % (", ".join(services.keys()),
+                                   responder.address[0], responder.address[1])
+    responder.start()
+    try:
+        while responder.isAlive():
+            responder.join(1)
+    except KeyboardInterrupt:
+        responder.stop()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,162 @@
+#!/usr/bin/python2.7
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+
+'''
+To run these tests, see the instructions in usr/src/tools/tests/README.
+Remember that since the proto area is used for the PYTHONPATH, the gate
+must be rebuilt for these tests to pick up any changes in the tested code.
+
+ai_sd itself is loaded from the source tree, since it is delivered as
+a program rather than a module. Queries go to the stand-in responder
+from mdns_responder.py on the loopback interface.
+'''
+
+import imp
+import os
+import shutil
+import tempfile
+import time
+import unittest
+from mdns_responder import MDNSResponder
+
+ai_sd = imp.load_source("ai_sd", os.path.join(os.path.dirname(__file__),
+                                              "..", "ai_sd.py"))
+
+SVC_TYPE = "_OSInstall._tcp"
+
+
+class ServiceResolver(unittest.TestCase):
+    '''Tests for AIServiceResolver against stand-in responder'''
+
+    def setUp(self):
+        self.tmp_dir = tempfile.mkdtemp(prefix="ai_sd_test.")
+        self.cache_file = os.path.join(self.tmp_dir, "ai_sd_cache")
+        self.responder = None
+
+    def tearDown(self):
+        if self.responder is not None:
+            self.responder.stop()
+        shutil.rmtree(self.tmp_dir)
+
+    def start_responder(self, services, additionals=True):
+        '''Start responder serving given services'''
+        self.responder = MDNSResponder(services, SVC_TYPE,
+                                       additionals=additionals)
+        self.responder.start()
+
+    def resolver(self):
+        '''Resolver querying the responder'''
+        return ai_sd.AIServiceResolver(SVC_TYPE,
+                                       address=self.responder.address,
+                                       cache_file=self.cache_file)
+
+    def test_named_found(self):
+        '''Named service is found without waiting for timeout'''
+        self.start_responder({"_test_service": ("10.0.0.1", 8081),
+                              "_default": ("10.0.0.2", 8082)})
+        start = time.time()
+        txt = self.resolver().lookup("_test_service", 5)
+        self.assertEquals(txt, "aiwebserver=10.0.0.1:8081")
+        self.assertTrue(time.time() - start < 2)
+        self.assertEquals(len(self.responder.questions), 1)
+
+    def test_default_from_same_browse(self):
+        '''Default service is picked up by the browse for named one'''
+        self.start_responder({"_default": ("10.0.0.2", 8082)})
+        resolver = self.resolver()
+        start = time.time()
+        self.assertEquals(resolver.lookup("_test_service", 1), None)
+        self.assertTrue(time.time() - start >= 1)
+        asked = len(self.responder.questions)
+
+        self.assertEquals(resolver.lookup("_default", 1),
+                          "aiwebserver=10.0.0.2:8082")
+        self.assertEquals(len(self.responder.questions), asked)
+
+    def test_txt_asked_explicitly(self):
+        '''TXT record is asked for if it doesn't come with the answer'''
+        self.start_responder({"_default": ("10.0.0.2", 8082)},
+                             additionals=False)
+        txt = self.resolver().lookup("_default", 5)
+        self.assertEquals(txt, "aiwebserver=10.0.0.2:8082")
+        self.assertEquals([qtype for labels, qtype in
+                           self.responder.questions],
+                          [ai_sd.DNS_TYPE_PTR, ai_sd.DNS_TYPE_TXT])
+
+    def test_not_found(self):
+        '''Look up gives up when timeout expires'''
+        self.start_responder({})
+        start = time.time()
+        self.assertEquals(self.resolver().lookup("_default", 1), None)
+        self.assertTrue(time.time() - start < 2)
+        self.assertFalse(os.path.exists(self.cache_file))
+
+    def test_cached(self):
+        '''Services found are reused from cache without querying'''
+        self.start_responder({"_default": ("10.0.0.2", 8082)})
+        self.resolver().lookup("_default", 5)
+        asked = len(self.responder.questions)
+
+        self.assertEquals(self.resolver().lookup("_default", 5),
+                          "aiwebserver=10.0.0.2:8082")
+        self.assertEquals(len(self.responder.questions), asked)
+        self.assertEquals(len(open(self.cache_file).readlines()), 1)
+
+    def test_addresses_ordered(self):
+        '''All instances found are listed, preferred ones first'''
+        self.start_responder({"_test_service": ("10.0.0.1", 8081),
+                              "_default": ("10.0.0.2", 8082),
+                              "_b_service": ("10.0.0.3", 8083),
+                              "_a_service": ("10.0.0.2", 8082)})
+        resolver = self.resolver()
+        resolver.browse(1)
+        self.assertEquals(ai_sd.ai_service_addresses(resolver,
+                          ["_default", "_test_service"]),
+                          ["10.0.0.2:8082", "10.0.0.1:8081",
+                           "10.0.0.3:8083"])
+
+
+class DNSMessage(unittest.TestCase):
+    '''Tests for DNS message decoding'''
+
+    def test_compressed_name(self):
+        '''Compressed names are expanded'''
+        msg = "\x03foo\x05local\x00\x03bar\xc0\x00"
+        self.assertEquals(ai_sd.dns_name_unpack(msg, 11),
+                          (["bar", "foo", "local"], 17))
+
+    def test_compression_loop(self):
+        '''Compression loop is detected'''
+        self.assertRaises(ValueError, ai_sd.dns_name_unpack,
+                          "\xc0\x00", 0)
+
+    def test_query_ignored(self):
+        '''Queries of other clients are not taken as responses'''
+        query = ai_sd.dns_query_pack([(["_OSInstall", "_tcp", "local"],
+                                       ai_sd.DNS_TYPE_PTR)])
+        self.assertEquals(ai_sd.dns_response_unpack(query), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
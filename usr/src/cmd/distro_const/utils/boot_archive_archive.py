@@ -29,11 +29,13 @@ import os
 import sys
 import stat
 import signal
+import threading
+from Queue import Queue, Empty
 from subprocess import Popen, PIPE
 from math import floor,log
 from osol_install.ManifestRead import ManifestRead
-from osol_install.install_utils import find
-from osol_install.install_utils import dir_size
+from osol_install.install_utils import scan_tree
+from osol_install.install_utils import inventory_size
 from osol_install.libti import ti_create_target
 from osol_install.libti import ti_release_target
 from osol_install.distro_const.dc_utils import get_manifest_value
@@ -69,7 +71,74 @@ LOFIADM = "/usr/sbin/lofiadm"
 SED = "/usr/bin/sed"
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-def compress(src, dst):
+def fiocompress_files(flist, dst):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ fiocompress the files in flist into dst, running one fiocompress
+    per online CPU at a time. Files are handed out in list order, so
+    putting the largest first keeps the CPUs busy until the end.
+
+    Args:
+      flist : files to compress, relative to the current directory.
+      dst : directory to put the compressed files in.
+
+    Returns: True if any file couldn't be compressed, False otherwise.
+
+    Raises: N/A
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    try:
+        nworkers = max(1, os.sysconf("SC_NPROCESSORS_ONLN"))
+    except (ValueError, OSError):
+        nworkers = 1
+    nworkers = min(nworkers, len(flist))
+
+    work = Queue()
+    for cpio_file in flist:
+        work.put(cpio_file)
+    failed = []
+    lock = threading.Lock()
+
+    def worker():
+        """ compress files off the queue until it is empty """
+        while True:
+            try:
+                cpio_file = work.get_nowait()
+            except Empty:
+                return
+            try:
+                status = Popen([FIOCOMPRESS, "-mc", cpio_file,
+                                dst + "/" + cpio_file]).wait()
+                if (status < 0):
+                    reason = FIOCOMPRESS + " killed by signal " + \
+                        str(-status)
+                else:
+                    reason = FIOCOMPRESS + " exited with status " + \
+                        str(status)
+            except OSError, err:
+                status = err.errno
+                reason = os.strerror(err.errno)
+            if (status != 0):
+                lock.acquire()
+                try:
+                    print >> sys.stderr, (sys.argv[0] +
+                        ": error compressing file " +
+                        cpio_file + ": " + reason)
+                    failed.append(cpio_file)
+                finally:
+                    lock.release()
+
+    workers = [threading.Thread(target=worker) for i in range(nworkers)]
+    for thr in workers:
+        thr.start()
+    for thr in workers:
+        thr.join()
+    return (len(failed) != 0)
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def compress(src, dst, inventory):
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     """ fiocompress files in the dst. The files listed in
     boot/solaris/filelist.ramdisk and files in usr/kernel are recopied
@@ -78,6 +147,7 @@ def compress(src, dst):
     Args:
       src : directory files are copied to dst from.
       dst : directory to fiocompress files in.
+      inventory : inventory of src, as returned by scan_tree(src).
 
     Returns: N/A
 
@@ -87,13 +157,6 @@ def compress(src, dst):
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
     os.chdir(src)
-
-    #
-    # Create list of boot archive files/directories.
-    # Since passed with '.' relative path, find() generates paths
-    # starting with './'
-    #
-    ba_flist = find(["."])
     errors = False
 
     #
@@ -106,9 +169,10 @@ def compress(src, dst):
     rdfd = open("boot/solaris/filelist.ramdisk", 'r')
     uc_list = []
     for filename in rdfd:
-        if not filename.startswith('./'):
-            filename = os.path.join('./', filename)
-        uc_list.append(filename.strip())
+        filename = filename.strip()
+        if not filename:
+            continue
+        uc_list.append(os.path.join('./', os.path.normpath(filename)))
     rdfd.close()
 
     # Append ./usr/kernel directory
@@ -146,42 +210,40 @@ def compress(src, dst):
             raise Exception, (sys.argv[0] + ": Error building "
                 "list of uncompressed boot_archive files.")
 
-    # Get expanded uncompressed list
-    exp_uc_flist = find(uc_list)
-
-    #
-    # Create set of entries to be compressed by differentiating following sets:
-    #  - set describing whole boot archive
-    #  - set of entries not eligible for compression
-    #
-    compress_fset = set(ba_flist) - set(exp_uc_flist)
+    uc_set = set(uc_list)
 
     #
-    # Enumerate through set of entries eligible for compression and compress
-    # those entries which meet all of the following criteria:
+    # Enumerate through the boot archive inventory and compress those
+    # entries which meet all of the following criteria:
     #
+    #  - it is neither listed as uncompressed, nor under a directory which is
     #  - it is a regular file
     #  - size > 0
     #  - it is NOT a hardlink
     #
-    for cfile in compress_fset:
-        # strip off the trailing \n
-        cpio_file = cfile.strip()
-
-        if os.access(cpio_file, os.F_OK):
-            stat_out = os.lstat(cpio_file)
-            mode = stat_out.st_mode
-            if (stat.S_ISREG(mode) and not (stat_out.st_size == 0)
-                and (stat_out.st_nlink < 2)):
-                cmd = FIOCOMPRESS + " -mc " + cpio_file + \
-                    " " + dst + "/" + cpio_file
-                status = os.system(cmd)
-                if (status != 0):
-                    print >> sys.stderr, (sys.argv[0] +
-                        ": error compressing file " +
-                        cpio_file + ": " +
-                        os.strerror(status >> 8))
-                    errors = True
+    # The files are compressed in parallel, one fiocompress per CPU.
+    #
+    if src.endswith("/"):
+        prefix_len = len(src)
+    else:
+        prefix_len = len(src) + 1
+    fio_flist = []
+    for (path, mode, size, nlink, ino) in inventory[1:]:
+        if (not stat.S_ISREG(mode) or size == 0 or nlink >= 2):
+            continue
+
+        # Relative path starting with './', as listed in uc_set
+        cpio_file = "./" + path[prefix_len:]
+        parent = cpio_file
+        while parent != "." and parent not in uc_set:
+            parent = os.path.dirname(parent)
+        if parent != ".":
+            continue
+        fio_flist.append((size, cpio_file))
+    if fio_flist:
+        fio_flist.sort(reverse=True)
+        errors = fiocompress_files([cpio_file for (size, cpio_file)
+                                    in fio_flist], dst)
     if (errors):
         raise Exception, (sys.argv[0] + ": Error processing " +
                           "compressed boot_archive files")
@@ -189,13 +251,14 @@ def compress(src, dst):
 
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-def get_boot_archive_nbpi(size, rootpath):
+def get_boot_archive_nbpi(size, inventory):
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     """ Get the number of bytes per inode for boot archive. 
 
 	Args:
 	  size : boot archive size in bytes.   
-	  rootpath : boot archive directory.
+	  inventory : inventory of the boot archive directory, as returned
+	    by scan_tree().
 
 	Returns: number of bytes per inode
 
@@ -207,10 +270,9 @@ def get_boot_archive_nbpi(size, rootpath):
     fcount = 0
     ioverhead = 0
     
-    # Get total number of inodes needed for boot archive
-    for root, subdirs, files in os.walk(rootpath):
-	for f in (files + subdirs):
-	    fcount += 1
+    # Get total number of inodes needed for boot archive (the inventory
+    # starts with the boot archive directory itself)
+    fcount = len(inventory) - 1
 
     # Add inode overhead for multiple disk systems using 500 disks as a target
     # upper bound. For sparc we need 16 inodes per target device:
@@ -400,8 +462,11 @@ if STRIP_ARCHIVE:
                           os.strerror(COPY_STATUS >> 8))
 
 print "Sizing boot archive requirements..."
-# dir_size() returns size in bytes, need to convert to KB
-BOOT_ARCHIVE_SIZE = (dir_size(BA_BUILD)) / 1024
+# Take the inventory of the boot archive area once, for sizing, counting
+# inodes and picking the files to compress.
+BA_INVENTORY = scan_tree(BA_BUILD)
+# inventory_size() returns size in bytes, need to convert to KB
+BOOT_ARCHIVE_SIZE = inventory_size(BA_INVENTORY) / 1024
 print "    Raw uncompressed: %d MB." % (BOOT_ARCHIVE_SIZE / 1024)
 
 # Add 10% to the reported size for overhead (20% for smaller archives),
@@ -417,7 +482,7 @@ BOOT_ARCHIVE_SIZE = \
 
 if (BA_BYTES_PER_INODE == 0):
     BA_BYTES_PER_INODE = get_boot_archive_nbpi(
-	BOOT_ARCHIVE_SIZE * 1024, BA_BUILD) 
+	BOOT_ARCHIVE_SIZE * 1024, BA_INVENTORY)
 
 print "Creating boot archive with padded size of %d MB..." % (
     (BOOT_ARCHIVE_SIZE / 1024))
@@ -464,7 +529,7 @@ if IS_SPARC:
     elif (BA_COMPR_TYPE == "dcfs"):
         print "Doing compression..."
         try:
-            compress(BA_BUILD, BA_LOFI_MNT_PT)
+            compress(BA_BUILD, BA_LOFI_MNT_PT, BA_INVENTORY)
         except Exception:
             release_archive()
             raise
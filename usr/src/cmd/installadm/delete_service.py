@@ -39,6 +39,9 @@ from optparse import OptionParser
 import osol_install.auto_install.installadm_common as com
 import osol_install.libaiscf as smf
 
+# images set up by setup-image, new images share their content
+IMAGE_REGISTRY = "/var/installadm/net_images"
+
 class Client_Data(object):
     '''
     A class to hold client data and interoperate with an AIservice class.
@@ -304,6 +307,35 @@ def remove_files(service, removeImageBool):
         # return the service directory
         return ("/var/ai/" + txt_record.split(":")[-1])
 
+    def unregister_image(image_path):
+        '''
+        Drops the image from the registry of images set up by setup-image,
+        so that no new image shares its files with it
+        '''
+        try:
+            fh = open(IMAGE_REGISTRY, "r")
+            images = fh.readlines()
+            fh.close()
+        # no image was registered
+        except IOError:
+            return
+
+        remaining = [image for image in images if
+                     os.path.normpath(image.rstrip("\n")) !=
+                     os.path.normpath(image_path)]
+        if len(remaining) == len(images):
+            return
+
+        # replace the registry so that setup-image never reads it partially
+        try:
+            fh = open(IMAGE_REGISTRY + ".new", "w")
+            fh.writelines(remaining)
+            fh.close()
+            os.rename(IMAGE_REGISTRY + ".new", IMAGE_REGISTRY)
+        except (IOError, OSError), e:
+            sys.stderr.write (_("Unable to update %s:\n%s\n") %
+                              (IMAGE_REGISTRY, e))
+
     def find_image_path(service):
         '''
         Handles finding image, ensuring image is not in use other than current
@@ -356,6 +388,9 @@ def remove_files(service, removeImageBool):
 
         # lastly, all is good, return the image and image-server path
         else:
+            # new images must not link to the files about to be removed
+            unregister_image(image_path)
+
             # find the longest empty path leading up to webserver image path
             files = [image_path,
                      # must strip the leading path separator from image_path as
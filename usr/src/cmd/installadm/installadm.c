@@ -616,11 +616,21 @@ do_create_service(
 	 */
 	if (access(target_directory, F_OK) == 0) {
 		if (stat(target_directory, &stat_buf) == 0) {
-			char	path[MAXPATHLEN];
+			char		path[MAXPATHLEN];
+			boolean_t	resume;
 			/*
 			 * If the directory is empty, then it is okay
 			 */
 			if (stat_buf.st_nlink > 2) {
+				/*
+				 * Setup of the image which was interrupted
+				 * is resumed by the setup-image script
+				 */
+				(void) snprintf(path, sizeof (path), "%s/%s",
+				    target_directory, AI_NETIMAGE_SETUP_DIR);
+				resume = create_netimage &&
+				    access(path, F_OK) == 0;
+
 				/*
 				 * Check whether it has valid file solaris.zlib
 				 */
@@ -628,16 +638,17 @@ do_create_service(
 				    target_directory,
 				    AI_NETIMAGE_REQUIRED_FILE);
 				if (access(path, R_OK) != 0) {
-					(void) fprintf(stderr,
-					    MSG_TARGET_NOT_EMPTY);
-					return (INSTALLADM_FAILURE);
-				}
-				/*
-				 * Already have an image. We can't create a
-				 * new one w/o removing the old one.
-				 * Display error
-				 */
-				if (create_netimage) {
+					if (!resume) {
+						(void) fprintf(stderr,
+						    MSG_TARGET_NOT_EMPTY);
+						return (INSTALLADM_FAILURE);
+					}
+				} else if (create_netimage && !resume) {
+					/*
+					 * Already have an image. We can't
+					 * create a new one w/o removing the
+					 * old one. Display error
+					 */
 					(void) fprintf(stderr,
 					    MSG_VALID_IMAGE_ERR,
 					    target_directory);
@@ -36,6 +36,7 @@
 
 #define	AI_SERVICE_DIR_PATH	"/var/ai/"
 #define	AI_NETIMAGE_REQUIRED_FILE "solaris.zlib"
+#define	AI_NETIMAGE_SETUP_DIR	".image_setup"
 #define	SERVICE_DELETE_SCRIPT	"/usr/lib/installadm/delete-service"
 #define	SETUP_IMAGE_SCRIPT	"/usr/lib/installadm/setup-image"
 #define	IMAGE_CREATE		"create"
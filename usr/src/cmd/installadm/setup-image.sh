@@ -29,6 +29,9 @@
 #	validated and the system checked for space availability.
 #	The contents is copied to the target directory and a link is created
 #	to the webserver running on a standard port.
+#	Files are copied concurrently and a setup which was interrupted
+#	resumes where it stopped. Large files with the same content as in
+#	images set up before in the same file system are hard linked to them.
 #	The document root is assumed to be /var/ai/image_server/images
 
 PATH=/usr/bin:/usr/sbin:/sbin:/usr/lib/installadm; export PATH
@@ -40,11 +43,35 @@ DOCROOT=/var/ai/image-server/images
 AI_NETIMAGE_REQUIRED_FILE="solaris.zlib"
 DF="/usr/sbin/df"
 
+#
+# Number of files copied (and checksummed) concurrently
+#
+COPY_JOBS=8
+#
+# State of image setup in progress, kept in the target directory
+#
+IMAGE_SETUP_DIR=".image_setup"
+#
+# Checksum manifest of the image, "<sha1> <path>" for each regular file
+#
+IMAGE_MANIFEST=".image_manifest"
+#
+# Images set up so far, their content can be shared by new images
+#
+IMAGE_REGISTRY=/var/installadm/net_images
+#
+# Only files of at least this size (in bytes) are shared with other images.
+# These are the read-only payloads like solaris.zlib, smaller files such as
+# the auto_install manifests may be edited in place and are always copied.
+#
+SHARED_MIN_SIZE=1048576
+
 caid_mnt="/tmp/caid.$$"
 caid_lofi_dev=""
 diskavail=0
 lofi_dev=""
 image_source=""
+copy_pids=""
 g_cwd=`pwd`
 
 #
@@ -73,6 +100,11 @@ cleanup_and_exit()
 		ret=1
 	fi
 
+	# stop copy jobs still running, along with the commands they run
+	for pid in $copy_pids ; do
+		kill -TERM -$pid > /dev/null 2>&1
+	done
+
 	cd $g_cwd
 	if [ -f "$image_source" ]; then
 		unmount_iso_image $image_source
@@ -206,6 +238,294 @@ unmount_iso_image()
 	rmdir $MOUNT_DIR
 }
 
+#
+# index_source
+#
+# Purpose : List regular files of the source image along with their sizes
+#	    and modification times, so that it can be told whether a partial
+#	    setup was started from the same source.
+#
+# Arguments :
+#	none, runs in the source directory
+#
+# Output : "<size> <mtime> <path>" lines, sorted by path
+#
+index_source()
+{
+	find . -type f -exec ls -E {} + | nawk '{
+		stamp = $5 " " $6 "T" $7 $8
+		for (i = 0; i < 8; i++)
+			sub(/^[ \t]*[^ \t]+/, "")
+		sub(/^[ \t]+/, "")
+		print stamp, $0
+	}' | sort -k 3
+}
+
+#
+# split_list
+#
+# Purpose : Deal lines of a file round robin into $COPY_JOBS files
+#
+# Arguments :
+#	$1 - file to split
+#	$2 - prefix of output files, job number is appended to it
+#
+split_list()
+{
+	nawk -v jobs=$COPY_JOBS -v prefix="$2" '
+		BEGIN { for (i = 0; i < jobs; i++) printf "" > (prefix i) }
+		{ print > (prefix (NR % jobs)) }' "$1"
+}
+
+#
+# start_job
+#
+# Purpose : Run a command in the background, in a process group of its own
+#	    so that cleanup_and_exit can stop the commands it runs as well
+#
+# Arguments :
+#	$@ - command and its arguments
+#
+start_job()
+{
+	set -m
+	"$@" &
+	copy_pids="$copy_pids $!"
+	set +m
+}
+
+#
+# wait_jobs
+#
+# Purpose : Wait for all background jobs started into copy_pids
+#
+# Returns : 0 if all of them succeeded, 1 otherwise
+#
+wait_jobs()
+{
+	jobs_ret=0
+	for pid in $copy_pids ; do
+		wait $pid || jobs_ret=1
+	done
+	copy_pids=""
+	return $jobs_ret
+}
+
+#
+# checksum_worker
+#
+# Purpose : Checksum files given in list. Each path is passed verbatim
+#	    to digest(1), whatever characters it contains.
+#
+# Arguments :
+#	$1 - list of paths
+#	$2 - output file, digest -v lines
+#
+# Returns : 0 on success, 1 if a file couldn't be checksummed
+#
+checksum_worker()
+{
+	while IFS= read -r path ; do
+		digest -v -a sha1 "$path" || return 1
+	done < $1 > $2
+}
+
+#
+# checksum_image
+#
+# Purpose : Create checksum manifest of the source image. Files are
+#	    checksummed by $COPY_JOBS concurrent digest(1) processes.
+#
+# Arguments :
+#	$1 - setup state directory, the file list is taken from its index
+#	     and the manifest is stored there
+#
+# Output : "<sha1> <path>" lines in $1/manifest
+#
+checksum_image()
+{
+	state=$1
+
+	nawk '{ sub(/^[^ ]+ [^ ]+ /, ""); print }' ${state}/index \
+	    > ${state}/files
+	split_list ${state}/files ${state}/files.
+
+	i=0
+	while [ $i -lt $COPY_JOBS ] ; do
+		start_job checksum_worker ${state}/files.$i ${state}/sums.$i
+		i=`expr $i + 1`
+	done
+
+	wait_jobs || return 1
+
+	cat ${state}/sums.* | \
+	    sed -n 's/^sha1 (\(.*\)) = \([0-9a-f]*\)$/\2 \1/p' \
+	    > ${state}/manifest.$$ || return 1
+
+	rm -f ${state}/files* ${state}/sums.*
+	mv ${state}/manifest.$$ ${state}/manifest
+}
+
+#
+# shared_content_index
+#
+# Purpose : List files of already set up images which are located in
+#	    the same file system as the target, so that files with the
+#	    same content can be hard linked rather than copied.
+#
+# Arguments :
+#	$1 - target directory
+#
+# Output : "<sha1> <absolute path>" lines
+#
+shared_content_index()
+{
+	[ -f ${IMAGE_REGISTRY} ] || return 0
+
+	target_fs=`${DF} -n $1 | nawk '{ print $1; exit }'`
+
+	while read image ; do
+		[ "$image" = "$1" ] && continue
+		[ -f ${image}/${IMAGE_MANIFEST} ] || continue
+
+		image_fs=`${DF} -n $image | nawk '{ print $1; exit }'`
+		[ "$image_fs" = "$target_fs" ] || continue
+
+		nawk -v image="$image" \
+		    '{ print $1, image "/" substr($0, 42) }' \
+		    ${image}/${IMAGE_MANIFEST}
+	done < ${IMAGE_REGISTRY}
+}
+
+#
+# copy_worker
+#
+# Purpose : Copy files given in list from the source image to the target.
+#	    Files whose content is already available in another image in
+#	    the same file system are hard linked to it, once compared to be
+#	    sure it was not replaced since. Every file done is recorded in
+#	    journal, so that an interrupted setup can resume.
+#
+#	    Since files are shared between images, they must be replaced
+#	    rather than modified in place once the image is set up.
+#
+# Arguments :
+#	$1 - list of "<path><TAB><shared path or ->" lines
+#	$2 - target directory
+#	$3 - journal file
+#
+# Returns : 0 on success, 1 if a file couldn't be copied
+#
+copy_worker()
+{
+	while IFS="	" read -r path shared ; do
+		#
+		# A file left over by interrupted setup might be linked
+		# to another image, so it is never written to in place
+		#
+		rm -f "$2/$path"
+		if [ "$shared" = "-" ] || ! cmp -s "$path" "$shared" || \
+		    ! ln "$shared" "$2/$path" 2>/dev/null ; then
+			if ! cp -p "$path" "$2/$path" ; then
+				print_err "ERROR: Unable to copy $path"
+				return 1
+			fi
+		fi
+		printf "%s\n" "$path" >> $3
+	done < $1
+
+	return 0
+}
+
+#
+# copy_image
+#
+# Purpose : Copy the image from the current directory to the target.
+#	    Regular files are copied by $COPY_JOBS concurrent workers.
+#	    State of the setup is kept in the $IMAGE_SETUP_DIR directory
+#	    in the target, so that a setup which was interrupted resumes
+#	    with files not copied yet. When done, the checksum manifest
+#	    is left in the image as $IMAGE_MANIFEST and the image is
+#	    recorded in $IMAGE_REGISTRY for the following setups to share
+#	    its content.
+#
+# Arguments :
+#	$1 - target directory
+#
+# Returns : 0 on success, 1 on failure
+#
+copy_image()
+{
+	target=$1
+	state=${target}/${IMAGE_SETUP_DIR}
+
+	mkdir -p $state || return 1
+	index_source > ${state}/index.$$ || return 1
+
+	if [ -f ${state}/manifest ] && \
+	    cmp -s ${state}/index ${state}/index.$$ ; then
+		echo "Resuming setup of the target image ..."
+		rm ${state}/index.$$
+	else
+		rm -f ${state}/manifest ${state}/journal.*
+		mv ${state}/index.$$ ${state}/index
+		checksum_image $state || return 1
+	fi
+
+	# directories and anything else which is not a regular file
+	find . ! -type f -print | cpio -pdmu ${target} >/dev/null 2>&1 || \
+	    return 1
+
+	#
+	# Pick up files which are not copied yet and look up the large
+	# ones which can be shared with other images
+	#
+	cat /dev/null ${state}/journal.* > ${state}/done 2>/dev/null
+	shared_content_index ${target} > ${state}/shared
+	nawk -v min_size=$SHARED_MIN_SIZE \
+	    'FILENAME == ARGV[1] { done[$0] = 1; next }
+	    FILENAME == ARGV[2] { path = $0; sub(/^[^ ]+ [^ ]+ /, "", path)
+		size[path] = $1; next }
+	    FILENAME == ARGV[3] { if (!($1 in shared))
+		shared[$1] = substr($0, 42); next }
+	    {
+		path = substr($0, 42)
+		if (path in done)
+			next
+		if (size[path] >= min_size && ($1 in shared))
+			print path "\t" shared[$1]
+		else
+			print path "\t-"
+	    }' ${state}/done ${state}/index ${state}/shared ${state}/manifest \
+	    > ${state}/todo || return 1
+
+	split_list ${state}/todo ${state}/todo.
+
+	i=0
+	while [ $i -lt $COPY_JOBS ] ; do
+		start_job copy_worker ${state}/todo.$i ${target} \
+		    ${state}/journal.$$.$i
+		i=`expr $i + 1`
+	done
+
+	wait_jobs || return 1
+
+	# restore modes and times of directories modified by the copy
+	find . -type d -print | cpio -pdmu ${target} >/dev/null 2>&1 || \
+	    return 1
+
+	mv ${state}/manifest ${target}/${IMAGE_MANIFEST} || return 1
+	rm -rf $state
+
+	if ! nawk -v image="$target" '$0 == image { found = 1 }
+	    END { exit !found }' ${IMAGE_REGISTRY} 2>/dev/null ; then
+		mkdir -p `dirname ${IMAGE_REGISTRY}`
+		echo "$target" >> ${IMAGE_REGISTRY}
+	fi
+
+	return 0
+}
+
 #
 # create_image
 #
@@ -266,6 +586,11 @@ create_image()
 	# Check for space to create image and in /tftpboot
 	#
 	space_reqd=`du -ks ${src_dir} | ( read size name; echo $size )`
+	# setup interrupted before resumes, the part copied is already there
+	if [ -d ${target}/${IMAGE_SETUP_DIR} ]; then
+		space_done=`du -ks ${target} | ( read size name; echo $size )`
+		space_reqd=`expr $space_reqd - $space_done`
+	fi
 	# copy the whole CD to disk except Boot image
 	if [ $space_reqd -gt $diskavail ]; then
 		print_err "ERROR: Insufficient space to copy CD image"
@@ -276,7 +601,7 @@ create_image()
 	current_dir=`pwd`
 	echo "Setting up the target image at ${target} ..."
 	cd ${src_dir}
-	find . -depth -print | cpio -pdmu ${target} >/dev/null 2>&1
+	copy_image ${target}
 	copy_ret=$?
 	cd $current_dir
 
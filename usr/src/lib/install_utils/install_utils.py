@@ -578,6 +578,61 @@ def find(rootpaths, path_type=None, raise_errors=False):
                 rlist.append(fullname)
     return rlist
 
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def scan_tree(rootpath, same_fs=False):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Take an inventory of a file or directory tree in a single pass.
+
+    The tree is walked by the native scanner of the transfer module,
+    which reads directories in parallel and lstat's every object once.
+    Callers needing several views of the same tree (lists of files,
+    sizes, counts) should derive them all from one inventory rather
+    than walk the tree again.
+
+    Args:
+      rootpath: file or directory to take the inventory of.
+
+      same_fs: when True, directories on other filesystems are listed but
+        not descended into, like find(1) -mount.
+
+    Returns:
+      List of (pathname, mode, size, nlink, inode) tuples, one for rootpath
+      and one for each object under it. Pathnames start with rootpath, as
+      those returned by find() do. rootpath comes first, the order of the
+      rest is unspecified. Symbolic links are not followed. Objects which
+      can't be read are logged and left out.
+
+    Raises:
+      OSError: rootpath can't be scanned.
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    # Imported here so that the other utilities don't need the transfer
+    # module to be loaded.
+    from osol_install.libtransfer import scan_tree as tm_scan_tree
+
+    return tm_scan_tree(rootpath, 0, same_fs)
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def inventory_size(inventory):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Estimates the size of the objects in an inventory.
+
+    Each object is counted as file_size() would count it.
+
+    Args:
+      inventory: list of objects as returned by scan_tree()
+
+    Returns:
+      Size of the objects in bytes.
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    size = 0
+    for (path, mode, obj_size, nlink, ino) in inventory:
+        size += ((obj_size + 1023) / 1024) * 1024
+    return size
+
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def file_size(filename):
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -639,37 +694,21 @@ def dir_size(rootpath):
       Size of the directory contents in bytes.
 
     Raises:
-      OSError as returned from file_size
+      OSError as returned from scan_tree
       Exception: rootpath is not valid
 
     """
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-    size = 0
+    # Objects which can't be read are logged and not counted.
+    inventory = scan_tree(rootpath)
 
     # Get the size of the root directory
-    size += file_size(rootpath)
-    if (size == 0):
+    if (inventory_size(inventory[:1]) == 0):
         # This indicates the root directory is not valid
         raise Exception, (rootpath + "is not valid")
 
-    for root, subdirs, files in os.walk(rootpath):
-        # There's no need to distinguish between directories and
-        # files in the size calculation, merge the subdirs list
-        # and files list to make rest of the code simpler.
-        for filename in (files + subdirs):
-            abs_filename = root + "/" + filename
-            try:
-                size += file_size(abs_filename)
-            except OSError:
-                # No need to exit because can't get size of
-                # a file/dir, just print an error and continue
-                print >> sys.stderr, \
-                    ("Error getting information about "
-                     + abs_filename)
-                continue
-
-    return (size)
+    return (inventory_size(inventory))
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def validate_crypt_id(val, alt_root=None):
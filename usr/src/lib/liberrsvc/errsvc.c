@@ -28,6 +28,7 @@
 #include <string.h>
 #include <sys/errno.h>
 #include <libintl.h>
+#include "pysession.h"
 #include "liberrsvc.h"
 #include "liberrsvc_priv.h"
 #include "liberrsvc_defs.h"
@@ -58,9 +59,6 @@
 #define	ERR_INVAL_PARAM gettext("ERROR - Invalid Parameter passed to function")
 #define	ERR_UNKNOWN gettext("UNKNOWN ERROR")
 
-static PyThreadState *mainThreadState = NULL;
-static char *empty_argv[1] = { "" };
-
 int es_errno = 0;
 
 /* ******************************************** */
@@ -201,28 +199,14 @@ _es_py_assert(PyObject *exc)
 boolean_t
 _initialize()
 {
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
-
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
-	}
-
-	if (PyErr_Occurred()) {
-		return (B_FALSE);
-	}
-
-	return (B_TRUE);
+	return (ps_session_init());
 }
 
 /*
  * Function:  _load_module
  *
- * Description: Convenience function for loading Python module
+ * Description: Convenience function for loading Python module. The
+ *		module is only imported once per process.
  *
  * Parameters: mode_name - The name of the Python module being loaded.
  *
@@ -235,58 +219,75 @@ _initialize()
 static PyObject	*
 _load_module(char *mod_name)
 {
-	PyObject	*pModule = NULL;
-	PyObject	*pName;
+	PyObject	*pModule;
 
 	es_errno = 0;
 
-	/* Make the name object and import the Python module */
-	if ((pName = PyString_FromString(mod_name)) != NULL) {
-		pModule = PyImport_Import(pName);
-		Py_DECREF(pName);
-	}
-
+	pModule = ps_get_module(mod_name);
 	if (pModule == NULL) {
 		_log_error(gettext("\t[%s] ERROR - Import of [%s] failed\n"),
 		    ERRSVC_ID, mod_name);
 		es_errno = EINVAL;
+		return (NULL);
 	}
 
+	/* callers release their reference as before */
+	Py_INCREF(pModule);
 	return (pModule);
 }
 
+/*
+ * Function:  _load_function
+ *
+ * Description: Convenience function for looking up a function or class of
+ *		the errsvc Python module. The lookup is only done once per
+ *		process.
+ *
+ * Parameters: func_name - The name of the Python function.
+ *
+ * Returns:
+ *	NULL on failure
+ *	Pointer to PyObject on success
+ *
+ * Scope: Private
+ */
+static PyObject	*
+_load_function(char *func_name)
+{
+	PyObject	*pFunc;
+
+	if ((pFunc = ps_get_function(ERRSVC_PY_MOD, func_name)) != NULL)
+		Py_INCREF(pFunc);
+
+	return (pFunc);
+}
+
 /*
  * Function:  _start_threads
  *
- * Description: Convenience function for initializing threads for Python-C API
+ * Description: Convenience function for entering the Python interpreter
+ *		session from the calling thread
  *
  * Parameters: None
  *
  * Returns:
- *	Pointer to PyThreadState
- *	Null on failure
+ *	State to be passed to _stop_threads()
  *
  * Scope: Private
  */
-static PyThreadState *
+static ps_state_t
 _start_threads()
 {
-	PyThreadState	*myThreadState;
-
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
-
-	return (myThreadState);
+	return (ps_session_enter());
 }
 
 /*
  * Function: _stop_threads
  *
- * Description: Convenience function for clearing threads for Python-C API
+ * Description: Convenience function for leaving the Python interpreter
+ *		session
  *
- * Parameters: None
+ * Parameters: pyState - value returned by _start_threads()
  *
  * Returns:
  *	void
@@ -294,11 +295,9 @@ _start_threads()
  * Scope: Private
  */
 void
-_stop_threads(PyThreadState *myThreadState)
+_stop_threads(ps_state_t pyState)
 {
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+	ps_session_exit(pyState);
 }
 
 /*
@@ -439,7 +438,7 @@ es_get_failure_reason_str(void)
 err_info_t *
 es_create_err_info(char *mod_id, int err_type)
 {
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject	*pParamModId = NULL;
 	PyObject	*pParamErrType = NULL;
 	PyObject	*pModule = NULL;
@@ -453,7 +452,7 @@ es_create_err_info(char *mod_id, int err_type)
 		return (NULL);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	/*
 	 * Prepare the params.
@@ -484,7 +483,7 @@ es_create_err_info(char *mod_id, int err_type)
 		goto cleanup;
 	}
 
-	pFunc = PyObject_GetAttrString(pModule, ERROR_INFO_CLASS);
+	pFunc = _load_function(ERROR_INFO_CLASS);
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
 		_log_error(gettext("\t[%s] %s [%s] (Cannot call Python "
 		    "function)\n"), ERRSVC_ID, ERR_PY_FUNC, ERROR_INFO_CLASS);
@@ -517,7 +516,7 @@ cleanup:
 	Py_XDECREF(pParamModId);
 	Py_XDECREF(pParamErrType);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return ((err_info_t *)pRet);
 }
@@ -568,7 +567,7 @@ es_free_err_info_list(err_info_list_t *list)
 void
 es_free_errors(void)
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pModule = NULL;
 	PyObject *pFunc = NULL;
 	PyObject *pRet = NULL;
@@ -597,12 +596,12 @@ es_free_errors(void)
 		return;
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pModule = _load_module(ERRSVC_PY_MOD);
 
 	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, CLEAR_ERROR_LIST_FUNC);
+		pFunc = _load_function(CLEAR_ERROR_LIST_FUNC);
 	}
 
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
@@ -625,7 +624,7 @@ es_free_errors(void)
 	Py_XDECREF(pFunc);
 	Py_XDECREF(pModule);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 }
 
 /*
@@ -649,7 +648,7 @@ es_free_errors(void)
 boolean_t
 es_set_err_data_int(err_info_t *err, int type, int val)
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pMethod = NULL;
 	PyObject *pRet = NULL;
 	PyObject *pParamType = NULL;
@@ -662,7 +661,7 @@ es_set_err_data_int(err_info_t *err, int type, int val)
 		return (retval);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	/*
 	 * Prepare the params.
@@ -719,7 +718,7 @@ cleanup:
 	Py_XDECREF(pParamType);
 	Py_XDECREF(pMethod);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
@@ -747,7 +746,7 @@ cleanup:
 boolean_t
 es_set_err_data_str(err_info_t *err, int type, char *str, ...)
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pMethod = NULL;
 	PyObject *pRet = NULL;
 	PyObject *pParamType = NULL;
@@ -764,7 +763,7 @@ es_set_err_data_str(err_info_t *err, int type, char *str, ...)
 		return (retval);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	/*
 	 * Prepare the params.
@@ -854,7 +853,7 @@ cleanup:
 		free(buf);
 	}
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
@@ -882,7 +881,7 @@ cleanup:
 err_info_list_t *
 es_get_errors_by_modid(char *mod_id)
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pParamModId = NULL;
 	PyObject *pModule = NULL;
 	PyObject *pFunc = NULL;
@@ -893,7 +892,7 @@ es_get_errors_by_modid(char *mod_id)
 		return (NULL);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	/*
 	 * Prepare the params.
@@ -911,7 +910,7 @@ es_get_errors_by_modid(char *mod_id)
 	}
 
 	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, GET_ERRORS_BY_MOD_ID);
+		pFunc = _load_function(GET_ERRORS_BY_MOD_ID);
 	}
 
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
@@ -940,7 +939,7 @@ es_get_errors_by_modid(char *mod_id)
 	Py_XDECREF(pModule);
 	Py_XDECREF(pParamModId);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (return_list);
 }
@@ -968,7 +967,7 @@ es_get_errors_by_modid(char *mod_id)
 err_info_list_t *
 es_get_all_errors()
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pModule = NULL;
 	PyObject *pFunc = NULL;
 	PyObject *pRet = NULL;
@@ -978,12 +977,12 @@ es_get_all_errors()
 		return (NULL);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pModule = _load_module(ERRSVC_PY_MOD);
 
 	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, GET_ALL_ERRORS);
+		pFunc = _load_function(GET_ALL_ERRORS);
 	}
 
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
@@ -1012,7 +1011,7 @@ es_get_all_errors()
 	Py_XDECREF(pFunc);
 	Py_XDECREF(pModule);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (return_list);
 }
@@ -1025,7 +1024,7 @@ es_get_all_errors()
 boolean_t
 es__dump_all_errors__(void)
 {
-	PyThreadState *myThreadState;
+	ps_state_t pyState;
 	PyObject *pModule = NULL;
 	PyObject *pFunc = NULL;
 	PyObject *pRet = NULL;
@@ -1035,12 +1034,12 @@ es__dump_all_errors__(void)
 		return (retval);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pModule = _load_module(ERRSVC_PY_MOD);
 
 	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, DUMP_ALL_ERRORS_FUNC);
+		pFunc = _load_function(DUMP_ALL_ERRORS_FUNC);
 	}
 
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
@@ -1068,7 +1067,7 @@ es__dump_all_errors__(void)
 	Py_XDECREF(pFunc);
 	Py_XDECREF(pModule);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
@@ -1102,7 +1101,7 @@ es_get_errors_by_type(int err_type, boolean_t *list_is_empty)
 	PyObject 	*pModule = NULL;
 	PyObject	*pFunc = NULL;
 	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject	*pParamErrType = NULL;
 	err_info_list_t	*return_list = NULL;
 
@@ -1112,7 +1111,7 @@ es_get_errors_by_type(int err_type, boolean_t *list_is_empty)
 		return (return_list);
 	}
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pParamErrType = PyInt_FromLong((long)err_type);
 	pModule = _load_module(ERRSVC_PY_MOD);
@@ -1122,7 +1121,7 @@ es_get_errors_by_type(int err_type, boolean_t *list_is_empty)
 	}
 
 	/* Retrieve the attribute from the module */
-	pFunc = PyObject_GetAttrString(pModule, GET_ERRORS_BY_TYPE);
+	pFunc = _load_function(GET_ERRORS_BY_TYPE);
 
 	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
 		_log_error(gettext("[%s] %s [%s] (function)\n"),
@@ -1163,7 +1162,7 @@ cleanup:
 	Py_XDECREF(pModule);
 	Py_XDECREF(pParamErrType);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (return_list);
 }
@@ -1190,7 +1189,7 @@ es_get_err_type(err_info_t *err)
 {
 	PyObject	*pMethod = NULL;
 	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	int		retvalue = -1;
 	long		py_retval;
 
@@ -1202,7 +1201,7 @@ es_get_err_type(err_info_t *err)
 	if (_initialize() != B_TRUE)
 		return (retvalue);
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	if (! PyObject_HasAttrString((PyObject *)err, GET_ERR_TYPE)) {
 		_log_error(gettext("[%s] %s [%s] (attribute)\n"),
@@ -1242,7 +1241,7 @@ cleanup:
 	Py_XDECREF(pRet);
 	Py_XDECREF(pMethod);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retvalue);
 }
@@ -1269,7 +1268,7 @@ es_get_err_mod_id(err_info_t *err)
 {
 	PyObject	*pMethod = NULL;
 	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	char		*retval = NULL;
 
 	es_errno = 0;
@@ -1281,7 +1280,7 @@ es_get_err_mod_id(err_info_t *err)
 	if (_initialize() != B_TRUE)
 		return (NULL);
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	if (!PyObject_HasAttrString((PyObject *)err, GET_MOD_ID)) {
 		_log_error(gettext("[%s] %s [%s] (attribute)\n"),
@@ -1323,7 +1322,7 @@ cleanup:
 	Py_XDECREF(pRet);
 	Py_XDECREF(pMethod);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
@@ -1354,7 +1353,7 @@ cleanup:
 boolean_t
 es_get_err_data_int_by_type(err_info_t *err, int elem_type, int *err_int)
 {
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject	*pMethod = NULL;
 	PyObject	*pElemType = NULL;
 	PyObject	*pErrInt = NULL;
@@ -1371,7 +1370,7 @@ es_get_err_data_int_by_type(err_info_t *err, int elem_type, int *err_int)
 	if (_initialize() != B_TRUE)
 		return (retval);
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pElemType = PyInt_FromLong((long)elem_type);
 
@@ -1422,7 +1421,7 @@ cleanup:
 	Py_XDECREF(pErrInt);
 	Py_XDECREF(pMethod);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
@@ -1452,7 +1451,7 @@ cleanup:
 boolean_t
 es_get_err_data_str_by_type(err_info_t *err, int elem_type, char **err_str)
 {
-	PyThreadState	*myThreadState;
+	ps_state_t	pyState;
 	PyObject	*pMethod = NULL;
 	PyObject	*pElemType = NULL;
 	PyObject	*pErrStr = NULL;
@@ -1471,7 +1470,7 @@ es_get_err_data_str_by_type(err_info_t *err, int elem_type, char **err_str)
 	if (_initialize() != B_TRUE)
 		return (retval);
 
-	myThreadState = _start_threads();
+	pyState = _start_threads();
 
 	pElemType = PyInt_FromLong((long)elem_type);
 
@@ -1526,7 +1525,7 @@ cleanup:
 	Py_XDECREF(pErrStr);
 	Py_XDECREF(pMethod);
 
-	_stop_threads(myThreadState);
+	_stop_threads(pyState);
 
 	return (retval);
 }
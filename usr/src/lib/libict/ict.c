@@ -633,7 +633,9 @@ ict_installboot(char *target, char *poolname)
 	ict_debug_print(ICT_DBGLVL_INFO, INSTALLBOOT_MSG, _this_func_);
 	ict_debug_print(ICT_DBGLVL_INFO, ICT_SAFE_SYSTEM_CMD, _this_func_, cmd);
 
+	ls_trace_begin(LS_TRACE_ICT, "installboot", 0);
 	ict_status = ict_safe_system(cmd, B_TRUE);
+	ls_trace_end(LS_TRACE_ICT, "installboot", ict_status);
 	if (ict_status != 0) {
 		ict_log_print(ICT_SAFE_SYSTEM_FAIL, _this_func_,
 		    cmd, ict_status);
@@ -701,7 +703,11 @@ ict_snapshot(char *be_ds, char *snapshot)
 		return (set_error(ICT_NVLIST_ADD_FAIL));
 	}
 
-	if ((ret = be_create_snapshot(be_args)) != 0) {
+	ls_trace_begin(LS_TRACE_ICT, "snapshot", 0);
+	ret = be_create_snapshot(be_args);
+	ls_trace_end(LS_TRACE_ICT, "snapshot", ret);
+
+	if (ret != 0) {
 		ict_log_print(SNAPSHOT_FAIL, _this_func_, ret);
 		nvlist_free(be_args);
 		return (set_error(ICT_BE_CR_SNAP_FAIL));
@@ -44,6 +44,7 @@ typedef enum {
 	LS_E_SUCCESS = 0,	/* command succeeded */
 	LS_E_NOMEM,		/* memory allocation failed */
 	LS_E_LOG_TRANSFER_FAILED,	/* couldn't transfer log file */
+	LS_E_TRACE_DUMP_FAILED,	/* couldn't write trace file */
 	LS_E_INVAL = -1		/* input parameter invalid */
 } ls_errno_t;
 
@@ -66,6 +67,17 @@ typedef enum {
 	LS_DBGLVL_LAST	/* serves only as end mark of the list */
 } ls_dbglvl_t;
 
+/* modules recording trace spans, used as event categories */
+
+typedef enum {
+	LS_TRACE_OM = 0,	/* orchestrator */
+	LS_TRACE_TD,		/* target discovery */
+	LS_TRACE_TI,		/* target instantiation */
+	LS_TRACE_TM,		/* transfer module */
+	LS_TRACE_ICT,		/* install completion tasks */
+	LS_TRACE_LAST	/* serves only as end mark of the list */
+} ls_trace_module_t;
+
 /*
  * select either stdout, stderr, or both
  */
@@ -100,6 +112,9 @@ ls_errno_t ls_init(nvlist_t *params);
 /* transfer log file */
 ls_errno_t ls_transfer(char *src_mountpoint, char *dst_mountpoint);
 
+/* write out posted messages and commit log file to stable storage */
+void ls_flush(void);
+
 /* set debugging level */
 ls_errno_t ls_set_dbg_level(ls_dbglvl_t level);
 
@@ -126,6 +141,12 @@ void ls_register_dbg_method(ls_dbg_method_t func);
 /* timestamp */
 #define	LS_ATTR_TIMESTAMP	"ls_timestamp"
 
+/* write messages asynchronously from dedicated thread */
+#define	LS_ATTR_ASYNC		"ls_async"
+
+/* record trace spans */
+#define	LS_ATTR_TRACE		"ls_trace"
+
 /* destination log file path */
 #define	LS_LOGFILE_DST_PATH	"/var/sadm/system/logs/"
 
@@ -144,6 +165,16 @@ void ls_write_dbg_message(const char *id, ls_dbglvl_t level,
  */
 void ls_log_std(ls_stdouterr_t, const char *id, char *buf);
 
+/*
+ * record beginning and end of trace span - name has to be string
+ * constant, it is not copied. Does nothing unless tracing is enabled.
+ */
+void ls_trace_begin(ls_trace_module_t module, const char *name, int64_t arg);
+void ls_trace_end(ls_trace_module_t module, const char *name, int64_t arg);
+
+/* write recorded trace spans as Chrome trace JSON */
+ls_errno_t ls_trace_dump(const char *path);
+
 /* initialize Python module logsvc */
 boolean_t ls_init_python_module(void);
 
@@ -26,19 +26,25 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <assert.h>
+#include <atomic.h>
 #include <dirent.h>
 #include <errno.h>
 #include <libgen.h>
 #include <libnvpair.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <strings.h>
 #include <time.h>
+#include <unistd.h>
 #include <wait.h>
 
 #include <ls_api.h>
+#include "ls_trace.h"
 
 /* configuration environment variables */
 
@@ -54,6 +60,12 @@
 /* timestamp */
 #define	LS_ENV_TIMESTAMP	"LS_TIMESTAMP"
 
+/* asynchronous logging */
+#define	LS_ENV_ASYNC		"LS_ASYNC"
+
+/* tracing */
+#define	LS_ENV_TRACE		"LS_TRACE"
+
 /* default log file name */
 #define	LS_LOGFILE_DEFAULT_NAME	"install_log"
 
@@ -75,6 +87,30 @@
  */
 #define	LS_POST_LOG_FLAG	-1
 
+/* max length of formatted message */
+#define	LS_BUF_MAXLEN		(LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1)
+
+/* max length of timestamp */
+#define	LS_TSTAMP_MAXLEN	30
+
+/*
+ * number of messages the asynchronous ring buffer can hold,
+ * needs to be power of two
+ */
+#define	LS_ASYNC_RING_SIZE	512
+
+/* max number of messages written out by the writer thread at once */
+#define	LS_ASYNC_BATCH		64
+
+/* how often the writer thread drains the ring buffer if not woken up */
+#define	LS_ASYNC_INTERVAL	(100 * (NANOSEC / MILLISEC))
+
+/* how often the writer thread polls if somebody waits for flush */
+#define	LS_ASYNC_POLL_INTERVAL	(NANOSEC / MILLISEC)
+
+/* size of stdio buffer for log file in asynchronous mode */
+#define	LS_ASYNC_FILE_BUFSIZE	(64 * 1024)
+
 /* validate destination */
 #define	ls_destination_valid(d)	\
 	((d >= LS_DEST_NONE) && (d <= LS_DEST_BOTH))
@@ -92,6 +128,11 @@ static void ls_log_method_default(const char *id, char *msg);
 static void ls_dbg_method_default(const char *id, ls_dbglvl_t level,
     char *msg);
 
+/* asynchronous logging */
+static void ls_async_start(void);
+static void ls_async_fini(void);
+static void ls_async_wait(void);
+
 /* private variables */
 
 /* method for posting logging message */
@@ -121,6 +162,55 @@ static ls_dbglvl_t	ls_dbglvl = LS_DBGLVL_DEFAULT;
 /* add timestamp to messages */
 static boolean_t	ls_timestamp = B_TRUE;
 
+/*
+ * Timestamp is formatted at most once per second, messages posted
+ * within that second share it
+ */
+static struct {
+	pthread_mutex_t	lock;
+	boolean_t	valid;
+	hrtime_t	refreshed;
+	char		str[LS_TSTAMP_MAXLEN];
+} ls_tstamp_cache = { PTHREAD_MUTEX_INITIALIZER, B_FALSE, 0, "" };
+
+/*
+ * Message waiting in asynchronous ring buffer to be written out.
+ * 'seq' tells whether the slot is free for producer (seq == position)
+ * or holds message ready for the writer (seq == position + 1).
+ */
+typedef struct ls_async_msg {
+	volatile uint64_t	seq;
+	hrtime_t		stamp;
+	int			level;
+	char			id[LS_ID_MAXLEN + 1];
+	char			msg[LS_BUF_MAXLEN];
+} ls_async_msg_t;
+
+/*
+ * Asynchronous logging state. Producers claim ring slots by advancing
+ * 'head' with compare-and-swap, so posting message doesn't take any lock.
+ * The only writer thread consumes slots at 'tail' and writes them out
+ * in batches. Lock and condition variables are only used for waking up
+ * the writer and for waiting until messages are flushed.
+ */
+static struct {
+	boolean_t		enabled;
+	boolean_t		stop;
+	ls_async_msg_t		*ring;
+	volatile uint64_t	head;
+	uint64_t		tail;
+	uint64_t		done;
+	int			waiters;
+	pthread_t		writer;
+	pthread_mutex_t		lock;
+	pthread_cond_t		work_cv;
+	pthread_cond_t		done_cv;
+} ls_async = {
+	B_FALSE, B_FALSE, NULL, 0, 0, 0, 0, 0,
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER
+};
+
 /* ------------------------ local functions --------------------------- */
 
 /*
@@ -244,103 +334,127 @@ ls_getenv_num(char *envname)
 
 
 /*
- * Function:	ls_dbg_method_default
- * Description:
- *
- * Parameters:	id - module identification
- *		level - debug message level
- *		msg - debugging message
+ * Function:	ls_get_timestamp
+ * Description:	Provides timestamp in UTC format without weekday and year.
+ *		Timestamp is cached and refreshed at most once per second.
  *
+ * Parameters:	now - time the message was posted
+ *		buf - buffer for the timestamp
+ *		len - size of the buffer
  *
  * Return:
  */
 static void
-ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
+ls_get_timestamp(hrtime_t now, char *buf, size_t len)
 {
-	FILE 		*post_console;
-	char		buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
-	static int	fl_init_console_done = 0;
 	time_t		tstamp;
-	char		asc_tstamp[30];
-	struct tm	*tm_tstamp;
-	char		*s = NULL;
-	char		*e = NULL;
+	struct tm	tm_tstamp;
+
+	(void) pthread_mutex_lock(&ls_tstamp_cache.lock);
+
+	if (!ls_tstamp_cache.valid ||
+	    now - ls_tstamp_cache.refreshed >= NANOSEC ||
+	    now < ls_tstamp_cache.refreshed) {
+		if ((tstamp = time(NULL)) == (time_t)-1 ||
+		    gmtime_r(&tstamp, &tm_tstamp) == NULL ||
+		    strftime(ls_tstamp_cache.str, sizeof (ls_tstamp_cache.str),
+		    "%b %e %T", &tm_tstamp) == 0) {
+			(void) strlcpy(ls_tstamp_cache.str, "--:--:--",
+			    sizeof (ls_tstamp_cache.str));
+		}
 
-	if (msg == NULL)
-		return;
+		ls_tstamp_cache.refreshed = now;
+		ls_tstamp_cache.valid = B_TRUE;
+	}
 
-	/*
-	 * set variables according to required action (debug or log)
-	 * and format debug or log message appropriately
-	 */
+	(void) strlcpy(buf, ls_tstamp_cache.str, len);
+
+	(void) pthread_mutex_unlock(&ls_tstamp_cache.lock);
+}
+
+
+/*
+ * Function:	ls_format_message
+ * Description:	Formats debug or log message as it appears in log
+ *
+ * Parameters:	buf - buffer for formatted message
+ *		len - size of the buffer
+ *		id - module identification
+ *		level - debug message level or LS_POST_LOG_FLAG
+ *		msg - debugging message
+ *		stamp - time the message was posted
+ *
+ * Return:
+ */
+static void
+ls_format_message(char *buf, size_t len, const char *id, int level,
+    const char *msg, hrtime_t stamp)
+{
+	char	s[LS_TSTAMP_MAXLEN];
+	char	*lvl_str;
 
 	/*
 	 * prepare time stamp in UTC format
 	 */
 
-	if (ls_timestamp) {
-		if ((tstamp = time(NULL)) != (time_t)-1 &&
-		    (tm_tstamp = gmtime(&tstamp)) != NULL &&
-		    asctime_r(tm_tstamp, asc_tstamp, sizeof (asc_tstamp)) !=
-		    NULL) {
-			/*
-			 * drop weekday and year information
-			 */
-
-			if ((s = strchr(asc_tstamp, ' ')) != NULL) {
-				s++;
-				e = strrchr(asc_tstamp, ' ');
-
-				*e = '\0';
-			} else
-				s = "--:--:--";
-		} else
-			s = "--:--:--";
-	}
+	if (ls_timestamp)
+		ls_get_timestamp(stamp, s, sizeof (s));
 
 	if (level == LS_POST_LOG_FLAG) {
-		post_console = ls_log_console;
-
 		if (ls_timestamp)
-			(void) snprintf(buf, sizeof (buf), "<%s %s> %s",
-			    id, s, msg);
+			(void) snprintf(buf, len, "<%s %s> %s", id, s, msg);
 		else
-			(void) snprintf(buf, sizeof (buf), "<%s> %s", id, msg);
-	} else {
-		char		*lvl_str;
-
-		post_console = ls_dbg_console;
+			(void) snprintf(buf, len, "<%s> %s", id, msg);
 
-		switch (level) {
-			case LS_DBGLVL_EMERG:
-				lvl_str = "!";
-				break;
+		return;
+	}
 
-			case LS_DBGLVL_ERR:
-				lvl_str = "E";
-				break;
+	switch (level) {
+		case LS_DBGLVL_EMERG:
+			lvl_str = "!";
+			break;
 
-			case LS_DBGLVL_WARN:
-				lvl_str = "W";
-				break;
+		case LS_DBGLVL_ERR:
+			lvl_str = "E";
+			break;
 
-			case LS_DBGLVL_INFO:
-				lvl_str = "I";
-				break;
+		case LS_DBGLVL_WARN:
+			lvl_str = "W";
+			break;
 
-			default:
-				lvl_str = "?";
-				break;
-		}
+		case LS_DBGLVL_INFO:
+			lvl_str = "I";
+			break;
 
-		if (ls_timestamp) {
-			(void) snprintf(buf, sizeof (buf), "<%s_%s %s> %s", id,
-			    lvl_str, s, msg);
-		} else
-			(void) snprintf(buf, sizeof (buf), "<%s_%s> %s", id,
-			    lvl_str, msg);
+		default:
+			lvl_str = "?";
+			break;
 	}
 
+	if (ls_timestamp)
+		(void) snprintf(buf, len, "<%s_%s %s> %s", id, lvl_str, s, msg);
+	else
+		(void) snprintf(buf, len, "<%s_%s> %s", id, lvl_str, msg);
+}
+
+
+/*
+ * Function:	ls_post_message
+ * Description:	Posts formatted message to console and/or log file.
+ *		In synchronous mode, both are unbuffered. In asynchronous
+ *		mode, they are buffered and flushed by the writer thread
+ *		after each batch of messages.
+ *
+ * Parameters:	level - debug message level or LS_POST_LOG_FLAG
+ *		buf - formatted message
+ *
+ * Return:
+ */
+static void
+ls_post_message(int level, const char *buf)
+{
+	static int	fl_init_console_done = 0;
+
 	/* post to console */
 
 	if ((ls_log_dest & LS_DEST_CONSOLE) != 0) {
@@ -351,22 +465,32 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 		if (!fl_init_console_done) {
 			fl_init_console_done = 1;
 
-			(void) setbuf(ls_log_console, NULL);
-			(void) setbuf(ls_dbg_console, NULL);
+			if (!ls_async.enabled) {
+				(void) setbuf(ls_log_console, NULL);
+				(void) setbuf(ls_dbg_console, NULL);
+			}
 		}
 
-		(void) fputs(buf, post_console);
+		(void) fputs(buf, level == LS_POST_LOG_FLAG ?
+		    ls_log_console : ls_dbg_console);
 	}
 
 	/* post to file */
 
 	if ((ls_log_dest & LS_DEST_FILE) != 0) {
 		if (ls_log_file == NULL) {
-			if ((ls_log_file = fopen(ls_log_filename, "a")) != NULL)
+			if ((ls_log_file = fopen(ls_log_filename, "a")) !=
+			    NULL) {
 				/*
-				 * Unbuffered I/O
+				 * Unbuffered I/O, unless messages are
+				 * written out in batches
 				 */
-				(void) setbuf(ls_log_file, NULL);
+				if (ls_async.enabled)
+					(void) setvbuf(ls_log_file, NULL,
+					    _IOFBF, LS_ASYNC_FILE_BUFSIZE);
+				else
+					(void) setbuf(ls_log_file, NULL);
+			}
 		}
 
 		if (ls_log_file != NULL)
@@ -375,6 +499,346 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 }
 
 
+/*
+ * Function:	ls_async_wakeup
+ * Description:	Wakes up the writer thread
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_wakeup(void)
+{
+	(void) pthread_mutex_lock(&ls_async.lock);
+	(void) pthread_cond_signal(&ls_async.work_cv);
+	(void) pthread_mutex_unlock(&ls_async.lock);
+}
+
+
+/*
+ * Function:	ls_async_post
+ * Description:	Queues message into asynchronous ring buffer. If the ring
+ *		is full, waits until the writer thread makes room for it,
+ *		so no message is dropped.
+ *
+ * Parameters:	id - module identification
+ *		level - debug message level or LS_POST_LOG_FLAG
+ *		msg - debugging message
+ *
+ * Return:
+ */
+static void
+ls_async_post(const char *id, int level, const char *msg)
+{
+	ls_async_msg_t	*slot;
+	uint64_t	pos, seq;
+
+	pos = ls_async.head;
+
+	for (;;) {
+		slot = &ls_async.ring[pos & (LS_ASYNC_RING_SIZE - 1)];
+		seq = slot->seq;
+		membar_consumer();
+
+		if (seq == pos) {
+			/* slot is free, try to claim it */
+			if (atomic_cas_64(&ls_async.head, pos, pos + 1) == pos)
+				break;
+		} else if ((int64_t)(seq - pos) < 0) {
+			/* ring is full, let the writer catch up */
+			ls_async_wakeup();
+			(void) sched_yield();
+		}
+
+		pos = ls_async.head;
+	}
+
+	slot->stamp = gethrtime();
+	slot->level = level;
+	(void) strlcpy(slot->id, id, sizeof (slot->id));
+	(void) strlcpy(slot->msg, msg, sizeof (slot->msg));
+
+	/* publish the message to the writer */
+	membar_producer();
+	slot->seq = pos + 1;
+
+	/* don't wait for the timer if the ring is filling up */
+	if (pos - ls_async.done >= LS_ASYNC_RING_SIZE / 2)
+		ls_async_wakeup();
+}
+
+
+/*
+ * Function:	ls_async_drain
+ * Description:	Writes out messages ready in the ring buffer. Only called
+ *		by the writer thread, or once it is gone.
+ *
+ * Parameters:	-
+ *
+ * Return:	number of messages written out
+ */
+static int
+ls_async_drain(void)
+{
+	ls_async_msg_t	*slot;
+	char		buf[LS_BUF_MAXLEN];
+	int		n;
+
+	for (n = 0; n < LS_ASYNC_BATCH; n++) {
+		slot = &ls_async.ring[ls_async.tail & (LS_ASYNC_RING_SIZE - 1)];
+
+		if (slot->seq != ls_async.tail + 1)
+			break;
+
+		membar_consumer();
+
+		ls_format_message(buf, sizeof (buf), slot->id, slot->level,
+		    slot->msg, slot->stamp);
+		ls_post_message(slot->level, buf);
+
+		/* hand the slot over to producers for the next lap */
+		membar_producer();
+		slot->seq = ls_async.tail + LS_ASYNC_RING_SIZE;
+		ls_async.tail++;
+	}
+
+	if (n > 0) {
+		if ((ls_log_dest & LS_DEST_CONSOLE) != 0) {
+			(void) fflush(ls_log_console);
+			(void) fflush(ls_dbg_console);
+		}
+
+		if (ls_log_file != NULL)
+			(void) fflush(ls_log_file);
+	}
+
+	return (n);
+}
+
+
+/*
+ * Function:	ls_async_writer
+ * Description:	Writer thread - drains the ring buffer in batches when
+ *		woken up by producers or periodically
+ *
+ * Parameters:	arg - not used
+ *
+ * Return:	NULL
+ */
+/* ARGSUSED */
+static void *
+ls_async_writer(void *arg)
+{
+	struct timespec	ts;
+	int		n;
+
+	(void) pthread_mutex_lock(&ls_async.lock);
+
+	for (;;) {
+		(void) pthread_mutex_unlock(&ls_async.lock);
+		n = ls_async_drain();
+		(void) pthread_mutex_lock(&ls_async.lock);
+
+		if (n > 0) {
+			ls_async.done = ls_async.tail;
+
+			if (ls_async.waiters > 0)
+				(void) pthread_cond_broadcast(
+				    &ls_async.done_cv);
+
+			continue;
+		}
+
+		if (ls_async.stop && ls_async.tail == ls_async.head)
+			break;
+
+		/*
+		 * Nothing to write. If somebody waits for a message being
+		 * just posted or the writer is to exit, poll quickly.
+		 */
+
+		ts.tv_sec = 0;
+		ts.tv_nsec = (ls_async.waiters > 0 || ls_async.stop) ?
+		    LS_ASYNC_POLL_INTERVAL : LS_ASYNC_INTERVAL;
+
+		(void) pthread_cond_reltimedwait_np(&ls_async.work_cv,
+		    &ls_async.lock, &ts);
+	}
+
+	(void) pthread_mutex_unlock(&ls_async.lock);
+
+	return (NULL);
+}
+
+
+/*
+ * Function:	ls_async_wait
+ * Description:	Waits until all messages posted so far are written out
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_wait(void)
+{
+	uint64_t	target = ls_async.head;
+
+	(void) pthread_mutex_lock(&ls_async.lock);
+
+	ls_async.waiters++;
+	(void) pthread_cond_signal(&ls_async.work_cv);
+
+	while (ls_async.enabled && ls_async.done < target)
+		(void) pthread_cond_wait(&ls_async.done_cv, &ls_async.lock);
+
+	ls_async.waiters--;
+
+	(void) pthread_mutex_unlock(&ls_async.lock);
+}
+
+
+/*
+ * Function:	ls_async_start
+ * Description:	Switches logging service to asynchronous mode - starts
+ *		writer thread draining the ring buffer. If it fails,
+ *		messages keep being written synchronously.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_start(void)
+{
+	uint64_t	i;
+
+	if (ls_async.enabled)
+		return;
+
+	ls_async.ring = calloc(LS_ASYNC_RING_SIZE, sizeof (ls_async_msg_t));
+
+	if (ls_async.ring == NULL) {
+		ls_debug_print(LS_DBGLVL_WARN, "Couldn't allocate ring "
+		    "buffer, asynchronous logging disabled\n");
+		return;
+	}
+
+	for (i = 0; i < LS_ASYNC_RING_SIZE; i++)
+		ls_async.ring[i].seq = i;
+
+	ls_async.head = ls_async.tail = ls_async.done = 0;
+	ls_async.stop = B_FALSE;
+
+	/*
+	 * Log file may have already been opened unbuffered, reopen it
+	 * with writer thread
+	 */
+
+	if (ls_log_file != NULL) {
+		(void) fclose(ls_log_file);
+		ls_log_file = NULL;
+	}
+
+	ls_async.enabled = B_TRUE;
+
+	if (pthread_create(&ls_async.writer, NULL, ls_async_writer, NULL)
+	    != 0) {
+		ls_async.enabled = B_FALSE;
+		free(ls_async.ring);
+		ls_async.ring = NULL;
+
+		ls_debug_print(LS_DBGLVL_WARN, "Couldn't create writer "
+		    "thread, asynchronous logging disabled\n");
+		return;
+	}
+
+	(void) atexit(ls_async_fini);
+}
+
+
+/*
+ * Function:	ls_async_fini
+ * Description:	Writes out all pending messages, stops the writer thread
+ *		and switches back to synchronous mode. Called at exit.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_fini(void)
+{
+	if (!ls_async.enabled)
+		return;
+
+	(void) pthread_mutex_lock(&ls_async.lock);
+	ls_async.stop = B_TRUE;
+	(void) pthread_cond_signal(&ls_async.work_cv);
+	(void) pthread_mutex_unlock(&ls_async.lock);
+
+	(void) pthread_join(ls_async.writer, NULL);
+
+	/* pick up messages posted while the writer was exiting */
+
+	while (ls_async_drain() > 0)
+		;
+
+	(void) pthread_mutex_lock(&ls_async.lock);
+	ls_async.enabled = B_FALSE;
+	(void) pthread_cond_broadcast(&ls_async.done_cv);
+	(void) pthread_mutex_unlock(&ls_async.lock);
+
+	if (ls_log_file != NULL)
+		(void) fsync(fileno(ls_log_file));
+}
+
+
+/*
+ * Function:	ls_dbg_method_default
+ * Description:
+ *
+ * Parameters:	id - module identification
+ *		level - debug message level
+ *		msg - debugging message
+ *
+ *
+ * Return:
+ */
+static void
+ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
+{
+	char		buf[LS_BUF_MAXLEN];
+
+	if (msg == NULL)
+		return;
+
+	/*
+	 * In asynchronous mode, leave formatting and writing to the
+	 * writer thread. Errors are waited for, so that they make it
+	 * to the log even if the process dies right after.
+	 */
+
+	if (ls_async.enabled) {
+		ls_async_post(id, level, msg);
+
+		if (level == LS_DBGLVL_EMERG || level == LS_DBGLVL_ERR)
+			ls_async_wait();
+
+		return;
+	}
+
+	/*
+	 * set variables according to required action (debug or log)
+	 * and format debug or log message appropriately
+	 */
+
+	ls_format_message(buf, sizeof (buf), id, level, msg, gethrtime());
+	ls_post_message(level, buf);
+}
+
+
 /*
  * Function:	ls_log_method_default
  * Description:
@@ -414,6 +878,9 @@ ls_init(nvlist_t *params)
 	char		*str;
 	int16_t		dest, lvl;
 	boolean_t	stamp;
+	boolean_t	async = B_FALSE;
+	boolean_t	trace = B_FALSE;
+	int		env_async, env_trace;
 	ls_dbglvl_t	ls_env_dbglvl;
 	char		*ls_env_dbglvl_str;
 
@@ -451,6 +918,18 @@ ls_init(nvlist_t *params)
 		if ((nvlist_lookup_int16(params, LS_ATTR_DBG_LVL, &lvl) == 0) &&
 		    ls_dbglvl_valid(lvl))
 			ls_dbglvl = lvl;
+
+		/* asynchronous logging */
+
+		if (nvlist_lookup_boolean_value(params, LS_ATTR_ASYNC,
+		    &stamp) == 0)
+			async = stamp;
+
+		/* tracing */
+
+		if (nvlist_lookup_boolean_value(params, LS_ATTR_TRACE,
+		    &stamp) == 0)
+			trace = stamp;
 	}
 
 	/* environment variables */
@@ -477,6 +956,22 @@ ls_init(nvlist_t *params)
 	if ((stamp = ls_getenv_num(LS_ENV_TIMESTAMP)) != LS_E_INVAL)
 		ls_timestamp = stamp == 0 ? B_FALSE : B_TRUE;
 
+	/* asynchronous logging */
+
+	if ((env_async = ls_getenv_num(LS_ENV_ASYNC)) != LS_E_INVAL)
+		async = env_async == 0 ? B_FALSE : B_TRUE;
+
+	if (async)
+		ls_async_start();
+
+	/* tracing */
+
+	if ((env_trace = ls_getenv_num(LS_ENV_TRACE)) != LS_E_INVAL)
+		trace = env_trace == 0 ? B_FALSE : B_TRUE;
+
+	if (trace)
+		ls_trace_init();
+
 	/* set debug level */
 
 	/* if environment variable supplied and valid, set debugging level */
@@ -519,6 +1014,10 @@ ls_transfer(char *src_mountpoint, char *dst_mountpoint)
 	if ((src_mountpoint == NULL) || (dst_mountpoint == NULL))
 		return (LS_E_LOG_TRANSFER_FAILED);
 
+	/* make sure the log is complete before it is copied */
+
+	ls_flush();
+
 	/*
 	 * Check whether the target directory exists. If not create it
 	 */
@@ -574,10 +1073,47 @@ ls_transfer(char *src_mountpoint, char *dst_mountpoint)
 		return (LS_E_LOG_TRANSFER_FAILED);
 	}
 
+	/*
+	 * dump trace spans recorded so far next to the log file, failing
+	 * to do so is not fatal
+	 */
+
+	if (ls_trace_enabled()) {
+		(void) snprintf(cmd, sizeof (cmd), "%s%s%s", dst_mountpoint,
+		    LS_LOGFILE_DST_PATH, LS_TRACE_FILENAME);
+
+		if (ls_trace_dump(cmd) != LS_E_SUCCESS)
+			ls_debug_print(LS_DBGLVL_WARN,
+			    "Couldn't write trace file %s\n", cmd);
+	}
+
 	return (LS_E_SUCCESS);
 }
 
 
+/*
+ * Function:	ls_flush
+ * Description:	Writes out all messages posted so far and commits log
+ *		file to stable storage. Intended to be called at install
+ *		milestones, so that the log survives crash of the system.
+ *
+ * Parameters:	-
+ *
+ * Return:	-
+ */
+void
+ls_flush(void)
+{
+	if (ls_async.enabled)
+		ls_async_wait();
+
+	if (ls_log_file != NULL) {
+		(void) fflush(ls_log_file);
+		(void) fsync(fileno(ls_log_file));
+	}
+}
+
+
 /*
  * Function:	ls_set_dbg_level
  * Description:	Set debugging level
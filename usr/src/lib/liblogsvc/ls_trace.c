@@ -0,0 +1,339 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * ls_trace.c
+ *
+ * Low overhead tracing of begin/end spans. Every thread records events
+ * into its own in-memory ring, so recording takes no lock and makes no
+ * system call. Rings are dumped as Chrome trace JSON (see "Trace Event
+ * Format") which can be loaded into chrome://tracing or similar viewer.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <atomic.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <ls_api.h>
+#include "ls_trace.h"
+
+/* trace event */
+typedef struct ls_trace_event {
+	hrtime_t	te_stamp;	/* time event was recorded */
+	const char	*te_name;	/* span name, string constant */
+	int64_t		te_arg;		/* numeric argument */
+	uint8_t		te_module;	/* module which recorded event */
+	char		te_phase;	/* 'B' - span begins, 'E' - ends */
+} ls_trace_event_t;
+
+/* per-thread ring of trace events */
+typedef struct ls_trace_ring {
+	struct ls_trace_ring	*tr_next;
+	pthread_t		tr_tid;
+	volatile uint64_t	tr_count;	/* events recorded so far */
+	ls_trace_event_t	tr_events[LS_TRACE_RING_SIZE];
+} ls_trace_ring_t;
+
+/* module names used as event categories */
+static const char *ls_trace_module_names[LS_TRACE_LAST] = {
+	"OM", "TD", "TI", "TM", "ICT"
+};
+
+/* tracing is enabled */
+static boolean_t	ls_trace_on = B_FALSE;
+
+/* time tracing was enabled, event times are relative to it */
+static hrtime_t		ls_trace_start;
+
+/* key for thread's ring */
+static pthread_key_t	ls_trace_key;
+static pthread_once_t	ls_trace_once = PTHREAD_ONCE_INIT;
+
+/* list of all rings, they are kept after their threads exit */
+static pthread_mutex_t	ls_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static ls_trace_ring_t	*ls_trace_rings = NULL;
+
+/* ------------------------ local functions --------------------------- */
+
+/*
+ * Function:	ls_trace_key_create
+ * Description:	Creates key for per-thread rings, called only once
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_trace_key_create(void)
+{
+	(void) pthread_key_create(&ls_trace_key, NULL);
+}
+
+
+/*
+ * Function:	ls_trace_get_ring
+ * Description:	Obtains ring of calling thread, creates it for the first
+ *		event recorded by the thread
+ *
+ * Parameters:	-
+ *
+ * Return:	NULL - couldn't allocate ring
+ *		pointer - ring of calling thread
+ */
+static ls_trace_ring_t *
+ls_trace_get_ring(void)
+{
+	ls_trace_ring_t	*ring;
+
+	if ((ring = pthread_getspecific(ls_trace_key)) != NULL)
+		return (ring);
+
+	if ((ring = calloc(1, sizeof (ls_trace_ring_t))) == NULL)
+		return (NULL);
+
+	ring->tr_tid = pthread_self();
+
+	if (pthread_setspecific(ls_trace_key, ring) != 0) {
+		free(ring);
+		return (NULL);
+	}
+
+	(void) pthread_mutex_lock(&ls_trace_lock);
+	ring->tr_next = ls_trace_rings;
+	ls_trace_rings = ring;
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+
+	return (ring);
+}
+
+
+/*
+ * Function:	ls_trace_record
+ * Description:	Records trace event into ring of calling thread
+ *
+ * Parameters:	module - module recording the event
+ *		phase - 'B' or 'E'
+ *		name - span name
+ *		arg - numeric argument
+ *
+ * Return:
+ */
+static void
+ls_trace_record(ls_trace_module_t module, char phase, const char *name,
+    int64_t arg)
+{
+	ls_trace_ring_t		*ring;
+	ls_trace_event_t	*ev;
+
+	if (!ls_trace_on || (int)module < 0 || module >= LS_TRACE_LAST)
+		return;
+
+	if ((ring = ls_trace_get_ring()) == NULL)
+		return;
+
+	ev = &ring->tr_events[ring->tr_count & (LS_TRACE_RING_SIZE - 1)];
+	ev->te_stamp = gethrtime();
+	ev->te_name = name != NULL ? name : "?";
+	ev->te_arg = arg;
+	ev->te_module = (uint8_t)module;
+	ev->te_phase = phase;
+
+	/* publish the event to ls_trace_dump() */
+	membar_producer();
+	ring->tr_count++;
+}
+
+
+/*
+ * Function:	ls_trace_print_string
+ * Description:	Prints string as JSON string literal
+ *
+ * Parameters:	fp - output stream
+ *		str - string to print
+ *
+ * Return:
+ */
+static void
+ls_trace_print_string(FILE *fp, const char *str)
+{
+	(void) fputc('"', fp);
+
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\')
+			(void) fputc('\\', fp);
+
+		if ((unsigned char)*str >= ' ')
+			(void) fputc(*str, fp);
+	}
+
+	(void) fputc('"', fp);
+}
+
+/* ----------------------- public functions --------------------------- */
+
+/*
+ * Function:	ls_trace_init
+ * Description:	Enables tracing. Times of events are relative to the time
+ *		tracing was enabled.
+ *
+ * Parameters:	-
+ *
+ * Return:	-
+ */
+void
+ls_trace_init(void)
+{
+	(void) pthread_once(&ls_trace_once, ls_trace_key_create);
+
+	if (ls_trace_on)
+		return;
+
+	ls_trace_start = gethrtime();
+	ls_trace_on = B_TRUE;
+}
+
+
+/*
+ * Function:	ls_trace_enabled
+ * Description:	Finds out if tracing is enabled
+ *
+ * Parameters:	-
+ *
+ * Return:	B_TRUE if tracing is enabled, otherwise B_FALSE
+ */
+boolean_t
+ls_trace_enabled(void)
+{
+	return (ls_trace_on);
+}
+
+
+/*
+ * Function:	ls_trace_begin
+ * Description:	Records beginning of trace span
+ *
+ * Parameters:	module - module recording the span
+ *		name - span name, has to be string constant
+ *		arg - numeric argument
+ *
+ * Return:	-
+ */
+void
+ls_trace_begin(ls_trace_module_t module, const char *name, int64_t arg)
+{
+	ls_trace_record(module, 'B', name, arg);
+}
+
+
+/*
+ * Function:	ls_trace_end
+ * Description:	Records end of trace span
+ *
+ * Parameters:	module - module recording the span
+ *		name - span name, has to be string constant
+ *		arg - numeric argument, typically result of the operation
+ *
+ * Return:	-
+ */
+void
+ls_trace_end(ls_trace_module_t module, const char *name, int64_t arg)
+{
+	ls_trace_record(module, 'E', name, arg);
+}
+
+
+/*
+ * Function:	ls_trace_dump
+ * Description:	Writes events recorded so far into file in Chrome trace
+ *		JSON format. Only last LS_TRACE_RING_SIZE events of every
+ *		thread are available. Events recorded while dumping may
+ *		not make it into the file.
+ *
+ * Parameters:	path - file to be created
+ *
+ * Return:	LS_E_SUCCESS - trace dumped successfully
+ *		LS_E_INVAL - tracing is not enabled
+ *		LS_E_TRACE_DUMP_FAILED - couldn't write the file
+ */
+ls_errno_t
+ls_trace_dump(const char *path)
+{
+	FILE			*fp;
+	ls_trace_ring_t		*ring;
+	ls_trace_event_t	*ev;
+	uint64_t		count, i;
+	hrtime_t		ts;
+	boolean_t		first = B_TRUE;
+	int			ret;
+
+	if (!ls_trace_on || path == NULL)
+		return (LS_E_INVAL);
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return (LS_E_TRACE_DUMP_FAILED);
+
+	(void) fprintf(fp, "{\"traceEvents\":[\n");
+
+	(void) pthread_mutex_lock(&ls_trace_lock);
+
+	for (ring = ls_trace_rings; ring != NULL; ring = ring->tr_next) {
+		count = ring->tr_count;
+		membar_consumer();
+
+		i = count > LS_TRACE_RING_SIZE ?
+		    count - LS_TRACE_RING_SIZE : 0;
+
+		for (; i < count; i++) {
+			ev = &ring->tr_events[i & (LS_TRACE_RING_SIZE - 1)];
+			ts = ev->te_stamp - ls_trace_start;
+
+			(void) fprintf(fp, "%s{\"name\":", first ? "" : ",\n");
+			ls_trace_print_string(fp, ev->te_name);
+			(void) fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"%c\","
+			    "\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%u,"
+			    "\"args\":{\"arg\":%lld}}",
+			    ls_trace_module_names[ev->te_module], ev->te_phase,
+			    ts / 1000, ts % 1000, (int)getpid(),
+			    (uint_t)ring->tr_tid, (longlong_t)ev->te_arg);
+
+			first = B_FALSE;
+		}
+	}
+
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+
+	(void) fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	ret = ferror(fp);
+
+	if (fclose(fp) != 0 || ret != 0)
+		return (LS_E_TRACE_DUMP_FAILED);
+
+	return (LS_E_SUCCESS);
+}
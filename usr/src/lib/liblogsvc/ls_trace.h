@@ -0,0 +1,60 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * ls_trace.h
+ *
+ * Private interface between logging service and its tracing facility
+ */
+
+#ifndef _LS_TRACE_H
+#define	_LS_TRACE_H
+
+#include <ls_api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * number of events recorded per thread, older events are overwritten,
+ * needs to be power of two
+ */
+#define	LS_TRACE_RING_SIZE	1024
+
+/* name of trace file created in the log directory */
+#define	LS_TRACE_FILENAME	"install_trace.json"
+
+/* start recording trace events */
+void ls_trace_init(void);
+
+/* tracing is enabled */
+boolean_t ls_trace_enabled(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LS_TRACE_H */
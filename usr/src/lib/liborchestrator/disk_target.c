@@ -151,12 +151,15 @@ handle_disk_discovery(void *args)
 	static int		status = 0;
 	om_callback_t		cb;
 	int			num_disks;
+	int			phase;
 
 	cp = (callback_args_t *)args;
 
 	num_disks = cp->cb_type.td.num_disks;
 	cb = cp->cb;
 
+	phase = om_timing_begin("target_discovery");
+
 	/*
 	 * If there are no disks, then just send a callback to the caller
 	 * indicating that the discovery is completed
@@ -180,6 +183,8 @@ handle_disk_discovery(void *args)
 		send_discovery_complete_callback(cb);
 	}
 
+	om_timing_end(phase, OM_SUCCESS);
+
 	/*
 	 * Free the Target discovery resources after target discovery
 	 * is done
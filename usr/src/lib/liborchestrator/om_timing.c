@@ -0,0 +1,285 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * om_timing.c
+ *
+ * Install phase timing. Every phase (target discovery, TI milestones,
+ * transfer, each ICT, finish scripts) records its monotonic start and
+ * end time and resources consumed by the installer process and its
+ * children meanwhile. At the end of installation, the report is written
+ * as JSON next to the install log, so that install times can be tracked
+ * across releases and machines.
+ *
+ * Note that TI and transfer run in parallel, so resource usage of
+ * phases overlapping in time is accounted to each of them.
+ *
+ * Bytes written are those counted by the transfer module while copying
+ * files from the installation media, so they are only reported for
+ * phases overlapping cpio transfer. The I/O of the installer process
+ * itself is reported as well, though it covers both reads and writes
+ * and doesn't include I/O done by its children.
+ *
+ * Once a report is written, the next phase begun starts a new one.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <procfs.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <transfermod.h>
+
+#include "orchestrator_private.h"
+
+/* max number of phases recorded */
+#define	OM_TIMING_MAX_PHASES	64
+
+/* resources consumed by the installer process and its children */
+typedef struct om_timing_usage {
+	hrtime_t	tu_user;	/* user CPU time */
+	hrtime_t	tu_sys;		/* system CPU time */
+	uint64_t	tu_ioch;	/* read and written by installer */
+	uint64_t	tu_copied;	/* bytes written by transfer */
+} om_timing_usage_t;
+
+typedef struct om_timing_phase {
+	const char		*tp_name;
+	hrtime_t		tp_start;
+	hrtime_t		tp_end;		/* 0 while running */
+	int			tp_status;
+	om_timing_usage_t	tp_usage;	/* at start, delta once done */
+} om_timing_phase_t;
+
+static pthread_mutex_t		om_timing_lock = PTHREAD_MUTEX_INITIALIZER;
+static om_timing_phase_t	om_timing_phases[OM_TIMING_MAX_PHASES];
+static int			om_timing_nphases = 0;
+
+/* report was written, next phase begun starts a new one */
+static boolean_t		om_timing_reported = B_FALSE;
+
+/* time the first phase started, times in report are relative to it */
+static hrtime_t			om_timing_base;
+
+/*
+ * om_timing_tv2hr
+ * Converts timeval to hrtime
+ */
+static hrtime_t
+om_timing_tv2hr(struct timeval *tv)
+{
+	return ((hrtime_t)tv->tv_sec * NANOSEC +
+	    (hrtime_t)tv->tv_usec * (NANOSEC / MICROSEC));
+}
+
+/*
+ * om_timing_sample
+ * Obtains resources consumed so far by the installer process and its
+ * children it waited for
+ */
+static void
+om_timing_sample(om_timing_usage_t *tu)
+{
+	struct rusage	self, children;
+	prusage_t	pru;
+	int		fd;
+
+	(void) memset(tu, 0, sizeof (om_timing_usage_t));
+
+	if (getrusage(RUSAGE_SELF, &self) == 0 &&
+	    getrusage(RUSAGE_CHILDREN, &children) == 0) {
+		tu->tu_user = om_timing_tv2hr(&self.ru_utime) +
+		    om_timing_tv2hr(&children.ru_utime);
+		tu->tu_sys = om_timing_tv2hr(&self.ru_stime) +
+		    om_timing_tv2hr(&children.ru_stime);
+	}
+
+	/* children's I/O is not available, only installer's one */
+
+	if ((fd = open("/proc/self/usage", O_RDONLY)) != -1) {
+		if (read(fd, &pru, sizeof (pru)) == sizeof (pru))
+			tu->tu_ioch = pru.pr_ioch;
+		(void) close(fd);
+	}
+
+	tu->tu_copied = TM_bytes_copied();
+}
+
+/*
+ * om_timing_begin
+ * Records start of install phase.
+ * Input:	name - phase name, has to be string constant
+ * Return:	phase id to be passed to om_timing_end(), -1 if the phase
+ *		couldn't be recorded
+ */
+int
+om_timing_begin(const char *name)
+{
+	om_timing_phase_t	*tp;
+	int			id;
+
+	(void) pthread_mutex_lock(&om_timing_lock);
+
+	if (om_timing_reported) {
+		om_timing_nphases = 0;
+		om_timing_reported = B_FALSE;
+	}
+
+	if (om_timing_nphases >= OM_TIMING_MAX_PHASES) {
+		(void) pthread_mutex_unlock(&om_timing_lock);
+		return (-1);
+	}
+
+	id = om_timing_nphases++;
+	tp = &om_timing_phases[id];
+	tp->tp_name = name;
+	tp->tp_end = 0;
+	tp->tp_status = 0;
+	om_timing_sample(&tp->tp_usage);
+	tp->tp_start = gethrtime();
+
+	if (id == 0)
+		om_timing_base = tp->tp_start;
+
+	(void) pthread_mutex_unlock(&om_timing_lock);
+
+	return (id);
+}
+
+/*
+ * om_timing_end
+ * Records end of install phase. Phase already finished is left intact,
+ * so it is safe to end the phase again on error paths.
+ * Input:	id - phase id returned by om_timing_begin()
+ *		status - result of the phase, 0 means success
+ */
+void
+om_timing_end(int id, int status)
+{
+	om_timing_phase_t	*tp;
+	om_timing_usage_t	tu;
+	hrtime_t		end;
+
+	if (id < 0 || id >= OM_TIMING_MAX_PHASES)
+		return;
+
+	end = gethrtime();
+	om_timing_sample(&tu);
+
+	(void) pthread_mutex_lock(&om_timing_lock);
+
+	tp = &om_timing_phases[id];
+
+	if (id < om_timing_nphases && tp->tp_end == 0) {
+		tp->tp_end = end;
+		tp->tp_status = status;
+		tp->tp_usage.tu_user = tu.tu_user - tp->tp_usage.tu_user;
+		tp->tp_usage.tu_sys = tu.tu_sys - tp->tp_usage.tu_sys;
+		tp->tp_usage.tu_ioch = tu.tu_ioch - tp->tp_usage.tu_ioch;
+		tp->tp_usage.tu_copied =
+		    tu.tu_copied - tp->tp_usage.tu_copied;
+	}
+
+	(void) pthread_mutex_unlock(&om_timing_lock);
+}
+
+/*
+ * om_timing_report
+ * Writes timing report of phases recorded so far into given directory.
+ * Times are in milliseconds relative to start of the first phase, phases
+ * which haven't finished yet have no end time and resource usage.
+ * Phases begun afterwards are recorded into a new report.
+ * Input:	dir - directory the report is written to
+ * Return:	OM_SUCCESS - report written
+ *		OM_FAILURE - couldn't write report
+ */
+int
+om_timing_report(const char *dir)
+{
+	char			path[MAXPATHLEN];
+	FILE			*fp;
+	om_timing_phase_t	*tp;
+	int			i, ret;
+
+	(void) snprintf(path, sizeof (path), "%s/%s", dir,
+	    OM_TIMING_REPORT_FILE);
+
+	if ((fp = fopen(path, "w")) == NULL) {
+		om_debug_print(OM_DBGLVL_WARN,
+		    "Couldn't create timing report %s\n", path);
+		return (OM_FAILURE);
+	}
+
+	(void) pthread_mutex_lock(&om_timing_lock);
+
+	(void) fprintf(fp, "{\n\"version\": 2,\n\"phases\": [");
+
+	for (i = 0; i < om_timing_nphases; i++) {
+		tp = &om_timing_phases[i];
+
+		(void) fprintf(fp, "%s\n{\"name\": \"%s\", \"start_ms\": %lld",
+		    i == 0 ? "" : ",", tp->tp_name,
+		    (tp->tp_start - om_timing_base) / (NANOSEC / MILLISEC));
+
+		if (tp->tp_end == 0) {
+			(void) fprintf(fp, ", \"end_ms\": null}");
+			continue;
+		}
+
+		(void) fprintf(fp, ", \"end_ms\": %lld, \"elapsed_ms\": %lld, "
+		    "\"status\": %d, \"user_cpu_ms\": %lld, "
+		    "\"sys_cpu_ms\": %lld, \"written_bytes\": %llu, "
+		    "\"io_read_write_bytes\": %llu}",
+		    (tp->tp_end - om_timing_base) / (NANOSEC / MILLISEC),
+		    (tp->tp_end - tp->tp_start) / (NANOSEC / MILLISEC),
+		    tp->tp_status,
+		    tp->tp_usage.tu_user / (NANOSEC / MILLISEC),
+		    tp->tp_usage.tu_sys / (NANOSEC / MILLISEC),
+		    (u_longlong_t)tp->tp_usage.tu_copied,
+		    (u_longlong_t)tp->tp_usage.tu_ioch);
+	}
+
+	(void) fprintf(fp, "\n]\n}\n");
+
+	om_timing_reported = B_TRUE;
+
+	(void) pthread_mutex_unlock(&om_timing_lock);
+
+	ret = ferror(fp);
+
+	if (fclose(fp) != 0 || ret != 0) {
+		om_debug_print(OM_DBGLVL_WARN,
+		    "Couldn't write timing report %s\n", path);
+		return (OM_FAILURE);
+	}
+
+	om_log_print("Install timing report written to %s\n", path);
+
+	return (OM_SUCCESS);
+}
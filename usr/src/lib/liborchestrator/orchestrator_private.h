@@ -62,6 +62,12 @@ extern "C" {
 
 #define	MAX_LOCALE	40
 
+/*
+ * Install phase timing report, written next to install log
+ */
+#define	OM_TIMING_REPORT_DIR	"/tmp"
+#define	OM_TIMING_REPORT_FILE	"install_timing.json"
+
 #define	BLOCKS_TO_MB	2048
 #define	ONE_GB_TO_MB	1024
 #define	ONE_MB_TO_KB	1024
@@ -308,6 +314,13 @@ disk_target_t	*find_disk_by_name(char *diskname);
 disk_parts_t	*find_partitions_by_disk(char *diskname);
 disk_slices_t	*find_slices_by_disk(char *diskname);
 
+/*
+ * om_timing.c
+ */
+int	om_timing_begin(const char *name);
+void	om_timing_end(int id, int status);
+int	om_timing_report(const char *dir);
+
 /*
  * perform_slim_install.c
  */
@@ -80,6 +80,17 @@ struct ti_callback {
 	nvlist_t *target_attrs;
 };
 
+/*
+ * Stages of Target Instantiation the transfer depends on. Transfer only
+ * needs BE to be mounted, swap and dump volumes are created by TI thread
+ * while the transfer is running.
+ */
+typedef enum {
+	TI_STAGE_NONE = 0,
+	TI_STAGE_BE_MOUNTED,	/* root pool created, BE mounted */
+	TI_STAGE_DONE		/* swap and dump volumes created as well */
+} ti_stage_t;
+
 /*
  * Global Variables
  */
@@ -90,6 +101,11 @@ boolean_t		create_swap_and_dump = B_FALSE;
 boolean_t		create_swap_slice = B_FALSE;
 static	pthread_t	ti_thread;
 static	int		ti_ret;
+static	pthread_mutex_t	ti_stage_mutex = PTHREAD_MUTEX_INITIALIZER;
+static	pthread_cond_t	ti_stage_cv = PTHREAD_COND_INITIALIZER;
+static	ti_stage_t	ti_stage = TI_STAGE_NONE;
+static	int		ti_stage_status = 0;
+static	boolean_t	tm_in_progress = B_FALSE;
 static	om_breakpoint_t	om_breakpoint = OM_no_breakpoint;
 int32_t requested_swap_size = -1;
 int32_t requested_dump_size = -1;
@@ -155,6 +171,11 @@ static uint32_t	get_mem_size(void);
 static void	log_bld_info(char *, char *);
 static uint64_t	calc_swap_size(uint64_t available_swap_space);
 static uint64_t	calc_dump_size(uint64_t available_dump_space);
+static void	ti_stage_post(ti_stage_t stage, int status);
+static int	ti_stage_wait(ti_stage_t stage);
+static int	ti_wait_finished(void);
+static int	tm_transfer_begin(void);
+static void	tm_transfer_end(void);
 
 void 		*do_transfer(void *arg);
 void		*do_ti(void *args);
@@ -587,6 +608,15 @@ om_perform_install(nvlist_t *uchoices, om_callback_t cb)
 	 * Start a thread to call TI module for fdisk & vtoc targets.
 	 */
 
+	/*
+	 * Forget the stage reached by TI thread of previous install, if any
+	 */
+	(void) pthread_mutex_lock(&ti_stage_mutex);
+	ti_stage = TI_STAGE_NONE;
+	ti_stage_status = 0;
+	tm_in_progress = B_FALSE;
+	(void) pthread_mutex_unlock(&ti_stage_mutex);
+
 	ti_ret = pthread_create(&ti_thread, NULL, do_ti, target_attrs);
 	if (ti_ret != 0) {
 		om_set_error(OM_ERROR_THREAD_CREATE);
@@ -1138,6 +1168,11 @@ do_ti(void *args)
 	uint64_t		available_disk_space;
 	uint64_t		recommended_size;
 	uint8_t			install_slice_id;
+	boolean_t		be_mounted = B_FALSE;
+	int			ti_phase, phase = -1;
+
+	ls_trace_begin(LS_TRACE_OM, "target_instantiation", 0);
+	ti_phase = om_timing_begin("target_instantiation");
 
 	ti_args = (struct ti_callback *)
 	    calloc(1, sizeof (struct ti_callback));
@@ -1179,6 +1214,7 @@ do_ti(void *args)
 	 * create fdisk target
 	 */
 
+	phase = om_timing_begin("ti_fdisk");
 	ti_status = ti_create_target(ti_args->target_attrs, NULL);
 
 	if (ti_status != TI_E_SUCCESS) {
@@ -1187,6 +1223,7 @@ do_ti(void *args)
 		status = -1;
 		goto ti_error;
 	}
+	om_timing_end(phase, 0);
 #endif
 	cb_data.percentage_done = 20;
 	om_cb(&cb_data, app_data);
@@ -1195,6 +1232,8 @@ do_ti(void *args)
 	 * create VTOC target
 	 */
 
+	phase = om_timing_begin("ti_vtoc");
+
 	if (nvlist_alloc(&ti_ex_attrs, TI_TARGET_NVLIST_TYPE, 0) != 0) {
 		om_log_print("Could not create target list.\n");
 		om_set_error(OM_NO_SPACE);
@@ -1227,6 +1266,7 @@ do_ti(void *args)
 		status = -1;
 		goto ti_error;
 	}
+	om_timing_end(phase, 0);
 
 	cb_data.percentage_done = 40;
 	om_cb(&cb_data, app_data);
@@ -1236,6 +1276,7 @@ do_ti(void *args)
 	 */
 
 	om_log_print("Set zfs root pool device\n");
+	phase = om_timing_begin("ti_zpool");
 
 	if (prepare_zfs_root_pool_attrs(&ti_ex_attrs, disk_name,
 	    install_slice_id) != OM_SUCCESS) {
@@ -1262,6 +1303,7 @@ do_ti(void *args)
 		status = -1;
 		goto ti_error;
 	}
+	om_timing_end(phase, 0);
 
 	cb_data.percentage_done = 60;
 	om_cb(&cb_data, app_data);
@@ -1290,6 +1332,59 @@ do_ti(void *args)
 	    "Available disk space for swap/dump: %llu MiB\n",
 	    available_disk_space);
 
+	cb_data.percentage_done = 80;
+	om_cb(&cb_data, app_data);
+
+	/*
+	 * Create BE
+	 */
+
+	phase = om_timing_begin("ti_be");
+
+	if (prepare_be_attrs(&ti_ex_attrs) != OM_SUCCESS) {
+		om_log_print("Could not prepare BE attribute set\n");
+		if (ti_ex_attrs != NULL) {
+			nvlist_free(ti_ex_attrs);
+		}
+		status = -1;
+		goto ti_error;
+	}
+
+	ti_status = ti_create_target(ti_ex_attrs, NULL);
+
+	nvlist_free(ti_ex_attrs);
+	ti_ex_attrs = NULL;
+
+	if (ti_status != TI_E_SUCCESS) {
+		om_log_print("Could not create BE target\n");
+		status = -1;
+		goto ti_error;
+	}
+	om_timing_end(phase, 0);
+
+	/*
+	 * BE is mounted, so let the transfer start now. Target
+	 * Instantiation is reported as finished at this point, swap and
+	 * dump volumes are created while the transfer is running. If that
+	 * fails, transfer is aborted and the failure is reported from
+	 * the transfer thread.
+	 *
+	 * If the breakpoint after TI was requested, nothing is to be
+	 * transferred, so don't release the transfer before TI is done.
+	 */
+
+	om_log_print("Boot environment mounted, transfer can be started\n");
+
+	be_mounted = B_TRUE;
+	cb_data.curr_milestone = OM_TARGET_INSTANTIATION;
+	cb_data.percentage_done = 100;
+	om_cb(&cb_data, app_data);
+
+	if (om_breakpoint != OM_breakpoint_after_TI)
+		ti_stage_post(TI_STAGE_BE_MOUNTED, 0);
+
+	phase = om_timing_begin("ti_swap_dump");
+
 	/* create_swap_and_dump is set in disk_parts.c or disk_slices.c */
 	/* Basic check to ensure there is space on actual partition/slice */
 	/* for software and some left over for swap/dump */
@@ -1412,38 +1507,12 @@ do_ti(void *args)
 		swap_device[0] = '\0';
 	}
 
-	cb_data.percentage_done = 80;
-	om_cb(&cb_data, app_data);
-
-	/*
-	 * Create BE
-	 */
-
-	if (prepare_be_attrs(&ti_ex_attrs) != OM_SUCCESS) {
-		om_log_print("Could not prepare BE attribute set\n");
-		if (ti_ex_attrs != NULL) {
-			nvlist_free(ti_ex_attrs);
-		}
-		status = -1;
-		goto ti_error;
-	}
-
-	ti_status = ti_create_target(ti_ex_attrs, NULL);
-
-	nvlist_free(ti_ex_attrs);
-	ti_ex_attrs = NULL;
-
-	if (ti_status != TI_E_SUCCESS) {
-		om_log_print("Could not create BE target\n");
-		status = -1;
-		goto ti_error;
-	}
-
-	cb_data.percentage_done = 99;
-	om_cb(&cb_data, app_data);
-
 ti_error:
 
+	/* finish the phase which failed or the last one */
+	om_timing_end(phase, status);
+	om_timing_end(ti_phase, status);
+
 	cb_data.num_milestones = 3;
 	cb_data.callback_type = OM_INSTALL_TYPE;
 
@@ -1456,7 +1525,18 @@ ti_error:
 		cb_data.percentage_done = 100;
 	}
 
-	om_cb(&cb_data, app_data);
+	/*
+	 * Once BE was mounted, progress was already reported and failure
+	 * is reported by the transfer thread
+	 */
+
+	if (!be_mounted)
+		om_cb(&cb_data, app_data);
+
+	ls_trace_end(LS_TRACE_OM, "target_instantiation", status);
+
+	/* Target Instantiation milestone reached, commit the log */
+	ls_flush();
 
 	if (om_breakpoint == OM_breakpoint_after_TI) {
 		om_log_std(LS_STDERR,
@@ -1464,6 +1544,8 @@ ti_error:
 		    " Installer exiting.\n");
 		exit(0);
 	}
+
+	ti_stage_post(TI_STAGE_DONE, status);
 	pthread_exit((void *)status);
 	/* LINTED [no return statement] */
 }
@@ -1484,16 +1566,19 @@ do_transfer(void *args)
 	struct transfer_callback	*tcb_args;
 	nvlist_t			**transfer_attr;
 	uint_t				transfer_attr_num;
-	int				i, status;
+	int				i, status, ret, err;
+	int				phase;
 	int				transfer_mode = OM_CPIO_TRANSFER;
 	int				value;
-	void				*exit_val;
 	char				buf[20], arc[MAXPATHLEN];
 
-	(void) pthread_join(ti_thread, &exit_val);
+	/*
+	 * Wait only until BE is mounted, swap and dump volumes are
+	 * created by TI thread while the transfer is running
+	 */
 
-	ti_ret += (int)exit_val;
-	if (ti_ret != 0) {
+	if (ti_stage_wait(TI_STAGE_BE_MOUNTED) != 0) {
+		(void) ti_wait_finished();
 		om_set_error(OM_TARGET_INSTANTIATION_FAILED);
 		notify_error_status(OM_TARGET_INSTANTIATION_FAILED);
 		status = -1;
@@ -1501,21 +1586,15 @@ do_transfer(void *args)
 	}
 
 	om_log_print("Transfer process initiated\n");
+	ls_trace_begin(LS_TRACE_OM, "transfer", 0);
 
 	tcb_args = (struct transfer_callback *)args;
 	transfer_attr = tcb_args->transfer_attr;
 	transfer_attr_num = tcb_args->transfer_attr_num;
 
 	if (tcb_args->target == NULL) {
-		if (transfer_attr != NULL) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-		}
-		om_set_error(OM_NO_TARGET_ATTRS);
-		notify_error_status(OM_NO_TARGET_ATTRS);
-		status = -1;
-		pthread_exit((void *)&status);
+		err = OM_NO_TARGET_ATTRS;
+		goto transfer_setup_failed;
 	}
 
 	/*
@@ -1527,72 +1606,42 @@ do_transfer(void *args)
 	if (transfer_attr != NULL) {
 		if (nvlist_lookup_uint32(transfer_attr[0], TM_ATTR_MECHANISM,
 		    ((uint32_t *)&value)) != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-			om_set_error(OM_NO_TARGET_ATTRS);
-			notify_error_status(OM_NO_TARGET_ATTRS);
-			status = -1;
-			pthread_exit((void *)&status);
+			err = OM_NO_TARGET_ATTRS;
+			goto transfer_setup_failed;
 		}
 		if (value == TM_PERFORM_IPS)
 			transfer_mode = OM_IPS_TRANSFER;
 	} else {
 		transfer_attr_num = 1;
-		transfer_attr = malloc(sizeof (nvlist_t *) * transfer_attr_num);
-		if (nvlist_alloc(transfer_attr, NV_UNIQUE_NAME, 0) != 0) {
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
-			status = -1;
-			pthread_exit((void *)&status);
+		transfer_attr = calloc(transfer_attr_num, sizeof (nvlist_t *));
+		if (transfer_attr == NULL ||
+		    nvlist_alloc(transfer_attr, NV_UNIQUE_NAME, 0) != 0) {
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
 		}
 
 		if (nvlist_add_uint32(*transfer_attr, TM_ATTR_MECHANISM,
 		    TM_PERFORM_CPIO) != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
-			status = -1;
-			pthread_exit((void *)&status);
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
 		}
 
 		if (nvlist_add_uint32(*transfer_attr, TM_CPIO_ACTION,
 		    TM_CPIO_ENTIRE) != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
-			status = -1;
-			pthread_exit((void *)&status);
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
 		}
 
 		if (nvlist_add_string(*transfer_attr, TM_CPIO_SRC_MNTPT,
 		    "/") != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
-			status = -1;
-			pthread_exit((void *)&status);
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
 		}
 
 		if (nvlist_add_string(*transfer_attr, TM_CPIO_DST_MNTPT,
 		    tcb_args->target) != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
-
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
-			status = -1;
-			pthread_exit((void *)&status);
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
 		}
 	}
 
@@ -1600,14 +1649,37 @@ do_transfer(void *args)
 	if (transfer_mode == OM_IPS_TRANSFER) {
 		om_log_print("IPS transfer mechanism selected\n");
 
-		status = om_perform_transfer_ips(transfer_attr,
-		    handle_TM_callback);
+		phase = om_timing_begin("transfer");
+
+		if (tm_transfer_begin() == 0) {
+			status = om_perform_transfer_ips(transfer_attr,
+			    handle_TM_callback);
+			tm_transfer_end();
+		} else {
+			status = OM_FAILURE;
+		}
+
+		om_timing_end(phase, status);
+
+		/*
+		 * Target Instantiation has to be finished before the
+		 * installed image is customized
+		 */
+
+		if (ti_wait_finished() != 0) {
+			ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
+			om_set_error(OM_TARGET_INSTANTIATION_FAILED);
+			notify_error_status(OM_TARGET_INSTANTIATION_FAILED);
+			status = -1;
+			pthread_exit((void *)&status);
+		}
 
 		/*
 		 * If IPS transfer phase failed, notify the caller and exit
 		 */
 
 		if (status != OM_SUCCESS) {
+			ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
 			notify_error_status(OM_TRANSFER_FAILED);
 			pthread_exit((void *)&status);
 		}
@@ -1629,18 +1701,21 @@ do_transfer(void *args)
 		}
 		if (nvlist_add_string(*transfer_attr, TM_UNPACK_ARCHIVE, arc)
 		    != 0) {
-			for (i = 0; i < transfer_attr_num; i++)
-				nvlist_free(transfer_attr[i]);
-			free(transfer_attr);
+			err = OM_NO_SPACE;
+			goto transfer_setup_failed;
+		}
 
-			om_set_error(OM_NO_SPACE);
-			notify_error_status(OM_NO_SPACE);
+		phase = om_timing_begin("transfer");
+
+		if (tm_transfer_begin() == 0) {
+			status = TM_perform_transfer(*transfer_attr,
+			    handle_TM_callback);
+			tm_transfer_end();
+		} else {
 			status = -1;
-			pthread_exit((void *)&status);
 		}
 
-		status = TM_perform_transfer(*transfer_attr,
-		    handle_TM_callback);
+		om_timing_end(phase, status);
 
 		/*
 		 * Since CPIO transfer phase finished, release nvlists holding
@@ -1651,17 +1726,33 @@ do_transfer(void *args)
 			nvlist_free(transfer_attr[i]);
 		free(transfer_attr);
 
+		/*
+		 * Target Instantiation has to be finished before the
+		 * installed image is customized
+		 */
+
+		if (ti_wait_finished() != 0) {
+			ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
+			om_set_error(OM_TARGET_INSTANTIATION_FAILED);
+			notify_error_status(OM_TARGET_INSTANTIATION_FAILED);
+			status = -1;
+			pthread_exit((void *)&status);
+		}
+
 		/*
 		 * If CPIO transfer phase failed, notify the caller and exit
 		 */
 
 		if (status != TM_SUCCESS) {
+			ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
 			om_log_print(NSI_TRANSFER_FAILED, status);
 			notify_error_status(OM_TRANSFER_FAILED);
 			pthread_exit((void *)&status);
 		}
 	}
 
+	ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
+
 	/*
 	 * Customize the installed image.
 	 */
@@ -1671,8 +1762,12 @@ do_transfer(void *args)
 	 * Set the language locale.
 	 */
 	if (def_locale != NULL) {
-		if (ict_set_lang_locale(tcb_args->target,
-		    def_locale, transfer_mode) != ICT_SUCCESS) {
+		phase = om_timing_begin("ict_set_lang_locale");
+		ret = ict_set_lang_locale(tcb_args->target, def_locale,
+		    transfer_mode);
+		om_timing_end(phase, ret);
+
+		if (ret != ICT_SUCCESS) {
 			om_log_print("Failed to set locale: "
 			    "%s\n%s\n", def_locale,
 			    ICT_STR_ERROR(ict_errno));
@@ -1690,8 +1785,12 @@ do_transfer(void *args)
 
 	if (!om_is_automated_installation()) {
 		/* Configure user directory */
-		if (ict_configure_user_directory(INSTALLED_ROOT_DIR,
-		    tcb_args->lname) != ICT_SUCCESS) {
+		phase = om_timing_begin("ict_configure_user_directory");
+		ret = ict_configure_user_directory(INSTALLED_ROOT_DIR,
+		    tcb_args->lname);
+		om_timing_end(phase, ret);
+
+		if (ret != ICT_SUCCESS) {
 			om_log_print("Couldn't configure user directory\n"
 			    "for user: %s\n%s\n", tcb_args->lname,
 			    ICT_STR_ERROR(ict_errno));
@@ -1699,8 +1798,11 @@ do_transfer(void *args)
 		}
 
 		/* Create personal initialization files */
-		if (ict_set_user_profile(tcb_args->target, tcb_args->lname) !=
-		    ICT_SUCCESS) {
+		phase = om_timing_begin("ict_set_user_profile");
+		ret = ict_set_user_profile(tcb_args->target, tcb_args->lname);
+		om_timing_end(phase, ret);
+
+		if (ret != ICT_SUCCESS) {
 			om_log_print("Couldn't set the user environment\n"
 			    "for user: %s\n%s\n",
 			    tcb_args->lname, ICT_STR_ERROR(ict_errno));
@@ -1717,18 +1819,26 @@ do_transfer(void *args)
 		setup_etc_vfstab_for_swap(tcb_args->target);
 	}
 
-	if (ict_set_host_node_name(tcb_args->target, tcb_args->hostname)
-	    != ICT_SUCCESS) {
+	phase = om_timing_begin("ict_set_host_node_name");
+	ret = ict_set_host_node_name(tcb_args->target, tcb_args->hostname);
+	om_timing_end(phase, ret);
+
+	if (ret != ICT_SUCCESS) {
 		om_log_print("Couldn't set the host and node name\n"
 		    "to hostname: %s\n%s\n", tcb_args->hostname,
 		    ICT_STR_ERROR(ict_errno));
 		status = -1;
 	}
 
+	phase = om_timing_begin("activate_be");
 	activate_be(INIT_BE_NAME);
+	om_timing_end(phase, 0);
 
-	if (ict_installboot(tcb_args->target, ROOTPOOL_NAME) 
-	    != ICT_SUCCESS) {
+	phase = om_timing_begin("ict_installboot");
+	ret = ict_installboot(tcb_args->target, ROOTPOOL_NAME);
+	om_timing_end(phase, ret);
+
+	if (ret != ICT_SUCCESS) {
 		om_log_print("installboot failed\n%s\n",
 		    ICT_STR_ERROR(ict_errno));
 		status = -1;
@@ -1737,9 +1847,13 @@ do_transfer(void *args)
 	/*
 	 * run_install_finish_script performs a group of ICT
 	 */
-	if (run_install_finish_script(tcb_args->target,
+	phase = om_timing_begin("finish_script");
+	ret = run_install_finish_script(tcb_args->target,
 	    tcb_args->uname, tcb_args->lname,
-	    tcb_args->upasswd, tcb_args->rpasswd) == OM_FAILURE) {
+	    tcb_args->upasswd, tcb_args->rpasswd);
+	om_timing_end(phase, ret);
+
+	if (ret == OM_FAILURE) {
 		om_log_print("The install finish script reported "
 		    "failures\n");
 		status = -1;
@@ -1748,8 +1862,11 @@ do_transfer(void *args)
 	/*
 	 * Take a snapshot of the installation.
 	 */
-	if (ict_snapshot(INIT_BE_NAME, INSTALL_SNAPSHOT) !=
-	    ICT_SUCCESS) {
+	phase = om_timing_begin("ict_snapshot");
+	ret = ict_snapshot(INIT_BE_NAME, INSTALL_SNAPSHOT);
+	om_timing_end(phase, ret);
+
+	if (ret != ICT_SUCCESS) {
 		om_log_print("Failed to generate snapshot\n"
 		    "pool: %s\nsnapshot: %s\n%s\n",
 		    INIT_BE_NAME, INSTALL_SNAPSHOT,
@@ -1763,7 +1880,11 @@ do_transfer(void *args)
 	 */
 
 	om_log_print("Marking root pool as 'ready'\n");
-	if (ict_mark_root_pool_ready(ROOTPOOL_NAME) != ICT_SUCCESS) {
+	phase = om_timing_begin("ict_mark_root_pool_ready");
+	ret = ict_mark_root_pool_ready(ROOTPOOL_NAME);
+	om_timing_end(phase, ret);
+
+	if (ret != ICT_SUCCESS) {
 		om_log_print("%s\n", ICT_STR_ERROR(ict_errno));
 		status = -1;
 	} else {
@@ -1796,6 +1917,26 @@ do_transfer(void *args)
 		notify_error_status(OM_ICT_FAILURE);
 
 	pthread_exit((void *)&status);
+
+transfer_setup_failed:
+	/*
+	 * Transfer couldn't be set up. Release the transfer attributes
+	 * and wait for TI thread, so that it doesn't keep creating
+	 * swap and dump while the failure is being reported.
+	 */
+	if (transfer_attr != NULL) {
+		for (i = 0; i < transfer_attr_num; i++)
+			nvlist_free(transfer_attr[i]);
+		free(transfer_attr);
+	}
+
+	(void) ti_wait_finished();
+	ls_trace_end(LS_TRACE_OM, "transfer", transfer_mode);
+
+	om_set_error(err);
+	notify_error_status(err);
+	status = -1;
+	pthread_exit((void *)&status);
 	/* LINTED [no return statement] */
 }
 
@@ -2034,6 +2175,11 @@ notify_error_status(int status)
 	cb_data.percentage_done = status; /* overload value on error */
 	cb_data.message = NULL;
 	om_cb(&cb_data, 0);
+
+	(void) om_timing_report(OM_TIMING_REPORT_DIR);
+
+	/* make sure the log describing the failure is on disk */
+	ls_flush();
 }
 
 /*
@@ -2050,6 +2196,113 @@ notify_install_complete()
 	cb_data.percentage_done = 100;
 	cb_data.message = NULL;
 	om_cb(&cb_data, 0);
+
+	(void) om_timing_report(OM_TIMING_REPORT_DIR);
+	ls_flush();
+}
+
+/*
+ * ti_stage_post
+ * Called by TI thread when it reaches given stage or fails. Failure
+ * releases all waiters and aborts the transfer if it is already running.
+ * Input:	stage - stage reached
+ *		status - 0 if TI succeeded so far, otherwise non-zero
+ */
+static void
+ti_stage_post(ti_stage_t stage, int status)
+{
+	boolean_t	abort_transfer = B_FALSE;
+
+	(void) pthread_mutex_lock(&ti_stage_mutex);
+
+	if (status != 0) {
+		ti_stage_status = status;
+		ti_stage = TI_STAGE_DONE;
+		abort_transfer = tm_in_progress;
+	} else if (stage > ti_stage) {
+		ti_stage = stage;
+	}
+
+	(void) pthread_cond_broadcast(&ti_stage_cv);
+	(void) pthread_mutex_unlock(&ti_stage_mutex);
+
+	if (abort_transfer) {
+		om_log_print("Target Instantiation failed, aborting "
+		    "transfer\n");
+		TM_abort_transfer();
+	}
+}
+
+/*
+ * ti_stage_wait
+ * Blocks until TI thread reaches given stage or fails.
+ * Input:	stage - stage to wait for
+ * Return:	0 if TI succeeded so far, otherwise non-zero
+ */
+static int
+ti_stage_wait(ti_stage_t stage)
+{
+	int	status;
+
+	(void) pthread_mutex_lock(&ti_stage_mutex);
+
+	while (ti_stage < stage)
+		(void) pthread_cond_wait(&ti_stage_cv, &ti_stage_mutex);
+
+	status = ti_stage_status;
+	(void) pthread_mutex_unlock(&ti_stage_mutex);
+
+	return (status);
+}
+
+/*
+ * ti_wait_finished
+ * Waits for TI thread to finish and collects its exit status.
+ * Return:	0 if TI succeeded, otherwise non-zero
+ */
+static int
+ti_wait_finished(void)
+{
+	void	*exit_val;
+
+	(void) pthread_join(ti_thread, &exit_val);
+
+	ti_ret += (int)exit_val;
+	return (ti_ret);
+}
+
+/*
+ * tm_transfer_begin
+ * Marks the transfer as running, so that it can be aborted if TI fails
+ * while the transfer is in progress.
+ * Return:	0 if the transfer can be started, non-zero if TI has
+ *		already failed
+ */
+static int
+tm_transfer_begin(void)
+{
+	int	status;
+
+	(void) pthread_mutex_lock(&ti_stage_mutex);
+
+	if ((status = ti_stage_status) == 0)
+		tm_in_progress = B_TRUE;
+
+	(void) pthread_mutex_unlock(&ti_stage_mutex);
+
+	return (status);
+}
+
+/*
+ * tm_transfer_end
+ * Marks the transfer as finished, it can't be aborted any more.
+ */
+static void
+tm_transfer_end(void)
+{
+	(void) pthread_mutex_lock(&ti_stage_mutex);
+	tm_in_progress = B_FALSE;
+	(void) pthread_mutex_unlock(&ti_stage_mutex);
 }
 
 /*
@@ -2139,6 +2392,16 @@ reset_zfs_mount_property(char *target, int transfer_mode)
 		}
 	}
 
+	/*
+	 * Save install timing report along with log files on the target.
+	 * The final report is written next to the install log when the
+	 * installation finishes.
+	 */
+
+	(void) snprintf(cmd, sizeof (cmd), "%s%s", target,
+	    LS_LOGFILE_DST_PATH);
+	(void) om_timing_report(cmd);
+
 	/*
 	 * Transfer log files to the destination.
 	 */
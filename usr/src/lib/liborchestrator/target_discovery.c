@@ -117,6 +117,12 @@ get_td_disk_info_discover(int *ndisks, om_callback_t cb)
 		cb_data.curr_milestone = OM_DISK_DISCOVERY;
 	}
 
+	/*
+	 * Query the disks in parallel up front. The loop below then
+	 * enumerates cached attributes in the usual order.
+	 */
+	(void) td_discover_attributes(TD_OT_DISK, TD_DISCOVERY_DEF_THREADS);
+
 	for (i = 1; i <= num; i++) {
 		/*
 		 * Get the disk information
@@ -195,6 +201,13 @@ get_td_disk_parts_discover(disk_target_t *disks, om_callback_t cb)
 		cb_data.curr_milestone = OM_PARTITION_DISCOVERY;
 	}
 
+	/*
+	 * Query all partitions in parallel up front, so that
+	 * enumerate_partitions() only picks the cached ones of each disk.
+	 */
+	(void) td_discover_attributes(TD_OT_PARTITION,
+	    TD_DISCOVERY_DEF_THREADS);
+
 	for (dt = disks, i = 1; dt != NULL; dt = dt->next, i++) {
 		/*
 		 * Now get the partitions for this disk
@@ -248,6 +261,13 @@ get_td_disk_slices_discover(disk_target_t *disks, om_callback_t cb)
 		cb_data.curr_milestone = OM_SLICE_DISCOVERY;
 	}
 
+	/*
+	 * Query all slices in parallel up front, so that
+	 * enumerate_slices() only picks the cached ones of each disk.
+	 */
+	(void) td_discover_attributes(TD_OT_SLICE,
+	    TD_DISCOVERY_DEF_THREADS);
+
 	for (dt = disks, i = 1; dt != NULL; dt = dt->next, i++) {
 		/*
 		 * Now get the partitions for this disk
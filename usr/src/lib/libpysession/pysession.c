@@ -0,0 +1,333 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * pysession.c
+ *
+ * Embedded Python interpreter session.
+ *
+ * The libraries built on top of this used to initialize the interpreter,
+ * import their Python module and create a fresh thread state on every
+ * call, and some of them finalized the interpreter again on the way out.
+ * This layer does the expensive parts once:
+ *
+ *   - the interpreter is initialized on first use and the global
+ *     interpreter lock is released right away, so any thread may enter
+ *     the session afterwards;
+ *   - a thread entering the session for the first time gets a thread
+ *     state which is kept ("pinned") until the thread exits, so later
+ *     enters only need to take the lock;
+ *   - modules and functions are looked up once and kept in a cache.
+ *
+ * If the interpreter was already initialized by the hosting process, for
+ * instance when the consumer is itself loaded into a Python program, the
+ * host keeps ownership of the interpreter and of its own thread state.
+ */
+
+#include <Python.h>
+#include <atomic.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include "pysession.h"
+
+/* per thread session state */
+typedef struct ps_thread {
+	boolean_t	pt_pinned;	/* thread state created by us */
+	uint_t		pt_depth;	/* nesting of enter/exit */
+	hrtime_t	pt_start;	/* time of the outermost enter */
+} ps_thread_t;
+
+/* module (pc_func == NULL) or function cache entry */
+typedef struct ps_cache {
+	struct ps_cache	*pc_next;
+	char		*pc_module;
+	char		*pc_func;
+	PyObject	*pc_obj;
+} ps_cache_t;
+
+static pthread_once_t	ps_once = PTHREAD_ONCE_INIT;
+static pthread_key_t	ps_thread_key;
+static boolean_t	ps_initialized = B_FALSE;
+static char		*empty_argv[1] = { "" };
+
+/* protected by the global interpreter lock */
+static ps_cache_t	*ps_cache = NULL;
+
+static volatile uint64_t	ps_crossings = 0;
+static volatile uint64_t	ps_boundary_ns = 0;
+static volatile uint64_t	ps_imports = 0;
+static volatile uint64_t	ps_lookups = 0;
+static volatile uint64_t	ps_hits = 0;
+
+/*
+ * Release the thread state pinned by ps_session_enter() when the
+ * thread exits.
+ */
+static void
+ps_thread_fini(void *arg)
+{
+	ps_thread_t	*pt = arg;
+
+	if (pt->pt_pinned) {
+		PyEval_RestoreThread(PyGILState_GetThisThreadState());
+		PyGILState_Release(PyGILState_UNLOCKED);
+	}
+	free(pt);
+}
+
+static void
+ps_init_once(void)
+{
+	if (pthread_key_create(&ps_thread_key, ps_thread_fini) != 0)
+		return;
+
+	if (Py_IsInitialized()) {
+		/* the host owns the interpreter and its locking */
+		ps_initialized = B_TRUE;
+		return;
+	}
+
+	Py_Initialize();
+
+	/*
+	 * sys.argv needs to be initialized, just in case other
+	 * modules access it.  It is not initialized automatically by
+	 * Py_Initialize().
+	 */
+	PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
+	PyEval_InitThreads();
+
+	if (PyErr_Occurred()) {
+		PyErr_Print();
+	} else {
+		ps_initialized = B_TRUE;
+	}
+
+	/*
+	 * The main thread state stays registered with this thread,
+	 * only the lock is given up.
+	 */
+	(void) PyEval_SaveThread();
+}
+
+/*
+ * Function:	ps_session_init
+ * Description:	Initialize the interpreter session.  Only the first call
+ *		does any work, later calls report the result of the first.
+ * Parameters:	none
+ * Return:	B_TRUE if the session is usable, B_FALSE otherwise
+ */
+boolean_t
+ps_session_init(void)
+{
+	(void) pthread_once(&ps_once, ps_init_once);
+	return (ps_initialized);
+}
+
+/*
+ * Function:	ps_session_enter
+ * Description:	Make the Python C API usable from the calling thread by
+ *		taking the global interpreter lock with the thread state
+ *		of this thread.  Calls may nest; the outermost one starts
+ *		the boundary timer.
+ * Parameters:	none
+ * Return:	state to be handed to the matching ps_session_exit()
+ */
+ps_state_t
+ps_session_enter(void)
+{
+	ps_thread_t	*pt;
+
+	(void) ps_session_init();
+
+	if ((pt = pthread_getspecific(ps_thread_key)) == NULL &&
+	    (pt = calloc(1, sizeof (ps_thread_t))) != NULL) {
+		/*
+		 * A thread unknown to the interpreter gets a thread state
+		 * which outlives this call.  Taking it leaves the lock
+		 * held, so give that up again before the real enter.
+		 */
+		if (PyGILState_GetThisThreadState() == NULL) {
+			(void) PyGILState_Ensure();
+			(void) PyEval_SaveThread();
+			pt->pt_pinned = B_TRUE;
+		}
+		(void) pthread_setspecific(ps_thread_key, pt);
+	}
+
+	if (pt != NULL && pt->pt_depth++ == 0)
+		pt->pt_start = gethrtime();
+
+	return (PyGILState_Ensure());
+}
+
+/*
+ * Function:	ps_session_exit
+ * Description:	Leave the session entered by ps_session_enter()
+ * Parameters:	state - value returned by ps_session_enter()
+ * Return:	none
+ */
+void
+ps_session_exit(ps_state_t state)
+{
+	ps_thread_t	*pt;
+
+	PyGILState_Release(state);
+
+	if ((pt = pthread_getspecific(ps_thread_key)) != NULL &&
+	    pt->pt_depth > 0 && --pt->pt_depth == 0) {
+		atomic_add_64(&ps_boundary_ns, gethrtime() - pt->pt_start);
+		atomic_inc_64(&ps_crossings);
+	}
+}
+
+static ps_cache_t *
+ps_cache_lookup(const char *mod_name, const char *func_name)
+{
+	ps_cache_t	*pc;
+
+	for (pc = ps_cache; pc != NULL; pc = pc->pc_next) {
+		if (strcmp(pc->pc_module, mod_name) != 0)
+			continue;
+		if (func_name == NULL ? pc->pc_func == NULL :
+		    pc->pc_func != NULL && strcmp(pc->pc_func, func_name) == 0)
+			return (pc);
+	}
+	return (NULL);
+}
+
+/*
+ * Add an object to the cache, taking over the reference held by the
+ * caller.  If there is no memory to remember it, the object is still
+ * handed back but the reference is leaked rather than left dangling.
+ */
+static PyObject *
+ps_cache_add(const char *mod_name, const char *func_name, PyObject *obj)
+{
+	ps_cache_t	*pc;
+
+	if ((pc = calloc(1, sizeof (ps_cache_t))) == NULL)
+		return (obj);
+
+	if ((pc->pc_module = strdup(mod_name)) == NULL ||
+	    (func_name != NULL && (pc->pc_func = strdup(func_name)) == NULL)) {
+		free(pc->pc_module);
+		free(pc);
+		return (obj);
+	}
+
+	pc->pc_obj = obj;
+	pc->pc_next = ps_cache;
+	ps_cache = pc;
+	return (obj);
+}
+
+/*
+ * Function:	ps_get_module
+ * Description:	Return the named module, importing it on first use.
+ *		Must be called with the session entered.
+ * Parameters:	mod_name - dotted name of the module
+ * Return:	borrowed reference to the module,
+ *		NULL with the Python error set if the import failed
+ */
+PyObject *
+ps_get_module(const char *mod_name)
+{
+	ps_cache_t	*pc;
+	PyObject	*pModule;
+
+	if ((pc = ps_cache_lookup(mod_name, NULL)) != NULL) {
+		atomic_inc_64(&ps_hits);
+		return (pc->pc_obj);
+	}
+
+	if ((pModule = PyImport_ImportModule((char *)mod_name)) == NULL)
+		return (NULL);
+
+	atomic_inc_64(&ps_imports);
+	return (ps_cache_add(mod_name, NULL, pModule));
+}
+
+/*
+ * Function:	ps_get_function
+ * Description:	Return a callable attribute of the named module, importing
+ *		the module and looking up the attribute on first use.
+ *		Must be called with the session entered.
+ * Parameters:	mod_name - dotted name of the module
+ *		func_name - name of the function (or class) in the module
+ * Return:	borrowed reference to the callable,
+ *		NULL with the Python error set if it can't be found
+ */
+PyObject *
+ps_get_function(const char *mod_name, const char *func_name)
+{
+	ps_cache_t	*pc;
+	PyObject	*pModule;
+	PyObject	*pFunc;
+
+	if ((pc = ps_cache_lookup(mod_name, func_name)) != NULL) {
+		atomic_inc_64(&ps_hits);
+		return (pc->pc_obj);
+	}
+
+	if ((pModule = ps_get_module(mod_name)) == NULL)
+		return (NULL);
+
+	if ((pFunc = PyObject_GetAttrString(pModule,
+	    (char *)func_name)) == NULL)
+		return (NULL);
+
+	if (!PyCallable_Check(pFunc)) {
+		Py_DECREF(pFunc);
+		PyErr_Format(PyExc_TypeError, "%s.%s is not callable",
+		    mod_name, func_name);
+		return (NULL);
+	}
+
+	atomic_inc_64(&ps_lookups);
+	return (ps_cache_add(mod_name, func_name, pFunc));
+}
+
+/*
+ * Function:	ps_session_stats
+ * Description:	Report how often and for how long the process crossed into
+ *		the interpreter, and how well the caches did.  The boundary
+ *		time covers everything between the outermost enter and
+ *		exit, including waiting for the interpreter lock.
+ * Parameters:	stats - filled in with the current counters
+ * Return:	none
+ */
+void
+ps_session_stats(ps_stats_t *stats)
+{
+	stats->pst_crossings = ps_crossings;
+	stats->pst_boundary_ns = ps_boundary_ns;
+	stats->pst_imports = ps_imports;
+	stats->pst_lookups = ps_lookups;
+	stats->pst_hits = ps_hits;
+}
@@ -0,0 +1,74 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * pysession.h
+ *
+ * Interface to the embedded Python interpreter session shared by the
+ * install libraries which call into Python modules from C.
+ *
+ * The interpreter is initialized once per process and is never finalized.
+ * Between calls the global interpreter lock is released, so a consumer
+ * brackets every use of the Python C API with ps_session_enter() and
+ * ps_session_exit().  Imported modules and looked up functions are cached
+ * for the life of the process; the returned references are borrowed and
+ * must only be used while the session is entered.
+ */
+
+#ifndef _PYSESSION_H
+#define	_PYSESSION_H
+
+#include <Python.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef PyGILState_STATE ps_state_t;
+
+/* counters describing the use of the session, see ps_session_stats() */
+typedef struct ps_stats {
+	uint64_t	pst_crossings;	/* outermost enter/exit pairs */
+	uint64_t	pst_boundary_ns; /* time spent between them */
+	uint64_t	pst_imports;	/* modules actually imported */
+	uint64_t	pst_lookups;	/* functions actually looked up */
+	uint64_t	pst_hits;	/* module/function cache hits */
+} ps_stats_t;
+
+boolean_t ps_session_init(void);
+ps_state_t ps_session_enter(void);
+void ps_session_exit(ps_state_t state);
+
+PyObject *ps_get_module(const char *mod_name);
+PyObject *ps_get_function(const char *mod_name, const char *func_name);
+
+void ps_session_stats(ps_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PYSESSION_H */
@@ -87,6 +87,11 @@ LLCreateList(TList * List, TLLData Data)
 	LocalList->Head = NULL;
 	LocalList->Tail = NULL;
 	LocalList->Current = NULL;
+	LocalList->Pool.LinksPerChunk = 0;
+	LocalList->Pool.LinksInUse = 0;
+	LocalList->Pool.LinksLeft = 0;
+	LocalList->Pool.Chunks = NULL;
+	LocalList->Pool.FreeLinks = NULL;
 
 	/*
 	 * Point the user's list at the created list.
@@ -97,6 +102,79 @@ LLCreateList(TList * List, TLLData Data)
 	return (LLSuccess);
 }
 
+/*
+ * *********************************************************************
+ * MODULE NAME: LLCreatePooledList
+ *
+ * DESCRIPTION:
+ *  This function creates a new instance of a linked list whose links
+ *  are created with LLCreatePooledLink() from a pool owned by the list.
+ *  The pool carves the links from chunks of contiguous memory, so that
+ *  creating and destroying a link doesn't call the memory allocator
+ *  and links of the list are close to each other.  The chunks are freed
+ *  in bulk by LLClearList() and LLDestroyList().
+ *
+ *  Links created from the pool of the list must not be used once the
+ *  list is destroyed.
+ *
+ * RETURN:
+ *  TYPE           DESCRIPTION
+ *  TLLError       This is the enumerated error
+ *                 code defined in the public
+ *                 header.  Upon success, LLSuccess
+ *                 will be returned.  Upon error,
+ *                 the appropriate error code will
+ *                 returned.
+ *
+ * PARAMETERS:
+ *  TYPE           DESCRIPTION
+ *  TList *        The pointer to the list to be created.  Upon success
+ *                 the contents of the pointer is set to the new list.
+ *  TLLData        The pointer to the user data to be associated with
+ *                 the list.  If the user does not have any list level
+ *                 data to store, then NULL can be passed.
+ *  int            The number of links carved from one chunk of memory.
+ *                 If 0 is passed, a default is used.
+ * *********************************************************************
+ */
+
+TLLError
+LLCreatePooledList(TList * List, TLLData Data, int LinksPerChunk)
+{
+	TLLError	LLError;
+
+	if (LinksPerChunk < 0)
+		return (LLInvalidOperation);
+
+	if ((LLError = LLCreateList(List, Data))) {
+		return (LLError);
+	}
+
+	((TLinkList *) *List)->Pool.LinksPerChunk =
+	    LinksPerChunk == 0 ? LLPOOL_DEFAULT_LINKS : LinksPerChunk;
+
+	return (LLSuccess);
+}
+
+/*
+ * Free all chunks of the pool of a list.  None of the links carved from
+ * them can be in use.
+ */
+
+static void
+LLFreeLinkPool(TLinkPool *Pool)
+{
+	TLinkChunk	*Chunk;
+
+	while ((Chunk = Pool->Chunks) != NULL) {
+		Pool->Chunks = Chunk->Next;
+		free(Chunk);
+	}
+
+	Pool->LinksLeft = 0;
+	Pool->FreeLinks = NULL;
+}
+
 /*
  * *********************************************************************
  * MODULE NAME: LLCreateLink
@@ -151,6 +229,7 @@ LLCreateLink(TLink * Link, TLLData Data)
 	LocalLink->Next = NULL;
 	LocalLink->Prev = NULL;
 	LocalLink->Data = Data;
+	LocalLink->Pool = NULL;
 
 	/*
 	 * Point the user's link at the created link.
@@ -161,6 +240,102 @@ LLCreateLink(TLink * Link, TLLData Data)
 	return (LLSuccess);
 }
 
+/*
+ * *********************************************************************
+ * MODULE NAME: LLCreatePooledLink
+ *
+ * DESCRIPTION:
+ *  This function creates an instance of a link from the pool of the
+ *  provided list, see LLCreatePooledList().  The link can be used the
+ *  same way as one created by LLCreateLink(), but it has to be
+ *  destroyed before the list is.  If the list is not pooled, the link
+ *  is created by LLCreateLink().
+ *
+ * RETURN:
+ *  TYPE           DESCRIPTION
+ *  TLLError       This is the enumerated error
+ *                 code defined in the public
+ *                 header.  Upon success, LLSuccess
+ *                 will be returned.  Upon error,
+ *                 the appropriate error code will
+ *                 returned.
+ *
+ * PARAMETERS:
+ *  TYPE           DESCRIPTION
+ *  TList          The list whose pool the link is carved from.
+ *  TLink *        The pointer to the link to be created.  Upon success
+ *                 the contents of the pointer is set to the new link.
+ *  TLLData        A pointer to the user data to be associated with the
+ *                 link.
+ * *********************************************************************
+ */
+
+TLLError
+LLCreatePooledLink(TList List, TLink * Link, TLLData Data)
+{
+	TLinkList	*LocalList;
+	TLinkPool	*Pool;
+	TLinkChunk	*Chunk;
+	TDoubleLink	*LocalLink;
+
+	if (List == NULL)
+		return (LLInvalidList);
+
+	LocalList = (TLinkList *) List;
+
+	if (LocalList->Initialized != LLINITIALIZED)
+		return (LLInvalidList);
+
+	Pool = &LocalList->Pool;
+
+	if (Pool->LinksPerChunk == 0)
+		return (LLCreateLink(Link, Data));
+
+	/*
+	 * Reuse a destroyed link if there is one, otherwise carve the
+	 * link from the current chunk, allocating a new one if the
+	 * current one is used up.
+	 */
+
+	if (Pool->FreeLinks != NULL) {
+		LocalLink = Pool->FreeLinks;
+		Pool->FreeLinks = LocalLink->Next;
+	} else {
+		if (Pool->LinksLeft == 0) {
+			Chunk = (TLinkChunk *) malloc(sizeof (TLinkChunk) +
+			    (Pool->LinksPerChunk - 1) * sizeof (TDoubleLink));
+			if (Chunk == NULL) {
+				*Link = NULL;
+				return (LLMemoryAllocationError);
+			}
+
+			Chunk->Next = Pool->Chunks;
+			Pool->Chunks = Chunk;
+			Pool->LinksLeft = Pool->LinksPerChunk;
+		}
+
+		LocalLink = &Pool->Chunks->Links[Pool->LinksPerChunk -
+		    Pool->LinksLeft];
+		Pool->LinksLeft--;
+	}
+
+	Pool->LinksInUse++;
+
+	/*
+	 * Initialize the link.
+	 */
+
+	LocalLink->Initialized = LLINITIALIZED;
+	LocalLink->Next = NULL;
+	LocalLink->Prev = NULL;
+	LocalLink->Data = Data;
+	LocalLink->Pool = Pool;
+
+	*Link = (TLink) LocalLink;
+
+	return (LLSuccess);
+}
+
 /*
  * *********************************************************************
  * MODULE NAME: LLAddLink
@@ -685,10 +860,18 @@ LLDestroyLink(TLink * Link, TLLData * Data)
 	}
 
 	/*
-	 * Ok, the link is not in use so free up it's memory.
+	 * Ok, the link is not in use so free up it's memory.  A pooled
+	 * link is returned to the pool of its list.
 	 */
 
-	free(*Link);
+	if (LocalLink->Pool != NULL) {
+		LocalLink->Initialized = 0;
+		LocalLink->Next = LocalLink->Pool->FreeLinks;
+		LocalLink->Pool->FreeLinks = LocalLink;
+		LocalLink->Pool->LinksInUse--;
+	} else {
+		free(*Link);
+	}
 	*Link = NULL;
 
 	return (LLSuccess);
@@ -755,7 +938,8 @@ LLDestroyList(TList * List, TLLData * Data)
 
 	if (LocalList->Head != NULL ||
 	    LocalList->Current != NULL ||
-	    LocalList->Tail != NULL) {
+	    LocalList->Tail != NULL ||
+	    LocalList->Pool.LinksInUse != 0) {
 		return (LLListInUse);
 	}
 
@@ -771,9 +955,11 @@ LLDestroyList(TList * List, TLLData * Data)
 	}
 
 	/*
-	 * Ok, the list is not in use so free up it's memory.
+	 * Ok, the list is not in use so free up it's memory along with
+	 * all the links of its pool.
 	 */
 
+	LLFreeLinkPool(&LocalList->Pool);
 	free(*List);
 	*List = NULL;
 
@@ -1193,7 +1379,14 @@ LLGetSuppliedLinkData(TLink Link, TLLData *Data)
  * MODULE NAME: LLSortList
  * DESCRIPTION:
  *   This function takes in a Link List and sorts it based upon the
- *   return values of the provided compare function.
+ *   return values of the provided compare function.  The links are
+ *   sorted in place with a bottom-up merge sort, so the list is sorted
+ *   in O(n log n) comparisons without allocating any memory.  The sort
+ *   is stable, links comparing equal keep their relative order.  Upon
+ *   return the current link of the list is its tail.
+ *
+ *   If the callback fails, the remaining links are not compared, but
+ *   the list still contains all of its links.
  * RETURN:
  *  TYPE           DESCRIPTION
  *  TLLError       This is the enumerated error
@@ -1207,10 +1400,9 @@ LLGetSuppliedLinkData(TLink Link, TLLData *Data)
  *  TYPE           DESCRIPTION
  *  TList          The list to be sorted.
  *  <Callback>     This is the users compare callback.  It will be
- *                 invoked for each link in the list to determine
- *                 where the current link of the old list should be
- *                 inserted relative to the current link of the new
- *                 list.
+ *                 invoked with the data of two links of the list and
+ *                 determines whether the link of the first data
+ *                 should be placed before the link of the second one.
  *  void *         A pointer to user data that will be passed to the
  *                 callback as the first argument when invoked.
  *
@@ -1225,95 +1417,434 @@ LLSortList(TList ListToSort,
     TLLCompare(*Compare) (void *, TLLData, TLLData),
     void *UserPtr)
 {
-	TList		SortedList;
-	TLink 		SortedLink;
+	TLinkList	*LocalList;
+	TDoubleLink	*Left, *Right, *Next, *Head, *Tail;
+	int		RunSize, LeftSize, RightSize, Merges;
+	TBoolean	TakeRight;
+	TLLError	LLError = LLSuccess;
 
-	TLLError	LLError;
-	TLLCompare	LLCompare;
-	TLink		CurrentLink;
+	if (ListToSort == NULL)
+		return (LLInvalidList);
 
-	TLLData		SortedData;
-	TLLData		LinkData;
+	LocalList = (TLinkList *) ListToSort;
 
-	TBoolean	Done;
-	TBoolean 	Found;
+	if (LocalList->Initialized != LLINITIALIZED)
+		return (LLInvalidList);
+
+	if (LocalList->Head == NULL)
+		return (LLSuccess);
 
 	/*
-	 * Create a temporary list to do the alphabetic sorting
+	 * Merge the sorted runs of RunSize links in pairs, doubling
+	 * the size of the runs with each pass until a single merge
+	 * is done.  Only the Next pointers are maintained while
+	 * merging, the Prev pointers are fixed up once sorted.
 	 */
 
-	if ((LLError = LLCreateList(&SortedList, NULL))) {
-		return (LLError);
+	Head = LocalList->Head;
+
+	for (RunSize = 1; ; RunSize *= 2) {
+		Left = Head;
+		Head = Tail = NULL;
+		Merges = 0;
+
+		while (Left != NULL) {
+			Merges++;
+
+			/*
+			 * The right run starts RunSize links after the
+			 * left one, or is empty at the end of the list.
+			 */
+
+			Right = Left;
+			for (LeftSize = 0; LeftSize < RunSize && Right != NULL;
+			    LeftSize++)
+				Right = Right->Next;
+			RightSize = RunSize;
+
+			while (LeftSize > 0 || (RightSize > 0 && Right)) {
+
+				/*
+				 * Take the link of the left run unless it
+				 * is greater, so that equal links keep
+				 * their order.  Once the callback failed,
+				 * the runs are just concatenated.
+				 */
+
+				if (LeftSize == 0) {
+					TakeRight = True;
+				} else if (RightSize == 0 || Right == NULL ||
+				    LLError != LLSuccess) {
+					TakeRight = False;
+				} else {
+					switch (Compare(UserPtr, Left->Data,
+					    Right->Data)) {
+					case LLCompareLess:
+					case LLCompareEqual:
+						TakeRight = False;
+						break;
+					case LLCompareGreater:
+						TakeRight = True;
+						break;
+					case LLCompareError:
+					default:
+						LLError = LLCallbackError;
+						TakeRight = False;
+						break;
+					}
+				}
+
+				if (TakeRight) {
+					Next = Right;
+					Right = Right->Next;
+					RightSize--;
+				} else {
+					Next = Left;
+					Left = Left->Next;
+					LeftSize--;
+				}
+
+				if (Tail != NULL)
+					Tail->Next = Next;
+				else
+					Head = Next;
+				Tail = Next;
+			}
+
+			Left = Right;
+		}
+
+		Tail->Next = NULL;
+
+		if (Merges <= 1 || LLError != LLSuccess)
+			break;
 	}
 
 	/*
-	 * Set to the beginning of the list to sort
+	 * Fix up the back links and the list itself.
 	 */
 
-	LLError = LLUpdateCurrent(ListToSort, LLHead);
+	Head->Prev = NULL;
+	for (Left = Head; Left->Next != NULL; Left = Left->Next)
+		Left->Next->Prev = Left;
+
+	LocalList->Head = Head;
+	LocalList->Tail = Left;
+	LocalList->Current = Left;
+
+	return (LLError);
+}
+
+/*
+ * *********************************************************************
+ * MODULE NAME: LLClearList
+ * DESCRIPTION:
+ *  This function allows the calling application to clear the contents
+ *  of the link list.  The calling application must provide a callback
+ *  that can be invoked to do any clean up prior to destroying a link
+ *  within the list.  If the list is pooled and none of the links of its
+ *  pool are in use afterwards, the memory of the pool is freed.
+ * RETURN:
+ *  TYPE           DESCRIPTION
+ *  TLLError       This is the enumerated error
+ *                 code defined in the public
+ *                 header.  Upon success, LLSuccess
+ *                 will be returned.  Upon error,
+ *                 the appropriate error code will
+ *                 returned.
+ *
+ * PARAMETERS:
+ *  TYPE           DESCRIPTION
+ *  TList          The list to remove all of the links from.
+ *  <Callback>     The callback to call with the data pointer
+ *                 for the link about to be removed and destroyed.
+ *
+ *  Change Activity:
+ *       Date   Developer Name    Description of Changes
+ *    15-May-96 Craig Vosburgh    Creation of Module
+ * *********************************************************************
+ */
+
+TLLError
+LLClearList(TList List,
+    TLLError(*CleanUp) (TLLData Data))
+{
+
+	TLink		CurrentLink;
+	TLLData 	LLData;
+	TLLError	LLError;
+	TBoolean	Done;
+
+	/*
+	 * Set up the current link to be the head of the list.
+	 */
+
+	LLError = LLUpdateCurrent(List, LLHead);
 	switch (LLError) {
 	case LLSuccess:
+		Done = False;
 		break;
 	case LLListEmpty:
-		return (LLSuccess);
+		Done = True;
+		break;
 	default:
 		return (LLError);
 	}
 
 	/*
-	 * For all of the Entries in the Directory
+	 * For all of the links in the list.
 	 */
 
-	Done = False;
 	while (!Done) {
 
 		/*
-		 * Get the current entry from the list.
-		 */
-
-		if ((LLError = LLGetCurrentLinkData(ListToSort,
-			    &CurrentLink,
-			    (void **) &LinkData))) {
-			return (LLError);
-		}
-
-		/*
-		 * Remove the link from the list to sort.
+		 * Get the current Link's data.
 		 */
 
-		if ((LLError = LLRemoveLink(ListToSort,
-			    CurrentLink))) {
-			return (LLError);
-		}
+		LLError = LLGetCurrentLinkData(List,
+		    &CurrentLink,
+		    (void **) &LLData);
 
 		/*
-		 * Now, let's insert the link into the sorted list.  The
-		 * first step is to set the sorted list to the first enrty.
+		 * Since I am removing links from the list and I started with
+		 * the head of the list, as I remove each link the current
+		 * pointer gets set to the next link in the list.  So all I
+		 * need to do is continue to get the current link until the
+		 * return code is LLListEmpty.
 		 */
 
-		LLError = LLUpdateCurrent(SortedList, LLHead);
 		switch (LLError) {
 		case LLSuccess:
 
 			/*
-			 * While the insertion point for the current link has
-			 * not been found
+			 * Remove the link from the list
 			 */
 
-			Found = False;
-			while (!Found) {
+			if ((LLError = LLRemoveLink(List, CurrentLink))) {
+				return (LLError);
+			}
 
-				/*
-				 * Get the current link from the sorted list.
-				 */
+			/*
+			 * Destroy the Link
+			 */
 
-				if ((LLError = LLGetCurrentLinkData(SortedList,
-					    &SortedLink,
-					    (void **) &SortedData))) {
-					return (LLError);
-				}
+			if ((LLError = LLDestroyLink(&CurrentLink,
+			    (void **)&LLData))) {
+				return (LLError);
+			}
 
-				/*
+			/*
+			 * Call the calling applications callback to clean up
+			 * the data pointer
+			 */
+
+			if (CleanUp(LLData) != LLSuccess) {
+				return (LLCallbackError);
+			}
+			break;
+		case LLListEmpty:
+			Done = True;
+			break;
+		default:
+			return (LLError);
+		}
+	}
+
+	/*
+	 * All links of a pooled list are back in the pool, so free it.
+	 */
+
+	if (((TLinkList *) List)->Pool.LinksInUse == 0)
+		LLFreeLinkPool(&((TLinkList *) List)->Pool);
+
+	return (LLSuccess);
+}
+
+/*
+ * *********************************************************************
+ * MODULE NAME: LLLinkListErrorString
+ * DESCRIPTION:
+ *  This function converts the enumerated error value passed back by
+ *  the Link List Functions into a NULL terminated string.
+ * RETURN:
+ *  TYPE           DESCRIPTION
+ *  char *         The ASCII string for the provided enumerated error.
+ *
+ * PARAMETERS:
+ *  TYPE           DESCRIPTION
+ *  TLLError       The error code of interest.
+ *
+ * CHANGE ACTIVITY:
+ *       Date   Developer Name    Description of Changes
+ *    05-Dec-94 Craig Vosburgh    Creation of Module
+ * *********************************************************************
+ */
+
+char *
+LLErrorString(TLLError Error)
+{
+
+	/*
+	 * Case on the enumerated Error value.
+	 */
+
+	switch (Error) {
+		case LLSuccess:
+		return ("Successful Completion");
+	case LLMemoryAllocationError:
+		return ("Unable to Allocate Necessary Memory");
+	case LLInvalidList:
+		return
+		    ("The List supplied was not initialized or is corrupted");
+	case LLInvalidLink:
+		return
+		    ("The Link supplied was not initialized or is corrupted");
+	case LLInvalidOperation:
+		return ("Invalid operation specified");
+	case LLLinkNotInUse:
+		return
+		    ("Supplied Link is currently not used in a Link List");
+	case LLLinkInUse:
+		return
+		    ("Supplied Link is currently used in a Link List");
+	case LLListInUse:
+		return
+		    ("Supplied List contains links.  Remove all links \
+before destroying");
+	case LLBeginningOfList:
+		return ("Beginning of Link List reached");
+	case LLEndOfList:
+		return ("Endof Link List reached");
+	case LLCallbackError:
+		return ("The supplied callback returned a non-zero");
+	case LLMemoryLeak:
+		return ("Memory leak");
+	default:
+		return ("Invalid Link List Error.");
+	}
+}
+
+/* --------------------------- test function ------------------------ */
+#ifdef MODULE_TEST
+
+#include <sys/time.h>
+
+/*
+ * Benchmark of LLSortList() against the former insertion sort
+ * implementation.  Build with "make common_linklist" and run
+ *
+ *	common_linklist [max_insertion_sort_links]
+ *
+ * The insertion sort is quadratic, so by default it is only run on
+ * lists of up to 100000 links.
+ */
+
+#define	BENCH_INSERTION_MAX	100000
+
+typedef struct {
+	int		Key;
+	int		Seq;
+} TBenchData;
+
+/*
+ * The former implementation of LLSortList(), inserting the links one
+ * by one into a temporary sorted list.
+ */
+
+static TLLError
+LLInsertionSortList(TList ListToSort,
+    TLLCompare(*Compare) (void *, TLLData, TLLData),
+    void *UserPtr)
+{
+	TList		SortedList;
+	TLink 		SortedLink;
+
+	TLLError	LLError;
+	TLLCompare	LLCompare;
+	TLink		CurrentLink;
+
+	TLLData		SortedData;
+	TLLData		LinkData;
+
+	TBoolean	Done;
+	TBoolean 	Found;
+
+	/*
+	 * Create a temporary list to do the alphabetic sorting
+	 */
+
+	if ((LLError = LLCreateList(&SortedList, NULL))) {
+		return (LLError);
+	}
+
+	/*
+	 * Set to the beginning of the list to sort
+	 */
+
+	LLError = LLUpdateCurrent(ListToSort, LLHead);
+	switch (LLError) {
+	case LLSuccess:
+		break;
+	case LLListEmpty:
+		return (LLSuccess);
+	default:
+		return (LLError);
+	}
+
+	/*
+	 * For all of the Entries in the Directory
+	 */
+
+	Done = False;
+	while (!Done) {
+
+		/*
+		 * Get the current entry from the list.
+		 */
+
+		if ((LLError = LLGetCurrentLinkData(ListToSort,
+			    &CurrentLink,
+			    (void **) &LinkData))) {
+			return (LLError);
+		}
+
+		/*
+		 * Remove the link from the list to sort.
+		 */
+
+		if ((LLError = LLRemoveLink(ListToSort,
+			    CurrentLink))) {
+			return (LLError);
+		}
+
+		/*
+		 * Now, let's insert the link into the sorted list.  The
+		 * first step is to set the sorted list to the first enrty.
+		 */
+
+		LLError = LLUpdateCurrent(SortedList, LLHead);
+		switch (LLError) {
+		case LLSuccess:
+
+			/*
+			 * While the insertion point for the current link has
+			 * not been found
+			 */
+
+			Found = False;
+			while (!Found) {
+
+				/*
+				 * Get the current link from the sorted list.
+				 */
+
+				if ((LLError = LLGetCurrentLinkData(SortedList,
+					    &SortedLink,
+					    (void **) &SortedData))) {
+					return (LLError);
+				}
+
+				/*
 				 * Call the callback to determine if the
 				 * insert point has been found.
 				 */
@@ -1474,180 +2005,162 @@ LLSortList(TList ListToSort,
 	return (LLSuccess);
 }
 
-/*
- * *********************************************************************
- * MODULE NAME: LLClearList
- * DESCRIPTION:
- *  This function allows the calling application to clear the contents
- *  of the link list.  The calling application must provide a callback
- *  that can be invoked to do any clean up prior to destroying a link
- *  within the list.
- * RETURN:
- *  TYPE           DESCRIPTION
- *  TLLError       This is the enumerated error
- *                 code defined in the public
- *                 header.  Upon success, LLSuccess
- *                 will be returned.  Upon error,
- *                 the appropriate error code will
- *                 returned.
- *
- * PARAMETERS:
- *  TYPE           DESCRIPTION
- *  TList          The list to remove all of the links from.
- *  <Callback>     The callback to call with the data pointer
- *                 for the link about to be removed and destroyed.
- *
- *  Change Activity:
- *       Date   Developer Name    Description of Changes
- *    15-May-96 Craig Vosburgh    Creation of Module
- * *********************************************************************
- */
-
-TLLError
-LLClearList(TList List,
-    TLLError(*CleanUp) (TLLData Data))
+static TLLCompare
+BenchCompare(void *UserPtr, TLLData A, TLLData B)
 {
+	int	KeyA = ((TBenchData *)A)->Key;
+	int	KeyB = ((TBenchData *)B)->Key;
 
-	TLink		CurrentLink;
-	TLLData 	LLData;
-	TLLError	LLError;
-	TBoolean	Done;
+	(*(long long *)UserPtr)++;
 
-	/*
-	 * Set up the current link to be the head of the list.
-	 */
+	if (KeyA < KeyB)
+		return (LLCompareLess);
+	if (KeyA > KeyB)
+		return (LLCompareGreater);
+	return (LLCompareEqual);
+}
 
-	LLError = LLUpdateCurrent(List, LLHead);
-	switch (LLError) {
-	case LLSuccess:
-		break;
-	case LLListEmpty:
-		return (LLSuccess);
-	default:
-		return (LLError);
-	}
+static TLLError
+BenchCleanUp(TLLData Data)
+{
+	return (LLSuccess);
+}
 
-	/*
-	 * For all of the links in the list.
-	 */
+/*
+ * Check that the list is sorted, consistently linked and, if requested,
+ * that links with equal keys kept their order.
+ */
 
-	Done = False;
-	while (!Done) {
+static int
+BenchCheck(TList List, int Count, TBoolean Stable)
+{
+	TLinkList	*LocalList = (TLinkList *) List;
+	TDoubleLink	*Link, *PrevLink = NULL;
+	TBenchData	*Data, *PrevData = NULL;
+	int		n = 0;
+
+	for (Link = LocalList->Head; Link != NULL; Link = Link->Next) {
+		Data = (TBenchData *)Link->Data;
+		if (Link->Prev != PrevLink)
+			return (-1);
+		if (PrevData != NULL && (PrevData->Key > Data->Key ||
+		    (Stable && PrevData->Key == Data->Key &&
+		    PrevData->Seq > Data->Seq)))
+			return (-1);
+		PrevData = Data;
+		PrevLink = Link;
+		n++;
+	}
 
-		/*
-		 * Get the current Link's data.
-		 */
+	if (n != Count || LocalList->NumberLinks != Count ||
+	    LocalList->Tail != PrevLink)
+		return (-1);
 
-		LLError = LLGetCurrentLinkData(List,
-		    &CurrentLink,
-		    (void **) &LLData);
+	return (0);
+}
 
-		/*
-		 * Since I am removing links from the list and I started with
-		 * the head of the list, as I remove each link the current
-		 * pointer gets set to the next link in the list.  So all I
-		 * need to do is continue to get the current link until the
-		 * return code is LLListEmpty.
-		 */
+/*
+ * Sort a list of Count links with the given function, returns the time
+ * spent sorting in milliseconds or -1 on failure.  Links of a pooled
+ * list are carved from its pool.
+ */
 
-		switch (LLError) {
-		case LLSuccess:
+static double
+BenchRun(TBenchData *Data, int Count,
+    TLLError (*Sort)(TList, TLLCompare (*)(void *, TLLData, TLLData),
+    void *), TBoolean Stable, TBoolean Pooled, long long *Compares)
+{
+	TList		List;
+	TLink		Link;
+	hrtime_t	Start, End;
+	int		i;
+	TLLError	LLError;
 
-			/*
-			 * Remove the link from the list
-			 */
+	if ((Pooled ? LLCreatePooledList(&List, NULL, 0) :
+	    LLCreateList(&List, NULL)) != LLSuccess)
+		return (-1);
 
-			if ((LLError = LLRemoveLink(List, CurrentLink))) {
-				return (LLError);
-			}
+	for (i = 0; i < Count; i++) {
+		if (LLCreatePooledLink(List, &Link, &Data[i]) != LLSuccess ||
+		    LLAddLink(List, Link, LLTail) != LLSuccess)
+			return (-1);
+	}
 
-			/*
-			 * Destroy the Link
-			 */
+	*Compares = 0;
+	Start = gethrtime();
+	LLError = Sort(List, BenchCompare, Compares);
+	End = gethrtime();
 
-			if ((LLError = LLDestroyLink(&CurrentLink,
-			    (void **)&LLData))) {
-				return (LLError);
-			}
+	if (LLError != LLSuccess || BenchCheck(List, Count, Stable) != 0)
+		return (-1);
 
-			/*
-			 * Call the calling applications callback to clean up
-			 * the data pointer
-			 */
+	if (LLClearList(List, BenchCleanUp) != LLSuccess ||
+	    LLDestroyList(&List, NULL) != LLSuccess)
+		return (-1);
 
-			if (CleanUp(LLData) != LLSuccess) {
-				return (LLCallbackError);
-			}
-			break;
-		case LLListEmpty:
-			return (LLSuccess);
-		default:
-			return (LLError);
-		}
-	}
-	return (LLSuccess);
+	return ((double)(End - Start) / 1000000.0);
 }
 
-/*
- * *********************************************************************
- * MODULE NAME: LLLinkListErrorString
- * DESCRIPTION:
- *  This function converts the enumerated error value passed back by
- *  the Link List Functions into a NULL terminated string.
- * RETURN:
- *  TYPE           DESCRIPTION
- *  char *         The ASCII string for the provided enumerated error.
- *
- * PARAMETERS:
- *  TYPE           DESCRIPTION
- *  TLLError       The error code of interest.
- *
- * CHANGE ACTIVITY:
- *       Date   Developer Name    Description of Changes
- *    05-Dec-94 Craig Vosburgh    Creation of Module
- * *********************************************************************
- */
-
-char *
-LLErrorString(TLLError Error)
+int
+main(int argc, char **argv)
 {
+	static int	Sizes[] = { 10000, 100000, 1000000 };
+	TBenchData	*Data;
+	long long	Compares;
+	double		Msec;
+	int		Max = BENCH_INSERTION_MAX;
+	int		i, n;
+
+	if (argc > 1)
+		Max = atoi(argv[1]);
+
+	for (i = 0; i < sizeof (Sizes) / sizeof (Sizes[0]); i++) {
+		if ((Data = malloc(Sizes[i] * sizeof (TBenchData))) == NULL)
+			exit(1);
+
+		/* plenty of equal keys to check the sort is stable */
+
+		srand(1);
+		for (n = 0; n < Sizes[i]; n++) {
+			Data[n].Key = rand() % (Sizes[i] / 4);
+			Data[n].Seq = n;
+		}
 
-	/*
-	 * Case on the enumerated Error value.
-	 */
+		if ((Msec = BenchRun(Data, Sizes[i], LLSortList, True,
+		    False, &Compares)) < 0) {
+			(void) fprintf(stderr, "%d links: merge sort failed\n",
+			    Sizes[i]);
+			exit(1);
+		}
+		(void) printf("%8d links: merge sort     %10.1f ms "
+		    "%12lld compares\n", Sizes[i], Msec, Compares);
+
+		if ((Msec = BenchRun(Data, Sizes[i], LLSortList, True,
+		    True, &Compares)) < 0) {
+			(void) fprintf(stderr, "%d links: pooled merge sort "
+			    "failed\n", Sizes[i]);
+			exit(1);
+		}
+		(void) printf("%8d links: pooled list    %10.1f ms "
+		    "%12lld compares\n", Sizes[i], Msec, Compares);
+
+		if (Sizes[i] <= Max) {
+			/* insertion sort reverses order of equal links */
+			if ((Msec = BenchRun(Data, Sizes[i],
+			    LLInsertionSortList, False, False,
+			    &Compares)) < 0) {
+				(void) fprintf(stderr,
+				    "%d links: insertion sort failed\n",
+				    Sizes[i]);
+				exit(1);
+			}
+			(void) printf("%8d links: insertion sort %10.1f ms "
+			    "%12lld compares\n", Sizes[i], Msec, Compares);
+		}
 
-	switch (Error) {
-		case LLSuccess:
-		return ("Successful Completion");
-	case LLMemoryAllocationError:
-		return ("Unable to Allocate Necessary Memory");
-	case LLInvalidList:
-		return
-		    ("The List supplied was not initialized or is corrupted");
-	case LLInvalidLink:
-		return
-		    ("The Link supplied was not initialized or is corrupted");
-	case LLInvalidOperation:
-		return ("Invalid operation specified");
-	case LLLinkNotInUse:
-		return
-		    ("Supplied Link is currently not used in a Link List");
-	case LLLinkInUse:
-		return
-		    ("Supplied Link is currently used in a Link List");
-	case LLListInUse:
-		return
-		    ("Supplied List contains links.  Remove all links \
-before destroying");
-	case LLBeginningOfList:
-		return ("Beginning of Link List reached");
-	case LLEndOfList:
-		return ("Endof Link List reached");
-	case LLCallbackError:
-		return ("The supplied callback returned a non-zero");
-	case LLMemoryLeak:
-		return ("Memory leak");
-	default:
-		return ("Invalid Link List Error.");
+		free(Data);
 	}
+
+	return (0);
 }
+#endif /* MODULE_TEST */
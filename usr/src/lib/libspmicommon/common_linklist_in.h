@@ -46,14 +46,51 @@ typedef unsigned long TLLInitialized;
  * *********************************************************************
  */
 
+/*
+ * Number of links carved from a chunk of a pooled list if the creator
+ * of the list doesn't specify it.
+ */
+
+#define	LLPOOL_DEFAULT_LINKS	128
+
+struct TLinkPoolTag;
+
 typedef struct TDoubleLinkTag {
 	TLLInitialized 		Initialized;
 	TList			OwningList;
 	struct TDoubleLinkTag 	*Prev;
 	struct TDoubleLinkTag 	*Next;
 	TLLData			Data;
+	struct TLinkPoolTag	*Pool;	/* NULL if allocated on its own */
 } TDoubleLink;
 
+/*
+ * *********************************************************************
+ * Define the structure for a chunk of links of a pooled list
+ * *********************************************************************
+ */
+
+typedef struct TLinkChunkTag {
+	struct TLinkChunkTag	*Next;
+	TDoubleLink		Links[1];	/* LinksPerChunk links */
+} TLinkChunk;
+
+/*
+ * *********************************************************************
+ * Define the structure for the pool links of a pooled list are carved
+ * from.  Destroyed links are kept on the free list for reuse, the
+ * chunks are freed together with the list.
+ * *********************************************************************
+ */
+
+typedef struct TLinkPoolTag {
+	int		LinksPerChunk;	/* 0 if the list is not pooled */
+	int		LinksInUse;	/* links created and not destroyed */
+	int		LinksLeft;	/* links not carved from Chunks yet */
+	TLinkChunk	*Chunks;	/* most recently allocated first */
+	TDoubleLink	*FreeLinks;	/* chained through Next */
+} TLinkPool;
+
 /*
  * *********************************************************************
  * Define the structure for the link list.
@@ -67,6 +104,7 @@ typedef struct {
 	TDoubleLink	*Head;
 	TDoubleLink	*Tail;
 	TDoubleLink	*Current;
+	TLinkPool	Pool;
 } TLinkList;
 
 #endif	/* _LINKLIST_IN_H */
@@ -26,6 +26,7 @@
 
 
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -36,6 +37,8 @@
 MFILE *		mopen(char *, int);
 void 		mclose(MFILE *);
 char *		mgets(char *, int, MFILE *);
+char *		mgetline(MFILE *, size_t *);
+void		mrewind(MFILE *);
 
 /* ---------------------- public prototypes -------------------------- */
 
@@ -46,7 +49,8 @@ char *		mgets(char *, int, MFILE *);
  *		as it uses madvise(MADV_WILLNEED) to get the kernel to read
  *		in the whole file so we don't have to wait for it. MFILE
  *		structures are dynamically allocated and are destroyed
- *		on close.
+ *		on close. Files of any size which fits in the address space
+ *		can be mapped, nothing is mapped for an empty file.
  * Scope:	public
  * Parameters:	name		[RO, *RO]
  *				Path name of file to be mmapped in.
@@ -59,35 +63,44 @@ char *		mgets(char *, int, MFILE *);
 MFILE *
 mopen(char *name, int read_all)
 {
-	struct stat	sbuf;
+	struct stat64	sbuf;
 	MFILE *		mp;
-	caddr_t		addr;
+	caddr_t		addr = NULL;
 	int		fd;
 
 	/* validate parameter */
 	if (name == NULL)
 		return (NULL);
 
-	if ((fd = open(name, O_RDONLY)) < 0 || stat(name, &sbuf) < 0)
+	if ((fd = open(name, O_RDONLY | O_LARGEFILE)) < 0)
 		return (NULL);
 
-	if ((addr = mmap((caddr_t)0, sbuf.st_size, PROT_READ,
-				MAP_PRIVATE, fd, (off_t)0)) == MAP_FAILED) {
+	/* the whole file has to fit in the address space */
+	if (fstat64(fd, &sbuf) < 0 || (u_longlong_t)sbuf.st_size > SIZE_MAX) {
+		(void) close(fd);
+		return (NULL);
+	}
+
+	if (sbuf.st_size > 0 && (addr = mmap((caddr_t)0,
+	    (size_t)sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, (off_t)0)) ==
+	    MAP_FAILED) {
 		(void)close(fd);
 		return (NULL);
 	}
 
 	(void) close(fd);
 
-	if (read_all) {
-		(void) madvise(addr, sbuf.st_size, MADV_WILLNEED);
+	if (read_all && addr != NULL) {
+		(void) madvise(addr, (size_t)sbuf.st_size, MADV_WILLNEED);
 	}
 
 	if ((mp = (MFILE *)calloc((size_t)1,
 			(size_t)sizeof (MFILE))) != NULL) {
 		mp->m_base = addr;
 		mp->m_ptr = addr;
-		mp->m_size = sbuf.st_size;
+		mp->m_size = (size_t)sbuf.st_size;
+	} else if (addr != NULL) {
+		(void) munmap(addr, (size_t)sbuf.st_size);
 	}
 
 	return (mp);
@@ -106,7 +119,8 @@ void
 mclose(MFILE *mp)
 {
 	if (mp != NULL) {
-		(void) munmap(mp->m_base, mp->m_size);
+		if (mp->m_base != NULL)
+			(void) munmap(mp->m_base, mp->m_size);
 		free(mp);
 	}
 }
@@ -114,7 +128,9 @@ mclose(MFILE *mp)
 /*
  * Function:	mgets
  * Description: Search mmapped data area up to the next '\n'. Advance the
- *		m_ptr passed the next '\n', and return the line.
+ *		m_ptr passed the next '\n', and return the line. Lines
+ *		longer than the buffer are returned in pieces; mgetline()
+ *		avoids the copy and the limit.
  * Scope:	public
  * Parameters:	buf	- [RO, *RO]
  *			  Buffer used to retrieve the next line.
@@ -162,3 +178,66 @@ mgets(char *buf, int len, MFILE *mp)
 	mp->m_ptr = src;
 	return (dest);
 }
+
+/*
+ * Function:	mgetline
+ * Description: Return the next line of an mopen'ed file without copying
+ *		it. The line is returned as a pointer into the mapped file
+ *		along with its length, which doesn't include the terminating
+ *		'\n'. The line is not NULL terminated and is valid until the
+ *		file is mclose'd. Lines may be of any length, the last line
+ *		needn't be terminated by '\n'. Advance the m_ptr passed the
+ *		returned line.
+ * Scope:	public
+ * Parameters:	mp	- [RO, *RW]
+ *			  Pointer to an opened mmaped file MFILE structure.
+ *		len	- [WO]
+ *			  Length of the returned line.
+ * Return:	NULL	- EOF
+ *		!NULL	- pointer to the first character of the line
+ */
+char *
+mgetline(MFILE *mp, size_t *len)
+{
+	caddr_t	line;
+	caddr_t	end;
+	caddr_t	nl;
+
+	/* validate parameters */
+	if (len == NULL || mp == NULL ||
+			mp->m_base == NULL || mp->m_ptr == NULL)
+		return (NULL);
+
+	line = mp->m_ptr;
+	end = mp->m_base + mp->m_size;
+
+	if (line >= end)
+		return (NULL);
+
+	/* memchr() scans a word at a time rather than byte by byte */
+	if ((nl = memchr(line, '\n', end - line)) == NULL) {
+		*len = end - line;
+		mp->m_ptr = end;
+	} else {
+		*len = nl - line;
+		mp->m_ptr = nl + 1;
+	}
+
+	return ((char *)line);
+}
+
+/*
+ * Function:	mrewind
+ * Description: Reset an mopen'ed file so that the next mgets() or
+ *		mgetline() call starts with the first line again.
+ * Scope:	public
+ * Parameters:	mp	- [RO, *RW]
+ *			  Pointer to an opened mmaped file MFILE structure.
+ * Return:	none
+ */
+void
+mrewind(MFILE *mp)
+{
+	if (mp != NULL)
+		mp->m_ptr = mp->m_base;
+}
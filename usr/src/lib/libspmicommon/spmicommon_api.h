@@ -652,6 +652,8 @@ void		trim_whitespace(char *);
 
 /* common_mmap.c */
 char		*mgets(char *, int, MFILE *);
+char		*mgetline(MFILE *, size_t *);
+void		mrewind(MFILE *);
 void		mclose(MFILE *);
 MFILE		*mopen(char *, int);
 
@@ -696,7 +698,9 @@ char		*get_prom_revision(void);
  */
 
 TLLError LLCreateList(TList *List, TLLData Data);
+TLLError LLCreatePooledList(TList *List, TLLData Data, int LinksPerChunk);
 TLLError LLCreateLink(TLink *Link, TLLData Data);
+TLLError LLCreatePooledLink(TList List, TLink *Link, TLLData Data);
 TLLError LLAddLink(TList List, TLink Link, TLLOperation Operation);
 TLLError LLRemoveLink(TList List, TLink Link);
 TLLError LLDestroyLink(TLink *Link, TLLData *Data);
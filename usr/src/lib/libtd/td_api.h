@@ -69,6 +69,13 @@ typedef enum {
 
 #define	TD_IOCTL_TIMEOUT 10 /* seconds to timeout blocking ioctls */
 
+/*
+ * number of threads used to discover object attributes in parallel
+ * see td_discover_attributes()
+ */
+#define	TD_DISCOVERY_DEF_THREADS	8
+#define	TD_DISCOVERY_MAX_THREADS	32
+
 /* nv attribute names for disk */
 
 #define	TD_DISK_ATTR_NAME	"ddm_disk_name"
@@ -264,6 +271,7 @@ typedef enum {
 /* function prototypes */
 
 td_errno_t td_discover(td_object_type_t, int *);
+td_errno_t td_discover_attributes(td_object_type_t, int);
 
 td_errno_t td_target_search(nvlist_t *);
 
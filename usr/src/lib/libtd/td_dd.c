@@ -34,8 +34,10 @@
 
 #include <unistd.h>
 #include <stropts.h>
+#include <pthread.h>
 
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include <sys/dkio.h>
 #include <sys/dktp/fdisk.h>
@@ -66,6 +68,14 @@
 
 #define	DDM_INSTALL_MEDIA_MOUNTPOINT	"/.cdrom"
 
+#define	DDM_SESSION_NBUCKETS	64		/* session hash table size */
+
+/* which lookups were done for a descriptor cached in discovery session */
+#define	DDM_DI_NAME		0x1	/* drive DM_ALIAS name */
+#define	DDM_DI_MEDIA		0x2	/* DM_MEDIA associated with drive */
+#define	DDM_DI_CONTROLLER	0x4	/* DM_CONTROLLER assoc. with drive */
+#define	DDM_DI_CTYPE		0x8	/* controller type */
+
 typedef struct ddm_conv_attr_t {
 	char	*nv_name_src;
 	char	*nv_name_dst;
@@ -142,12 +152,48 @@ static char *ddm_slice_inuse_conv_tbl[][2] = {
  */
 static dm_descriptor_t	*ddm_drive_desc = NULL;
 
+/*
+ * Data looked up from libdiskmgt for a drive or controller descriptor.
+ * Descriptor arrays are kept until the session is released, so that
+ * the descriptors can't be reused for other devices in the meantime.
+ */
+typedef struct ddm_desc_info {
+	dm_descriptor_t		di_desc;	/* drive or controller */
+	int			di_flags;	/* DDM_DI_* lookups done */
+	char			*di_name;	/* drive name */
+	dm_descriptor_t		*di_media;	/* drive media */
+	dm_descriptor_t		*di_controller;	/* drive controller */
+	char			*di_ctype;	/* controller type */
+	struct ddm_desc_info	*di_next;	/* next in hash chain */
+} ddm_desc_info_t;
+
+/*
+ * Discovery session - information which doesn't change while targets are
+ * being discovered is looked up only once, and then shared by the disk,
+ * partition and slice discovery, which may run in several threads.
+ * The session starts with ddm_get_disks() and ends with
+ * ddm_session_release() called from td_discovery_release().
+ */
+static struct {
+	pthread_mutex_t		ds_lock;	/* protects the session */
+	hrtime_t		ds_start;	/* when session started */
+	boolean_t		ds_bootdisk_done; /* boot disk looked up */
+	char			*ds_bootdisk;	/* current boot disk */
+	int			ds_hits;	/* lookups served from cache */
+	int			ds_misses;	/* lookups done in libdiskmgt */
+	ddm_desc_info_t		*ds_info[DDM_SESSION_NBUCKETS];
+} ddm_session = { PTHREAD_MUTEX_INITIALIZER };
+
 
 /* ------------------------ local functions declarations -------------- */
 
 static char *
 ddm_get_device_path_from_ctd_name(char *ctd_name, char strip_symbol,
 	boolean_t strip_devices);
+static char *ddm_drive_get_name(ddm_handle_t d);
+static dm_descriptor_t ddm_drive_get_media(ddm_handle_t d, int *errn);
+static char *ddm_controller_get_ctype(ddm_handle_t d, int *errn);
+static char *ddm_session_bootdisk(void);
 
 /* ------------------------ local functions --------------------------- */
 
@@ -821,50 +867,16 @@ ddm_is_linux_swap(char *part_name)
 static int
 ddm_drive_set_ctype(ddm_handle_t d, nvlist_t *attr)
 {
-	dm_descriptor_t	*ad;
 	int		errn;
-	nvlist_t	*nv_tmp;
 	char		*ctype;
-	int		ctype_recognized = B_FALSE;
-
-	ad = dm_get_associated_descriptors((dm_descriptor_t)d, DM_CONTROLLER,
-	    &errn);
-
-	if ((errn != 0) || (ad == NULL) || (ad[0] == 0)) {
-		DDM_DEBUG(DDM_DBGLVL_ERROR, "ddm_drive_get_ctype():"
-		    "Can't get DM_CONTROLLER assoc. w/ DM_DRIVE, err=%d\n",
-		    errn);
 
-		/* free unused descriptors */
-
-		if ((errn == 0) && (ad != NULL))
-			dm_free_descriptors(ad);
-	} else {
-		/* get attributes for controller */
-		nv_tmp = dm_get_attributes(ad[0], &errn);
-
-		dm_free_descriptors(ad);
-
-		if ((errn == 0) &&
-		    (nvlist_lookup_string(nv_tmp, DM_CTYPE, &ctype) == 0)) {
-
-			nvlist_add_string(attr, TD_DISK_ATTR_CTYPE, ctype);
-
-			nvlist_free(nv_tmp);
-
-			ctype_recognized = B_TRUE;
-		} else {
-			DDM_DEBUG(DDM_DBGLVL_ERROR, "ddm_drive_get_ctype():"
-			    "Can't get attr. for DM_CONTROLLER, err=%d\n",
-			    errn);
-		}
-	}
+	/* controller type is cached by discovery session */
+	ctype = ddm_controller_get_ctype(d, &errn);
 
-	/* if drive type not recognized so far, set it to "unknown" */
+	/* if drive type not recognized, set it to "unknown" */
 
-	if (!ctype_recognized) {
-		nvlist_add_string(attr, TD_DISK_ATTR_CTYPE, "unknown");
-	}
+	nvlist_add_string(attr, TD_DISK_ATTR_CTYPE,
+	    ctype != NULL ? ctype : "unknown");
 
 	return (errn);
 }
@@ -939,18 +951,18 @@ ddm_drive_set_btype(ddm_handle_t d, nvlist_t *attr)
 }
 
 /*
- * ddm_drive_get_name()
+ * ddm_drive_lookup_name()
  *	Gets name of the drive from handle
  *
  * Parameters:
  *	ddm_handle_t d
  * Return:
- *	char *
+ *	char *	- name to be freed by dm_free_name()
  * Status:
- *	public
+ *	private
  */
 static char *
-ddm_drive_get_name(ddm_handle_t d)
+ddm_drive_lookup_name(ddm_handle_t d)
 {
 	dm_descriptor_t	*ad;
 	char		*name;
@@ -959,7 +971,7 @@ ddm_drive_get_name(ddm_handle_t d)
 	ad = dm_get_associated_descriptors((dm_descriptor_t)d, DM_ALIAS, &errn);
 
 	if ((ad == NULL) || (errn != 0)) {
-		DDM_DEBUG(DDM_DBGLVL_INFO, "ddm_drive_get_name(): "
+		DDM_DEBUG(DDM_DBGLVL_INFO, "ddm_drive_lookup_name(): "
 		    "Can't get DM_ALIAS assoc. w/ DM_DRIVE, err=%d\n",
 		    errn);
 
@@ -973,7 +985,7 @@ ddm_drive_get_name(ddm_handle_t d)
 
 	if (errn != 0) {
 		DDM_DEBUG(DDM_DBGLVL_INFO,
-		    "ddm_drive_get_name(): Can't get alias name, err=%d\n",
+		    "ddm_drive_lookup_name(): Can't get alias name, err=%d\n",
 		    errn);
 
 		return (NULL);
@@ -982,6 +994,330 @@ ddm_drive_get_name(ddm_handle_t d)
 	return (name);
 }
 
+/*
+ * ddm_session_find()
+ *	Finds discovery session entry for drive or controller descriptor
+ *	and creates it if it doesn't exist yet. Must be called with
+ *	session lock held.
+ *
+ * Parameters:
+ *	dm_descriptor_t d
+ * Return:
+ *	ddm_desc_info_t *	- session entry
+ *	NULL			- out of memory
+ * Status:
+ *	private
+ */
+static ddm_desc_info_t *
+ddm_session_find(dm_descriptor_t d)
+{
+	ddm_desc_info_t	**bucket, *di;
+
+	bucket = &ddm_session.ds_info[d % DDM_SESSION_NBUCKETS];
+
+	for (di = *bucket; di != NULL; di = di->di_next) {
+		if (di->di_desc == d)
+			return (di);
+	}
+
+	di = calloc(1, sizeof (ddm_desc_info_t));
+
+	if (di == NULL) {
+		DDM_DEBUG(DDM_DBGLVL_ERROR, "%s",
+		    "ddm_session_find(): calloc() OOM\n");
+
+		return (NULL);
+	}
+
+	di->di_desc = d;
+	di->di_next = *bucket;
+	*bucket = di;
+	return (di);
+}
+
+/*
+ * ddm_session_cached()
+ *	Checks if given lookup was already done for descriptor in discovery
+ *	session.
+ *
+ * Parameters:
+ *	dm_descriptor_t d
+ *	int flag	- DDM_DI_* lookup
+ * Return:
+ *	ddm_desc_info_t *	- session entry, if lookup was done
+ *	NULL			- lookup not done yet
+ * Status:
+ *	private
+ */
+static ddm_desc_info_t *
+ddm_session_cached(dm_descriptor_t d, int flag)
+{
+	ddm_desc_info_t	*di;
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	di = ddm_session_find(d);
+
+	if ((di != NULL) && (di->di_flags & flag)) {
+		ddm_session.ds_hits++;
+	} else {
+		ddm_session.ds_misses++;
+		di = NULL;
+	}
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+	return (di);
+}
+
+/*
+ * ddm_drive_get_name()
+ *	Gets name of the drive from handle. The name is looked up once
+ *	per discovery session.
+ *
+ * Parameters:
+ *	ddm_handle_t d
+ * Return:
+ *	char *	- name owned by discovery session, must not be freed
+ * Status:
+ *	private
+ */
+static char *
+ddm_drive_get_name(ddm_handle_t d)
+{
+	ddm_desc_info_t	*di;
+	char		*name;
+
+	if ((di = ddm_session_cached(d, DDM_DI_NAME)) != NULL)
+		return (di->di_name);
+
+	/*
+	 * Look the name up without holding the lock, so that threads
+	 * discovering other drives are not blocked. If another thread
+	 * was faster, use its result.
+	 */
+
+	name = ddm_drive_lookup_name(d);
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	di = ddm_session_find(d);
+
+	if (di == NULL) {
+		/* can't cache it - it is lost, as it can't be freed later */
+		if (name != NULL)
+			dm_free_name(name);
+
+		name = NULL;
+	} else if (di->di_flags & DDM_DI_NAME) {
+		if (name != NULL)
+			dm_free_name(name);
+
+		name = di->di_name;
+	} else {
+		di->di_name = name;
+		di->di_flags |= DDM_DI_NAME;
+	}
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+	return (name);
+}
+
+/*
+ * ddm_drive_get_media()
+ *	Gets DM_MEDIA descriptor associated with drive. Since there
+ *	is 1:1 relationship between drive and media, only the first
+ *	descriptor is returned. It is looked up once per discovery session.
+ *
+ * Parameters:
+ *	ddm_handle_t d
+ *	int *errn	- set to libdiskmgt error
+ * Return:
+ *	dm_descriptor_t	- media descriptor owned by discovery session
+ *	0		- no media associated with drive
+ * Status:
+ *	private
+ */
+static dm_descriptor_t
+ddm_drive_get_media(ddm_handle_t d, int *errn)
+{
+	ddm_desc_info_t	*di;
+	dm_descriptor_t	*am;
+
+	*errn = 0;
+
+	if ((di = ddm_session_cached(d, DDM_DI_MEDIA)) == NULL) {
+		am = dm_get_associated_descriptors(d, DM_MEDIA, errn);
+
+		if (*errn != 0)
+			return (0);
+
+		(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+		di = ddm_session_find(d);
+
+		if ((di == NULL) || (di->di_flags & DDM_DI_MEDIA)) {
+			if (am != NULL)
+				dm_free_descriptors(am);
+		} else {
+			di->di_media = am;
+			di->di_flags |= DDM_DI_MEDIA;
+		}
+
+		(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+
+		if (di == NULL)
+			return (0);
+	}
+
+	return (di->di_media != NULL ? di->di_media[0] : 0);
+}
+
+/*
+ * ddm_controller_get_ctype()
+ *	Gets type of controller the drive is attached to. Controller
+ *	associated with drive and its type are looked up once per discovery
+ *	session, the latter being shared by all drives on the controller.
+ *
+ * Parameters:
+ *	ddm_handle_t d
+ *	int *errn	- set to libdiskmgt error
+ * Return:
+ *	char *	- controller type owned by discovery session
+ *	NULL	- controller type not known
+ * Status:
+ *	private
+ */
+static char *
+ddm_controller_get_ctype(ddm_handle_t d, int *errn)
+{
+	ddm_desc_info_t	*di;
+	dm_descriptor_t	*ac;
+	dm_descriptor_t	c;
+	nvlist_t	*nv_tmp;
+	char		*ctype;
+
+	*errn = 0;
+
+	/* find controller for drive */
+
+	if ((di = ddm_session_cached(d, DDM_DI_CONTROLLER)) == NULL) {
+		ac = dm_get_associated_descriptors((dm_descriptor_t)d,
+		    DM_CONTROLLER, errn);
+
+		if ((*errn != 0) || (ac == NULL) || (ac[0] == 0)) {
+			DDM_DEBUG(DDM_DBGLVL_ERROR, "ddm_drive_get_ctype():"
+			    "Can't get DM_CONTROLLER assoc. w/ DM_DRIVE, "
+			    "err=%d\n", *errn);
+
+			/* free unused descriptors */
+
+			if ((*errn == 0) && (ac != NULL))
+				dm_free_descriptors(ac);
+
+			return (NULL);
+		}
+
+		(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+		di = ddm_session_find(d);
+
+		if ((di == NULL) || (di->di_flags & DDM_DI_CONTROLLER)) {
+			dm_free_descriptors(ac);
+		} else {
+			di->di_controller = ac;
+			di->di_flags |= DDM_DI_CONTROLLER;
+		}
+
+		(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+
+		if (di == NULL)
+			return (NULL);
+	}
+
+	c = di->di_controller[0];
+
+	/* get controller type */
+
+	if ((di = ddm_session_cached(c, DDM_DI_CTYPE)) != NULL)
+		return (di->di_ctype);
+
+	ctype = NULL;
+	nv_tmp = dm_get_attributes(c, errn);
+
+	if (*errn == 0) {
+		if (nvlist_lookup_string(nv_tmp, DM_CTYPE, &ctype) == 0)
+			ctype = strdup(ctype);
+		else
+			ctype = NULL;
+
+		nvlist_free(nv_tmp);
+	}
+
+	if (ctype == NULL) {
+		DDM_DEBUG(DDM_DBGLVL_ERROR, "ddm_drive_get_ctype():"
+		    "Can't get attr. for DM_CONTROLLER, err=%d\n",
+		    *errn);
+
+		/* don't cache failures, as they are not expected */
+
+		return (NULL);
+	}
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	di = ddm_session_find(c);
+
+	if ((di == NULL) || (di->di_flags & DDM_DI_CTYPE)) {
+		free(ctype);
+		ctype = (di != NULL) ? di->di_ctype : NULL;
+	} else {
+		di->di_ctype = ctype;
+		di->di_flags |= DDM_DI_CTYPE;
+	}
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+	return (ctype);
+}
+
+/*
+ * ddm_session_bootdisk()
+ *	Gets current boot disk name. It is looked up once per discovery
+ *	session.
+ *
+ * Parameters:
+ *	none
+ * Return:
+ *	char *	- boot disk name owned by discovery session
+ *	NULL	- boot disk not known
+ * Status:
+ *	private
+ */
+static char *
+ddm_session_bootdisk(void)
+{
+	char	*bootdisk;
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	if (!ddm_session.ds_bootdisk_done) {
+		ddm_session.ds_bootdisk = ddm_get_curr_bootdisk();
+		ddm_session.ds_bootdisk_done = B_TRUE;
+
+		if (ddm_session.ds_bootdisk != NULL) {
+			DDM_DEBUG(DDM_DBGLVL_NOTICE, "ddm_session_bootdisk():"
+			    "Current bootdisk: %s\n", ddm_session.ds_bootdisk);
+		} else {
+			DDM_DEBUG(DDM_DBGLVL_WARNING, "ddm_session_bootdisk():"
+			    "Can't get current bootdisk\n");
+		}
+	}
+
+	bootdisk = ddm_session.ds_bootdisk;
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+	return (bootdisk);
+}
+
 /*
  * ddm_drive_is_cdrom()
  *	Checks if drive is CD/DVD by means of DKIOCINFO ioctl
@@ -1020,7 +1356,6 @@ ddm_drive_is_cdrom(ddm_handle_t d)
 		DDM_DEBUG(DDM_DBGLVL_ERROR, "%s",
 		    "ddm_drive_is_cdrom(): malloc() OOM\n");
 
-		dm_free_name(dn);
 		return (0);
 	}
 
@@ -1032,7 +1367,6 @@ ddm_drive_is_cdrom(ddm_handle_t d)
 		    dn_cdt);
 
 		free(dn_cdt);
-		dm_free_name(dn);
 		return (0);
 	}
 
@@ -1045,7 +1379,6 @@ ddm_drive_is_cdrom(ddm_handle_t d)
 		(void) close(fd);
 
 		free(dn_cdt);
-		dm_free_name(dn);
 		return (0);
 	} else {
 		DDM_DEBUG(DDM_DBGLVL_NOTICE, "Controller name: %s\n",
@@ -1059,7 +1392,6 @@ ddm_drive_is_cdrom(ddm_handle_t d)
 
 	(void) close(fd);
 	free(dn_cdt);
-	dm_free_name(dn);
 
 	/* test if it is CDROM */
 
@@ -1111,7 +1443,6 @@ ddm_drive_is_floppy(ddm_handle_t d)
 	else
 		drive_is_diskette = 0;
 
-	dm_free_name(dn);
 	return (drive_is_diskette);
 }
 
@@ -1152,7 +1483,6 @@ ddm_drive_is_install_media(ddm_handle_t d)
 		== NULL) {
 		DDM_DEBUG(DDM_DBGLVL_INFO, "Could not obtain physical device "
 			"path for disk %s\n", dn);
-		dm_free_name(dn);
 		return (B_TRUE);
 	}
 	DDM_DEBUG(DDM_DBGLVL_INFO, "Physical device path for disk %s: "
@@ -1165,7 +1495,6 @@ ddm_drive_is_install_media(ddm_handle_t d)
 	if (mnttab == NULL) {
 		DDM_DEBUG(DDM_DBGLVL_ERROR,
 			"Couldn't open mnttab. Something is terribly wrong. ");
-		dm_free_name(dn);
 		free(device_path);
 		return (B_TRUE);
 	}
@@ -1180,7 +1509,6 @@ ddm_drive_is_install_media(ddm_handle_t d)
 	}
 
 	fclose(mnttab);
-	dm_free_name(dn);
 	free(device_path);
 
 	return (drive_is_install_media);
@@ -1496,6 +1824,15 @@ ddm_get_disks(void)
 
 	assert(ddm_drive_desc == NULL);
 
+	/* disk discovery starts the discovery session */
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	if (ddm_session.ds_start == 0)
+		ddm_session.ds_start = gethrtime();
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+
 	ddm_drive_desc = dm_get_descriptors(DM_DRIVE, NULL, &errn);
 
 	if (ddm_drive_desc == NULL) {
@@ -1527,25 +1864,17 @@ ddm_get_disks(void)
 nvlist_t *
 ddm_get_disk_attributes(ddm_handle_t disk)
 {
-	dm_descriptor_t	*ad;
 	nvlist_t	*nv_src, *nv_dst, *nv_tmp;
 	int		errn;
 	char		*dn, *devid, *device_path;
 	char		*id;
 	uint32_t	disk_label;
 	char		*curr_bootdisk;
+	dm_descriptor_t	media;
 
 	/* ask for current boot disk name */
 
-	curr_bootdisk = ddm_get_curr_bootdisk();
-
-	if (curr_bootdisk != NULL) {
-		DDM_DEBUG(DDM_DBGLVL_NOTICE, "ddm_get_disk_attributes():"
-		    "Current bootdisk: %s\n", curr_bootdisk);
-	} else {
-		DDM_DEBUG(DDM_DBGLVL_WARNING,
-		    "ddm_get_disk_attributes():Can't get current bootdisk\n");
-	}
+	curr_bootdisk = ddm_session_bootdisk();
 
 	/*
 	 * Since DM_DRIVE contains only limited set of information,it is
@@ -1555,7 +1884,7 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 	 * (ata, usb, scsi, ...).
 	 */
 
-	ad = dm_get_associated_descriptors(disk, DM_MEDIA, &errn);
+	media = ddm_drive_get_media(disk, &errn);
 
 	/*
 	 * If there is no associated DM_MEDIA descriptor it might be due
@@ -1564,19 +1893,11 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 	 * information about the drive.
 	 */
 
-	if ((errn != 0) || (ad == NULL) || (ad[0] == 0)) {
+	if ((errn != 0) || (media == 0)) {
 		DDM_DEBUG(DDM_DBGLVL_WARNING, "ddm_get_disk_attributes():"
 		    "Can't get DM_MEDIA assoc. w/ DM_DRIVE, err=%d\n",
 		    errn);
 
-		/*
-		 * free media descriptors, if they were alocated, because
-		 * they are not to be used
-		 */
-
-		if ((errn == 0) && (ad != NULL))
-			dm_free_descriptors(ad);
-
 		/*
 		 * get nvlist attributes from libdiskmgt and convert to libtd
 		 * namespace. Keep original nvlist for later processing.
@@ -1622,12 +1943,8 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 		    (strcmp(curr_bootdisk, dn) == 0)) {
 
 			nvlist_add_boolean(nv_dst, TD_DISK_ATTR_CURRBOOT);
-
-			free(curr_bootdisk);
 		}
 
-		dm_free_name(dn);
-
 		/* add controller type to the list of attributes */
 
 		(void) ddm_drive_set_ctype(disk, nv_dst);
@@ -1643,9 +1960,7 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 
 	/* get attributes for media and convert to libtd namespace */
 
-	nv_src = dm_get_attributes(ad[0], &errn);
-
-	dm_free_descriptors(ad);
+	nv_src = dm_get_attributes(media, &errn);
 
 	if (errn != 0) {
 		DDM_DEBUG(DDM_DBGLVL_ERROR, "ddm_get_disk_attributes()"
@@ -1688,8 +2003,6 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 		nvlist_add_boolean(nv_dst, TD_DISK_ATTR_CURRBOOT);
 	}
 
-	free(curr_bootdisk);
-
 	/*
 	 * Add 'device id' to the list of attributes.
 	 * If it can't be obtained, set to "unknown".
@@ -1816,8 +2129,6 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 
 	nvlist_add_uint32(nv_dst, TD_DISK_ATTR_LABEL, disk_label);
 
-	dm_free_name(dn);
-
 	nvlist_free(nv_src);
 	return (nv_dst);
 }
@@ -1832,7 +2143,7 @@ ddm_get_disk_attributes(ddm_handle_t disk)
 ddm_handle_t *
 ddm_get_partitions(ddm_handle_t d)
 {
-	dm_descriptor_t	*am;
+	dm_descriptor_t	am;
 	dm_descriptor_t	*ddm_part_desc;
 	int		errn;
 
@@ -1860,9 +2171,9 @@ ddm_get_partitions(ddm_handle_t d)
 	 * on the one side and with partition on the other side.
 	 */
 
-	am = dm_get_associated_descriptors(d, DM_MEDIA, &errn);
+	am = ddm_drive_get_media(d, &errn);
 
-	if ((am == NULL) || (errn != 0)) {
+	if ((am == 0) || (errn != 0)) {
 		DDM_DEBUG(DDM_DBGLVL_ERROR,
 		    "ddm_get_partitions(): No DM_MEDIA assoc. w/ DM_DRIVE,"
 		    "err=%d\n", errn);
@@ -1870,12 +2181,7 @@ ddm_get_partitions(ddm_handle_t d)
 		return (NULL);
 	}
 
-	/*
-	 * since there is 1:1 relationship between drive and media, use
-	 * the first (and the only) descriptor when asking for partitions
-	 */
-
-	ddm_part_desc = dm_get_associated_descriptors(am[0], DM_PARTITION,
+	ddm_part_desc = dm_get_associated_descriptors(am, DM_PARTITION,
 	    &errn);
 
 	if ((ddm_part_desc == NULL) || (errn != 0)) {
@@ -1883,11 +2189,9 @@ ddm_get_partitions(ddm_handle_t d)
 		    "ddm_get_partitions(): No DM_PARTITION assoc. w/ DM_MEDIA,"
 		    "err=%d\n", errn);
 
-		dm_free_descriptors(am);
 		return (NULL);
 	}
 
-	dm_free_descriptors(am);
 	return ((ddm_handle_t *)ddm_part_desc);
 }
 
@@ -2004,7 +2308,7 @@ ddm_handle_t *
 ddm_get_slices(ddm_handle_t h)
 {
 	dm_descriptor_t	*ddm_slice_desc;
-	dm_descriptor_t	*am;
+	dm_descriptor_t	am;
 	dm_desc_type_t	desc_type;
 
 	int		errn;
@@ -2069,9 +2373,9 @@ ddm_get_slices(ddm_handle_t h)
 	 * discover them
 	 */
 
-	am = dm_get_associated_descriptors(h, DM_MEDIA, &errn);
+	am = ddm_drive_get_media(h, &errn);
 
-	if ((am == NULL) || (errn != 0)) {
+	if ((am == 0) || (errn != 0)) {
 		DDM_DEBUG(DDM_DBGLVL_ERROR,
 		    "ddm_get_slices(): Can't get media info, err=%d\n",
 		    errn);
@@ -2079,7 +2383,7 @@ ddm_get_slices(ddm_handle_t h)
 		return (NULL);
 	}
 
-	ddm_slice_desc = dm_get_associated_descriptors(am[0], DM_SLICE,
+	ddm_slice_desc = dm_get_associated_descriptors(am, DM_SLICE,
 	    &errn);
 
 	if ((ddm_slice_desc == NULL) || (errn != 0)) {
@@ -2090,7 +2394,6 @@ ddm_get_slices(ddm_handle_t h)
 		return (NULL);
 	}
 
-	dm_free_descriptors(am);
 	return ((ddm_handle_t *)ddm_slice_desc);
 }
 
@@ -2355,6 +2658,53 @@ ddm_free_handle_list(ddm_handle_t *h)
 	}
 }
 
+/*
+ * ddm_session_release()
+ *	Releases all information cached by discovery session and reports
+ *	how long the session took.
+ */
+void
+ddm_session_release(void)
+{
+	ddm_desc_info_t	*di, *next;
+	int		i;
+
+	(void) pthread_mutex_lock(&ddm_session.ds_lock);
+
+	if (ddm_session.ds_start != 0) {
+		DDM_DEBUG(DDM_DBGLVL_INFO, "Discovery session lasted %lld ms, "
+		    "%d lookups cached, %d passed to libdiskmgt\n",
+		    (gethrtime() - ddm_session.ds_start) / 1000000LL,
+		    ddm_session.ds_hits, ddm_session.ds_misses);
+	}
+
+	for (i = 0; i < DDM_SESSION_NBUCKETS; i++) {
+		for (di = ddm_session.ds_info[i]; di != NULL; di = next) {
+			next = di->di_next;
+
+			if (di->di_name != NULL)
+				dm_free_name(di->di_name);
+			if (di->di_media != NULL)
+				dm_free_descriptors(di->di_media);
+			if (di->di_controller != NULL)
+				dm_free_descriptors(di->di_controller);
+			free(di->di_ctype);
+			free(di);
+		}
+
+		ddm_session.ds_info[i] = NULL;
+	}
+
+	free(ddm_session.ds_bootdisk);
+	ddm_session.ds_bootdisk = NULL;
+	ddm_session.ds_bootdisk_done = B_FALSE;
+	ddm_session.ds_start = 0;
+	ddm_session.ds_hits = 0;
+	ddm_session.ds_misses = 0;
+
+	(void) pthread_mutex_unlock(&ddm_session.ds_lock);
+}
+
 /*
  * ddm_free_attr_list()
  */
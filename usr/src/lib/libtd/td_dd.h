@@ -88,6 +88,7 @@ extern ddm_handle_t	*ddm_get_slices(ddm_handle_t h);
 extern nvlist_t		*ddm_get_slice_attributes(ddm_handle_t s);
 extern void		ddm_free_handle_list(ddm_handle_t *h);
 extern void		ddm_free_attr_list(nvlist_t *attrs);
+extern void		ddm_session_release(void);
 extern int		ddm_get_slice_inuse_stats(char *, nvlist_t *);
 
 extern int ddm_is_slice_name(char *str);
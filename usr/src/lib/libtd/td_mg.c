@@ -31,6 +31,7 @@
 #include <strings.h>
 #include <sys/param.h>
 #include <sys/systeminfo.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <libfstyp.h>
@@ -42,6 +43,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <time.h>
 #include <ustat.h>
@@ -68,9 +70,11 @@
 
 #define	ATTR_LIST_TERMINATOR ((nvlist_t *)-1)
 
-/* template temporary directory names for mkdtemp() */
+/* initial number of elements of object arrays grown one by one */
+#define	TD_OBJ_ALLOC_MIN	16
+
+/* template temporary directory name for mkdtemp() */
 #define	TEMPLATEROOT	"/tmp/td_rootXXXXXX"
-#define	TEMPLATEVAR	TEMPLATEROOT "/var"
 
 /* object instances */
 struct td_obj {
@@ -79,15 +83,52 @@ struct td_obj {
 	boolean_t discovery_done;	/* discovery performed for object */
 };
 
+/* entry in index of partitions or slices by disk */
+struct td_child {
+	const char *name;		/* object name, e.g. c0t0d0s0 */
+	size_t disklen;			/* length of disk part of name */
+	int objidx;			/* index of object in object array */
+};
+
 /* class for TD objects */
 struct td_class {
 	td_object_type_t objtype;	/* self-type identifier */
 	int objcnt;			/* count of objects */
+	int objalloc;			/* count of allocated array elements */
 	struct td_obj *objarr;		/* object array */
 	struct td_obj *objcur;		/* current object */
 	ddm_handle_t *pddm;		/* disk module handle */
 	boolean_t issorted;		/* object list has been sorted */
 	int (*compare_routine)(const void *, const void *); /* sorting */
+	struct td_child *children;	/* index by disk, sorted by disk */
+	int nchildren;			/* count of index entries */
+};
+
+/* work shared by threads discovering attributes of one object type */
+struct td_attr_pool {
+	td_object_type_t otype;		/* type of objects discovered */
+	struct td_obj *objarr;		/* objects to discover */
+	int objcnt;			/* count of objects */
+	int next;			/* index of next object to claim */
+	pthread_mutex_t lock;		/* protects next */
+};
+
+/* slice which may hold the root file system of a Solaris instance */
+struct td_os_cand {
+	nvlist_t *nvl;			/* slice attributes */
+	char *slicenm;			/* slice name, from nvl */
+	uint32_t partition_tag;		/* VTOC tag of the slice */
+	boolean_t premounted;		/* mounted before discovery */
+	boolean_t mounted;		/* root file system is mounted */
+	char mntpnt[MAXPATHLEN];	/* where it is mounted */
+};
+
+/* root slice candidates probed and mounted by a pool of threads */
+struct td_os_pool {
+	struct td_os_cand *cands;	/* candidates */
+	int ncands;			/* count of candidates */
+	int next;			/* index of next candidate to claim */
+	pthread_mutex_t lock;		/* protects next */
 };
 
 /* sort comparison routines for objects */
@@ -98,10 +139,14 @@ static int compare_os_objs(const void *p1, const void *p2);
 
 /* object type declarations */
 static struct td_class objlist[] = {
-	{TD_OT_DISK, 0, NULL, NULL, NULL, B_FALSE, compare_disk_objs},
-	{TD_OT_PARTITION, 0, NULL, NULL, NULL, B_FALSE, compare_partition_objs},
-	{TD_OT_SLICE, 0, NULL, NULL, NULL, B_FALSE, compare_slice_objs},
-	{TD_OT_OS, 0, NULL, NULL, NULL, B_FALSE, compare_os_objs}
+	{TD_OT_DISK, 0, 0, NULL, NULL, NULL, B_FALSE, compare_disk_objs,
+	    NULL, 0},
+	{TD_OT_PARTITION, 0, 0, NULL, NULL, NULL, B_FALSE,
+	    compare_partition_objs, NULL, 0},
+	{TD_OT_SLICE, 0, 0, NULL, NULL, NULL, B_FALSE, compare_slice_objs,
+	    NULL, 0},
+	{TD_OT_OS, 0, 0, NULL, NULL, NULL, B_FALSE, compare_os_objs,
+	    NULL, 0}
 };
 #define	is_valid_td_object_type(ot) \
 	((ot) >= 0 && (ot) < sizeof (objlist) / sizeof (objlist[0]))
@@ -137,6 +182,8 @@ static char mntrc_text[32];
 static td_errno_t set_td_errno(int);
 static void clear_td_errno();
 static td_errno_t os_discover(void);
+static void os_probe_all(struct td_os_pool *, int);
+static void *os_probe_worker(void *);
 static struct td_obj *search_disks(const char *);
 static char *td_get_default_inst(void);
 static boolean_t string_array_add(const char *, char ***);
@@ -146,11 +193,17 @@ static char *td_get_value(const char *, char);
 static boolean_t bootenv_exists(const char *);
 static struct td_obj *disk_random_slice(nvlist_t *);
 static void disks_discover_all_attrs(void);
+static void objs_discover_all_attrs(td_object_type_t, int);
+static void *attr_pool_worker(void *);
 static void sort_objs(td_object_type_t);
 static int td_fsck_mount(char *, char *, boolean_t, char *, char *, char *,
     nvlist_t **);
 static nvlist_t *dup_attr_set_errno(struct td_obj *);
 static void free_td_obj_list(td_object_type_t);
+static td_errno_t build_child_index(td_object_type_t);
+static void free_child_index(td_object_type_t);
+static int compare_child_objs(const void *, const void *);
+static int compare_child_disk(const struct td_child *, const char *, size_t);
 static nvlist_t **td_discover_object_by_disk(td_object_type_t,
     const char *, int *);
 static boolean_t is_wrong_metacluster(char *);
@@ -208,7 +261,9 @@ td_discover(td_object_type_t otype, int *number_found)
 	switch (otype) {
 	case TD_OT_DISK: /* get disks */
 		if (PDDMDISKS == NULL) {
+			ls_trace_begin(LS_TRACE_TD, "get_disks", 0);
 			PDDMDISKS = ddm_get_disks();
+			ls_trace_end(LS_TRACE_TD, "get_disks", 0);
 			if (PDDMDISKS == NULL) {
 				return (set_td_errno(TD_E_NO_DEVICE));
 			}
@@ -228,6 +283,7 @@ td_discover(td_object_type_t otype, int *number_found)
 		    realloc(PDISKARR, (NDISKS + 1) * sizeof (struct td_obj));
 		if (PDISKARR == NULL)
 			return (set_td_errno(TD_E_MEMORY));
+		objlist[otype].objalloc = NDISKS + 1;
 
 		pddm = PDDMDISKS;
 		ptdobj = PDISKARR;
@@ -247,7 +303,9 @@ td_discover(td_object_type_t otype, int *number_found)
 		break;
 	case TD_OT_PARTITION:
 		if (PDDMPARTS == NULL) {
+			ls_trace_begin(LS_TRACE_TD, "get_partitions", 0);
 			PDDMPARTS = ddm_get_partitions(DDM_DISCOVER_ALL);
+			ls_trace_end(LS_TRACE_TD, "get_partitions", 0);
 			if (PDDMPARTS == NULL) {
 				return (set_td_errno(TD_E_END));
 			}
@@ -269,6 +327,7 @@ td_discover(td_object_type_t otype, int *number_found)
 		    realloc(PPARTARR, (NPARTS + 1) * sizeof (struct td_obj));
 		if (PPARTARR == NULL)
 			return (set_td_errno(TD_E_MEMORY));
+		objlist[otype].objalloc = NPARTS + 1;
 
 		pddm = PDDMPARTS;
 		ptdobj = PPARTARR;
@@ -285,10 +344,13 @@ td_discover(td_object_type_t otype, int *number_found)
 		ptdobj->handle = NULL;
 		ptdobj->attrib = NULL;
 		CURPART = NULL;
+		free_child_index(TD_OT_PARTITION);
 		break;
 	case TD_OT_SLICE:
 		if (PDDMSLICES == NULL) {
+			ls_trace_begin(LS_TRACE_TD, "get_slices", 0);
 			PDDMSLICES = ddm_get_slices(DDM_DISCOVER_ALL);
+			ls_trace_end(LS_TRACE_TD, "get_slices", 0);
 			if (PDDMSLICES == NULL)
 				return (set_td_errno(TD_E_END));
 		}
@@ -309,6 +371,7 @@ td_discover(td_object_type_t otype, int *number_found)
 		    realloc(PSLICEARR, (NSLICES + 1) * sizeof (struct td_obj));
 		if (PSLICEARR == NULL)
 			return (set_td_errno(TD_E_MEMORY));
+		objlist[otype].objalloc = NSLICES + 1;
 
 		pddm = PDDMSLICES;
 		ptdobj = PSLICEARR;
@@ -321,6 +384,7 @@ td_discover(td_object_type_t otype, int *number_found)
 		ptdobj->handle = NULL;
 		ptdobj->attrib = NULL;
 		CURSLICE = NULL;
+		free_child_index(TD_OT_SLICE);
 		break;
 	case TD_OT_OS: /* get OS instances */
 		if (PDDMSLICES == NULL) {
@@ -516,6 +580,42 @@ td_attributes_get(td_object_type_t otype)
 	return (NULL);
 }
 
+/*
+ * discover attributes for all objects of specific type in parallel
+ * interface to TD user
+ * parameters:
+ *	otype	indicate object type - disks, partitions or slices
+ *	nthreads	maximum number of threads to use, capped at
+ *		TD_DISCOVERY_MAX_THREADS
+ * returns TD_ERRNO
+ *
+ * Objects are discovered first if not done yet.  Attributes are cached
+ * exactly as if td_attributes_get() had been called for every object, so
+ * the user then enumerates the objects as usual, in the usual order, without
+ * waiting on the disk module for each of them.  The enumeration state is
+ * not changed.
+ *
+ * As with td_discover_partition_by_disk() and td_discover_slice_by_disk(),
+ * slice attributes are not cross-referenced with the list of disks.
+ */
+td_errno_t
+td_discover_attributes(td_object_type_t otype, int nthreads)
+{
+	clear_td_errno();
+	if (otype != TD_OT_DISK && otype != TD_OT_PARTITION &&
+	    otype != TD_OT_SLICE)
+		return (set_td_errno(TD_E_NO_OBJECT));
+
+	/* discover objects if not done */
+	if (objlist[otype].objarr == NULL) {
+		(void) td_discover(otype, NULL);
+		if (TD_ERRNO != TD_E_SUCCESS)
+			return (TD_ERRNO);
+	}
+	objs_discover_all_attrs(otype, nthreads);
+	return (TD_E_SUCCESS);
+}
+
 /*
  * perform discovery of all objects of the specified type and return all
  *	attributes
@@ -719,6 +819,8 @@ td_discovery_release(void)
 	free_td_obj_list(TD_OT_PARTITION);
 	free_td_obj_list(TD_OT_SLICE);
 	free_td_obj_list(TD_OT_OS);
+	/* forget data cached by disk module for this discovery */
+	ddm_session_release();
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO, "td_discovery_release ends \n");
 	return (TD_E_SUCCESS);
@@ -896,16 +998,21 @@ td_errno_t
 add_td_discovered_obj(td_object_type_t objtype, nvlist_t *onvl)
 {
 	struct td_obj *pobja = objlist[objtype].objarr;
-
-	pobja =
-	    realloc(pobja, sizeof (*pobja) * (objlist[objtype].objcnt + 2));
-
-	if (pobja == NULL) {
-		td_debug_print(LS_DBGLVL_ERR,
-		    "nvlist td_obj allocation failure\n");
-		return (TD_E_MEMORY);
+	int nalloc = objlist[objtype].objalloc;
+
+	/* room for new object plus terminator, grow array geometrically */
+	if (objlist[objtype].objcnt + 2 > nalloc) {
+		nalloc = (nalloc < TD_OBJ_ALLOC_MIN ?
+		    TD_OBJ_ALLOC_MIN : nalloc * 2);
+		pobja = realloc(pobja, sizeof (*pobja) * nalloc);
+		if (pobja == NULL) {
+			td_debug_print(LS_DBGLVL_ERR,
+			    "nvlist td_obj allocation failure\n");
+			return (TD_E_MEMORY);
+		}
+		objlist[objtype].objarr = pobja;
+		objlist[objtype].objalloc = nalloc;
 	}
-	objlist[objtype].objarr = pobja;
 	pobja += objlist[objtype].objcnt;
 	pobja->attrib = onvl;
 	pobja->handle = (ddm_handle_t)onvl;
@@ -1238,6 +1345,13 @@ td_is_fstyp(const char *slicenm, char *fs)
  * return an nvlist of information interesting to someone wanting Solaris
  * instances
  * - slice name
+ *
+ * Root slice candidates are found from slice attributes and mnttab first.
+ * Candidates not mounted yet are probed for UFS, checked and mounted on
+ * their own temporary mount points by a pool of threads, since this is
+ * where the time goes with many legacy slices. The mounted candidates are
+ * then inspected one by one, since inspection is relative to the TD root
+ * directory and the zones library root, which are process wide.
  */
 static td_errno_t
 os_discover(void)
@@ -1245,12 +1359,15 @@ os_discover(void)
 	ddm_handle_t *cslice;
 	FILE *mnttabfp; /* running system mnttab file pointer */
 	char *tmprootmntpnt = NULL;
-	char tmpvarmntpnt[] = TEMPLATEVAR;
+	char tmpvarmntpnt[MAXPATHLEN];
 	char templateroot[] = TEMPLATEROOT; /* for mkdtemp() */
 	td_errno_t tderr = TD_E_SUCCESS; /* return status */
 	char *orootdir = strdup(td_get_rootdir());
 	char build_id[80];
 	FILE *localvfstabfp;
+	struct td_os_cand *cands;
+	struct td_os_pool pool;
+	int ncands, nslices, i;
 
 	/* set current swap file and device as exempt from later removal */
 	if ((localvfstabfp = fopen(VFSTAB, "r")) != NULL) {
@@ -1287,26 +1404,22 @@ os_discover(void)
 		    MNTTAB, errno);
 		return (TD_E_MNTTAB);
 	}
+
+	for (nslices = 0, cslice = PDDMSLICES; *cslice != NULL; cslice++)
+		nslices++;
+	if ((cands = calloc(nslices + 1, sizeof (*cands))) == NULL) {
+		(void) fclose(mnttabfp);
+		return (TD_E_MEMORY);
+	}
+
 	/* seeking partition tag is root */
-	for (cslice = PDDMSLICES; *cslice != NULL; cslice++) {
+	for (ncands = 0, cslice = PDDMSLICES; *cslice != NULL; cslice++) {
+		struct td_os_cand *cand = &cands[ncands];
 		struct mnttab mpref, mnttab;
-		struct vfstab vref, vfstab;
 		uint32_t partition_tag;
 		char *slicenm; /* name of slice */
 		char slicemp[MAXPATHLEN];
-		char *varslice = NULL; /* assume no separate var */
-		char vfstabname[MAXPATHLEN];
-		boolean_t varmounted = B_FALSE;
-		FILE *vfstabfp = NULL;
-		boolean_t rootmounted;
-		nvlist_t *nvl, *onvl, *svmnvl = NULL;
-		char release[32] = "";
-		char minor[32] = "";
-		char **znvl;
-		struct td_upgrade_fail_reasons fr;
-		int new_var_sadm;
-		int ret;
-		char *pclustertoc, *pcluster;
+		nvlist_t *nvl;
 
 		nvl = ddm_get_slice_attributes(*cslice);
 		if (nvl == NULL)
@@ -1315,14 +1428,17 @@ os_discover(void)
 		/* check VTOC information: partition tag says root fs */
 		if (nvlist_lookup_uint32(nvl, TD_SLICE_ATTR_TAG,
 		    &partition_tag) != 0 ||
-		    (partition_tag != 0 && partition_tag != V_ROOT))
+		    (partition_tag != 0 && partition_tag != V_ROOT)) {
+			nvlist_free(nvl);
 			continue;
+		}
 
 		/* now root slice candidate based on attributes */
 
 		if (nvlist_lookup_string(nvl, TD_SLICE_ATTR_NAME, &slicenm) !=
 		    0) {
 			td_debug_print(LS_DBGLVL_ERR, "slice name not found\n");
+			nvlist_free(nvl);
 			continue;
 		}
 
@@ -1331,25 +1447,15 @@ os_discover(void)
 			if (TLI)
 				td_debug_print(LS_DBGLVL_INFO,
 				    "slice %s has no disk entry\n", slicenm);
+			nvlist_free(nvl);
 			continue;
 		}
 
-		bzero(&fr, sizeof (fr)); /* clear upgrade fail reason codes */
-
-		/* is root slice mounted */
-		if (tmprootmntpnt == NULL) /* mount point for root */
-			tmprootmntpnt = mkdtemp(templateroot);
-		bzero(&mpref, sizeof (struct mnttab));
-		td_set_rootdir(tmprootmntpnt);
-		rootmounted = B_FALSE; /* assume not */
-
 		/* get mount point from mnttab given slice name */
+		bzero(&mpref, sizeof (struct mnttab));
 		(void) snprintf(slicemp, sizeof (slicemp),
 		    "/dev/dsk/%s", slicenm);
 		mpref.mnt_special = slicemp;
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    "mounting %s %s \n", slicemp, tmprootmntpnt);
 		/* if slice already mounted */
 		resetmnttab(mnttabfp);
 		if (getmntany(mnttabfp, &mnttab, &mpref) == 0) {
@@ -1357,20 +1463,71 @@ os_discover(void)
 				td_debug_print(LS_DBGLVL_INFO,
 				    "slice %s busy, assumed mounted\n",
 				    slicenm);
-			rootmounted = B_TRUE;
 			/* assume already mounted - find mount point */
 			if (strcmp(mnttab.mnt_fstype, MNTTYPE_UFS) != 0) {
 				if (TLI)
 					td_debug_print(LS_DBGLVL_INFO,
 					    "  skipping %s fstype=%s\n",
 					    slicemp, mnttab.mnt_fstype);
+				nvlist_free(nvl);
 				continue;
 			}
-			td_set_rootdir(mnttab.mnt_mountp);
+			(void) strlcpy(cand->mntpnt, mnttab.mnt_mountp,
+			    sizeof (cand->mntpnt));
+			cand->premounted = B_TRUE;
+			cand->mounted = B_TRUE;
+		}
+
+		cand->nvl = nvl;
+		cand->slicenm = slicenm;
+		cand->partition_tag = partition_tag;
+		ncands++;
+	}
+
+	/* probe, check and mount candidates not mounted yet in parallel */
+	pool.cands = cands;
+	pool.ncands = ncands;
+	pool.next = 0;
+	(void) pthread_mutex_init(&pool.lock, NULL);
+	os_probe_all(&pool, TD_DISCOVERY_DEF_THREADS);
+	(void) pthread_mutex_destroy(&pool.lock);
+
+	/* inspect mounted candidates */
+	for (i = 0; i < ncands; i++) {
+		struct td_os_cand *cand = &cands[i];
+		struct mnttab mpref, mnttab;
+		struct vfstab vref, vfstab;
+		uint32_t partition_tag = cand->partition_tag;
+		char *slicenm = cand->slicenm; /* name of slice */
+		char *varslice = NULL; /* assume no separate var */
+		char vfstabname[MAXPATHLEN];
+		boolean_t varmounted = B_FALSE;
+		FILE *vfstabfp = NULL;
+		boolean_t rootmounted = cand->premounted;
+		nvlist_t *onvl;
+		char release[32] = "";
+		char minor[32] = "";
+		char **znvl;
+		struct td_upgrade_fail_reasons fr;
+		int new_var_sadm;
+		int ret;
+		char *pclustertoc, *pcluster;
+
+		/* not mounted, or give up after failure, just clean up */
+		if (!cand->mounted || tderr != TD_E_SUCCESS)
+			goto umount;
+
+		bzero(&fr, sizeof (fr)); /* clear upgrade fail reason codes */
+		td_set_rootdir(cand->mntpnt);
+
+		if (rootmounted) {
 			if (TLI)
 				td_debug_print(LS_DBGLVL_INFO,
 				    "getmntany rootdir=%s\n",
 				    td_get_rootdir());
+			/* temporary mount point for separate var */
+			if (tmprootmntpnt == NULL)
+				tmprootmntpnt = mkdtemp(templateroot);
 			/* look for separate var in mnttab for the slice */
 			bzero(&mpref, sizeof (struct mnttab));
 			mpref.mnt_mountp = "/var";
@@ -1381,38 +1538,19 @@ os_discover(void)
 					    "separate var already mounted\n");
 				varmounted = B_TRUE;
 			} else { /* var not mounted - find mntpnt in vfstab */
-				(void) strncpy(tmpvarmntpnt, tmprootmntpnt,
-				    sizeof (TEMPLATEVAR));
-				(void) strlcat(tmpvarmntpnt, "/var",
-				    sizeof (TEMPLATEVAR));
+				(void) snprintf(tmpvarmntpnt,
+				    sizeof (tmpvarmntpnt), "%s/var",
+				    tmprootmntpnt != NULL ? tmprootmntpnt : "");
 			}
 			(void) strcpy(vfstabname, td_get_rootdir());
 			(void) strcat(vfstabname, VFSTAB);
 		} else {
-			/*
-			 * Check to see what type of filesystem the
-			 * device contains. The fsck and mount code only
-			 * applies to ufs filesystems
-			 */
-
-			if (!td_is_fstyp(slicenm, "ufs"))
-				continue;
-
-			/* perform fsck and mount */
-			ret = td_fsck_mount(tmprootmntpnt, slicenm, B_TRUE,
-			    NULL, "-r", "ufs", &svmnvl);
-			if (ret != MNTRC_MOUNT_SUCCEEDS) {
-				continue;
-			}
-
 			/* read vfstab from mounted slice */
-			(void) strncpy(tmpvarmntpnt, tmprootmntpnt,
-			    sizeof (TEMPLATEVAR));
-			(void) strlcat(tmpvarmntpnt, "/var",
-			    sizeof (TEMPLATEVAR));
+			(void) snprintf(tmpvarmntpnt, sizeof (tmpvarmntpnt),
+			    "%s/var", cand->mntpnt);
 			/* use vfstab from mounted root slice */
 			(void) snprintf(vfstabname, sizeof (vfstabname),
-			    "%s%s", tmprootmntpnt, VFSTAB);
+			    "%s%s", cand->mntpnt, VFSTAB);
 		}
 		if (TLI)
 			td_debug_cat_file(LS_DBGLVL_INFO, vfstabname);
@@ -1639,7 +1777,6 @@ add_instance:
 			    != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1647,7 +1784,6 @@ add_instance:
 			    TD_OS_ATTR_VERSION_MINOR, minor) != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1657,7 +1793,6 @@ add_instance:
 		    != 0) {
 			td_debug_print(LS_DBGLVL_ERR,
 			    "nvlist add_string failure\n");
-			nvlist_free(nvl);
 			tderr = TD_E_MEMORY;
 			goto umount;
 		}
@@ -1668,7 +1803,6 @@ add_instance:
 			    build_id) != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1677,14 +1811,12 @@ add_instance:
 		if (TD_UPGRADE_FAIL(fr) &&
 		    nvlist_add_uint32(onvl, TD_OS_ATTR_NOT_UPGRADEABLE,
 		    *(uint32_t *)&fr) != 0) {
-			nvlist_free(nvl);
 			tderr = TD_E_MEMORY;
 			goto umount;
 		}
 		/* allocate or extend list */
 		tderr = add_td_discovered_obj(TD_OT_OS, onvl);
 		if (tderr != TD_E_SUCCESS) {
-			nvlist_free(nvl);
 			goto umount;
 		}
 umount:		/* if we goto to this label, no Solaris instance */
@@ -1702,16 +1834,13 @@ umount:		/* if we goto to this label, no Solaris instance */
 		/* unmount var if on separate slice */
 		if (varslice != NULL)
 			(void) umount2(tmpvarmntpnt, MS_FORCE);
-		/* unmount current root, var at temporary mount points */
-		if (!rootmounted && umount2(tmprootmntpnt, MS_FORCE) != 0) {
-			/* unmount failed - use new temp mount point */
-			(void) strncpy(templateroot, TEMPLATEROOT,
-			    sizeof (templateroot));
-			tmprootmntpnt = NULL;
-		}
-		if (tderr != TD_E_SUCCESS)
-			break;
+		/* unmount root at its temporary mount point */
+		if (!rootmounted && cand->mounted &&
+		    umount2(cand->mntpnt, MS_FORCE) == 0)
+			(void) rmdir(cand->mntpnt);
+		nvlist_free(cand->nvl);
 	} /* next slice */
+	free(cands);
 	td_be_list(); /* discover all Snap Boot Environments */
 	if (tderr == TD_E_SUCCESS)
 		sort_objs(TD_OT_OS);
@@ -1723,6 +1852,109 @@ umount:		/* if we goto to this label, no Solaris instance */
 	return (tderr); /* return error/success code */
 }
 
+/*
+ * probe root slice candidates for UFS, then check and mount them on their
+ * own temporary mount points, using up to nthreads threads including the
+ * caller
+ */
+static void
+os_probe_all(struct td_os_pool *pool, int nthreads)
+{
+	pthread_t tid[TD_DISCOVERY_MAX_THREADS];
+	hrtime_t start;
+	int i, npending, nstarted;
+
+	for (npending = 0, i = 0; i < pool->ncands; i++)
+		if (!pool->cands[i].premounted)
+			npending++;
+	if (npending == 0)
+		return;
+
+	if (nthreads > TD_DISCOVERY_MAX_THREADS)
+		nthreads = TD_DISCOVERY_MAX_THREADS;
+	if (nthreads > npending)
+		nthreads = npending;
+
+	start = gethrtime();
+	ls_trace_begin(LS_TRACE_TD, "probe_root_slices", npending);
+
+	/* caller is a worker too, so a failure to start threads is harmless */
+	for (nstarted = 0; nstarted < nthreads - 1; nstarted++) {
+		if (pthread_create(&tid[nstarted], NULL,
+		    os_probe_worker, pool) != 0) {
+			td_debug_print(LS_DBGLVL_WARN,
+			    "Can't start root slice probing thread\n");
+			break;
+		}
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "probing %d root slice candidates with %d threads\n",
+		    npending, nstarted + 1);
+
+	(void) os_probe_worker(pool);
+	for (i = 0; i < nstarted; i++)
+		(void) pthread_join(tid[i], NULL);
+	ls_trace_end(LS_TRACE_TD, "probe_root_slices", npending);
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "root slice candidates probed in %lld ms\n",
+		    (gethrtime() - start) / 1000000LL);
+}
+
+/* claim candidates one at a time, mount them if they contain UFS */
+static void *
+os_probe_worker(void *arg)
+{
+	struct td_os_pool *pool = arg;
+	struct td_os_cand *cand;
+	int i;
+
+	for (;;) {
+		(void) pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		(void) pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->ncands)
+			break;
+
+		cand = &pool->cands[i];
+		if (cand->premounted)
+			continue;
+
+		/*
+		 * Check to see what type of filesystem the
+		 * device contains. The fsck and mount code only
+		 * applies to ufs filesystems
+		 */
+
+		if (!td_is_fstyp(cand->slicenm, "ufs"))
+			continue;
+
+		(void) strlcpy(cand->mntpnt, TEMPLATEROOT,
+		    sizeof (cand->mntpnt));
+		if (mkdtemp(cand->mntpnt) == NULL) {
+			td_debug_print(LS_DBGLVL_WARN,
+			    "Can't create mount point for %s\n",
+			    cand->slicenm);
+			continue;
+		}
+		if (TLI)
+			td_debug_print(LS_DBGLVL_INFO,
+			    "mounting /dev/dsk/%s %s \n", cand->slicenm,
+			    cand->mntpnt);
+
+		/* perform fsck and mount */
+		ls_trace_begin(LS_TRACE_TD, "fsck_mount", i);
+		if (td_fsck_mount(cand->mntpnt, cand->slicenm, B_TRUE,
+		    NULL, "-r", "ufs", NULL) == MNTRC_MOUNT_SUCCEEDS)
+			cand->mounted = B_TRUE;
+		else
+			(void) rmdir(cand->mntpnt);
+		ls_trace_end(LS_TRACE_TD, "fsck_mount", cand->mounted);
+	}
+	return (NULL);
+}
+
 /*
  * fsck -m checks to see if file system
  * needs checking.
@@ -2080,9 +2312,11 @@ free_td_obj_list(td_object_type_t ot)
 		free(pobl->objarr);
 		pobl->objarr = NULL;
 	}
+	free_child_index(ot);
 	/* unset static information for object */
 	pobl->objcur = NULL;
 	pobl->objcnt = 0;
+	pobl->objalloc = 0;
 	pobl->issorted = B_FALSE;
 	/* free handle lists from lower-level modules */
 	if (pobl->pddm != NULL) {
@@ -2094,11 +2328,12 @@ free_td_obj_list(td_object_type_t ot)
 static nvlist_t **
 td_discover_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
 {
+	struct td_class *pobl;
 	struct td_obj *pobj, *pdisk;
+	struct td_child *pch, *pend;
 	nvlist_t **ppd = NULL; /* partition list to return */
-	char *pobjname;
-	int i, nmatch = 0;
-	char	device_match[MAXPATHLEN];
+	size_t disklen;
+	int lo, hi, mid, nmatch = 0;
 
 	clear_td_errno();
 	if (pcount != NULL)
@@ -2109,6 +2344,7 @@ td_discover_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
 		(void) set_td_errno(TD_E_NO_OBJECT);
 		return (NULL);
 	}
+	pobl = &objlist[ot];
 	/* discover disks if not done */
 	if (objlist[TD_OT_DISK].objarr == NULL) {
 		(void) td_discover(TD_OT_DISK, NULL);
@@ -2127,83 +2363,163 @@ td_discover_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
 		td_debug_print(LS_DBGLVL_INFO,
 		    ">>>  discover partition by diskname=%s\n", disk);
 	/* discover object type if not done */
-	if (objlist[ot].objarr == NULL) {
+	if (pobl->objarr == NULL) {
 		(void) td_discover(ot, NULL);
 		if (TD_ERRNO != TD_E_SUCCESS)
 			return (NULL);
 	}
-	pobj = objlist[ot].objarr;
+	/* index objects by disk if not done */
+	if (pobl->children == NULL && build_child_index(ot) != TD_E_SUCCESS)
+		return (NULL);
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO,
-		    ">>>   object count=%d\n", objlist[ot].objcnt);
-
-	(void) snprintf(device_match, sizeof (device_match), "%s%s",
-	    disk, ot == TD_OT_PARTITION ? "p" : "s");
+		    ">>>   object count=%d indexed=%d\n",
+		    pobl->objcnt, pobl->nchildren);
+
+	/* find first index entry for the disk */
+	disklen = strlen(disk);
+	lo = 0;
+	hi = pobl->nchildren;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		pch = &pobl->children[mid];
+		if (compare_child_disk(pch, disk, disklen) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	/* entries of one disk are adjacent, in object array order */
+	for (hi = lo; hi < pobl->nchildren &&
+	    compare_child_disk(&pobl->children[hi], disk, disklen) == 0; hi++)
+		;
+	if (hi == lo)
+		return (NULL);
 
-	for (i = 0; i < objlist[ot].objcnt; i++, pobj++) {
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    ">>>   obj %d handle=0x%llx\n", i, pobj->handle);
-		if (!pobj->discovery_done) {
-			pobj->attrib = (ot == TD_OT_PARTITION ?
-			    ddm_get_partition_attributes(pobj->handle):
-			    ddm_get_slice_attributes(pobj->handle));
-			pobj->discovery_done = B_TRUE;
-		}
-		/*
-		 * if no attributes, we cannot match on name
-		 * this may pose a problem, since there could be a partition
-		 * without attributes that is on the disk
-		 */
-		if (pobj->attrib == NULL)
-			continue;
-		/* match on partition/slice name? */
-		if (nvlist_lookup_string(pobj->attrib,
-		    (ot == TD_OT_PARTITION ?
-		    TD_PART_ATTR_NAME : TD_SLICE_ATTR_NAME),
-		    &pobjname) != 0)
-			continue;
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    " obj=%s search disk=%s\n", pobjname, disk);
-		/*
-		 * Look for an exact match between the slice/partition
-		 * (pobjname) we're processing and the passed in disk
-		 * name + disk part (eg: c0t0d0s or c0d0p)
-		 */
-		if (strstr(pobjname, device_match) == NULL)
-			continue;
-		/* match on disk name */
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    ">>>   partition/slice %d %s NDISKS=%d\n",
-			    i, pobjname, NDISKS);
-		/* allocate or extend list of pointers */
-		ppd = ((ppd == NULL) ?
-		    malloc(2 * sizeof (*ppd)) :
-		    realloc(ppd, (nmatch + 2) * sizeof (*ppd)));
-		if (ppd == NULL) {
-			(void) set_td_errno(TD_E_MEMORY);
-			return (NULL);
-		}
+	ppd = malloc((hi - lo + 1) * sizeof (*ppd));
+	if (ppd == NULL) {
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	pend = &pobl->children[hi];
+	for (pch = &pobl->children[lo]; pch < pend; pch++) {
+		pobj = &pobl->objarr[pch->objidx];
 		/* copy partition attributes */
 		if (nvlist_dup(pobj->attrib, &ppd[nmatch], NV_UNIQUE_NAME)
 		    != 0) {
+			ppd[nmatch] = ATTR_LIST_TERMINATOR;
+			td_attribute_list_free(ppd);
 			(void) set_td_errno(TD_E_MEMORY);
 			return (NULL);
 		}
 		if (TLI)
 			td_debug_print(LS_DBGLVL_INFO,
 			    ">>>   partition/slice match %d %s %s \n",
-			    nmatch, disk, pobjname);
+			    nmatch, disk, pch->name);
 		nmatch++;
-		ppd[nmatch] = ATTR_LIST_TERMINATOR;
 	}
+	ppd[nmatch] = ATTR_LIST_TERMINATOR;
 	if (pcount != NULL)
 		*pcount = nmatch;
 	return (ppd);
 }
 
+/*
+ * compare disk part of index entry name with disk name
+ * returns <0, 0 or >0 like strcmp(3C)
+ */
+static int
+compare_child_disk(const struct td_child *pch, const char *disk,
+    size_t disklen)
+{
+	int ret;
+
+	ret = strncmp(pch->name, disk,
+	    pch->disklen < disklen ? pch->disklen : disklen);
+	if (ret != 0)
+		return (ret);
+	if (pch->disklen == disklen)
+		return (0);
+	return (pch->disklen < disklen ? -1 : 1);
+}
+
+/* sort index entries by disk, keeping object array order within a disk */
+static int
+compare_child_objs(const void *p1, const void *p2)
+{
+	const struct td_child *c1 = p1;
+	const struct td_child *c2 = p2;
+	int ret;
+
+	ret = compare_child_disk(c1, c2->name, c2->disklen);
+	if (ret != 0)
+		return (ret);
+	return (c1->objidx - c2->objidx);
+}
+
+/*
+ * index discovered partitions or slices by the disk they belong to
+ *
+ * Object names have the form <disk>pN or <disk>sN, so the disk part is
+ * what precedes the trailing p or s and digits.  Objects without attributes
+ * or with names of another form can't be matched with a disk and are left
+ * out.  Attributes for all objects are discovered first.
+ */
+static td_errno_t
+build_child_index(td_object_type_t ot)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_obj *pobj;
+	struct td_child *pch;
+	char *pobjname, *psuffix;
+	char sep = (ot == TD_OT_PARTITION ? 'p' : 's');
+	int i;
+
+	free_child_index(ot);
+	objs_discover_all_attrs(ot, TD_DISCOVERY_DEF_THREADS);
+
+	/* one more element so an empty index is not NULL */
+	pobl->children = malloc((pobl->objcnt + 1) * sizeof (struct td_child));
+	if (pobl->children == NULL)
+		return (set_td_errno(TD_E_MEMORY));
+
+	pch = pobl->children;
+	for (i = 0, pobj = pobl->objarr; i < pobl->objcnt; i++, pobj++) {
+		if (pobj->attrib == NULL)
+			continue;
+		if (nvlist_lookup_string(pobj->attrib,
+		    (ot == TD_OT_PARTITION ?
+		    TD_PART_ATTR_NAME : TD_SLICE_ATTR_NAME),
+		    &pobjname) != 0)
+			continue;
+		psuffix = strrchr(pobjname, sep);
+		if (psuffix == NULL || psuffix == pobjname ||
+		    psuffix[1] == '\0' ||
+		    strspn(psuffix + 1, "0123456789") != strlen(psuffix + 1))
+			continue;
+		pch->name = pobjname;
+		pch->disklen = psuffix - pobjname;
+		pch->objidx = i;
+		pch++;
+	}
+	pobl->nchildren = pch - pobl->children;
+	qsort(pobl->children, pobl->nchildren, sizeof (struct td_child),
+	    compare_child_objs);
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "indexed %d of %d objects type %d by disk\n",
+		    pobl->nchildren, pobl->objcnt, ot);
+	return (TD_E_SUCCESS);
+}
+
+/* release index of partitions or slices by disk */
+static void
+free_child_index(td_object_type_t ot)
+{
+	free(objlist[ot].children);
+	objlist[ot].children = NULL;
+	objlist[ot].nchildren = 0;
+}
+
 /* insure all disk discovery complete */
 static void
 disks_discover_all_attrs(void)
@@ -2216,13 +2532,111 @@ disks_discover_all_attrs(void)
 		if (TD_ERRNO != TD_E_SUCCESS)
 			return;
 	}
-	for (j = 0; j < NDISKS; j++)
-		/* discover disk attributes if not done */
-		if (!PDISKARR[j].discovery_done) {
-			PDISKARR[j].attrib =
-			    ddm_get_disk_attributes(PDISKARR[j].handle);
-			PDISKARR[j].discovery_done = B_TRUE;
+	objs_discover_all_attrs(TD_OT_DISK, TD_DISCOVERY_DEF_THREADS);
+}
+
+/*
+ * discover attributes for all discovered objects of given type not
+ * discovered yet, using up to nthreads threads including the caller
+ *
+ * The disk module is queried concurrently, but every object is claimed by
+ * exactly one thread, and all TD state besides the claimed objects is left
+ * to the calling thread.
+ */
+static void
+objs_discover_all_attrs(td_object_type_t ot, int nthreads)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_attr_pool pool;
+	pthread_t tid[TD_DISCOVERY_MAX_THREADS];
+	hrtime_t start;
+	int i, npending, nstarted;
+
+	if (pobl->objarr == NULL)
+		return;
+	for (npending = 0, i = 0; i < pobl->objcnt; i++)
+		if (!pobl->objarr[i].discovery_done)
+			npending++;
+	if (npending == 0)
+		return;
+
+	if (nthreads > TD_DISCOVERY_MAX_THREADS)
+		nthreads = TD_DISCOVERY_MAX_THREADS;
+	if (nthreads > npending)
+		nthreads = npending;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	start = gethrtime();
+	ls_trace_begin(LS_TRACE_TD, "discover_attributes", ot);
+	pool.otype = ot;
+	pool.objarr = pobl->objarr;
+	pool.objcnt = pobl->objcnt;
+	pool.next = 0;
+	(void) pthread_mutex_init(&pool.lock, NULL);
+
+	/* caller is a worker too, so a failure to start threads is harmless */
+	for (nstarted = 0; nstarted < nthreads - 1; nstarted++) {
+		if (pthread_create(&tid[nstarted], NULL,
+		    attr_pool_worker, &pool) != 0) {
+			td_debug_print(LS_DBGLVL_WARN,
+			    "Can't start attribute discovery thread\n");
+			break;
+		}
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "discovering attributes of %d objects type %d "
+		    "with %d threads\n", npending, ot, nstarted + 1);
+
+	(void) attr_pool_worker(&pool);
+	for (i = 0; i < nstarted; i++)
+		(void) pthread_join(tid[i], NULL);
+	(void) pthread_mutex_destroy(&pool.lock);
+	ls_trace_end(LS_TRACE_TD, "discover_attributes", npending);
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "attributes of objects type %d discovered in %lld ms\n",
+		    ot, (gethrtime() - start) / 1000000LL);
+}
+
+/* claim objects one at a time and discover their attributes */
+static void *
+attr_pool_worker(void *arg)
+{
+	struct td_attr_pool *pool = arg;
+	struct td_obj *pobj;
+	int i;
+
+	for (;;) {
+		(void) pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		(void) pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->objcnt)
+			break;
+
+		pobj = &pool->objarr[i];
+		if (pobj->discovery_done)
+			continue;
+		ls_trace_begin(LS_TRACE_TD, "object_attributes", i);
+		switch (pool->otype) {
+		case TD_OT_DISK:
+			pobj->attrib = ddm_get_disk_attributes(pobj->handle);
+			break;
+		case TD_OT_PARTITION:
+			pobj->attrib =
+			    ddm_get_partition_attributes(pobj->handle);
+			break;
+		case TD_OT_SLICE:
+			pobj->attrib = ddm_get_slice_attributes(pobj->handle);
+			break;
+		default:
+			break;
 		}
+		ls_trace_end(LS_TRACE_TD, "object_attributes", pool->otype);
+		pobj->discovery_done = B_TRUE;
+	}
+	return (NULL);
 }
 
 static struct td_obj *
@@ -887,7 +887,9 @@ ti_create_target(nvlist_t *attrs, ti_cbf_t cbf)
 
 	/* create target */
 
+	ls_trace_begin(LS_TRACE_TI, target_name, target_type);
 	ret = ti_create_target_method_table[target_type](attrs);
+	ls_trace_end(LS_TRACE_TI, target_name, ret);
 
 	return (ret);
 }
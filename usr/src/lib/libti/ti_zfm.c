@@ -33,6 +33,7 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <libzfs.h>
 
 #include <ti_dm.h>
 #include <ti_zfm.h>
@@ -60,8 +61,8 @@ static boolean_t	zfm_dryrun_mode_fl = B_FALSE;
 static zfm_errno_t zfm_add_volume_to_swap_pool(char *zpool_name,
     char *volume_name);
 static zfm_errno_t zfm_set_volume_as_dump(char *zpool_name, char *volume_name);
-static zfm_errno_t zfm_set_dataset_properties(char *zpool_name,
-    char *dataset_name, nvlist_t *props);
+static zfm_errno_t zfm_add_dataset_properties(char *dataset_name,
+    nvlist_t *props, nvlist_t *zfs_props);
 
 
 /* ------------------------ private functions --------------------------- */
@@ -128,37 +129,123 @@ zfm_system(char *cmd)
 }
 
 
+/*
+ * Function:	zfm_zfs_init()
+ *
+ * Description:	Opens libzfs handle. ZFS pool and datasets are
+ *		created in-process through libzfs rather than by running
+ *		zpool(1M) and zfs(1M) for every dataset and property.
+ *
+ * Scope:	private
+ * Parameters:	none
+ *
+ * Return:	libzfs handle, NULL if libzfs couldn't be initialized
+ *
+ */
+
+static libzfs_handle_t *
+zfm_zfs_init(void)
+{
+	libzfs_handle_t	*hdl;
+
+	if ((hdl = libzfs_init()) == NULL) {
+		zfm_debug_print(LS_DBGLVL_ERR,
+		    "Couldn't initialize libzfs\n");
+
+		return (NULL);
+	}
+
+	libzfs_print_on_error(hdl, B_FALSE);
+	return (hdl);
+}
+
+
+/*
+ * Function:	zfm_zfs_error()
+ *
+ * Description:	Logs description of the last libzfs error
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		operation - ZFS operation which failed
+ *		name - ZFS pool or dataset name
+ *
+ * Return:	none
+ *
+ */
+
+static void
+zfm_zfs_error(libzfs_handle_t *hdl, const char *operation, const char *name)
+{
+	zfm_debug_print(LS_DBGLVL_WARN, " %s %s: %s: %s\n", operation, name,
+	    libzfs_error_action(hdl), libzfs_error_description(hdl));
+}
+
+
+/*
+ * Function:	zfm_debug_print_props()
+ *
+ * Description:	Logs ZFS properties for debugging purposes
+ *
+ * Scope:	private
+ * Parameters:	name - ZFS pool or dataset name
+ *		zfs_props - ZFS properties
+ *
+ * Return:	none
+ *
+ */
+
+static void
+zfm_debug_print_props(const char *name, nvlist_t *zfs_props)
+{
+	nvpair_t	*nvp;
+	char		*strval;
+	uint64_t	intval;
+
+	if (zfs_props == NULL)
+		return;
+
+	for (nvp = nvlist_next_nvpair(zfs_props, NULL); nvp != NULL;
+	    nvp = nvlist_next_nvpair(zfs_props, nvp)) {
+		if (nvpair_value_string(nvp, &strval) == 0) {
+			zfm_debug_print(LS_DBGLVL_INFO,
+			    "Property %s=%s will be set for %s\n",
+			    nvpair_name(nvp), strval, name);
+		} else if (nvpair_value_uint64(nvp, &intval) == 0) {
+			zfm_debug_print(LS_DBGLVL_INFO,
+			    "Property %s=%llu will be set for %s\n",
+			    nvpair_name(nvp), (u_longlong_t)intval, name);
+		}
+	}
+}
+
+
 /*
  * Function:	zfm_zpool_exists()
  *
  * Description:	Finds out if ZFS pool already exists
  *
  * Scope:	private
- * Parameters:	zpool_name - ZFS pool name
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
  *
  * Return:	B_TRUE if pool exists, otherwise B_FALSE
  *
  */
 
 static boolean_t
-zfm_zpool_exists(char *zpool_name)
+zfm_zpool_exists(libzfs_handle_t *hdl, char *zpool_name)
 {
-	FILE	*p;
-	char	cmd[IDM_MAXCMDLEN];
-	int	ret;
-
-	(void) snprintf(cmd, sizeof (cmd),
-	    "/usr/sbin/zpool list %s >/dev/null 2>&1", zpool_name);
+	zpool_handle_t	*zph;
 
-	if ((p = popen(cmd, "w")) == NULL)
+	if (hdl == NULL)
 		return (B_FALSE);
 
-	ret = pclose(p);
-
-	if ((ret != -1) && (WEXITSTATUS(ret) == 0))
-		return (B_TRUE);
-	else
+	if ((zph = zpool_open_canfail(hdl, zpool_name)) == NULL)
 		return (B_FALSE);
+
+	zpool_close(zph);
+	return (B_TRUE);
 }
 
 /*
@@ -167,7 +254,8 @@ zfm_zpool_exists(char *zpool_name)
  * Description:	Finds out if ZFS dataset already exists
  *
  * Scope:	private
- * Parameters:	zpool_name - ZFS pool name
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
  *		dataset_name - ZFS dataset name
  *
  * Return:	B_TRUE if dataset exists, otherwise B_FALSE
@@ -175,25 +263,256 @@ zfm_zpool_exists(char *zpool_name)
  */
 
 static boolean_t
-zfm_dataset_exists(char *zpool_name, char *dataset_name)
+zfm_dataset_exists(libzfs_handle_t *hdl, char *zpool_name,
+    char *dataset_name)
 {
-	FILE	*p;
-	char	cmd[IDM_MAXCMDLEN];
-	int	ret;
+	char	name[ZFS_MAXNAMELEN];
 
-	(void) snprintf(cmd, sizeof (cmd),
-	    "/usr/sbin/zfs list %s/%s >/dev/null 2>&1", zpool_name,
+	if (hdl == NULL)
+		return (B_FALSE);
+
+	(void) snprintf(name, sizeof (name), "%s/%s", zpool_name,
 	    dataset_name);
 
-	if ((p = popen(cmd, "w")) == NULL)
-		return (B_FALSE);
+	return (zfs_dataset_exists(hdl, name, ZFS_TYPE_DATASET));
+}
 
-	ret = pclose(p);
 
-	if ((ret != -1) && (WEXITSTATUS(ret) == 0))
-		return (B_TRUE);
+/*
+ * Function:	zfm_zpool_create()
+ *
+ * Description:	Creates ZFS pool on one device and mounts its root
+ *		dataset, as 'zpool create -f' does
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *		device - device name, either c#t#d#s# or full path
+ *		fs_props - ZFS properties of root dataset
+ *
+ * Return:	0 - pool created, -1 - creating pool failed
+ *
+ */
+
+static int
+zfm_zpool_create(libzfs_handle_t *hdl, char *zpool_name, char *device,
+    nvlist_t *fs_props)
+{
+	nvlist_t	*nvroot = NULL;
+	nvlist_t	*vdev = NULL;
+	zfs_handle_t	*zhp;
+	char		path[MAXPATHLEN];
+	int		ret = -1;
+
+	if (*device == '/')
+		(void) strlcpy(path, device, sizeof (path));
 	else
-		return (B_FALSE);
+		(void) snprintf(path, sizeof (path), "/dev/dsk/%s", device);
+
+	zfm_debug_print(LS_DBGLVL_INFO, "zpool create -f %s %s\n",
+	    zpool_name, path);
+
+	zfm_debug_print_props(zpool_name, fs_props);
+
+	if (zfm_dryrun_mode_fl)
+		return (0);
+
+	/* root of vdev tree with the only disk vdev */
+
+	if ((nvlist_alloc(&vdev, NV_UNIQUE_NAME, 0) != 0) ||
+	    (nvlist_add_string(vdev, ZPOOL_CONFIG_TYPE, VDEV_TYPE_DISK) != 0) ||
+	    (nvlist_add_string(vdev, ZPOOL_CONFIG_PATH, path) != 0) ||
+	    (nvlist_add_uint64(vdev, ZPOOL_CONFIG_WHOLE_DISK, B_FALSE) != 0) ||
+	    (nvlist_alloc(&nvroot, NV_UNIQUE_NAME, 0) != 0) ||
+	    (nvlist_add_string(nvroot, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT)
+	    != 0) ||
+	    (nvlist_add_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN, &vdev, 1)
+	    != 0)) {
+		zfm_debug_print(LS_DBGLVL_ERR,
+		    "Couldn't create vdev tree for ZFS pool %s\n", zpool_name);
+
+		goto done;
+	}
+
+	if (zpool_create(hdl, zpool_name, nvroot, NULL, fs_props) != 0) {
+		zfm_zfs_error(hdl, "zpool create", zpool_name);
+		goto done;
+	}
+
+	if ((zhp = zfs_open(hdl, zpool_name, ZFS_TYPE_FILESYSTEM)) == NULL) {
+		zfm_zfs_error(hdl, "zfs open", zpool_name);
+		goto done;
+	}
+
+	if (zfs_mount(zhp, NULL, 0) != 0)
+		zfm_zfs_error(hdl, "zfs mount", zpool_name);
+	else
+		ret = 0;
+
+	zfs_close(zhp);
+
+done:
+	nvlist_free(vdev);
+	nvlist_free(nvroot);
+	return (ret);
+}
+
+
+/*
+ * Function:	zfm_zpool_destroy()
+ *
+ * Description:	Unmounts all datasets of ZFS pool and destroys the pool,
+ *		as 'zpool destroy -f' does
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *
+ * Return:	0 - pool destroyed, -1 - destroying pool failed
+ *
+ */
+
+static int
+zfm_zpool_destroy(libzfs_handle_t *hdl, char *zpool_name)
+{
+	zpool_handle_t	*zph;
+	int		ret = 0;
+
+	zfm_debug_print(LS_DBGLVL_INFO, "zpool destroy -f %s\n", zpool_name);
+
+	if (zfm_dryrun_mode_fl)
+		return (0);
+
+	if ((zph = zpool_open_canfail(hdl, zpool_name)) == NULL) {
+		zfm_zfs_error(hdl, "zpool open", zpool_name);
+		return (-1);
+	}
+
+	if (zpool_disable_datasets(zph, B_TRUE) != 0) {
+		zfm_zfs_error(hdl, "zpool unmount", zpool_name);
+		ret = -1;
+	} else if (zpool_destroy(zph) != 0) {
+		zfm_zfs_error(hdl, "zpool destroy", zpool_name);
+		ret = -1;
+	}
+
+	zpool_close(zph);
+	return (ret);
+}
+
+
+/*
+ * Function:	zfm_create_dataset()
+ *
+ * Description:	Creates ZFS filesystem or volume with given properties
+ *		and mounts the filesystem, as 'zfs create [-p]' does.
+ *		Since properties are passed at creation time, each dataset
+ *		is created and mounted only once with its final settings.
+ *		A filesystem created with canmount=noauto is mounted as
+ *		well, as it used to be when properties were set only after
+ *		the filesystem was created and mounted.
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *		dataset_name - ZFS dataset name
+ *		type - ZFS_TYPE_FILESYSTEM or ZFS_TYPE_VOLUME
+ *		zfs_props - ZFS properties, may be NULL
+ *
+ * Return:	0 - dataset created, -1 - creating dataset failed
+ *
+ */
+
+static int
+zfm_create_dataset(libzfs_handle_t *hdl, char *zpool_name,
+    char *dataset_name, zfs_type_t type, nvlist_t *zfs_props)
+{
+	char		name[ZFS_MAXNAMELEN];
+	zfs_handle_t	*zhp;
+	int		ret = 0;
+
+	(void) snprintf(name, sizeof (name), "%s/%s", zpool_name,
+	    dataset_name);
+
+	zfm_debug_print(LS_DBGLVL_INFO, "zfs create %s%s\n",
+	    type == ZFS_TYPE_VOLUME ? "-V " : "-p ", name);
+
+	zfm_debug_print_props(name, zfs_props);
+
+	if (zfm_dryrun_mode_fl)
+		return (0);
+
+	/* create missing parents of filesystem */
+
+	if ((type == ZFS_TYPE_FILESYSTEM) &&
+	    (zfs_create_ancestors(hdl, name) != 0)) {
+		zfm_zfs_error(hdl, "zfs create", name);
+		return (-1);
+	}
+
+	if (zfs_create(hdl, name, type, zfs_props) != 0) {
+		zfm_zfs_error(hdl, "zfs create", name);
+		return (-1);
+	}
+
+	if (type != ZFS_TYPE_FILESYSTEM)
+		return (0);
+
+	/* mount filesystem, unless it can't be mounted at all */
+
+	if ((zhp = zfs_open(hdl, name, ZFS_TYPE_FILESYSTEM)) == NULL) {
+		zfm_zfs_error(hdl, "zfs open", name);
+		return (-1);
+	}
+
+	if ((zfs_prop_get_int(zhp, ZFS_PROP_CANMOUNT) != ZFS_CANMOUNT_OFF) &&
+	    (zfs_mount(zhp, NULL, 0) != 0)) {
+		zfm_zfs_error(hdl, "zfs mount", name);
+		ret = -1;
+	}
+
+	zfs_close(zhp);
+	return (ret);
+}
+
+
+/*
+ * Function:	zfm_volume_reservation()
+ *
+ * Description:	Calculates space to be reserved for ZFS volume of given
+ *		size, as 'zfs create -V' does. It accounts for metadata
+ *		and number of copies besides volume data.
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *		volsize - volume size in bytes
+ *		zfs_props - ZFS properties the volume is created with
+ *
+ * Return:	reservation in bytes, volume size if it couldn't be
+ *		calculated
+ *
+ */
+
+static uint64_t
+zfm_volume_reservation(libzfs_handle_t *hdl, char *zpool_name,
+    uint64_t volsize, nvlist_t *zfs_props)
+{
+	zpool_handle_t	*zph;
+	uint64_t	resv;
+
+	if (zfm_dryrun_mode_fl)
+		return (volsize);
+
+	if ((zph = zpool_open(hdl, zpool_name)) == NULL) {
+		zfm_zfs_error(hdl, "zpool open", zpool_name);
+		return (volsize);
+	}
+
+	resv = zvol_volsize_to_reservation(zph, volsize, zfs_props);
+	zpool_close(zph);
+
+	return (resv);
 }
 
 
@@ -262,25 +581,25 @@ zfm_set_volume_as_dump(char *zpool_name, char *volume_name)
 }
 
 /*
- * Function:	zfm_set_dataset_properties
+ * Function:	zfm_add_dataset_properties
  *
- * Description:	Set ZFS properties for dataset (filesystem or volume)
+ * Description:	Adds ZFS properties for dataset (filesystem or volume)
+ *		to the list of properties the dataset is created with
  *
  * Scope:	private
- * Parameters:	zpool_name - ZFS pool name
- *		dataset_name - ZFS dataset name
+ * Parameters:	dataset_name - ZFS dataset name
  *		props - properties
+ *		zfs_props - ZFS properties for dataset creation
  *
- * Return:	ZFM_E_SUCCESS - all properties successfully set
- *		ZFM_E_ZFS_SET_PROP_FAILED - couldn't set ZFS properties
+ * Return:	ZFM_E_SUCCESS - all properties successfully added
+ *		ZFM_E_ZFS_SET_PROP_FAILED - couldn't add ZFS properties
  *
  */
 
 static zfm_errno_t
-zfm_set_dataset_properties(char *zpool_name, char *dataset_name,
-    nvlist_t *props)
+zfm_add_dataset_properties(char *dataset_name, nvlist_t *props,
+    nvlist_t *zfs_props)
 {
-	char	cmd[IDM_MAXCMDLEN];
 	char	**prop_names, **prop_values;
 	uint_t	prop_numn, prop_numv;
 	int	i;
@@ -301,19 +620,11 @@ zfm_set_dataset_properties(char *zpool_name, char *dataset_name,
 	}
 
 	for (i = 0; i < prop_numn; i++) {
-		(void) snprintf(cmd, sizeof (cmd), "/usr/sbin/zfs set "
-		    "%s=%s %s/%s", prop_names[i], prop_values[i], zpool_name,
-		    dataset_name);
-
-		zfm_debug_print(LS_DBGLVL_INFO,
-		    "Property %s=%s will be set for %s/%s\n", prop_names[i],
-		    prop_values[i], zpool_name, dataset_name);
-
-		if (zfm_system(cmd) == -1) {
+		if (nvlist_add_string(zfs_props, prop_names[i],
+		    prop_values[i]) != 0) {
 			zfm_debug_print(LS_DBGLVL_ERR,
-			    "Couldn't set ZFS property %s=%s for %s/%s\n",
-			    prop_names[i], prop_values[i], zpool_name,
-			    dataset_name);
+			    "Couldn't set ZFS property %s=%s for %s\n",
+			    prop_names[i], prop_values[i], dataset_name);
 
 			return (ZFM_E_ZFS_SET_PROP_FAILED);
 		}
@@ -348,6 +659,9 @@ zfm_create_pool(nvlist_t *attrs)
 	char		*zfs_device;
 	boolean_t	zfs_root_pool_fl = B_TRUE;
 	boolean_t	zfs_preserve_pool_fl;
+	libzfs_handle_t	*hdl;
+	nvlist_t	*fs_props = NULL;
+	zfm_errno_t	ret = ZFM_E_ZFS_POOL_CREATE_FAILED;
 
 	/*
 	 * validate set of attributes provided
@@ -384,30 +698,54 @@ zfm_create_pool(nvlist_t *attrs)
 		zfs_preserve_pool_fl = B_FALSE;
 	}
 
-	if (zfm_zpool_exists(zfs_pool_name)) {
+	/* libzfs is needed for existence check even in dry run mode */
+
+	if ((hdl = zfm_zfs_init()) == NULL && !zfm_dryrun_mode_fl)
+		return (ZFM_E_ZFS_POOL_CREATE_FAILED);
+
+	if (zfm_zpool_exists(hdl, zfs_pool_name)) {
 		if (zfs_preserve_pool_fl) {
 			zfm_debug_print(LS_DBGLVL_INFO,
 			    "pool <%s> already exists, will be preserved\n",
 			    zfs_pool_name);
 
-			return (ZFM_E_SUCCESS);
+			ret = ZFM_E_SUCCESS;
+			goto done;
 		} else {
 			zfm_debug_print(LS_DBGLVL_WARN,
 			    "root pool <%s> already exists, will be "
 			    "destroyed\n", zfs_pool_name);
 
-			(void) snprintf(cmd, sizeof (cmd),
-			    "/usr/sbin/zpool destroy -f %s", zfs_pool_name);
-
-			if (zfm_system(cmd) == -1) {
+			if (zfm_zpool_destroy(hdl, zfs_pool_name) == -1) {
 				zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
 				    "Couldn't destroy ZFS pool\n");
 
-				return (ZFM_E_ZFS_POOL_CREATE_FAILED);
+				goto done;
 			}
 		}
 	}
 
+	/*
+	 * Root pool is marked as 'busy' when it is created - ZFS user
+	 * property is set for root dataset 'rpool':
+	 *	org.openindiana.caiman:install=busy
+	 * After installer finishes its job, the property value is
+	 * changed to 'ready' indicating successful installation
+	 */
+
+	if (zfs_root_pool_fl) {
+		if ((nvlist_alloc(&fs_props, NV_UNIQUE_NAME, 0) != 0) ||
+		    (nvlist_add_string(fs_props, TI_RPOOL_PROPERTY_STATE,
+		    TI_RPOOL_BUSY) != 0)) {
+			zfm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't set user property for ZFS dataset %s: "
+			    TI_RPOOL_PROPERTY_STATE "=" TI_RPOOL_BUSY "\n",
+			    zfs_pool_name);
+
+			goto done;
+		}
+	}
+
 	/*
 	 * display ZFS pool parameters for debugging purposes
 	 */
@@ -416,28 +754,16 @@ zfm_create_pool(nvlist_t *attrs)
 	    "zfs: ZFS pool <%s> will be created on slice <%s>\n",
 	    zfs_pool_name, zfs_device);
 
-	(void) snprintf(cmd, sizeof (cmd),
-	    "/usr/sbin/zpool create -f %s %s",
-	    zfs_pool_name, zfs_device);
-
-	if (zfm_system(cmd) == -1) {
+	if (zfm_zpool_create(hdl, zfs_pool_name, zfs_device, fs_props) == -1) {
 		zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
 		    "Couldn't create ZFS pool\n");
 
-		return (ZFM_E_ZFS_POOL_CREATE_FAILED);
+		goto done;
 	}
 
 	/*
-	 * For root pool, do more things right now:
-	 *
-	 * [1] create "boot/grub" directory in root dataset
+	 * For root pool, create "boot/grub" directory in root dataset
 	 * for holding menu.lst file.
-	 *
-	 * [2] mark created pool as 'busy' - ZFS user property
-	 * is set for root dataset 'rpool':
-	 *	org.openindiana.caiman:install=busy
-	 * After installer finishes its job, the property value is
-	 * changed to 'ready' indicating successful installation
 	 */
 
 	if (zfs_root_pool_fl) {
@@ -451,24 +777,19 @@ zfm_create_pool(nvlist_t *attrs)
 			    "dataset <%s>\n", ZFM_GRUB_MENU_DIR,
 			    zfs_pool_name);
 
-			return (ZFM_E_ZFS_POOL_CREATE_FAILED);
+			goto done;
 		}
+	}
 
-		(void) snprintf(cmd, sizeof (cmd),
-		    "/usr/sbin/zfs set %s=%s %s", TI_RPOOL_PROPERTY_STATE,
-		    TI_RPOOL_BUSY, zfs_pool_name);
+	ret = ZFM_E_SUCCESS;
 
-		if (zfm_system(cmd) == -1) {
-			zfm_debug_print(LS_DBGLVL_ERR,
-			    "Couldn't set user property for ZFS dataset %s: "
-			    TI_RPOOL_PROPERTY_STATE "=" TI_RPOOL_BUSY,
-			    zfs_pool_name);
+done:
+	nvlist_free(fs_props);
 
-			return (ZFM_E_ZFS_POOL_CREATE_FAILED);
-		}
-	}
+	if (hdl != NULL)
+		libzfs_fini(hdl);
 
-	return (ZFM_E_SUCCESS);
+	return (ret);
 }
 
 
@@ -494,6 +815,8 @@ zfm_release_pool(nvlist_t *attrs)
 	char		*zfs_pool_name;
 	char		*zfs_device;
 	boolean_t	zfs_root_pool_fl = B_TRUE;
+	libzfs_handle_t	*hdl;
+	int		ret;
 
 	/*
 	 * validate set of attributes provided
@@ -560,10 +883,16 @@ zfm_release_pool(nvlist_t *attrs)
 	}
 
 	/* And finally destroy ZFS pool */
-	(void) snprintf(cmd, sizeof (cmd),
-	    "/usr/sbin/zpool destroy -f %s", zfs_pool_name);
 
-	if (zfm_system(cmd) != 0) {
+	if ((hdl = zfm_zfs_init()) == NULL && !zfm_dryrun_mode_fl)
+		return (ZFM_E_ZFS_POOL_RELEASE_FAILED);
+
+	ret = zfm_zpool_destroy(hdl, zfs_pool_name);
+
+	if (hdl != NULL)
+		libzfs_fini(hdl);
+
+	if (ret != 0) {
 		zfm_debug_print(LS_DBGLVL_INFO,
 		    "Releasing of ZFS pool %s failed\n", zfs_pool_name);
 
@@ -595,14 +924,15 @@ zfm_release_pool(nvlist_t *attrs)
 zfm_errno_t
 zfm_create_fs(nvlist_t *attrs)
 {
-	char		cmd[IDM_MAXCMDLEN];
-
 	char		**fs_names;
 	char		*zfs_pool_name;
 	nvlist_t	**props;
+	nvlist_t	*zfs_props;
+	libzfs_handle_t	*hdl;
 	uint_t		nelem;
 	int		i;
 	uint16_t	fs_num;
+	zfm_errno_t	ret = ZFM_E_SUCCESS;
 
 	/*
 	 * validate set of attributes provided
@@ -664,8 +994,12 @@ zfm_create_fs(nvlist_t *attrs)
 
 	/* if invoked in dry run mode, no changes done to the target */
 
+	if ((hdl = zfm_zfs_init()) == NULL && !zfm_dryrun_mode_fl)
+		return (ZFM_E_ZFS_FS_CREATE_FAILED);
+
 	/*
-	 * create file systems and set properties
+	 * create file systems with their properties, all of them
+	 * through the same libzfs handle
 	 */
 
 	for (i = 0; i < fs_num; i++) {
@@ -673,7 +1007,7 @@ zfm_create_fs(nvlist_t *attrs)
 		 * if dataset already exists, don't create it
 		 */
 
-		if (zfm_dataset_exists(zfs_pool_name, fs_names[i])) {
+		if (zfm_dataset_exists(hdl, zfs_pool_name, fs_names[i])) {
 			zfm_debug_print(LS_DBGLVL_INFO,
 			    "dataset <%s/%s> already exists, won't be created "
 			    "again\n", zfs_pool_name, fs_names[i]);
@@ -681,36 +1015,52 @@ zfm_create_fs(nvlist_t *attrs)
 			continue;
 		}
 
-		(void) snprintf(cmd, sizeof (cmd), "/usr/sbin/zfs "
-		    "create -p %s/%s", zfs_pool_name, fs_names[i]);
-
-		if (zfm_system(cmd) == -1) {
-			zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
-			    "Couldn't create ZFS filesystem\n");
+		if (nvlist_alloc(&zfs_props, NV_UNIQUE_NAME, 0) != 0) {
+			zfm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't allocate ZFS properties\n");
 
-			return (ZFM_E_ZFS_FS_CREATE_FAILED);
+			ret = ZFM_E_ZFS_FS_CREATE_FAILED;
+			break;
 		}
 
 		/*
-		 * Set ZFS properties if provided
+		 * Pass ZFS properties at creation time if provided
 		 */
 
 		if (props != NULL && props[i] != NULL) {
-			if (zfm_set_dataset_properties(zfs_pool_name,
-			    fs_names[i], props[i]) != ZFM_E_SUCCESS)
-				return (ZFM_E_ZFS_FS_CREATE_FAILED);
+			if (zfm_add_dataset_properties(fs_names[i], props[i],
+			    zfs_props) != ZFM_E_SUCCESS) {
+				nvlist_free(zfs_props);
+				ret = ZFM_E_ZFS_FS_CREATE_FAILED;
+				break;
+			}
 		} else {
 			zfm_debug_print(LS_DBGLVL_INFO,
 			    "Properties not provided for %s dataset\n",
 			    fs_names[i]);
 		}
+
+		if (zfm_create_dataset(hdl, zfs_pool_name, fs_names[i],
+		    ZFS_TYPE_FILESYSTEM, zfs_props) == -1) {
+			zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
+			    "Couldn't create ZFS filesystem\n");
+
+			nvlist_free(zfs_props);
+			ret = ZFM_E_ZFS_FS_CREATE_FAILED;
+			break;
+		}
+
+		nvlist_free(zfs_props);
 	}
 
+	if (hdl != NULL)
+		libzfs_fini(hdl);
+
 	if (zfm_dryrun_mode_fl) {
 		(void) sleep(1);
 	}
 
-	return (ZFM_E_SUCCESS);
+	return (ret);
 }
 
 
@@ -733,6 +1083,8 @@ zfm_fs_exists(nvlist_t *attrs)
 	char		*zfs_pool_name;
 	uint_t		nelem;
 	uint16_t	fs_num;
+	libzfs_handle_t	*hdl;
+	boolean_t	exists;
 
 	/*
 	 * validate set of attributes provided
@@ -787,7 +1139,13 @@ zfm_fs_exists(nvlist_t *attrs)
 	zfm_debug_print(LS_DBGLVL_INFO, "ZFS fs to be checked: %s/%s\n",
 	    zfs_pool_name, fs_names[0]);
 
-	return (zfm_dataset_exists(zfs_pool_name, fs_names[0]));
+	if ((hdl = zfm_zfs_init()) == NULL)
+		return (B_FALSE);
+
+	exists = zfm_dataset_exists(hdl, zfs_pool_name, fs_names[0]);
+
+	libzfs_fini(hdl);
+	return (exists);
 }
 
 /*
@@ -812,16 +1170,18 @@ zfm_fs_exists(nvlist_t *attrs)
 zfm_errno_t
 zfm_create_volumes(nvlist_t *attrs)
 {
-	char		cmd[IDM_MAXCMDLEN];
-
 	char		*zfs_pool_name;
 	char		**vol_names;
 	uint32_t	*vol_sizes;
 	uint16_t	*vol_types = NULL;
 	nvlist_t	**props;
+	nvlist_t	*zfs_props;
+	libzfs_handle_t	*hdl;
+	uint64_t	volsize;
 	uint_t		nelem;
 	int		i;
 	uint16_t	vol_num;
+	zfm_errno_t	ret = ZFM_E_SUCCESS;
 
 	/*
 	 * validate set of attributes provided
@@ -930,12 +1290,15 @@ zfm_create_volumes(nvlist_t *attrs)
 		    vol_types == NULL ? 0 : vol_types[i]);
 	}
 
+	if ((hdl = zfm_zfs_init()) == NULL && !zfm_dryrun_mode_fl)
+		return (ZFM_E_ZFS_VOL_CREATE_FAILED);
+
 	for (i = 0; i < vol_num; i++) {
 		/*
 		 * If volume already exists, do nothing
 		 */
 
-		if (zfm_dataset_exists(zfs_pool_name, vol_names[i])) {
+		if (zfm_dataset_exists(hdl, zfs_pool_name, vol_names[i])) {
 			zfm_debug_print(LS_DBGLVL_WARN,
 			    "volume <%s/%s> already exists, nothing will be "
 			    "done\n", zfs_pool_name, vol_names[i]);
@@ -946,6 +1309,9 @@ zfm_create_volumes(nvlist_t *attrs)
 		/*
 		 * Create ZFS volumes
 		 *
+		 * Space is reserved for the volume, as 'zfs create -V' does
+		 * unless sparse volume is requested.
+		 *
 		 * Handle volumes dedicated to swap or dump
 		 * in special way:
 		 * both:
@@ -960,48 +1326,84 @@ zfm_create_volumes(nvlist_t *attrs)
 		 *  - call dumpadm(1M) to enable dump on volume
 		 */
 
-		if (vol_types == NULL ||
-		    (vol_types[i] != TI_ZFS_VOL_TYPE_SWAP &&
-		    vol_types[i] != TI_ZFS_VOL_TYPE_DUMP)) {
-			(void) snprintf(cmd, sizeof (cmd),
-			    "/usr/sbin/zfs create -V %dm %s/%s",
-			    vol_sizes[i], zfs_pool_name, vol_names[i]);
-		} else {
-			int	blocksize;
+		volsize = (uint64_t)vol_sizes[i] * 1024 * 1024;
+
+		if ((nvlist_alloc(&zfs_props, NV_UNIQUE_NAME, 0) != 0) ||
+		    (nvlist_add_uint64(zfs_props,
+		    zfs_prop_to_name(ZFS_PROP_VOLSIZE), volsize) != 0)) {
+			zfm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't allocate ZFS properties\n");
+
+			ret = ZFM_E_ZFS_VOL_CREATE_FAILED;
+			break;
+		}
+
+		if (vol_types != NULL &&
+		    (vol_types[i] == TI_ZFS_VOL_TYPE_SWAP ||
+		    vol_types[i] == TI_ZFS_VOL_TYPE_DUMP)) {
+			uint64_t	blocksize;
 
 			if (vol_types[i] == TI_ZFS_VOL_TYPE_SWAP)
 				blocksize = ZFM_SWAP_BLOCK_SIZE;
 			else
 				blocksize = ZFM_DUMP_BLOCK_SIZE;
 
-			(void) snprintf(cmd, sizeof (cmd),
-			    "/usr/sbin/zfs create -b %d -V %dm %s/%s",
-			    blocksize, vol_sizes[i], zfs_pool_name,
-			    vol_names[i]);
+			if (nvlist_add_uint64(zfs_props,
+			    zfs_prop_to_name(ZFS_PROP_VOLBLOCKSIZE),
+			    blocksize) != 0) {
+				zfm_debug_print(LS_DBGLVL_ERR,
+				    "Couldn't allocate ZFS properties\n");
 
-		}
-
-		if (zfm_system(cmd) == -1) {
-			zfm_debug_print(LS_DBGLVL_ERR,
-			    "Couldn't create ZFS volume <%s> on pool <%s>\n",
-			    vol_names[i], zfs_pool_name);
-
-			return (ZFM_E_ZFS_VOL_CREATE_FAILED);
+				nvlist_free(zfs_props);
+				ret = ZFM_E_ZFS_VOL_CREATE_FAILED;
+				break;
+			}
 		}
 
 		/*
-		 * Set ZFS properties if provided
+		 * Pass ZFS properties at creation time if provided,
+		 * they may request reservation other than default one
 		 */
 		if (props != NULL && props[i] != NULL) {
-			if (zfm_set_dataset_properties(zfs_pool_name,
-			    vol_names[i], props[i]) != ZFM_E_SUCCESS)
-				return (ZFM_E_ZFS_FS_CREATE_FAILED);
+			if (zfm_add_dataset_properties(vol_names[i], props[i],
+			    zfs_props) != ZFM_E_SUCCESS) {
+				nvlist_free(zfs_props);
+				ret = ZFM_E_ZFS_FS_CREATE_FAILED;
+				break;
+			}
 		} else {
 			zfm_debug_print(LS_DBGLVL_INFO,
 			    "Properties not provided for %s dataset\n",
 			    vol_names[i]);
 		}
 
+		if (!nvlist_exists(zfs_props,
+		    zfs_prop_to_name(ZFS_PROP_REFRESERVATION)) &&
+		    (nvlist_add_uint64(zfs_props,
+		    zfs_prop_to_name(ZFS_PROP_REFRESERVATION),
+		    zfm_volume_reservation(hdl, zfs_pool_name, volsize,
+		    zfs_props)) != 0)) {
+			zfm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't allocate ZFS properties\n");
+
+			nvlist_free(zfs_props);
+			ret = ZFM_E_ZFS_VOL_CREATE_FAILED;
+			break;
+		}
+
+		if (zfm_create_dataset(hdl, zfs_pool_name, vol_names[i],
+		    ZFS_TYPE_VOLUME, zfs_props) == -1) {
+			zfm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't create ZFS volume <%s> on pool <%s>\n",
+			    vol_names[i], zfs_pool_name);
+
+			nvlist_free(zfs_props);
+			ret = ZFM_E_ZFS_VOL_CREATE_FAILED;
+			break;
+		}
+
+		nvlist_free(zfs_props);
+
 		if (vol_types == NULL)
 			continue;
 
@@ -1072,7 +1474,10 @@ zfm_create_volumes(nvlist_t *attrs)
 		}
 	}
 
-	return (ZFM_E_SUCCESS);
+	if (hdl != NULL)
+		libzfs_fini(hdl);
+
+	return (ret);
 }
 
 
@@ -22,6 +22,8 @@
 # Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
 # Use is subject to license terms.
 #
+import filecmp
+import os
 from libtransfer import *
 from transfer_mod import tm_perform_transfer
 
@@ -40,6 +42,78 @@ else:
 	num_failed += 1
 	print "FAILED"
 
+print "Testing valid src, dest, and file with cpio(1) engine.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_CPIO),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_ENGINE, TM_CPIO_ENGINE_CPIO),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/cpio_entire4'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing valid src, dest, and file with native engine.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_CPIO),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_ENGINE, TM_CPIO_ENGINE_NATIVE),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/cpio_entire5'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS and \
+    filecmp.cmp('/usr/sbin/zlogin', '/export/home/cpio_entire5/usr/sbin/zlogin',
+    shallow=False):
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing file over existing directory with native engine.  " \
+    "directory should be kept"
+os.makedirs('/export/home/cpio_entire6/usr/sbin/zlogin')
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_CPIO),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_ENGINE, TM_CPIO_ENGINE_NATIVE),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/cpio_entire6'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS and \
+    os.path.isdir('/export/home/cpio_entire6/usr/sbin/zlogin') and \
+    os.path.isfile('/export/home/cpio_entire6/usr/sbin/zoneadm'):
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing directory times kept with native engine and -m.  " \
+    "should PASS"
+src = '/export/home/cpio_mtime_src'
+dirs = ['d', 'd/e']
+os.makedirs(os.path.join(src, 'd/e'))
+open(os.path.join(src, 'd/f'), 'w').write('f')
+open(os.path.join(src, 'd/e/g'), 'w').write('g')
+for d in dirs:
+	os.utime(os.path.join(src, d), (1000000000, 1000000000))
+list_file = open('/export/home/cpio_mtime_list', 'w')
+list_file.write('d\nd/e\nd/f\nd/e/g\n')
+list_file.close()
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_CPIO),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_ENGINE, TM_CPIO_ENGINE_NATIVE),
+    (TM_CPIO_ARGS, 'pdm'),
+    (TM_CPIO_LIST_FILE, '/export/home/cpio_mtime_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/cpio_entire7'),
+    (TM_CPIO_SRC_MNTPT, src)])
+if status == TM_E_SUCCESS and \
+    [os.stat(os.path.join('/export/home/cpio_entire7', d)).st_mtime
+    for d in dirs] == [1000000000] * len(dirs):
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
 print "Testing missing TM_CPIO_ACTION, should FAIL"
 status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_CPIO),
     (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
@@ -82,6 +82,9 @@ TM_IPS_PROP_NAME = TM_DEFINES['TM_IPS_PROP_NAME'].strip('"')
 TM_IPS_PROP_VALUE = TM_DEFINES['TM_IPS_PROP_VALUE'].strip('"')
 TM_IPS_ALT_URL = TM_DEFINES['TM_IPS_ALT_URL'].strip('"')
 TM_UNPACK_ARCHIVE = TM_DEFINES['TM_UNPACK_ARCHIVE'].strip('"')
+TM_CPIO_ENGINE = TM_DEFINES['TM_CPIO_ENGINE'].strip('"')
+TM_CPIO_ENGINE_NATIVE = int(TM_DEFINES['TM_CPIO_ENGINE_NATIVE'])
+TM_CPIO_ENGINE_CPIO = int(TM_DEFINES['TM_CPIO_ENGINE_CPIO'])
 
 # The following is only useful for python code, not C code.  So, it will 
 # only be defined here, instead of being defined in transfermod.h
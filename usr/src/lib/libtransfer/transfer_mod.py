@@ -21,6 +21,7 @@
 # Copyright (c) 2008, 2010, Oracle and/or its affiliates. All rights reserved.
 #
 """ Slim Install Transfer Module """
+import array
 import errno
 import operator
 import sys
@@ -35,6 +36,7 @@ import re
 import liblogsvc as logsvc
 import libtransfer as tmod
 from osol_install.install_utils import exec_cmd_outputs_to_log
+from osol_install.install_utils import scan_tree
 from osol_install.transfer_defs import TRANSFER_ID, \
     TM_ATTR_IMAGE_INFO, \
     TM_ATTR_MECHANISM, \
@@ -75,6 +77,8 @@ from osol_install.transfer_defs import TRANSFER_ID, \
     TM_IPS_ALT_URL, \
     TM_IPS_INIT_RETRY_TIMEOUT, \
     TM_UNPACK_ARCHIVE, \
+    TM_CPIO_ENGINE, \
+    TM_CPIO_ENGINE_NATIVE, \
     TM_PYTHON_LOG_HANDLER, \
     TM_E_SUCCESS, \
     TM_E_INVALID_TRANSFER_TYPE_ATTR, \
@@ -97,6 +101,8 @@ class TMDefs(object):
     MAX_NUMFILES = 200000.0
     FIND_PERCENT = 4
     CPIO = "/usr/bin/cpio"
+    # cpio pass mode options the native copy engine knows how to honor
+    NATIVE_CPIO_ARGS = "pdum"
     PKG = "/usr/bin/pkg"
     MOUNT = "/usr/sbin/mount -o ro,nologging "
     GZCAT = "/usr/bin/gzcat "
@@ -130,6 +136,11 @@ class Flist(object):
         self.clobber_files = clobber_files
         self.cpio_args = cpio_args
         self.handle = None
+        # Planned transfer size of the list, in bytes and entries, and
+        # the size of each entry in list order. None if not known.
+        self.nbytes = None
+        self.nfiles = None
+        self.sizes = None
 
     def open(self):
         """Open a file"""
@@ -175,6 +186,7 @@ class TIPSPkgmissing(TError):
 
 def tm_abort_transfer():
     """Method to signal to abort the transfer"""
+    tmod.copy_abort()
     if PARAMS.tm_lock.locked():
         PARAMS.tm_lock.release()
     else:
@@ -186,99 +198,91 @@ def tm_abort_signaled():
 
 class ProgressMon(object):
     """The ProgressMon class contains methods to monitor
-          the progress of the transfer
+          the progress of the transfer. Progress is computed from the
+          bytes and files transferred against the bytes and files
+          planned, as reported by the copy engine.
        """
-    def __init__(self, message=None, distrosize=0,
-        initpct=0, endpct=0, done=0):
+    def __init__(self, message=None, initpct=0, endpct=100):
         self.message = message
-        self.distrosize = distrosize
         self.initpct = initpct
         self.endpct = endpct
-        self.done = done
-        self.thread1 = None
-
-    def startmonitor(self, filesys, distrosize, message, initpct=0,
+        self.total_bytes = 0
+        self.total_files = 0
+        self.bytes_done = 0
+        self.files_done = 0
+        self.list_base = (0, 0)
+        self.list_planned = True
+        self.prevpct = -1
+        self.bytes_accounted = 0
+
+    def startmonitor(self, total_bytes, total_files, message, initpct=0,
         endpct=100):
-        """Start thread to monitor progress in populating file system
-           filesys - file system to monitor
-           distrosize = full distro size in kilobytes
-           message = progress message to log. 
+        """Start monitoring the progress of a transfer
+           total_bytes - planned number of bytes to transfer
+           total_files - planned number of files to transfer
+           message = progress message to log.
            initpct = base percent value from which to start calculating.
            endpct = percentage value at which to stop calculating
            """
-        self.message =	message
-        self.distrosize = distrosize
+        self.message = message
+        self.total_bytes = total_bytes
+        self.total_files = total_files
         self.initpct = initpct
         self.endpct = endpct
-        self.done = False
-        self.thread1 = threading.Thread(target=self.__progressthread,
-                                        args=(filesys, ))
-        self.thread1.start()
+        self.bytes_done = 0
+        self.files_done = 0
+        self.prevpct = -1
+        self.bytes_accounted = 0
+        self.report()
         return 0
 
-    def wait(self):
-        """Wait"""
-        self.thread1.join()
+    def begin_list(self, fent):
+        """Note the start of the transfer of the file list in fent"""
+        self.list_base = (self.bytes_done, self.files_done)
+        self.list_planned = fent.nbytes is not None
 
-    def __progressthread(self, filesystem):
-        """Monitor progress in populating file system
-              filesystem - file system to monitor
+    def list_progress(self, bytes_done, files_done, bytes_total,
+                      files_total):
+        """Progress callback of the copy engine for the current list.
+           Counts are cumulative for the list. If the list wasn't
+           planned up front, its totals are added to the planned totals.
            """
-        initsize = self.__fssize(filesystem)
-        totpct = self.endpct - self.initpct
-        prevpct = -1
-
-        # Loop until the user aborts or we're done transferring.
-        # Keep track of the percentage done and let the user know
-        # how far the transfer has progressed.
-        while True:
-            # Compute increase in filesystem size
-            fssz = self.__fssize(filesystem)
-            if (fssz == -1):
-                return -1
-            fsgain = fssz - initsize
-
-            # Compute percentage transfer
-            actualpct = fsgain * 100 / self.distrosize
-            # Compute percentage transfer in terms of stated range
-            pct = fsgain * totpct / self.distrosize + self.initpct
-            # Do not exceed limits
-            if pct >= self.endpct or actualpct > 100:
-                pct = self.endpct
-            # If the percentage has changed at all, log the
-            # progress so the user can see something is going on.
-            if (pct != prevpct):
-                tmod.logprogress(int(pct), self.message)
-                prevpct = pct
-            if pct >= self.endpct:
-                return 0
-            time.sleep(2)
-            if tm_abort_signaled() or self.done:
-                return 0
-
-    @staticmethod
-    def __fssize(filesystem):
-        """Find the current size of the specified file system.
-			filesystem - file system to monitor
-		Returns the size of the filesystem in kilobytes
-		"""	
-        cmd = "/usr/bin/df -k " + filesystem
-        output = os.popen(cmd)
-        # Read the header and throw it away....
-        dfout = output.readline()
-        if not dfout:
-            logsvc.write_log(TRANSFER_ID, "FS size computation " +
-                             "failed for " + filesystem + "\n")
-            return -1
-        # read the line with the size information.
-        dfout = output.readline()
-        if not dfout:
-            logsvc.write_log(TRANSFER_ID, "FS size computation " +
-                             "failed for " + filesystem + "\n")
-            return -1
-        # and yank out the size information
-        line_tokens = dfout.split()
-        return int(line_tokens[2])
+        if not self.list_planned:
+            self.total_bytes += bytes_total
+            self.total_files += files_total
+            self.list_planned = True
+        self.bytes_done = self.list_base[0] + bytes_done
+        self.files_done = self.list_base[1] + files_done
+        self.report()
+
+    def update(self, nbytes, nfiles):
+        """Account for nbytes and nfiles more having been transferred"""
+        self.bytes_done += nbytes
+        self.files_done += nfiles
+        self.report()
+
+    def report(self):
+        """Log the progress if the percentage has changed at all, so
+           the user can see something is going on. Bytes transferred
+           since the last report are accounted to the C module, which
+           lets the installer tell how much each install phase wrote.
+           """
+        if self.bytes_done > self.bytes_accounted:
+            tmod.account_bytes(self.bytes_done - self.bytes_accounted)
+            self.bytes_accounted = self.bytes_done
+        if self.total_bytes > 0:
+            frac = float(self.bytes_done) / self.total_bytes
+        elif self.total_files > 0:
+            frac = float(self.files_done) / self.total_files
+        else:
+            frac = 0.0
+        pct = int(self.initpct + frac * (self.endpct - self.initpct))
+        # Do not exceed limits
+        if pct > self.endpct:
+            pct = self.endpct
+        if pct != self.prevpct:
+            tmod.logprogress(pct, self.message)
+            self.prevpct = pct
 
 
 class TransferCpio(object):
@@ -300,6 +304,7 @@ class TransferCpio(object):
         self.distro_size = 0
         self.log_handler = None
         self.unpack_archive = None
+        self.cpio_engine = TM_CPIO_ENGINE_NATIVE
 
         # This is live media specific and shouldn't be part
         # of transfer mod.
@@ -380,6 +385,13 @@ class TransferCpio(object):
                 pass
         filehandle.close()
 
+    @staticmethod
+    def regular_size(st1):
+        """Number of bytes a file list entry accounts for in progress"""
+        if st.S_ISREG(st1.st_mode):
+            return st1.st_size
+        return 0
+
     @staticmethod
     def check_abort():
         """Check if the user aborted the transfer""" 
@@ -532,108 +544,91 @@ class TransferCpio(object):
                     # Store the extent location of the
                     # hsfs file and the filename to a
                     # temporary list
-                    tmp_flist.append((st1.st_ino, fname))
+                    tmp_flist.append((st1.st_ino, fname,
+                                      self.regular_size(st1)))
             else:
                 #
-                # os.walk does not recurse into directory
-                # symlinks so nftw(..., FTW_PHYS) is satisfied.
-                # In addition, we want to restrict our search
-                # only to the current filesystem which is
-                # handled below.
+                # Take an inventory of the tree in a single pass.
+                # Symbolic links are not followed, so nftw(..., FTW_PHYS)
+                # is satisfied, and directories holding other mounted
+                # filesystems are listed but not descended into, as
+                # nftw(..., FTW_MOUNT) would. The inventory starts with
+                # the cpio directory itself, which is not listed.
                 #
-                for root, dirs, files in os.walk(cp.cpio_dir):
-                    self.check_abort()
-                    for name in files:
-                        match = None
-                        fname = root + "/" + name
-                        if patt is not None:
-                            match = \
-                                cpatt.match(name)
-                            # If we have a match on
-                            # the name but the
-                            # pattern was !, then
-                            # that's really a
-                            # non-match.  Also, if
-                            # no match is found
-                            # but the pattern
-                            # was not ! it's a
-                            # non-match.
-                            if (match is not None \
-                                and negate) \
-                                or (match is None \
-                                    and not negate):
-                                self.dbg_msg(
-                                    "Non " \
-                                    "match. " \
-                                    "Skipped:" \
-                                    + fname)
-                                continue
-
-                        try:
-                            st1 = os.lstat(fname)
-                        except OSError:
-                            self.info_msg(
-                                          "Warning: Error" +
-                                          " processing " +
-                                          fname)
-                            continue
-
-                        # Store the extent location of
-                        # the hsfs file and the
-                        # filename to a temporary list
-                        tmp_flist.append((st1.st_ino,
-                                         fname))
-
-                        nfiles = nfiles + 1
-                        PARAMS.percent = int(nfiles /
-                                             TMDefs.MAX_NUMFILES *
-                                             total_find_percent)
-                        if PARAMS.percent - opercent > 1:
-                            tmod.logprogress(
-                                PARAMS.percent, "Building cpio file lists")
-                            opercent = PARAMS.percent
+                try:
+                    inventory = scan_tree(cp.cpio_dir, same_fs=True)
+                except OSError:
+                    raise TAbort("Failed to access Cpio dir: " +
+                                 traceback.format_exc(),
+                                 TM_E_CPIO_ENTIRE_FAILED)
+                self.check_abort()
 
+                for (fname, mode, size, nlink, ino) in inventory[1:]:
                     #
-                    # Identify directories that we do not
-                    # want to traverse.  These are those
-                    # that can't be read for some reason
-                    # or those holding other mounted
-                    # filesystems.
+                    # Symbolic links to directories are taken as
+                    # directories, identified by the inode of the
+                    # directory they point to. Those which can't be
+                    # followed are taken as files.
                     #
-                    rmlist = []
-                    for name in dirs:
-                        dname = root + "/" + name
+                    is_dir = st.S_ISDIR(mode)
+                    if st.S_ISLNK(mode):
                         try:
-                            st1 = os.stat(dname)
+                            st1 = os.stat(fname)
+                            if st.S_ISDIR(st1.st_mode):
+                                is_dir = True
+                                ino = st1.st_ino
                         except OSError:
-                            rmlist.append(name)
-                            continue
+                            pass
 
+                    if is_dir:
                         # Store the extent location of
                         # the hsfs file and the
                         # filename to a temporary list
-                        tmp_flist.append((st1.st_ino,
-                                         dname))
+                        tmp_flist.append((ino, fname, 0))
+                        continue
 
-                        # Emulate nftw(..., FTW_MOUNT)
-                        # for directories.
-                        if st1.st_dev != st2.st_dev:
-                            rmlist.append(name)
+                    if patt is not None:
+                        match = cpatt.match(os.path.basename(fname))
+                        # If we have a match on the name but
+                        # the pattern was !, then that's
+                        # really a non-match.  Also, if no
+                        # match is found but the pattern was
+                        # not ! it's a non-match.
+                        if (match is not None and negate) or \
+                            (match is None and not negate):
+                            self.dbg_msg("Non match. Skipped:" + fname)
+                            continue
 
-                    #
-                    # Remove directories so that they are
-                    # not traversed.   os.walk allows dirs
-                    # to be modified in place.
-                    #
-                    for dname in rmlist:
-                        dirs.remove(dname)
+                    # Store the extent location of
+                    # the hsfs file and the
+                    # filename to a temporary list
+                    if st.S_ISREG(mode):
+                        tmp_flist.append((ino, fname, size))
+                    else:
+                        tmp_flist.append((ino, fname, 0))
+                    nfiles = nfiles + 1
+
+                PARAMS.percent = int(nfiles / TMDefs.MAX_NUMFILES *
+                                     total_find_percent)
+                if PARAMS.percent - opercent > 1:
+                    tmod.logprogress(PARAMS.percent,
+                                     "Building cpio file lists")
+                    opercent = PARAMS.percent
 
             # Write file list out to the file, after sorting
-            # by the inode number, which is the first item
+            # by the inode number, which is the first item.
+            # Keep track of the planned transfer size as we go.
             tmp_flist.sort(key=operator.itemgetter(0))
             lf = fent.handle
-            for entry in map(operator.itemgetter(1), tmp_flist):
+            if fent.sizes is None:
+                fent.nbytes = 0
+                fent.nfiles = 0
+                fent.sizes = array.array('d')
+            for (ino, entry, size) in tmp_flist:
                 lf.write(entry + "\n")
+                fent.sizes.append(size)
+                fent.nbytes += size
+            fent.nfiles += len(tmp_flist)
             lf.flush()
 				
         for fent in fent_list:
@@ -699,6 +694,35 @@ class TransferCpio(object):
         if self.skip_file_list:
             self.cpio_skip_files()
 
+    def use_native_copy(self, cpio_args):
+        """Determine whether the native copy engine can stand in for
+           cpio with the given arguments.
+           """
+        if self.cpio_engine != TM_CPIO_ENGINE_NATIVE:
+            return False
+        for opt in cpio_args:
+            if opt not in TMDefs.NATIVE_CPIO_ARGS:
+                return False
+        return True
+
+    def native_transfer_filelist(self, fent, err_code, pmon):
+        """Copy the files listed in fent using the native copy engine.
+           The current working directory must be fent.chdir_prefix.
+           """
+        self.dbg_msg("Copying " + fent.name + " to " + self.dst_mntpt +
+                     " CWD: " + fent.chdir_prefix)
+        self.check_abort()
+        (status, nerrors) = tmod.copy_filelist(fent.name, self.dst_mntpt,
+                                               fent.cpio_args, 0,
+                                               pmon.list_progress)
+        self.check_abort()
+        if status != 0:
+            raise TAbort("Copy of " + fent.name + " failed: " +
+                         os.strerror(status), err_code)
+        if nerrors != 0:
+            self.info_msg("WARNING: copy of " + fent.name + " had " +
+                          str(nerrors) + " errors")
+
     def cpio_transfer_filelist(self, fent_list, err_code):
         """Transfer every file in fent_list"""
         self.info_msg("Beginning cpio actions")
@@ -710,16 +734,21 @@ class TransferCpio(object):
         #
 
         #
-        # Start the disk space monitor thread
+        # Start monitoring progress against the planned transfer size.
+        # Lists which weren't planned up front are accounted for
+        # once the copy engine has read them.
         #
-        if self.distro_size:
-            pmon = ProgressMon()
-            pmon.startmonitor(self.dst_mntpt, self.distro_size,
-                              "Transferring Contents", PARAMS.percent, 95)
+        pmon = ProgressMon()
+        pmon.startmonitor(sum([fent.nbytes for fent in fent_list
+                               if fent.nbytes is not None]),
+                          sum([fent.nfiles for fent in fent_list
+                               if fent.nfiles is not None]),
+                          "Transferring Contents", PARAMS.percent, 95)
 
         # Walk file lists, cpio'ing each in turn.
         for fent in fent_list:
             self.check_abort()
+            pmon.begin_list(fent)
 
             if fent.clobber_files == 1:
                 self.do_clobber_files(fent.name)
@@ -729,6 +758,18 @@ class TransferCpio(object):
             except OSError:
                 raise TAbort("Failed to access " +
                              fent.chdir_prefix, err_code)
+
+            if self.use_native_copy(fent.cpio_args):
+                self.native_transfer_filelist(fent, err_code, pmon)
+                continue
+
+            # Without a plan from the file tree walk, progress is
+            # tracked by the number of entries in the list.
+            if fent.nfiles is None:
+                flist = open(fent.name, 'r')
+                pmon.list_progress(0, 0, 0, len(flist.readlines()))
+                flist.close()
+
             cmd = TMDefs.CPIO + " -" + fent.cpio_args + "V " + \
                 self.dst_mntpt + " < " + fent.name
             self.dbg_msg("Executing: " + cmd + " CWD: " +
@@ -743,10 +784,19 @@ class TransferCpio(object):
             else:
                 pipe = sp.Popen(cmd, shell=True, stdout=sp.PIPE,
                              stderr=err_file, close_fds=True)
+                # cpio prints a dot per pathname, in list order
+                nent = 0
                 char = True
                 while char:
                     char = pipe.stdout.read(1)
                     self.check_abort()
+                    if char == '.':
+                        if fent.sizes is not None and \
+                            nent < len(fent.sizes):
+                            pmon.update(int(fent.sizes[nent]), 1)
+                        else:
+                            pmon.update(0, 1)
+                        nent += 1
                 retval = pipe.wait()
 
                 if retval != 0 and self.debugflag == 1:
@@ -758,10 +808,6 @@ class TransferCpio(object):
 
                 err_file.close()
 
-        if self.distro_size:
-            pmon.done = True
-            pmon.wait()
-
 
     def perform_transfer(self, args):
         """Main function for doing the copying of bits"""
@@ -792,6 +838,8 @@ class TransferCpio(object):
                 self.log_handler = val
             elif opt == TM_UNPACK_ARCHIVE:
                 self.unpack_archive = val
+            elif opt == TM_CPIO_ENGINE:
+                self.cpio_engine = val
             else:
                 raise TValueError("Invalid attribute " +
                                   str(opt), 
@@ -821,8 +869,8 @@ class TransferCpio(object):
 
         #
         # Read in approx size of the entire distribution from
-        # .image_info file. This is used for disk space usage
-        # monitoring.
+        # .image_info file. Progress is tracked against the
+        # file lists, but the file is still validated here.
         #
         if self.image_info:
             try:
@@ -1418,6 +1466,10 @@ def tm_perform_transfer(args, callback=None):
         # C code.
         tmod.set_py_callback(callback)
 
+        # An abort of a previous transfer must not stop this one, but
+        # aborts raised from now on are kept until the transfer ends.
+        tmod.copy_reset()
+
         action = ""
         for opt, val in args:
             if opt == TM_ATTR_MECHANISM:
@@ -72,11 +72,14 @@ extern "C" {
 #define	TM_IPS_PROP_VALUE		"TM_IPS_PROP_VALUE"
 #define	TM_IPS_VERBOSE_MODE		"TM_IPS_VERBOSE_MODE"
 #define	TM_UNPACK_ARCHIVE		"TM_UNPACK_ARCHIVE"
+#define	TM_CPIO_ENGINE			"TM_CPIO_ENGINE"
 
 #define	TM_PERFORM_CPIO		0
 #define	TM_PERFORM_IPS		1
 #define	TM_CPIO_ENTIRE		0
 #define	TM_CPIO_LIST		1
+#define	TM_CPIO_ENGINE_NATIVE	0
+#define	TM_CPIO_ENGINE_CPIO	1
 #define	TM_IPS_INIT		0
 #define	TM_IPS_REPO_CONTENTS_VERIFY	1
 #define	TM_IPS_RETRIEVE		2
@@ -118,6 +121,7 @@ typedef void (*tm_callback_t)(const int percentage,
 
 tm_errno_t TM_perform_transfer(nvlist_t *targs, tm_callback_t progress);
 void TM_abort_transfer(void);
+uint64_t TM_bytes_copied(void);
 void TM_enable_debug(void);
 
 #ifdef __cplusplus
@@ -27,7 +27,12 @@
 #include <libnvpair.h>
 #include <ls_api.h>
 #include <errno.h>
+#include <atomic.h>
+#include <sys/time.h>
+#include "pysession.h"
 #include "transfermod.h"
+#include "tm_copy.h"
+#include "tm_scan.h"
 
 #define	TRANSFER_PY_SCRIPT "osol_install.transfer_mod"
 #define	PERFORM_TRANSFER_FUNC "tm_perform_transfer"
@@ -36,12 +41,12 @@
 
 static PyObject *tmod_logprogress(PyObject *self, PyObject *args);
 static PyObject *tmod_set_callback(PyObject *self, PyObject *args);
+static PyObject *tmod_account_bytes(PyObject *self, PyObject *args);
 
-static PyThreadState * mainThreadState = NULL;
 static tm_callback_t progress;
 static PyObject *py_callback = NULL;
 static int dbgflag = 0;
-static char *empty_argv[1] = { "" };
+static volatile uint64_t bytes_copied = 0;
 
 void initlibtransfer();
 
@@ -52,6 +57,16 @@ static struct PyMethodDef libtransferMethods[] = {
 	    "Record the percentage completion of the transfer process"},
 	{"set_py_callback", tmod_set_callback, METH_VARARGS,
 	    "Save the Python callback"},
+	{"account_bytes", tmod_account_bytes, METH_VARARGS,
+	    "Add to the number of bytes written by transfers"},
+	{"copy_filelist", tmod_copy_filelist, METH_VARARGS,
+	    "Copy a list of files using the native copy engine"},
+	{"copy_abort", tmod_copy_abort, METH_VARARGS,
+	    "Abort a copy in progress in the native copy engine"},
+	{"copy_reset", tmod_copy_reset, METH_VARARGS,
+	    "Forget an abort of a previous transfer"},
+	{"scan_tree", tmod_scan_tree, METH_VARARGS,
+	    "Return an inventory of a directory tree"},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -119,6 +134,23 @@ tmod_set_callback(PyObject *self, PyObject *args)
 	return (Py_BuildValue("i", rval));
 }
 
+/*
+ * Called by the progress monitor of the Python module with the number
+ * of bytes it has seen transferred since its last call.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_account_bytes(PyObject *self, PyObject *args)
+{
+	unsigned PY_LONG_LONG	nbytes;
+
+	if (!PyArg_ParseTuple(args, "K", &nbytes))
+		return (NULL);
+
+	atomic_add_64(&bytes_copied, (uint64_t)nbytes);
+	return (Py_BuildValue("i", 0));
+}
+
 /*
  * The C interface to tm_perform_transfer (python module)
  * This function will parse the nvlist and put the values
@@ -129,13 +161,13 @@ tmod_set_callback(PyObject *self, PyObject *args)
 tm_errno_t
 TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 {
-	PyObject	*pFunc, *pModule = NULL, *pName;
+	PyObject	*pFunc;
 	PyObject	*pArgs, *pValues;
 	nvpair_t	*curr;
 	tm_errno_t	rv = TM_E_SUCCESS;
 	int		i, numpairs = 0;
-	PyThreadState	*myThreadState;
-	boolean_t	call_Py_Finalize = B_FALSE;
+	ps_state_t	pyState;
+	ps_stats_t	stats;
 
 	if (dbgflag)
 		nvlist_add_string(nvl, "dbgflag", "true");
@@ -149,57 +181,20 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 		curr = next;
 	}
 
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
-
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
-
-		/*
-		 * If the Python interpreter was initialized here, allow
-		 * destroying its context before we leave this function.
-		 * Otherwise, keep the context alive for other potential
-		 * existing Python consumers.
-		 */
-		call_Py_Finalize = B_TRUE;
-	}
-
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
-	progress = prog;
-
-	pModule = NULL;
-	if ((pName = PyString_FromString(TRANSFER_PY_SCRIPT)) != NULL) {
-		pModule = PyImport_Import(pName);
-		Py_DECREF(pName);
-	}
-	if (pModule == NULL) {
-		PyErr_Print();
+	if (!ps_session_init()) {
 		ls_write_log_message(TRANSFER_ID,
 		    "Call failed: %s\n", PERFORM_TRANSFER_FUNC);
-
-		/*
-		 * release the Python interpreter only if we initialized it.
-		 * Otherwise we might destroy the context of other Python
-		 * consumers which are still active.
-		 */
-
-		if (call_Py_Finalize)
-			Py_Finalize();
-
 		return (TM_E_PYTHON_ERROR);
 	}
 
+	ls_trace_begin(LS_TRACE_TM, "perform_transfer", numpairs);
+	pyState = ps_session_enter();
+	progress = prog;
+
 	/* Load the Transfer Module */
-	pFunc = PyObject_GetAttrString(pModule, PERFORM_TRANSFER_FUNC);
-	/* pFunc is a new reference */
-	if (pFunc && PyCallable_Check(pFunc)) {
+	pFunc = ps_get_function(TRANSFER_PY_SCRIPT, PERFORM_TRANSFER_FUNC);
+	/* pFunc is a borrowed reference owned by the session */
+	if (pFunc != NULL) {
 		char *val;
 		PyObject *pTuple;
 		PyObject *pRet;
@@ -223,6 +218,7 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 
 			if (strcmp(name, TM_ATTR_MECHANISM) == 0 ||
 			    strcmp(name, TM_CPIO_ACTION) == 0 ||
+			    strcmp(name, TM_CPIO_ENGINE) == 0 ||
 			    strcmp(name, TM_IPS_ACTION) == 0) {
 				uint32_t val;
 
@@ -246,7 +242,10 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 
 			if (!pTuple) {
 				Py_DECREF(pArgs);
-				Py_DECREF(pModule);
+				Py_DECREF(pValues);
+				ps_session_exit(pyState);
+				ls_trace_end(LS_TRACE_TM, "perform_transfer",
+				    1);
 				ls_write_log_message(TRANSFER_ID,
 				    "Cannot convert argument\n");
 				return (1);
@@ -264,32 +263,25 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 			rv = PyInt_AsLong(pRet);
 			Py_DECREF(pRet);
 		} else {
-			Py_DECREF(pFunc);
-			Py_DECREF(pModule);
 			PyErr_Print();
 			ls_write_log_message(TRANSFER_ID,
 			    "Call failed: %s\n", PERFORM_TRANSFER_FUNC);
 			rv = TM_E_PYTHON_ERROR;
 		}
 	} else {
-		if (PyErr_Occurred())
-			PyErr_Print();
+		PyErr_Print();
+		ls_write_log_message(TRANSFER_ID,
+		    "Call failed: %s\n", PERFORM_TRANSFER_FUNC);
 		rv = TM_E_PYTHON_ERROR;
 	}
-	Py_XDECREF(pFunc);
-	Py_DECREF(pModule);
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+	ps_session_exit(pyState);
+	ls_trace_end(LS_TRACE_TM, "perform_transfer", rv);
 
-	/*
-	 * release the Python interpreter only if we initialized it.
-	 * Otherwise we might destroy the context of other Python consumers
-	 * which are still active.
-	 */
-
-	if (call_Py_Finalize)
-		Py_Finalize();
+	ps_session_stats(&stats);
+	ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_INFO,
+	    "Python session: %llu calls, %llu ms in the interpreter\n",
+	    (u_longlong_t)stats.pst_crossings,
+	    (u_longlong_t)(stats.pst_boundary_ns / (NANOSEC / MILLISEC)));
 
 	return (rv);
 }
@@ -300,94 +292,48 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 void
 TM_abort_transfer()
 {
-	PyObject *pFunc, *pModule, *pName;
-	boolean_t	call_Py_Finalize = B_FALSE;
-
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
+	PyObject	*pFunc, *pRet;
+	ps_state_t	pyState;
 
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
-
-		/*
-		 * If the Python interpreter was initialized here, allow
-		 * destroying its context before we leave this function.
-		 * Otherwise, keep the context alive for other potential
-		 * existing Python consumers.
-		 */
-		call_Py_Finalize = B_TRUE;
-	}
+	/*
+	 * The native copy engine runs without the interpreter lock, so
+	 * tell it directly rather than only through the Python module.
+	 */
+	tm_copy_abort();
 
-	pName = PyString_FromString(TRANSFER_PY_SCRIPT);
-	if (pName == NULL) {
-		PyErr_Print();
+	if (!ps_session_init()) {
 		ls_write_log_message(TRANSFER_ID,
 		    "Call failed: %s\n", TRANSFER_ABORT_FUNC);
-
-		/*
-		 * release the Python interpreter only if we initialized it.
-		 * Otherwise we might destroy the context of other Python
-		 * consumers which are still active.
-		 */
-
-		if (call_Py_Finalize)
-			Py_Finalize();
-
 		return;
 	}
 
-	pModule = PyImport_Import(pName);
-	if (!pModule) {
-		PyErr_Print();
-		ls_write_log_message(TRANSFER_ID,
-		    "Call failed: %s\n", TRANSFER_ABORT_FUNC);
-
-		/*
-		 * release the Python interpreter only if we initialized it.
-		 * Otherwise we might destroy the context of other Python
-		 * consumers which are still active.
-		 */
-
-		if (call_Py_Finalize)
-			Py_Finalize();
-
-		return;
-	}
+	pyState = ps_session_enter();
 
 	/* Load the Transfer Module */
-	pFunc = PyObject_GetAttrString(pModule, TRANSFER_ABORT_FUNC);
-	/* pFunc is a new reference */
-	if (pFunc && PyCallable_Check(pFunc)) {
+	pFunc = ps_get_function(TRANSFER_PY_SCRIPT, TRANSFER_ABORT_FUNC);
+	/* pFunc is a borrowed reference owned by the session */
+	if (pFunc != NULL) {
 		/* Call our transfer script */
-		PyObject_CallObject(pFunc, NULL);
-	} else {
-		if (PyErr_Occurred())
+		pRet = PyObject_CallObject(pFunc, NULL);
+		Py_XDECREF(pRet);
+	}
+	if (PyErr_Occurred()) {
 		PyErr_Print();
-
-
-		/*
-		 * release the Python interpreter only if we initialized it.
-		 * Otherwise we might destroy the context of other Python
-		 * consumers which are still active.
-		 */
-
-		if (call_Py_Finalize)
-			Py_Finalize();
-		return;
+		ls_write_log_message(TRANSFER_ID,
+		    "Call failed: %s\n", TRANSFER_ABORT_FUNC);
 	}
 
-	/*
-	 * release the Python interpreter only if we initialized it.
-	 * Otherwise we might destroy the context of other Python
-	 * consumers which are still active.
-	 */
+	ps_session_exit(pyState);
+}
 
-	if (call_Py_Finalize)
-		Py_Finalize();
+/*
+ * Return the number of bytes written by all transfers of this process
+ * so far. Callers interested in a single transfer take the difference.
+ */
+uint64_t
+TM_bytes_copied()
+{
+	return (atomic_add_64_nv(&bytes_copied, 0));
 }
 
 /* Enable debugging messages */
@@ -0,0 +1,908 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Native copy engine used by the transfer module in place of a
+ * "cpio -pdum" pipeline.
+ *
+ * The file list is read and every pathname is stat'ed once. Directories
+ * are created up front in list order, so that the remaining objects can
+ * be copied by a pool of worker threads in any order. Hard links are
+ * resolved after all workers are done and directory ownership and modes
+ * are applied last, so that restrictive directory permissions can't get
+ * in the way of populating the tree.
+ *
+ * The engine keeps count of the bytes and files it has processed against
+ * the totals found in the file list. While the workers run, the calling
+ * thread hands those counters to a progress function at regular intervals.
+ */
+
+#include <Python.h>
+#include <atomic.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/attr.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <ls_api.h>
+#include "tm_copy.h"
+
+#define	TRANSFER_ID "TRANSFERMOD"
+
+typedef struct tm_copy_ent {
+	char		*ce_name;	/* pathname as given in the file list */
+	struct stat	ce_st;		/* lstat(2) of the source */
+	int		ce_master;	/* entry this one is a hard link to */
+} tm_copy_ent_t;
+
+typedef struct tm_copy {
+	tm_copy_ent_t	*cp_ents;
+	size_t		cp_nents;
+	size_t		cp_next;	/* next entry to hand to a worker */
+	pthread_mutex_t	cp_lock;
+	pthread_cond_t	cp_cv;		/* signaled as workers finish */
+	int		cp_nrunning;	/* workers still running */
+	const char	*cp_dst;	/* destination directory */
+	int		cp_flags;	/* TM_COPY_* options */
+	boolean_t	cp_chown;	/* preserve ownership */
+	uint_t		cp_nerrors;
+	uint64_t	cp_bytes_total;	/* regular file bytes in the list */
+	uint64_t	cp_files_total;	/* entries in the list */
+	volatile uint64_t cp_bytes_done;
+	volatile uint64_t cp_files_done;
+} tm_copy_t;
+
+/* Python callback state for tmod_copy_progress() */
+typedef struct tmod_copy_cb {
+	PyObject	*cb_func;
+	PyThreadState	*cb_state;
+} tmod_copy_cb_t;
+
+static volatile int tm_copy_aborted = 0;
+
+static void
+tm_copy_error(tm_copy_t *cp, const char *fmt, ...)
+{
+	char	buf[LS_MESSAGE_MAXLEN];
+	va_list	ap;
+
+	va_start(ap, fmt);
+	(void) vsnprintf(buf, sizeof (buf), fmt, ap);
+	va_end(ap);
+
+	ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_WARN, "%s\n", buf);
+
+	(void) pthread_mutex_lock(&cp->cp_lock);
+	cp->cp_nerrors++;
+	(void) pthread_mutex_unlock(&cp->cp_lock);
+}
+
+/*
+ * Create all missing parent directories of path, like cpio -d does.
+ */
+static int
+tm_copy_mkparents(const char *path)
+{
+	char	buf[MAXPATHLEN];
+	char	*p;
+
+	(void) strlcpy(buf, path, sizeof (buf));
+	for (p = strchr(buf + 1, '/'); p != NULL; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+			return (-1);
+		}
+		*p = '/';
+	}
+	return (0);
+}
+
+/*
+ * Decide whether the destination may be replaced by the source, removing
+ * it if so. Without -u an existing destination is only replaced if it
+ * is older than the source. An existing directory is kept for a
+ * directory source and can't be replaced by anything else.
+ */
+static boolean_t
+tm_copy_replace(tm_copy_t *cp, tm_copy_ent_t *ce, const char *dst)
+{
+	struct stat	dst_st;
+
+	if (lstat(dst, &dst_st) != 0)
+		return (B_TRUE);
+
+	if (S_ISDIR(dst_st.st_mode)) {
+		if (S_ISDIR(ce->ce_st.st_mode))
+			return (B_TRUE);
+		tm_copy_error(cp, "Cannot replace directory <%s>", dst);
+		return (B_FALSE);
+	}
+
+	if (!(cp->cp_flags & TM_COPY_UNCOND) &&
+	    dst_st.st_mtime >= ce->ce_st.st_mtime) {
+		ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_INFO,
+		    "current <%s> newer or same age\n", dst);
+		return (B_FALSE);
+	}
+
+	if (unlink(dst) != 0 && errno != ENOENT) {
+		tm_copy_error(cp, "Cannot unlink <%s>: %s", dst,
+		    strerror(errno));
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+static int
+tm_copy_data(int sfd, int dfd, char *buf)
+{
+	ssize_t	rd, wr, off;
+
+	while ((rd = read(sfd, buf, TM_COPY_BUFSZ)) != 0) {
+		if (rd < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		for (off = 0; off < rd; off += wr) {
+			if ((wr = write(dfd, buf + off, rd - off)) < 0) {
+				if (errno == EINTR) {
+					wr = 0;
+					continue;
+				}
+				return (-1);
+			}
+		}
+	}
+	return (0);
+}
+
+/*
+ * Copy the extended attributes of an open source file to an open
+ * destination file. System attributes views are skipped.
+ */
+static int
+tm_copy_xattrs(tm_copy_t *cp, const char *src, int sfd, int dfd, char *buf)
+{
+	DIR		*dirp;
+	struct dirent	*dp;
+	struct stat	ast;
+	int		sattr, dattr, afd, tfd;
+	int		ret = 0;
+
+	if (pathconf(src, _PC_XATTR_EXISTS) != 1)
+		return (0);
+
+	if ((sattr = openat(sfd, ".", O_RDONLY | O_XATTR)) < 0)
+		return (-1);
+	if ((dattr = openat(dfd, ".", O_RDONLY | O_XATTR)) < 0) {
+		(void) close(sattr);
+		return (-1);
+	}
+	if ((dirp = fdopendir(sattr)) == NULL) {
+		(void) close(sattr);
+		(void) close(dattr);
+		return (-1);
+	}
+
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 ||
+		    strcmp(dp->d_name, "..") == 0 ||
+		    strcmp(dp->d_name, VIEW_READONLY) == 0 ||
+		    strcmp(dp->d_name, VIEW_READWRITE) == 0)
+			continue;
+
+		if ((afd = openat(sattr, dp->d_name, O_RDONLY)) < 0) {
+			ret = -1;
+			continue;
+		}
+		if (fstat(afd, &ast) != 0 || (tfd = openat(dattr, dp->d_name,
+		    O_WRONLY | O_CREAT | O_TRUNC, ast.st_mode & 07777)) < 0) {
+			(void) close(afd);
+			ret = -1;
+			continue;
+		}
+		if (tm_copy_data(afd, tfd, buf) != 0)
+			ret = -1;
+		if (cp->cp_chown)
+			(void) fchown(tfd, ast.st_uid, ast.st_gid);
+		(void) close(tfd);
+		(void) close(afd);
+	}
+
+	(void) closedir(dirp);
+	(void) close(dattr);
+	return (ret);
+}
+
+static void
+tm_copy_times(tm_copy_t *cp, tm_copy_ent_t *ce, const char *dst)
+{
+	struct timeval	tv[2];
+
+	if (!(cp->cp_flags & TM_COPY_MTIME))
+		return;
+
+	tv[0].tv_sec = ce->ce_st.st_atime;
+	tv[0].tv_usec = 0;
+	tv[1].tv_sec = ce->ce_st.st_mtime;
+	tv[1].tv_usec = 0;
+	if (utimes(dst, tv) != 0)
+		tm_copy_error(cp, "Cannot set time on <%s>: %s", dst,
+		    strerror(errno));
+}
+
+static void
+tm_copy_file(tm_copy_t *cp, tm_copy_ent_t *ce, const char *dst, char *buf)
+{
+	int	sfd, dfd;
+
+	if ((sfd = open(ce->ce_name, O_RDONLY)) < 0) {
+		tm_copy_error(cp, "Cannot open <%s>: %s", ce->ce_name,
+		    strerror(errno));
+		return;
+	}
+
+	dfd = open(dst, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (dfd < 0 && errno == ENOENT && (cp->cp_flags & TM_COPY_MKDIRS) &&
+	    tm_copy_mkparents(dst) == 0)
+		dfd = open(dst, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (dfd < 0) {
+		tm_copy_error(cp, "Cannot create <%s>: %s", dst,
+		    strerror(errno));
+		(void) close(sfd);
+		return;
+	}
+
+	if (ce->ce_st.st_size != 0 && tm_copy_data(sfd, dfd, buf) != 0)
+		tm_copy_error(cp, "Cannot copy <%s>: %s", ce->ce_name,
+		    strerror(errno));
+
+	/* chown(2) clears set-id bits, so ownership goes first */
+	if (cp->cp_chown &&
+	    fchown(dfd, ce->ce_st.st_uid, ce->ce_st.st_gid) != 0)
+		tm_copy_error(cp, "Cannot chown <%s>: %s", dst,
+		    strerror(errno));
+	if (fchmod(dfd, ce->ce_st.st_mode & 07777) != 0)
+		tm_copy_error(cp, "Cannot chmod <%s>: %s", dst,
+		    strerror(errno));
+	if (tm_copy_xattrs(cp, ce->ce_name, sfd, dfd, buf) != 0)
+		tm_copy_error(cp, "Cannot copy extended attributes of <%s>",
+		    ce->ce_name);
+
+	(void) close(dfd);
+	(void) close(sfd);
+
+	tm_copy_times(cp, ce, dst);
+}
+
+static void
+tm_copy_symlink(tm_copy_t *cp, tm_copy_ent_t *ce, const char *dst)
+{
+	char	target[MAXPATHLEN];
+	ssize_t	len;
+	int	ret;
+
+	if ((len = readlink(ce->ce_name, target, sizeof (target) - 1)) < 0) {
+		tm_copy_error(cp, "Cannot read symbolic link <%s>: %s",
+		    ce->ce_name, strerror(errno));
+		return;
+	}
+	target[len] = '\0';
+
+	ret = symlink(target, dst);
+	if (ret != 0 && errno == ENOENT && (cp->cp_flags & TM_COPY_MKDIRS) &&
+	    tm_copy_mkparents(dst) == 0)
+		ret = symlink(target, dst);
+	if (ret != 0) {
+		tm_copy_error(cp, "Cannot create symbolic link <%s>: %s",
+		    dst, strerror(errno));
+		return;
+	}
+
+	if (cp->cp_chown &&
+	    lchown(dst, ce->ce_st.st_uid, ce->ce_st.st_gid) != 0)
+		tm_copy_error(cp, "Cannot chown <%s>: %s", dst,
+		    strerror(errno));
+}
+
+static void
+tm_copy_special(tm_copy_t *cp, tm_copy_ent_t *ce, const char *dst)
+{
+	int	ret;
+
+	ret = mknod(dst, ce->ce_st.st_mode, ce->ce_st.st_rdev);
+	if (ret != 0 && errno == ENOENT && (cp->cp_flags & TM_COPY_MKDIRS) &&
+	    tm_copy_mkparents(dst) == 0)
+		ret = mknod(dst, ce->ce_st.st_mode, ce->ce_st.st_rdev);
+	if (ret != 0) {
+		tm_copy_error(cp, "Cannot mknod <%s>: %s", dst,
+		    strerror(errno));
+		return;
+	}
+
+	if (cp->cp_chown &&
+	    chown(dst, ce->ce_st.st_uid, ce->ce_st.st_gid) != 0)
+		tm_copy_error(cp, "Cannot chown <%s>: %s", dst,
+		    strerror(errno));
+	if (chmod(dst, ce->ce_st.st_mode & 07777) != 0)
+		tm_copy_error(cp, "Cannot chmod <%s>: %s", dst,
+		    strerror(errno));
+	tm_copy_times(cp, ce, dst);
+}
+
+/*
+ * Copy a single non-directory file list entry.
+ */
+static void
+tm_copy_one(tm_copy_t *cp, tm_copy_ent_t *ce, char *buf)
+{
+	char	dst[MAXPATHLEN];
+
+	(void) snprintf(dst, sizeof (dst), "%s/%s", cp->cp_dst, ce->ce_name);
+
+	if (!tm_copy_replace(cp, ce, dst))
+		return;
+
+	switch (ce->ce_st.st_mode & S_IFMT) {
+	case S_IFREG:
+		tm_copy_file(cp, ce, dst, buf);
+		break;
+	case S_IFLNK:
+		tm_copy_symlink(cp, ce, dst);
+		break;
+	case S_IFCHR:
+	case S_IFBLK:
+	case S_IFIFO:
+		tm_copy_special(cp, ce, dst);
+		break;
+	default:
+		tm_copy_error(cp, "<%s> is not a supported file type",
+		    ce->ce_name);
+		break;
+	}
+}
+
+/*
+ * Number of bytes an entry accounts for in the progress counters.
+ */
+static uint64_t
+tm_copy_ent_bytes(tm_copy_ent_t *ce)
+{
+	return (S_ISREG(ce->ce_st.st_mode) ? (uint64_t)ce->ce_st.st_size : 0);
+}
+
+static void
+tm_copy_account(tm_copy_t *cp, uint64_t nbytes, uint64_t nfiles)
+{
+	atomic_add_64(&cp->cp_bytes_done, nbytes);
+	atomic_add_64(&cp->cp_files_done, nfiles);
+}
+
+static void
+tm_copy_report(tm_copy_t *cp, tm_copy_progress_t progress, void *arg)
+{
+	if (progress != NULL)
+		(*progress)(arg, cp->cp_bytes_done, cp->cp_files_done,
+		    cp->cp_bytes_total, cp->cp_files_total);
+}
+
+static void *
+tm_copy_worker(void *arg)
+{
+	tm_copy_t	*cp = arg;
+	tm_copy_ent_t	*ce;
+	char		*buf;
+	size_t		i, first, last;
+	uint64_t	nbytes, nfiles;
+
+	if ((buf = malloc(TM_COPY_BUFSZ)) == NULL) {
+		tm_copy_error(cp, "Cannot allocate copy buffer");
+		goto done;
+	}
+
+	while (!tm_copy_aborted) {
+		(void) pthread_mutex_lock(&cp->cp_lock);
+		first = cp->cp_next;
+		last = MIN(first + TM_COPY_BATCH, cp->cp_nents);
+		cp->cp_next = last;
+		(void) pthread_mutex_unlock(&cp->cp_lock);
+
+		if (first >= last)
+			break;
+
+		nbytes = nfiles = 0;
+		for (i = first; i < last && !tm_copy_aborted; i++) {
+			ce = &cp->cp_ents[i];
+			if (S_ISDIR(ce->ce_st.st_mode) || ce->ce_master != -1)
+				continue;
+			tm_copy_one(cp, ce, buf);
+			nbytes += tm_copy_ent_bytes(ce);
+			nfiles++;
+		}
+		tm_copy_account(cp, nbytes, nfiles);
+	}
+
+	free(buf);
+done:
+	(void) pthread_mutex_lock(&cp->cp_lock);
+	cp->cp_nrunning--;
+	(void) pthread_cond_signal(&cp->cp_cv);
+	(void) pthread_mutex_unlock(&cp->cp_lock);
+	return (NULL);
+}
+
+/*
+ * Wait for all workers to finish, reporting progress every
+ * TM_COPY_PROGRESS_MS milliseconds in the meantime.
+ */
+static void
+tm_copy_wait(tm_copy_t *cp, tm_copy_progress_t progress, void *arg)
+{
+	timespec_t	rel;
+
+	rel.tv_sec = TM_COPY_PROGRESS_MS / 1000;
+	rel.tv_nsec = (TM_COPY_PROGRESS_MS % 1000) * 1000000;
+
+	(void) pthread_mutex_lock(&cp->cp_lock);
+	while (cp->cp_nrunning > 0) {
+		(void) pthread_cond_reltimedwait_np(&cp->cp_cv, &cp->cp_lock,
+		    &rel);
+		if (cp->cp_nrunning > 0) {
+			(void) pthread_mutex_unlock(&cp->cp_lock);
+			tm_copy_report(cp, progress, arg);
+			(void) pthread_mutex_lock(&cp->cp_lock);
+		}
+	}
+	(void) pthread_mutex_unlock(&cp->cp_lock);
+}
+
+/*
+ * Create a directory from the file list. Ownership, modes and times
+ * are applied by tm_copy_dir_attrs() once the tree is populated.
+ */
+static void
+tm_copy_mkdir(tm_copy_t *cp, tm_copy_ent_t *ce)
+{
+	char		dst[MAXPATHLEN];
+	struct stat	dst_st;
+	int		ret;
+
+	(void) snprintf(dst, sizeof (dst), "%s/%s", cp->cp_dst, ce->ce_name);
+
+	if (lstat(dst, &dst_st) == 0) {
+		if (S_ISDIR(dst_st.st_mode))
+			return;
+		if (!tm_copy_replace(cp, ce, dst))
+			return;
+	}
+
+	ret = mkdir(dst, S_IRWXU);
+	if (ret != 0 && errno == ENOENT && (cp->cp_flags & TM_COPY_MKDIRS) &&
+	    tm_copy_mkparents(dst) == 0)
+		ret = mkdir(dst, S_IRWXU);
+	if (ret != 0 && errno != EEXIST)
+		tm_copy_error(cp, "Cannot create directory <%s>: %s", dst,
+		    strerror(errno));
+}
+
+static void
+tm_copy_dir_attrs(tm_copy_t *cp, tm_copy_ent_t *ce, char *buf)
+{
+	char	dst[MAXPATHLEN];
+	int	sfd, dfd;
+
+	(void) snprintf(dst, sizeof (dst), "%s/%s", cp->cp_dst, ce->ce_name);
+
+	if (cp->cp_chown &&
+	    chown(dst, ce->ce_st.st_uid, ce->ce_st.st_gid) != 0)
+		tm_copy_error(cp, "Cannot chown <%s>: %s", dst,
+		    strerror(errno));
+	if (chmod(dst, ce->ce_st.st_mode & 07777) != 0)
+		tm_copy_error(cp, "Cannot chmod <%s>: %s", dst,
+		    strerror(errno));
+
+	if (pathconf(ce->ce_name, _PC_XATTR_EXISTS) == 1 &&
+	    (sfd = open(ce->ce_name, O_RDONLY)) >= 0) {
+		if ((dfd = open(dst, O_RDONLY)) >= 0) {
+			if (tm_copy_xattrs(cp, ce->ce_name, sfd, dfd,
+			    buf) != 0)
+				tm_copy_error(cp,
+				    "Cannot copy extended attributes of <%s>",
+				    ce->ce_name);
+			(void) close(dfd);
+		}
+		(void) close(sfd);
+	}
+
+	/* last, since writing attributes may touch the directory again */
+	tm_copy_times(cp, ce, dst);
+}
+
+/*
+ * Recreate the hard link in dst of an entry whose master has already
+ * been copied. Fall back to a full copy if that isn't possible.
+ */
+static void
+tm_copy_link(tm_copy_t *cp, tm_copy_ent_t *ce, char *buf)
+{
+	char	src[MAXPATHLEN];
+	char	dst[MAXPATHLEN];
+
+	(void) snprintf(src, sizeof (src), "%s/%s", cp->cp_dst,
+	    cp->cp_ents[ce->ce_master].ce_name);
+	(void) snprintf(dst, sizeof (dst), "%s/%s", cp->cp_dst, ce->ce_name);
+
+	tm_copy_account(cp, tm_copy_ent_bytes(ce), 1);
+
+	if (!tm_copy_replace(cp, ce, dst))
+		return;
+
+	if (link(src, dst) == 0)
+		return;
+	if (errno == ENOENT && (cp->cp_flags & TM_COPY_MKDIRS) &&
+	    tm_copy_mkparents(dst) == 0 && link(src, dst) == 0)
+		return;
+
+	ce->ce_master = -1;
+	tm_copy_one(cp, ce, buf);
+}
+
+/*
+ * Sort order used to group entries sharing an inode. Entries are
+ * ordered by list position within a group so that the first one in
+ * the list becomes the master, just like with cpio.
+ */
+static int
+tm_copy_inode_cmp(const void *a, const void *b)
+{
+	const tm_copy_ent_t	*ea = *(const tm_copy_ent_t **)a;
+	const tm_copy_ent_t	*eb = *(const tm_copy_ent_t **)b;
+
+	if (ea->ce_st.st_dev != eb->ce_st.st_dev)
+		return (ea->ce_st.st_dev < eb->ce_st.st_dev ? -1 : 1);
+	if (ea->ce_st.st_ino != eb->ce_st.st_ino)
+		return (ea->ce_st.st_ino < eb->ce_st.st_ino ? -1 : 1);
+	return (ea < eb ? -1 : (ea > eb ? 1 : 0));
+}
+
+/*
+ * Find groups of hard linked entries and point every entry of a group
+ * to the first one.
+ */
+static int
+tm_copy_find_links(tm_copy_t *cp)
+{
+	tm_copy_ent_t	**links;
+	size_t		i, nlinks = 0;
+
+	for (i = 0; i < cp->cp_nents; i++) {
+		if (!S_ISDIR(cp->cp_ents[i].ce_st.st_mode) &&
+		    cp->cp_ents[i].ce_st.st_nlink > 1)
+			nlinks++;
+	}
+	if (nlinks < 2)
+		return (0);
+
+	if ((links = malloc(nlinks * sizeof (tm_copy_ent_t *))) == NULL)
+		return (-1);
+
+	nlinks = 0;
+	for (i = 0; i < cp->cp_nents; i++) {
+		if (!S_ISDIR(cp->cp_ents[i].ce_st.st_mode) &&
+		    cp->cp_ents[i].ce_st.st_nlink > 1)
+			links[nlinks++] = &cp->cp_ents[i];
+	}
+	qsort(links, nlinks, sizeof (tm_copy_ent_t *), tm_copy_inode_cmp);
+
+	for (i = 1; i < nlinks; i++) {
+		if (links[i]->ce_st.st_dev == links[i - 1]->ce_st.st_dev &&
+		    links[i]->ce_st.st_ino == links[i - 1]->ce_st.st_ino) {
+			links[i]->ce_master = links[i - 1]->ce_master != -1 ?
+			    links[i - 1]->ce_master :
+			    (int)(links[i - 1] - cp->cp_ents);
+		}
+	}
+
+	free(links);
+	return (0);
+}
+
+/*
+ * Read the file list, stat every entry relative to the current working
+ * directory and record it.
+ */
+static int
+tm_copy_read_list(tm_copy_t *cp, const char *list_file)
+{
+	FILE		*fp;
+	char		line[MAXPATHLEN + 2];
+	size_t		len, nalloc = 0;
+	tm_copy_ent_t	*ce, *ents;
+
+	if ((fp = fopen(list_file, "r")) == NULL)
+		return (errno);
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		len = strlen(line);
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		if (cp->cp_nents == nalloc) {
+			nalloc = nalloc == 0 ? 4096 : nalloc * 2;
+			ents = realloc(cp->cp_ents,
+			    nalloc * sizeof (tm_copy_ent_t));
+			if (ents == NULL) {
+				(void) fclose(fp);
+				return (ENOMEM);
+			}
+			cp->cp_ents = ents;
+		}
+
+		ce = &cp->cp_ents[cp->cp_nents];
+		if (lstat(line, &ce->ce_st) != 0) {
+			tm_copy_error(cp, "Cannot stat <%s>: %s", line,
+			    strerror(errno));
+			continue;
+		}
+		if ((ce->ce_name = strdup(line)) == NULL) {
+			(void) fclose(fp);
+			return (ENOMEM);
+		}
+		ce->ce_master = -1;
+		cp->cp_nents++;
+		cp->cp_bytes_total += tm_copy_ent_bytes(ce);
+	}
+	cp->cp_files_total = cp->cp_nents;
+
+	(void) fclose(fp);
+	return (0);
+}
+
+/*
+ * Copy every pathname listed in list_file, relative to the current
+ * working directory, into dst_dir, using nthreads workers. If progress
+ * is not NULL, it is called from the calling thread as the copy proceeds
+ * and once more when it is complete.
+ *
+ * Returns 0 on success, ECANCELED if the copy was aborted or an errno
+ * value if the copy couldn't be started. Per file failures are logged
+ * and counted in *nerrors.
+ */
+static int
+tm_copy_filelist(const char *list_file, const char *dst_dir, int flags,
+    int nthreads, tm_copy_progress_t progress, void *arg, uint_t *nerrors)
+{
+	tm_copy_t	cp;
+	pthread_t	tids[TM_COPY_MAX_THREADS];
+	char		*buf;
+	size_t		i;
+	int		t, nstarted, ret;
+
+	(void) memset(&cp, 0, sizeof (cp));
+	(void) pthread_mutex_init(&cp.cp_lock, NULL);
+	(void) pthread_cond_init(&cp.cp_cv, NULL);
+	cp.cp_dst = dst_dir;
+	cp.cp_flags = flags;
+	cp.cp_chown = (geteuid() == 0);
+
+	if (nthreads <= 0) {
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		if (nthreads <= 0)
+			nthreads = 1;
+	}
+	nthreads = MIN(nthreads, TM_COPY_MAX_THREADS);
+
+	if ((ret = tm_copy_read_list(&cp, list_file)) != 0)
+		goto done;
+	if (tm_copy_find_links(&cp) != 0 ||
+	    (buf = malloc(TM_COPY_BUFSZ)) == NULL) {
+		ret = ENOMEM;
+		goto done;
+	}
+
+	ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_INFO,
+	    "Copying %lu entries from %s using %d threads\n",
+	    (ulong_t)cp.cp_nents, list_file, nthreads);
+
+	/* Directories first, in list order, so workers never race on them */
+	ls_trace_begin(LS_TRACE_TM, "copy_mkdirs", cp.cp_nents);
+	for (i = 0; i < cp.cp_nents && !tm_copy_aborted; i++) {
+		if (S_ISDIR(cp.cp_ents[i].ce_st.st_mode)) {
+			tm_copy_mkdir(&cp, &cp.cp_ents[i]);
+			tm_copy_account(&cp, 0, 1);
+		}
+	}
+	ls_trace_end(LS_TRACE_TM, "copy_mkdirs", 0);
+	tm_copy_report(&cp, progress, arg);
+
+	ls_trace_begin(LS_TRACE_TM, "copy_files", nthreads);
+
+	for (nstarted = 0; nstarted < nthreads && !tm_copy_aborted;
+	    nstarted++) {
+		cp.cp_nrunning++;
+		if (pthread_create(&tids[nstarted], NULL, tm_copy_worker,
+		    &cp) != 0) {
+			cp.cp_nrunning--;
+			break;
+		}
+	}
+	/* If no worker could be started, do the work ourselves */
+	if (nstarted == 0) {
+		cp.cp_nrunning++;
+		(void) tm_copy_worker(&cp);
+	}
+	tm_copy_wait(&cp, progress, arg);
+	for (t = 0; t < nstarted; t++)
+		(void) pthread_join(tids[t], NULL);
+	ls_trace_end(LS_TRACE_TM, "copy_files", cp.cp_bytes_done);
+
+	ls_trace_begin(LS_TRACE_TM, "copy_links", 0);
+	for (i = 0; i < cp.cp_nents && !tm_copy_aborted; i++) {
+		if (cp.cp_ents[i].ce_master != -1)
+			tm_copy_link(&cp, &cp.cp_ents[i], buf);
+	}
+	ls_trace_end(LS_TRACE_TM, "copy_links", 0);
+
+	/* Deepest directories first, as modes may deny write access */
+	ls_trace_begin(LS_TRACE_TM, "copy_dir_attrs", 0);
+	for (i = cp.cp_nents; i > 0 && !tm_copy_aborted; i--) {
+		if (S_ISDIR(cp.cp_ents[i - 1].ce_st.st_mode))
+			tm_copy_dir_attrs(&cp, &cp.cp_ents[i - 1], buf);
+	}
+	ls_trace_end(LS_TRACE_TM, "copy_dir_attrs", 0);
+
+	free(buf);
+	if (tm_copy_aborted)
+		ret = ECANCELED;
+	else
+		tm_copy_report(&cp, progress, arg);
+
+done:
+	for (i = 0; i < cp.cp_nents; i++)
+		free(cp.cp_ents[i].ce_name);
+	free(cp.cp_ents);
+	(void) pthread_cond_destroy(&cp.cp_cv);
+	(void) pthread_mutex_destroy(&cp.cp_lock);
+
+	*nerrors = cp.cp_nerrors;
+	return (ret);
+}
+
+/*
+ * Signal any running copy to stop as soon as possible.
+ */
+void
+tm_copy_abort(void)
+{
+	tm_copy_aborted = 1;
+}
+
+/*
+ * Forget an abort of a previous transfer. Called once when a transfer
+ * starts, so that an abort raised between its file lists is honored.
+ */
+void
+tm_copy_reset(void)
+{
+	tm_copy_aborted = 0;
+}
+
+/*
+ * Progress function handing the copy counters to a Python callable,
+ * reacquiring the interpreter lock for the duration of the call.
+ */
+static void
+tmod_copy_progress(void *arg, uint64_t bytes_done, uint64_t files_done,
+    uint64_t bytes_total, uint64_t files_total)
+{
+	tmod_copy_cb_t	*cb = arg;
+	PyObject	*ret;
+
+	PyEval_RestoreThread(cb->cb_state);
+	ret = PyObject_CallFunction(cb->cb_func, "KKKK",
+	    (unsigned PY_LONG_LONG)bytes_done,
+	    (unsigned PY_LONG_LONG)files_done,
+	    (unsigned PY_LONG_LONG)bytes_total,
+	    (unsigned PY_LONG_LONG)files_total);
+	if (ret == NULL)
+		PyErr_Print();
+	else
+		Py_DECREF(ret);
+	cb->cb_state = PyEval_SaveThread();
+}
+
+/*
+ * Python entry point:
+ *	copy_filelist(list_file, dst_dir, cpio_args, nthreads[, progress])
+ *	    -> (status, nerrors)
+ *
+ * cpio_args holds cpio(1) pass mode options; d, u and m are honored.
+ * progress, if given, is called as progress(bytes_done, files_done,
+ * bytes_total, files_total). The interpreter lock is released for the
+ * duration of the copy.
+ */
+/* ARGSUSED */
+PyObject *
+tmod_copy_filelist(PyObject *self, PyObject *args)
+{
+	char		*list_file, *dst_dir, *cpio_args;
+	int		nthreads, flags = 0;
+	uint_t		nerrors = 0;
+	int		ret;
+	tmod_copy_cb_t	cb;
+
+	cb.cb_func = NULL;
+	if (!PyArg_ParseTuple(args, "sssi|O", &list_file, &dst_dir,
+	    &cpio_args, &nthreads, &cb.cb_func))
+		return (NULL);
+	if (cb.cb_func == Py_None)
+		cb.cb_func = NULL;
+	if (cb.cb_func != NULL && !PyCallable_Check(cb.cb_func)) {
+		PyErr_SetString(PyExc_TypeError, "progress must be callable");
+		return (NULL);
+	}
+
+	if (strchr(cpio_args, 'd') != NULL)
+		flags |= TM_COPY_MKDIRS;
+	if (strchr(cpio_args, 'u') != NULL)
+		flags |= TM_COPY_UNCOND;
+	if (strchr(cpio_args, 'm') != NULL)
+		flags |= TM_COPY_MTIME;
+
+	cb.cb_state = PyEval_SaveThread();
+	ret = tm_copy_filelist(list_file, dst_dir, flags, nthreads,
+	    cb.cb_func != NULL ? tmod_copy_progress : NULL, &cb, &nerrors);
+	PyEval_RestoreThread(cb.cb_state);
+
+	return (Py_BuildValue("(iI)", ret, nerrors));
+}
+
+/* ARGSUSED */
+PyObject *
+tmod_copy_abort(PyObject *self, PyObject *args)
+{
+	tm_copy_abort();
+	return (Py_BuildValue("i", 0));
+}
+
+/* ARGSUSED */
+PyObject *
+tmod_copy_reset(PyObject *self, PyObject *args)
+{
+	tm_copy_reset();
+	return (Py_BuildValue("i", 0));
+}
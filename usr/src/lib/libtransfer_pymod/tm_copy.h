@@ -0,0 +1,73 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * tm_copy.h
+ *
+ * Private interface to the native copy engine of the transfer module
+ */
+
+#ifndef _TM_COPY_H
+#define	_TM_COPY_H
+
+#include <Python.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* upper bound on the number of copy worker threads */
+#define	TM_COPY_MAX_THREADS	16
+
+/* number of file list entries handed to a worker at a time */
+#define	TM_COPY_BATCH		32
+
+/* size of the per worker data copy buffer */
+#define	TM_COPY_BUFSZ		(256 * 1024)
+
+/* interval at which progress is reported while workers run */
+#define	TM_COPY_PROGRESS_MS	250
+
+/* cpio(1) pass mode options understood by the copy engine */
+#define	TM_COPY_MKDIRS		0x01	/* -d: create missing directories */
+#define	TM_COPY_UNCOND		0x02	/* -u: copy unconditionally */
+#define	TM_COPY_MTIME		0x04	/* -m: retain modification times */
+
+/* progress function, given bytes and files done out of the list totals */
+typedef void (*tm_copy_progress_t)(void *arg, uint64_t bytes_done,
+    uint64_t files_done, uint64_t bytes_total, uint64_t files_total);
+
+void tm_copy_abort(void);
+void tm_copy_reset(void);
+
+PyObject *tmod_copy_filelist(PyObject *self, PyObject *args);
+PyObject *tmod_copy_abort(PyObject *self, PyObject *args);
+PyObject *tmod_copy_reset(PyObject *self, PyObject *args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_COPY_H */
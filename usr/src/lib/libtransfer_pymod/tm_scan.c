@@ -0,0 +1,398 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Native tree scanner of the transfer module.
+ *
+ * Walks a directory tree like nftw(3C) with FTW_PHYS does (symbolic links
+ * are reported, not followed) and returns an inventory of everything found
+ * in it: the pathname, mode, size, link count and inode number of each
+ * object, every object being lstat'ed exactly once. Directories are read
+ * by a pool of threads sharing a stack of directories still to be read,
+ * which overlaps the latency of reading directories and inodes.
+ *
+ * Each thread keeps the entries it finds in an inventory of its own, so
+ * no locking is needed but for the directory stack. The order of the
+ * resulting inventory is unspecified, except that the root comes first.
+ */
+
+#include <Python.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ls_api.h>
+#include "tm_scan.h"
+
+#define	TRANSFER_ID "TRANSFERMOD"
+
+typedef struct tm_scan_ent {
+	char		*se_name;	/* pathname, starting with the root */
+	mode_t		se_mode;
+	nlink_t		se_nlink;
+	off_t		se_size;
+	ino_t		se_ino;
+} tm_scan_ent_t;
+
+typedef struct tm_scan_inv {
+	tm_scan_ent_t	*si_ents;
+	size_t		si_nents;
+	size_t		si_nalloc;
+} tm_scan_inv_t;
+
+/* directory waiting to be read, named by an inventory entry */
+typedef struct tm_scan_dir {
+	struct tm_scan_dir *sd_next;
+	const char	*sd_name;
+} tm_scan_dir_t;
+
+struct tm_scan;
+
+typedef struct tm_scan_worker {
+	struct tm_scan	*sw_scan;
+	tm_scan_inv_t	sw_inv;		/* entries found by this thread */
+} tm_scan_worker_t;
+
+typedef struct tm_scan {
+	tm_scan_dir_t	*sc_dirs;	/* directories still to be read */
+	pthread_mutex_t	sc_lock;
+	pthread_cond_t	sc_cv;		/* signaled as the stack changes */
+	int		sc_nbusy;	/* threads reading a directory */
+	boolean_t	sc_same_fs;	/* stay on the filesystem of the root */
+	dev_t		sc_dev;		/* filesystem of the root */
+	uint_t		sc_nerrors;
+	tm_scan_worker_t sc_workers[TM_SCAN_MAX_THREADS];
+} tm_scan_t;
+
+static void
+tm_scan_error(tm_scan_t *sc, const char *fmt, ...)
+{
+	char	buf[LS_MESSAGE_MAXLEN];
+	va_list	ap;
+
+	va_start(ap, fmt);
+	(void) vsnprintf(buf, sizeof (buf), fmt, ap);
+	va_end(ap);
+
+	ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_WARN, "%s\n", buf);
+
+	(void) pthread_mutex_lock(&sc->sc_lock);
+	sc->sc_nerrors++;
+	(void) pthread_mutex_unlock(&sc->sc_lock);
+}
+
+/*
+ * Add an entry for name to an inventory, which takes over name.
+ */
+static int
+tm_scan_add(tm_scan_inv_t *inv, char *name, struct stat *st)
+{
+	tm_scan_ent_t	*se;
+	size_t		nalloc;
+
+	if (inv->si_nents == inv->si_nalloc) {
+		nalloc = MAX(TM_SCAN_CHUNK, inv->si_nalloc * 2);
+		se = realloc(inv->si_ents, nalloc * sizeof (tm_scan_ent_t));
+		if (se == NULL)
+			return (ENOMEM);
+		inv->si_ents = se;
+		inv->si_nalloc = nalloc;
+	}
+
+	se = &inv->si_ents[inv->si_nents++];
+	se->se_name = name;
+	se->se_mode = st->st_mode;
+	se->se_nlink = st->st_nlink;
+	se->se_size = st->st_size;
+	se->se_ino = st->st_ino;
+	return (0);
+}
+
+/*
+ * Read a directory, adding its entries to the inventory and pushing its
+ * subdirectories onto the directory stack.
+ */
+static void
+tm_scan_dir(tm_scan_t *sc, tm_scan_inv_t *inv, const char *dname)
+{
+	DIR		*dirp;
+	struct dirent	*dp;
+	struct stat	st;
+	tm_scan_dir_t	*head = NULL, *tail = NULL, *sd;
+	size_t		dlen, len;
+	const char	*sep;
+	char		*name;
+
+	if ((dirp = opendir(dname)) == NULL) {
+		tm_scan_error(sc, "Cannot read directory %s: %s", dname,
+		    strerror(errno));
+		return;
+	}
+
+	dlen = strlen(dname);
+	sep = (dlen > 0 && dname[dlen - 1] == '/') ? "" : "/";
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 ||
+		    strcmp(dp->d_name, "..") == 0)
+			continue;
+
+		len = dlen + strlen(dp->d_name) + 2;
+		if ((name = malloc(len)) == NULL) {
+			tm_scan_error(sc, "Cannot allocate memory to scan %s",
+			    dname);
+			break;
+		}
+		(void) snprintf(name, len, "%s%s%s", dname, sep, dp->d_name);
+
+		if (lstat(name, &st) != 0) {
+			tm_scan_error(sc, "Cannot stat %s: %s", name,
+			    strerror(errno));
+			free(name);
+			continue;
+		}
+		if (tm_scan_add(inv, name, &st) != 0) {
+			tm_scan_error(sc, "Cannot allocate memory to scan %s",
+			    dname);
+			free(name);
+			break;
+		}
+
+		/* Emulate FTW_MOUNT if asked to */
+		if (!S_ISDIR(st.st_mode) ||
+		    (sc->sc_same_fs && st.st_dev != sc->sc_dev))
+			continue;
+
+		if ((sd = malloc(sizeof (tm_scan_dir_t))) == NULL) {
+			tm_scan_error(sc, "Cannot allocate memory to scan %s",
+			    name);
+			continue;
+		}
+		sd->sd_name = name;
+		sd->sd_next = head;
+		head = sd;
+		if (tail == NULL)
+			tail = sd;
+	}
+	(void) closedir(dirp);
+
+	if (head != NULL) {
+		(void) pthread_mutex_lock(&sc->sc_lock);
+		tail->sd_next = sc->sc_dirs;
+		sc->sc_dirs = head;
+		(void) pthread_cond_broadcast(&sc->sc_cv);
+		(void) pthread_mutex_unlock(&sc->sc_lock);
+	}
+}
+
+/*
+ * Read directories off the stack until it is empty and no other thread
+ * is reading one (which might push more).
+ */
+static void *
+tm_scan_worker(void *arg)
+{
+	tm_scan_worker_t	*sw = arg;
+	tm_scan_t		*sc = sw->sw_scan;
+	tm_scan_dir_t		*sd;
+
+	(void) pthread_mutex_lock(&sc->sc_lock);
+	for (;;) {
+		while (sc->sc_dirs == NULL && sc->sc_nbusy > 0)
+			(void) pthread_cond_wait(&sc->sc_cv, &sc->sc_lock);
+		if ((sd = sc->sc_dirs) == NULL)
+			break;
+		sc->sc_dirs = sd->sd_next;
+		sc->sc_nbusy++;
+		(void) pthread_mutex_unlock(&sc->sc_lock);
+
+		tm_scan_dir(sc, &sw->sw_inv, sd->sd_name);
+		free(sd);
+
+		(void) pthread_mutex_lock(&sc->sc_lock);
+		if (--sc->sc_nbusy == 0 && sc->sc_dirs == NULL)
+			(void) pthread_cond_broadcast(&sc->sc_cv);
+	}
+	(void) pthread_mutex_unlock(&sc->sc_lock);
+	return (NULL);
+}
+
+static void
+tm_scan_fini(tm_scan_t *sc)
+{
+	tm_scan_inv_t	*inv;
+	tm_scan_dir_t	*sd;
+	size_t		i;
+	int		t;
+
+	while ((sd = sc->sc_dirs) != NULL) {
+		sc->sc_dirs = sd->sd_next;
+		free(sd);
+	}
+	for (t = 0; t < TM_SCAN_MAX_THREADS; t++) {
+		inv = &sc->sc_workers[t].sw_inv;
+		for (i = 0; i < inv->si_nents; i++)
+			free(inv->si_ents[i].se_name);
+		free(inv->si_ents);
+	}
+	(void) pthread_cond_destroy(&sc->sc_cv);
+	(void) pthread_mutex_destroy(&sc->sc_lock);
+}
+
+/*
+ * Scan the tree under root into the inventories of sc, which the caller
+ * releases with tm_scan_fini(). Returns 0, or an errno value if the root
+ * itself can't be scanned. Objects which can't be scanned below the root
+ * are logged, counted in sc_nerrors and left out.
+ */
+static int
+tm_scan_tree(tm_scan_t *sc, const char *root, int nthreads,
+    boolean_t same_fs)
+{
+	pthread_t	tids[TM_SCAN_MAX_THREADS];
+	struct stat	st;
+	tm_scan_dir_t	*sd;
+	char		*name;
+	int		t, nstarted, ret;
+	size_t		nents;
+
+	(void) memset(sc, 0, sizeof (tm_scan_t));
+	(void) pthread_mutex_init(&sc->sc_lock, NULL);
+	(void) pthread_cond_init(&sc->sc_cv, NULL);
+	for (t = 0; t < TM_SCAN_MAX_THREADS; t++)
+		sc->sc_workers[t].sw_scan = sc;
+
+	if (nthreads <= 0)
+		nthreads = TM_SCAN_DEF_THREADS;
+	nthreads = MIN(nthreads, TM_SCAN_MAX_THREADS);
+
+	if (lstat(root, &st) != 0)
+		return (errno);
+	if ((name = strdup(root)) == NULL)
+		return (ENOMEM);
+	if ((ret = tm_scan_add(&sc->sc_workers[0].sw_inv, name, &st)) != 0) {
+		free(name);
+		return (ret);
+	}
+	if (!S_ISDIR(st.st_mode))
+		return (0);
+
+	if ((sd = malloc(sizeof (tm_scan_dir_t))) == NULL)
+		return (ENOMEM);
+	sd->sd_name = name;
+	sd->sd_next = NULL;
+	sc->sc_dirs = sd;
+	sc->sc_same_fs = same_fs;
+	sc->sc_dev = st.st_dev;
+
+	ls_trace_begin(LS_TRACE_TM, "scan_tree", nthreads);
+	for (nstarted = 0; nstarted < nthreads; nstarted++) {
+		if (pthread_create(&tids[nstarted], NULL, tm_scan_worker,
+		    &sc->sc_workers[nstarted]) != 0)
+			break;
+	}
+	/* If no thread could be started, do the work ourselves */
+	if (nstarted == 0)
+		(void) tm_scan_worker(&sc->sc_workers[0]);
+	for (t = 0; t < nstarted; t++)
+		(void) pthread_join(tids[t], NULL);
+
+	for (nents = 0, t = 0; t < TM_SCAN_MAX_THREADS; t++)
+		nents += sc->sc_workers[t].sw_inv.si_nents;
+	ls_trace_end(LS_TRACE_TM, "scan_tree", nents);
+	ls_write_dbg_message(TRANSFER_ID, LS_DBGLVL_INFO,
+	    "Scanned %lu entries under %s using %d threads, %u errors\n",
+	    (ulong_t)nents, root, MAX(nstarted, 1), sc->sc_nerrors);
+	return (0);
+}
+
+/*
+ * scan_tree(root[, nthreads[, same_fs]]) -> list
+ *
+ * Returns a (pathname, mode, size, nlink, inode) tuple for root and
+ * everything under it. If same_fs is set, directories on other
+ * filesystems are listed but not descended into. Raises OSError if root
+ * can't be scanned.
+ */
+/* ARGSUSED */
+PyObject *
+tmod_scan_tree(PyObject *self, PyObject *args)
+{
+	tm_scan_t	sc;
+	tm_scan_inv_t	*inv;
+	tm_scan_ent_t	*se;
+	PyThreadState	*state;
+	PyObject	*list, *item;
+	char		*root;
+	int		nthreads = 0, same_fs = 0;
+	int		ret, t;
+	size_t		i, n, nents;
+
+	if (!PyArg_ParseTuple(args, "s|ii", &root, &nthreads, &same_fs))
+		return (NULL);
+
+	state = PyEval_SaveThread();
+	ret = tm_scan_tree(&sc, root, nthreads, same_fs ? B_TRUE : B_FALSE);
+	PyEval_RestoreThread(state);
+
+	if (ret != 0) {
+		tm_scan_fini(&sc);
+		errno = ret;
+		return (PyErr_SetFromErrnoWithFilename(PyExc_OSError, root));
+	}
+
+	for (nents = 0, t = 0; t < TM_SCAN_MAX_THREADS; t++)
+		nents += sc.sc_workers[t].sw_inv.si_nents;
+	if ((list = PyList_New(nents)) == NULL) {
+		tm_scan_fini(&sc);
+		return (NULL);
+	}
+
+	for (n = 0, t = 0; t < TM_SCAN_MAX_THREADS && list != NULL; t++) {
+		inv = &sc.sc_workers[t].sw_inv;
+		for (i = 0; i < inv->si_nents; i++) {
+			se = &inv->si_ents[i];
+			item = Py_BuildValue("(sILIK)", se->se_name,
+			    (uint_t)se->se_mode, (long long)se->se_size,
+			    (uint_t)se->se_nlink,
+			    (unsigned long long)se->se_ino);
+			if (item == NULL) {
+				Py_DECREF(list);
+				list = NULL;
+				break;
+			}
+			PyList_SET_ITEM(list, n++, item);
+		}
+	}
+
+	tm_scan_fini(&sc);
+	return (list);
+}
@@ -0,0 +1,59 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * tm_scan.h
+ *
+ * Private interface to the native tree scanner of the transfer module
+ */
+
+#ifndef _TM_SCAN_H
+#define	_TM_SCAN_H
+
+#include <Python.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* upper bound on the number of scanner threads */
+#define	TM_SCAN_MAX_THREADS	16
+
+/*
+ * Number of scanner threads used by default. Scanning mostly waits on
+ * directory and inode reads, so this is not tied to the number of CPUs.
+ */
+#define	TM_SCAN_DEF_THREADS	8
+
+/* number of entries a scanner thread's inventory grows by at a time */
+#define	TM_SCAN_CHUNK		1024
+
+PyObject *tmod_scan_tree(PyObject *self, PyObject *args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_SCAN_H */